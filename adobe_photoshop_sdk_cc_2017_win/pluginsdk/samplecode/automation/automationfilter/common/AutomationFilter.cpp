@@ -26,6 +26,7 @@
 #include "AutomationFilterUI.h"
 #include "PITerminology.h"
 #include "PIStringTerminology.h"
+#include "PIUStringID.h"
 
 #define AFERROR(FUNC) if (true) { error = FUNC; if (error) throw(this); } else
 
@@ -48,6 +49,15 @@ SPErr gError = kSPNoError;
 // helper routine for the SuspendHistory()
 SPErr Execute(void * parameters);
 
+// checks what the hidden filter said for a batched command
+static SPErr CheckHiddenResult(PIActionDescriptor result);
+
+//-------------------------------------------------------------------------------
+// Locals
+//-------------------------------------------------------------------------------
+
+PIU_DECLARE_STRING_ID(gHiddenEventID, HiddenUniqueString);
+
 DLLExport SPAPI SPErr AutoPluginMain(
 	const char* caller,	// who is calling
 	const char* selector, // what do they want
@@ -308,10 +318,10 @@ SPErr AutomationFilterData::GetLayerNames(void)
 	DescriptorKeyID layerSectionTypeID = 0;
 	DescriptorKeyID layerSectionStartID = 0;
 	DescriptorKeyID layerSectionEndID = 0;
-	(void)sPSActionControl->StringIDToTypeID(klayerGroupStr, &layerSectionID);
-	(void)sPSActionControl->StringIDToTypeID(klayerGroupTypeStr, &layerSectionTypeID);
-	(void)sPSActionControl->StringIDToTypeID(klayerGroupStartStr, &layerSectionStartID);
-	(void)sPSActionControl->StringIDToTypeID(klayerGroupEndStr, &layerSectionEndID);
+	(void)PIUStringIDToTypeID(klayerGroupStr, &layerSectionID);
+	(void)PIUStringIDToTypeID(klayerGroupTypeStr, &layerSectionTypeID);
+	(void)PIUStringIDToTypeID(klayerGroupStartStr, &layerSectionStartID);
+	(void)PIUStringIDToTypeID(klayerGroupEndStr, &layerSectionEndID);
 
 	Auto_Desc result(false); // don't create one we pass into Get(...) routine
 	Auto_Ref reference;
@@ -462,29 +472,18 @@ SPErr AutomationFilterData::ExecuteHiddenFilter(DescriptorEnumID command,
 	DescriptorEnumID enumID = enumNoCommand;
 	DescriptorEnumTypeID typeID;
 	
-	AFERROR(sPSActionDescriptor->PutEnumerated(descriptor.get(), 
-		                                       keyCommand, 
-											   typeCommand, 
-											   command));
-
-	if (command == enumWrite)
-	{
-		if (nameOfChannel.length() == 0)
-			error = sPSActionDescriptor->PutInteger(descriptor.get(),
-													keyType,
-													(int32)typeOfChannel);
-		else
-			error = sPSActionDescriptor->PutString(descriptor.get(),
-												   keyChannelName,
-												   (char*)(nameOfChannel.c_str()));
-		if (error) throw(this);
+	AFERROR(PutHiddenParameters(descriptor.get(), 
+		                        command, 
+								nameOfChannel, 
+								typeOfChannel, 
+								percent));
 		
-		AFERROR(sPSActionDescriptor->PutInteger(descriptor.get(), keyPercent, percent));
-				
-	} // writing pass extra parameters
-		
-	AFERROR(sPSActionControl->StringIDToTypeID(HiddenUniqueString, 
-		                                       &hiddenEventID));
+	hiddenEventID = gHiddenEventID;
+	if (hiddenEventID == 0)
+	{
+		error = kSPBadParameterError;
+		throw(this);
+	}
 	
 	error = sPSActionControl->Play(&result, 
 		                           hiddenEventID, 
@@ -540,6 +539,113 @@ SPErr AutomationFilterData::ExecuteHiddenFilter(DescriptorEnumID command,
 
 
 
+//-------------------------------------------------------------------------------
+//
+//	AutomationFilterData::PutHiddenParameters
+//	
+//  Fill in the descriptor for a hidden filter command.
+//
+//-------------------------------------------------------------------------------
+SPErr AutomationFilterData::PutHiddenParameters(PIActionDescriptor descriptor,
+												DescriptorEnumID command, 
+												const string & nameOfChannel,
+												int16 typeOfChannel,
+												uint8 percent)
+{
+	SPErr putError = sPSActionDescriptor->PutEnumerated(descriptor, 
+		                                                keyCommand, 
+														typeCommand, 
+														command);
+	if (putError) return putError;
+
+	if (command == enumWrite)
+	{
+		if (nameOfChannel.length() == 0)
+			putError = sPSActionDescriptor->PutInteger(descriptor,
+													   keyType,
+													   (int32)typeOfChannel);
+		else
+			putError = sPSActionDescriptor->PutString(descriptor,
+													  keyChannelName,
+													  (char*)(nameOfChannel.c_str()));
+		if (putError) return putError;
+		
+		putError = sPSActionDescriptor->PutInteger(descriptor, keyPercent, percent);
+				
+	} // writing pass extra parameters
+
+	return putError;
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	AutomationFilterData::AddHiddenFilter
+//	
+//  Queue a hidden filter write on the batch. It is skipped if the command
+//	before it, selecting what to write to, failed.
+//
+//-------------------------------------------------------------------------------
+SPErr AutomationFilterData::AddHiddenFilter(PIUActionBatch & batch,
+											const string & nameOfChannel,
+											int16 typeOfChannel,
+											uint8 percent)
+{
+	PIActionDescriptor descriptor = NULL;
+
+	DescriptorTypeID hiddenEventID = gHiddenEventID;
+	if (hiddenEventID == 0)
+		return kSPBadParameterError;
+
+	SPErr addError = sPSActionDescriptor->Make(&descriptor);
+	if (addError) return addError;
+
+	addError = PutHiddenParameters(descriptor, 
+		                           enumWrite, 
+								   nameOfChannel, 
+								   typeOfChannel, 
+								   percent);
+	if (addError)
+	{
+		sPSActionDescriptor->Free(descriptor);
+		return addError;
+	}
+
+	// the batch owns the descriptor now
+	return batch.Add(hiddenEventID, 
+		             descriptor, 
+					 plugInDialogSilent, 
+					 CheckHiddenResult, 
+					 true);
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	CheckHiddenResult
+//	
+//	The hidden filter says enumOK in keyResult when it worked.
+//
+//-------------------------------------------------------------------------------
+static SPErr CheckHiddenResult(PIActionDescriptor result)
+{
+	DescriptorEnumID enumID = enumNoCommand;
+	DescriptorEnumTypeID typeID;
+
+	if (result == NULL)
+		return -1;
+
+	if (sPSActionDescriptor->GetEnumerated(result, keyResult, &typeID, &enumID) || 
+		enumID != enumOK)
+		return -1;
+
+	return kSPNoError;
+}
+
+
+
 //-------------------------------------------------------------------------------
 //
 //	AutomationFilterData::GetLayerName
@@ -582,21 +688,55 @@ void AutomationFilterData::GetChannelName(int32 index, string & outName)
 //-------------------------------------------------------------------------------
 void AutomationFilterData::ExecuteFilter(const string & layerName, const string & channelName, uint8 percentWhite)
 {
-	Boolean isBackground = true;
+	vector<string> layers(1, layerName);
+
+	(void)ExecuteFilter(layers, channelName, percentWhite);
+}
 
-	PIUSelectByName(classLayer, (char*)(layerName.c_str()));
-	PIUSelectByName(classChannel, (char*)(channelName.c_str()));
 
-	PIUGetInfo(classLayer, keyBackground, &isBackground, NULL);
 
-	if (!isBackground)
+//-------------------------------------------------------------------------------
+//
+//	AutomationFilterData::ExecuteFilter
+//	
+//	The same for each of the layers, all played as one batch. We are already
+//	inside SuspendHistory, see DoIt, so the batch only saves the redraws.
+//	Which layer is the background is known from GetLayerNames; it can not
+//	be asked for between the commands of a batch.
+//
+//-------------------------------------------------------------------------------
+SPErr AutomationFilterData::ExecuteFilter(const vector<string> & layers, const string & channelName, uint8 percentWhite)
+{
+	PIUActionBatch batch;
+	SPErr batchError = kSPNoError;
+
+	for (size_t index = 0; index < layers.size() && batchError == kSPNoError; index++)
 	{
-		// you are on a layer so set the transparency layer
-		string t;
-		ExecuteHiddenFilter(enumWrite, t, ctTransparency, 100);
+		bool isBackground = hasBackground && 
+			                layerNames.size() > 0 && 
+							layers[index] == layerNames[0];
+
+		batchError = batch.AddSelectByName(classLayer, layers[index].c_str());
+		if (batchError) break;
+
+		batchError = batch.AddSelectByName(classChannel, channelName.c_str(), true);
+		if (batchError) break;
+
+		if (!isBackground)
+		{
+			// you are on a layer so set the transparency layer
+			string t;
+			batchError = AddHiddenFilter(batch, t, ctTransparency, 100);
+			if (batchError) break;
+		}
+
+		batchError = AddHiddenFilter(batch, channelName, ctUnspecified, percentWhite);
 	}
 
-	ExecuteHiddenFilter(enumWrite, channelName, ctUnspecified, percentWhite);
+	// play what was queued even if queueing the rest failed
+	SPErr playError = batch.Play(NULL);
+
+	return batchError ? batchError : playError;
 }
 
 
@@ -29,6 +29,7 @@
 #include "HiddenCommands.h"
 #include "ASZStringSuite.h"
 #include "PIUSuites.h"
+#include "PIUActionBatch.h"
 
 
 using namespace std;
@@ -68,6 +69,15 @@ private:
 		                      const string & nameOfChannel,
 							  int16 typeOfChannel,
 							  uint8 percent);
+	SPErr PutHiddenParameters(PIActionDescriptor descriptor,
+							  DescriptorEnumID command, 
+		                      const string & nameOfChannel,
+							  int16 typeOfChannel,
+							  uint8 percent);
+	SPErr AddHiddenFilter(PIUActionBatch & batch,
+						  const string & nameOfChannel,
+						  int16 typeOfChannel,
+						  uint8 percent);
 	SPErr GetChannelNames(void);
 	SPErr GetLayerNames(void);
 
@@ -86,6 +96,10 @@ public:
 	void GetLayerName(int32 index, string & outName);
 	void GetChannelName(int32 index, string & outName);
 	void ExecuteFilter(const string & layerName, const string & channelName, uint8 percentWhite);
+
+	/// Run the filter on many layers, with one redraw at the end.
+	/// Returns the first error, the rest of the layers are still done.
+	SPErr ExecuteFilter(const vector<string> & layers, const string & channelName, uint8 percentWhite);
 	
 	/// Tell Photoshop to redraw everything, this is an expensive call
 	void Redraw(void);
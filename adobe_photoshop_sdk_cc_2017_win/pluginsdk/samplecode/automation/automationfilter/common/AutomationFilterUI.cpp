@@ -130,9 +130,8 @@ void AutomationFilterDialog::Notify(int32 item)
 	string channelName;
 	channelList.GetCurrentSelection(channelName);
 
+	// this redraws when it is done
 	_instance->ExecuteFilter(layerName, channelName, percentWhite);
-
-	_instance->Redraw();
 }
 
 #endif // #if !__LP64__
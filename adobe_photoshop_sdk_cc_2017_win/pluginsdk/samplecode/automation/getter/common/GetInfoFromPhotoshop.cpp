@@ -37,6 +37,8 @@
 #include "PITerminology.h"
 #include "PIStringTerminology.h"
 #include "PIUSelect.h"
+#include "PIULayerTable.h"
+#include "PIUStringID.h"
 #include <sstream>
 
 //-------------------------------------------------------------------------------
@@ -101,49 +103,41 @@ SPErr GetHistoryInfo(char* logfilename)
 //
 // get the layer information from each layer of each document
 //
+// Whole layer descriptors are slow to make, so rather than dumping one per
+// layer this asks each layer for just the properties below, through
+// PIULayerTable, and writes them to the log as a table, a line per layer.
+// Add to the list to see more; a whole descriptor is still there for the
+// asking with PIUGetInfoByIndexIndex and a desiredKey of 0.
+//
 //-------------------------------------------------------------------------------
 SPErr GetLayerInfo(char* logfilename)
 {
-	PIActionDescriptor	result = NULL;
-	int32				numDocuments, numLayers;
+	PIULayerTable		table;
 	SPErr				error = kSPNoError;
-	DescriptorTypeID	typeID = 0;
+	DescriptorKeyID		boundsKey = 0;
+	DescriptorKeyID		fillOpacityKey = 0;
 
-	sPSActionControl->StringIDToTypeID("Getting Layer Info", &typeID);
-
-	error = PIUGetInfo(classApplication, 
-		               keyNumberOfDocuments, 
-					   &numDocuments, 
-					   NULL);
-	
-	if (numDocuments > 0)	
-		for (int32 docCounter = 1; docCounter <= numDocuments && ! error; docCounter++)
-		{
-			error = PIUGetInfoByIndex(docCounter, 
-				                      classDocument, 
-									  keyNumberOfLayers, 
-									  &numLayers, 
-									  NULL);
+	(void) PIUStringIDToTypeID(kboundsStr, &boundsKey);
+	(void) PIUStringIDToTypeID(kfillOpacityStr, &fillOpacityKey);
 
-			if (numLayers > 0)
-				for (int32 layCounter = 1; 
-				     layCounter <= numLayers && error == kSPNoError; 
-					 layCounter++)
-				{
-					error = PIUGetInfoByIndexIndex(layCounter, 
-						                           docCounter, 
-												   classLayer, 
-												   classDocument, 
-												   0, 
-												   &result, 
-												   NULL);
+	table.AddProperty(keyName);
+	table.AddProperty(keyLayerID);
+	table.AddProperty(keyVisible);
+	table.AddProperty(keyOpacity);
+	table.AddProperty(keyMode);
+	if (fillOpacityKey) table.AddProperty(fillOpacityKey);
+	if (boundsKey) table.AddProperty(boundsKey);
 
-					PIUDumpDescriptor(typeID, result, logfilename);
+	error = table.Collect();
 
-					if (result) sPSActionDescriptor->Free(result);
-					result = NULL;
-				}
-		}
+	FILE * fd = fopen(logfilename, "a");
+	if (fd != NULL)
+	{
+		fprintf(fd, "Layer Info\n");
+		table.Write(fd);
+		fprintf(fd, "\n");
+		fclose(fd);
+	}
 
 	return (error);
 }
@@ -238,8 +232,8 @@ SPErr	GetPathInfo(char* logfilename)
 		}
 	}
 	
-	(void) sPSActionControl->StringIDToTypeID(kvectorMaskStr, &vectorMaskID);
-	(void) sPSActionControl->StringIDToTypeID(ktextShapeStr, &textMaskID);
+	(void) PIUStringIDToTypeID(kvectorMaskStr, &vectorMaskID);
+	(void) PIUStringIDToTypeID(ktextShapeStr, &textMaskID);
 
 	otherPathID[0] = vectorMaskID;
 	otherPathID[1] = textMaskID;
@@ -25,6 +25,12 @@
 
 #include "Listener.h"
 #include "PITerminology.h"
+#include "PIUReplayHost.h"
+#include "PIUStringID.h"
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
 
 #ifndef MAX_PATH
 #define MAX_PATH	256
@@ -40,10 +46,36 @@ SPPluginRef				gPlugInRef = NULL;
 std::string * gActionName = NULL;
 std::string * gActionSet = NULL;
 DescriptorEventID gEventID = 0;
+std::string * gPredicate = NULL;
 
 static bool notifierOn = false;
 
+// Release builds trace events through this instead of PIUDumpDescriptor
+static PIUDescriptorLog* gDescriptorLog = NULL;
+
 Listener_t* gListenerList = NULL;
+static Listener_t* gListenerListEnd = NULL;
+
+vector<ListenerSpec>* gListenerBatch = NULL;
+bool gRemoveListeners = false;
+
+string* gReplayPath = NULL;
+bool gReplayPaced = false;
+
+// The events a replay plays are not logged again, whether the host tells
+// us about them while they play or once the replay has returned
+static bool gReplaying = false;
+static bool gReplayNotified = false;
+static deque<DescriptorEventID> gReplayPending;
+
+// The registrations for one event, played in turn when it happens.  A
+// removal moves the last one into the gap, so the order is not kept.
+typedef vector<Listener_t*> ListenerBucket;
+
+// Registrations by event, for dispatch, and by event, action set and
+// action, for finding one to remove
+static unordered_map<DescriptorEventID, ListenerBucket> gListenersByEvent;
+static unordered_map<string, Listener_t*> gListenersByKey;
 
 //-------------------------------------------------------------------------------
 //	Prototypes.
@@ -61,6 +93,13 @@ static void Listener
 	/* IN */	void*					data		// Your user data. 
 );
 
+// Play and give up on the actions registered for an event:
+static bool PlayListeners (DescriptorEventID bucketID, DescriptorEventID event, PIActionDescriptor descriptor);
+static void ForgetListeners (DescriptorEventID bucketID);
+
+// Write down an event for the Event Dump notifier:
+static void LogEvent (DescriptorEventID event, PIActionDescriptor descriptor);
+
 // Our Event Dump notifier:
 static void EventDumper
 	(
@@ -79,8 +118,19 @@ static SPErr Shutdown (void);
 // Register to receive a notification:
 static SPErr DoRegister (void);
 
-// Track listeners in a list:
-static Listener_t* AddListenerToList (void);
+// Play a recording again and write how long each event took:
+static SPErr Replay (const string& path, bool paced);
+
+// Is this the event the host records for playing this plug-in?
+static bool IsOwnEvent (DescriptorEventID event);
+
+// Is this an event a replay played?
+static bool IsReplayedEvent (DescriptorEventID event);
+
+// Keep the registry:
+static string ListenerKey (DescriptorEventID event, const string& actionSet, const string& actionName);
+static SPErr AddListener (const ListenerSpec& spec);
+static SPErr RemoveListener (const string& key);
 
 //-------------------------------------------------------------------------------
 //
@@ -171,6 +221,34 @@ SPErr Execute(PIActionParameters* actionParams)
 	// Override globals with new descriptor info.
 	ReadScriptParams(actionParams); 
 	
+	// A list of listeners is registered, or unregistered, all at once,
+	// with no dialog:
+	if (gListenerBatch != NULL)
+	{
+		if (gRemoveListeners)
+			error = RemoveListeners(*gListenerBatch);
+		else
+			error = AddListeners(*gListenerBatch);
+
+		delete gListenerBatch;
+		gListenerBatch = NULL;
+		gRemoveListeners = false;
+
+		return error;
+	}
+
+	// So is a replay:
+	if (gReplayPath != NULL)
+	{
+		error = Replay(*gReplayPath, gReplayPaced);
+
+		delete gReplayPath;
+		gReplayPath = NULL;
+		gReplayPaced = false;
+
+		return error;
+	}
+
 	// Determine if we need to pop our dialog:
 	PIDialogPlayOptions playInfo = actionParams->playInfo;	
 	
@@ -193,6 +271,11 @@ SPErr Execute(PIActionParameters* actionParams)
 				delete gActionName;
 				gActionName = NULL;
 			}
+			if (gPredicate != NULL)
+			{
+				delete gPredicate;
+				gPredicate = NULL;
+			}
 		}
 	}
 
@@ -221,6 +304,102 @@ static void Initialize (void)
 	// initialization.
 }
 
+//-------------------------------------------------------------------------------
+//
+//	PlayListeners
+//
+//	Plays the actions registered in one bucket of the registry for an
+//	event, and stops playing the ones that fail.  Returns false when the
+//	bucket is empty, so the caller knows its notifier is left over.
+//
+//	A listener with a predicate only plays its action for the events
+//	that match it.  That is decided here, before anything is played, so
+//	a predicate that rules out the many events of a brush stroke keeps
+//	them from costing an action each.
+//
+//-------------------------------------------------------------------------------
+static bool PlayListeners
+	(
+	/* IN */	DescriptorEventID		bucketID,	// Registry bucket to play.
+	/* IN */	DescriptorEventID		event,		// Incoming event.
+	/* IN */	PIActionDescriptor		descriptor	// Event descriptor.
+)
+{
+	vector<string> failed;
+	bool registered = false;
+	size_t visited = 0;
+
+	// Playing an action can come back into this plug-in and change
+	// the registry, so look the bucket up again for each one
+	for (;;)
+	{
+		unordered_map<DescriptorEventID, ListenerBucket>::iterator found = gListenersByEvent.find(bucketID);
+		if (found == gListenersByEvent.end() || visited >= found->second.size())
+			break;
+
+		registered = true;
+
+		Listener_t* listener = found->second[visited++];
+
+		if (!MatchListenerPredicate(listener->predicate, event, descriptor))
+			continue;
+
+		// and the listener itself can be gone once its action has played
+		string key = ListenerKey(listener->eventID, listener->actionSet, listener->actionName);
+		string actionSet = listener->actionSet;
+		string actionName = listener->actionName;
+
+		SPErr error = PIUActionsPlayByName((char*)(actionSet.c_str()),
+										   (char*)(actionName.c_str()));
+		if (error)
+			failed.push_back(key);
+	}
+
+	// stop playing actions that fail
+	for (size_t f = 0; f < failed.size(); f++)
+		(void)RemoveListener(failed[f]);
+
+	return registered;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	ForgetListeners
+//
+//	Gives up on one bucket of the registry after its actions threw, so
+//	that adding to it later registers it with the host again.
+//
+//-------------------------------------------------------------------------------
+static void ForgetListeners
+	(
+	/* IN */	DescriptorEventID		bucketID	// Registry bucket to empty.
+)
+{
+	try
+	{
+		vector<ListenerSpec> specs;
+		unordered_map<DescriptorEventID, ListenerBucket>::iterator found = gListenersByEvent.find(bucketID);
+		if (found != gListenersByEvent.end())
+		{
+			for (size_t h = 0; h < found->second.size(); h++)
+			{
+				ListenerSpec spec = { bucketID, found->second[h]->actionSet, found->second[h]->actionName };
+				specs.push_back(spec);
+			}
+		}
+		if (!specs.empty())
+			(void)RemoveListeners(specs);
+		else if (bucketID != eventAll)
+			(void)sPSActionControl->RemoveNotify(gPlugInRef, bucketID);
+	}
+	catch (...)
+	{
+		// EventDumper has "eventAll", and it is not ours to take away
+		if (bucketID != eventAll)
+			(void)sPSActionControl->RemoveNotify(gPlugInRef, bucketID);
+	}
+}
+
 //-------------------------------------------------------------------------------
 //
 //	Listener
@@ -229,9 +408,14 @@ static void Initialize (void)
 //	registered for.
 //
 //	You can only have one listening proc registered per event, but you
-//	can have the same listening proc for multiple events.
+//	can have the same listening proc for multiple events.  So this one
+//	is registered once for each event in the registry, with the event as
+//	its data, and plays only the actions registered there; the cost of an
+//	event is its own actions, however many other events are registered.
 //
-//	Use "eventAll" to get notification of all actions events.
+//	"eventAll" already has EventDumper, and the host keeps one notifier
+//	per event, so the actions registered for "eventAll" are played from
+//	there and this routine is never registered for it.
 //
 //	MACINTOSH WARNING: Due to resource management problems, when this
 //	routine is called, **YOUR RESOURCE FORK IS CLOSED**.  If you need
@@ -248,113 +432,147 @@ static void Initialize (void)
 static void Listener
 	(
 	/* IN */	DescriptorEventID		event,		// Incoming event.
-	/* IN */	PIActionDescriptor		/* descriptor */,	// Event descriptor.
+	/* IN */	PIActionDescriptor		descriptor,	// Event descriptor.
 	/* IN */	PIDialogRecordOptions	/* options */,		// Outgoing dialog options.
-	/* IN */	void*					data				// Your user data. 
+	/* IN */	void*					data		// The event it was registered for. 
 )
 {
-    // do not throw back into Photoshop on callbacks
-    try
-    {
-        // This listener dispatches an action, stored in data:
-        if (data != NULL)
-        {
-            Listener_t* listener = (Listener_t*)data;
-
-            if (listener != NULL)
-            {
-                SPErr error = PIUActionsPlayByName((char*)(listener->actionSet.c_str()),
-				                           	       (char*)(listener->actionName.c_str()));
-                if (error)
-                {
-                    (void)sPSActionControl->RemoveNotify(gPlugInRef, event);
-                }
-            }
-            else
-            {
-                (void)sPSActionControl->RemoveNotify(gPlugInRef, event);
-            }
-        }
-        else
-        {
-            (void)sPSActionControl->RemoveNotify(gPlugInRef, event);
-        }
+	DescriptorEventID bucketID = (DescriptorEventID)(intptr_t)data;
+
+	// do not throw back into Photoshop on callbacks
+	try
+	{
+		// nothing to play, so the notifier is left over from something
+		if (!PlayListeners(bucketID, event, descriptor))
+			(void)sPSActionControl->RemoveNotify(gPlugInRef, bucketID);
+	}
+	catch (...)
+	{
+		ForgetListeners(bucketID);
 	}
-    
-    catch (...)
-    {
-        (void)sPSActionControl->RemoveNotify(gPlugInRef, event);
-    }
 
 }
 
 //-------------------------------------------------------------------------------
 //
-//	EventDumper
+//	LogEvent
 //
-//	This is the routine that gets notified for all events from Photoshop.
-//
-//	You can only have one listening proc registered per event, but you
-//	can have the same listening proc for multiple events.
-//
-//	Use "eventAll" to get notification of all actions events.   
+//	This writes down each event from Photoshop for EventDumper.
 //
 //	MACINTOSH WARNING: Due to resource management problems, when this
 //	routine is called, **YOUR RESOURCE FORK IS CLOSED**.  If you need
 //	resources from your fork, load them during startup or call your
 //	own plug-in using a Play() command.
 //
-//	The notifier is intended to show an automation plug in programmer
+//	The log is intended to show an automation plug in programmer
 //	how to put event descriptors together. The DumpDescriptor routine
 //	takes the event that just happened and walks through the descriptor
 //	dumping everything that it finds.
 //
-//	NOTE: THIS IS FOR THE DEBUG BUILD OF THIS PLUG IN ONLY. THE DEBUG
-//	LIBRARY IS RATHER LARGE AND YOU PROBABLY DON'T WANT IT IN YOUR
-//	SHIPPING PLUG IN.  
+//	NOTE: THE C CODE DUMP IS FOR THE DEBUG BUILD OF THIS PLUG IN ONLY. THE
+//	DEBUG LIBRARY IS RATHER LARGE AND YOU PROBABLY DON'T WANT IT IN YOUR
+//	SHIPPING PLUG IN.  A release build writes a plain trace of every
+//	kListenerLogSampling'th event instead, through PIUDescriptorLog, which
+//	copies the descriptor here and does the writing on its own thread.
+//	That trace is the binary recording Listener.pirec unless
+//	kListenerLogFormat asks for text.
 //	
 //-------------------------------------------------------------------------------
-static void EventDumper
+static void LogEvent
 	(
-	/* IN */	DescriptorEventID		 event ,		// Incoming event.
-	/* IN */	PIActionDescriptor		 descriptor ,	// Event descriptor.
-	/* IN */	PIDialogRecordOptions	 /*options*/,		// Outgoing dialog options.
-	/* IN */	void*					/*data*/			// Your user data. 
+	/* IN */	DescriptorEventID		event,		// Incoming event.
+	/* IN */	PIActionDescriptor		descriptor	// Event descriptor.
 )
 {
-    
-    // do not throw back into Photoshop on callbacks
-    try
+    static char logfilename[MAX_PATH];
+    static TryState gotFullPath = kUnknown;
+
+    if (kUnknown == gotFullPath)
     {
-        static char logfilename[MAX_PATH];
-        static TryState gotFullPath = kUnknown;
+        gotFullPath = kFalse;
 
-        if (kUnknown == gotFullPath)
+        if (GetFullPathToDesktop(logfilename, MAX_PATH))
         {
-            gotFullPath = kFalse;
-
-            if (GetFullPathToDesktop(logfilename, MAX_PATH))
-            {
-                logfilename[0] = '\0';
-                return;
-            }
+            logfilename[0] = '\0';
+            return;
+        }
 
-            if (PIstrlcat(logfilename, "Listener.log", MAX_PATH-1) >= MAX_PATH-1)
-                return;
+        #ifdef _DEBUG
+            const char* logname = "Listener.log";
+        #else
+            const char* logname = kListenerLogFormat == kDescriptorLogRecording ? "Listener.pirec" : "Listener.log";
+        #endif
 
-            gotFullPath = kTrue;
+        if (PIstrlcat(logfilename, logname, MAX_PATH-1) >= MAX_PATH-1)
+            return;
 
-        }
+        gotFullPath = kTrue;
 
-        if (kTrue == gotFullPath)
-            PIUDumpDescriptor(event, descriptor, logfilename);
     }
-    catch(...)
+
+    // a replay of a log with our own event in it would play itself
+    if (kTrue == gotFullPath && !IsOwnEvent(event))
     {
-        // ignore error but try and
-        // remove myself from this event as I am having some trouble it seems
-        (void)sPSActionControl->RemoveNotify(gPlugInRef, eventAll);
+        #ifdef _DEBUG
+            PIUDumpDescriptor(event, descriptor, logfilename);
+        #else
+            if (gDescriptorLog == NULL)
+                gDescriptorLog = new PIUDescriptorLog(logfilename, kListenerLogSampling, kListenerLogFormat);
+            gDescriptorLog->Log(event, descriptor);
+        #endif
     }
+}
+
+//-------------------------------------------------------------------------------
+//
+//	EventDumper
+//
+//	This is the routine that gets notified for all events from Photoshop.
+//	It logs the event, then plays the actions registered for "eventAll",
+//	which cannot have a notifier of their own while this one has it.
+//
+//	A log that fails stops logging, but the notifier is only taken away
+//	when there is nothing registered for "eventAll" to keep it for.
+//
+//-------------------------------------------------------------------------------
+static void EventDumper
+	(
+	/* IN */	DescriptorEventID		 event ,		// Incoming event.
+	/* IN */	PIActionDescriptor		 descriptor ,	// Event descriptor.
+	/* IN */	PIDialogRecordOptions	 /*options*/,		// Outgoing dialog options.
+	/* IN */	void*					/*data*/			// Your user data. 
+)
+{
+	static bool logging = true;
+
+	// do not throw back into Photoshop on callbacks
+	try
+	{
+		// what a replay played is not logged again
+		if (!IsReplayedEvent(event) && logging)
+			LogEvent(event, descriptor);
+	}
+	catch(...)
+	{
+		// ignore error but stop logging, and remove myself from this
+		// event unless actions registered for it still need me
+		logging = false;
+		if (gListenersByEvent.find(eventAll) == gListenersByEvent.end())
+		{
+			(void)sPSActionControl->RemoveNotify(gPlugInRef, eventAll);
+			notifierOn = false;
+			return;
+		}
+	}
+
+	try
+	{
+		(void)PlayListeners(eventAll, event, descriptor);
+	}
+	catch (...)
+	{
+		ForgetListeners(eventAll);
+	}
 
 }
 
@@ -428,37 +646,23 @@ static SPErr Startup (void)
 //	Shutdown
 //
 //	It's our responsibility to unregister any notifiers or memory we allocated
-//	at startup.  So we iterate through the listener list, both removing
-//	any notifiers and cleaning out memory.
+//	at startup.  So we empty the registry, which removes the notifier for
+//	each event in it.
 //
 //-------------------------------------------------------------------------------
 static SPErr Shutdown (void)
 {
-	SPErr error = kSPNoError;
-	
-	Listener_t* thisList = gListenerList;
-	
-	while (thisList != NULL)
-	{
-		gEventID = thisList->eventID;
-	
-		error = sPSActionControl->RemoveNotify(gPlugInRef,
-											   gEventID);
-
-		gEventID = 0;
-		thisList->eventID = 0;
-		
-		Listener_t* nextList = thisList->next;
-		delete thisList;
-		
-		thisList = nextList;
-	}		
+	SPErr error = RemoveAllListeners();
 
 	if (notifierOn)
 			error = sPSActionControl->RemoveNotify(
 				gPlugInRef,
 				eventAll);				// Event we registered.
 
+	// writes out whatever is still queued
+	delete gDescriptorLog;
+	gDescriptorLog = NULL;
+
 	// clean up after ourselves
 	PIUSuitesRelease();
 
@@ -474,62 +678,347 @@ static SPErr Shutdown (void)
 //-------------------------------------------------------------------------------
 static SPErr DoRegister (void)
 {
-	SPErr error = kSPNoError;
-	
+	if (gActionName == NULL || gActionSet == NULL)
+		return kSPBadParameterError;
+
 	// Once you run this, gActionName, gActionSet, gEventID are all
-	// set to NULL (so they aren't accidentally deleted by someone)
-	// and you must use newListener->actionName, newListener->actionSet,
-	// and newListener->eventID to get at this info:
-	Listener_t* newListener = AddListenerToList();
-
-	error = sPSActionControl->AddNotify(gPlugInRef,
-										newListener->eventID, // event to listen for
-										Listener, // Proc for listening routine.
-										(void*)newListener); // User data.
-	return error;
+	// cleared and the registration has them instead:
+	vector<ListenerSpec> specs(1);
+	specs[0].eventID = gEventID;
+	specs[0].actionName = *gActionName;
+	specs[0].actionSet = *gActionSet;
+	if (gPredicate != NULL)
+		specs[0].predicate = *gPredicate;
+
+	gEventID = 0;
+	delete gActionName;
+	gActionName = NULL;
+	delete gActionSet;
+	gActionSet = NULL;
+	delete gPredicate;
+	gPredicate = NULL;
+
+	return AddListeners(specs);
+}
+
+//-------------------------------------------------------------------------------
+//
+//	Replay
+//
+//	Plays the events of a recording, such as the Listener.pirec a release
+//	build writes, and writes the times next to it: path.txt has a line per
+//	event with its count and latencies, and path.folded has them as
+//	collapsed stacks for a flame graph tool.  Record what is slow once,
+//	then replay it before and after a change to see what the change did.
+//	Events that fail are counted, and the rest are still played.
+//	Our own event is never logged, but a recording made some other way
+//	can still have it, so a replay does not start another one.
+//
+//	The host can tell EventDumper about a played event while it plays or
+//	after this plug-in returns.  ListenerReplayHost notes which, and keeps
+//	the ones still to come for IsReplayedEvent to leave out of the log.
+//
+//-------------------------------------------------------------------------------
+class ListenerReplayHost : public PIUReplayHost {
+public:
+	virtual int Play(const PIURecordingReader& reader, const RecordedEvent& event)
+	{
+		gReplayNotified = false;
+
+		int error = PIUReplayHost::Play(reader, event);
+
+		if (error == kSPNoError && !gReplayNotified)
+			gReplayPending.push_back(ID(reader, event.event));
+
+		return error;
+	}
+};
+
+static SPErr Replay (const string& path, bool paced)
+{
+	if (gReplaying)
+		return kSPBadParameterError;
+
+	ifstream file(path.c_str(), ios::in | ios::binary);
+	if (!file)
+		return kSPBadParameterError;
+
+	vector<uint8_t> recording((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	if (recording.empty())
+		return kSPBadParameterError;
+
+	ListenerReplayHost host;
+	PIUReplay replay(host);
+	PIUReplayOptions options;
+	options.paced = paced;
+
+	gReplaying = true;
+	bool ok = replay.Run(&recording[0], recording.size(), options);
+	gReplaying = false;
+
+	FILE* summary = fopen((path + ".txt").c_str(), "w");
+	if (summary != NULL)
+	{
+		replay.WriteSummary(summary);
+		fclose(summary);
+	}
+
+	FILE* folded = fopen((path + ".folded").c_str(), "w");
+	if (folded != NULL)
+	{
+		replay.WriteFolded(folded);
+		fclose(folded);
+	}
+
+	return ok ? kSPNoError : kSPBadParameterError;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	IsOwnEvent
+//
+//	A plug-in with a unique string is recorded under the runtime ID of that
+//	string rather than under plugInEventID, so both are ours.
+//
+//-------------------------------------------------------------------------------
+static bool IsOwnEvent (DescriptorEventID event)
+{
+	static DescriptorEventID runtimeEventID = 0;
+	static bool lookedUp = false;
+
+	if (!lookedUp)
+	{
+		lookedUp = true;
+		if (PIUStringIDToTypeID(vendorName " " plugInName, &runtimeEventID) != kSPNoError)
+			runtimeEventID = 0;
+	}
+
+	return event == plugInEventID || (runtimeEventID != 0 && event == runtimeEventID);
+}
+
+//-------------------------------------------------------------------------------
+//
+//	IsReplayedEvent
+//
+//	While a replay plays, every event is its own.  After it, the events it
+//	played that were not heard from yet come in the order they were
+//	played; one the host never told us about is passed over by the next
+//	that does come.
+//
+//-------------------------------------------------------------------------------
+static bool IsReplayedEvent (DescriptorEventID event)
+{
+	if (gReplaying)
+	{
+		gReplayNotified = true;
+		return true;
+	}
+
+	deque<DescriptorEventID>::iterator found = find(gReplayPending.begin(), gReplayPending.end(), event);
+	if (found == gReplayPending.end())
+		return false;
+
+	gReplayPending.erase(gReplayPending.begin(), found + 1);
+	return true;
 }
 
 //-------------------------------------------------------------------------------
 //
 //	ListenerUtils
 //
-//	Utility routines to track a list of listener events and actions.
+//	Utility routines to track the registered listener events and actions.
+//	gListenerList links them all, in the order they were added, for the
+//	dialog; the two maps find them.
 //
 //-------------------------------------------------------------------------------
 Listener_t* FindListenerListEnd (void)
 {
-	Listener_t* thisList = gListenerList;
-	
-	while (thisList != NULL && thisList->next != NULL)
-		thisList = thisList->next;
+	return gListenerListEnd;
+}
 
-	return thisList;
+static string ListenerKey (DescriptorEventID event, const string& actionSet, const string& actionName)
+{
+	string key(reinterpret_cast<const char*>(&event), sizeof(event));
+	key += actionSet;
+	key += '\0';
+	key += actionName;
+	return key;
 }
-	
-static Listener_t* AddListenerToList (void)
+
+static SPErr AddListener (const ListenerSpec& spec)
 {
-	Listener_t* listEnd = FindListenerListEnd();
-	
+	string key = ListenerKey(spec.eventID, spec.actionSet, spec.actionName);
+
+	ListenerPredicate* predicate = NULL;
+	SPErr error = AcquireListenerPredicate(spec.predicate, &predicate);
+	if (error)
+		return error;
+
+	unordered_map<string, Listener_t*>::iterator found = gListenersByKey.find(key);
+	if (found != gListenersByKey.end())
+	{
+		ReleaseListenerPredicate(found->second->predicate);
+		found->second->predicate = predicate;
+		return kSPNoError;
+	}
+
+	ListenerBucket& bucket = gListenersByEvent[spec.eventID];
+
+	// the first action for an event is when the host needs to know, but
+	// "eventAll" is played from EventDumper, which only needs to be there
+	if (bucket.empty() && spec.eventID == eventAll)
+	{
+		if (!notifierOn)
+		{
+			error = sPSActionControl->AddNotify(gPlugInRef,
+												eventAll, // event to listen for
+												EventDumper, // Proc for listening routine.
+												NULL); // User data.
+			if (!error)
+				notifierOn = true;
+		}
+		if (error)
+		{
+			gListenersByEvent.erase(spec.eventID);
+			ReleaseListenerPredicate(predicate);
+			return error;
+		}
+	}
+	else if (bucket.empty())
+	{
+		error = sPSActionControl->AddNotify(gPlugInRef,
+											spec.eventID, // event to listen for
+											Listener, // Proc for listening routine.
+											(void*)(intptr_t)spec.eventID); // The bucket it plays.
+		if (error)
+		{
+			gListenersByEvent.erase(spec.eventID);
+			ReleaseListenerPredicate(predicate);
+			return error;
+		}
+	}
+
 	Listener_t* newListener = new Listener_t;
-	
-	newListener->eventID = gEventID;	
-	gEventID = 0;
-		
-	// Same for action name:
-	newListener->actionName = *gActionName;
-	gActionName = NULL;
-	
-	newListener->actionSet = *gActionSet;
-	gActionSet = NULL;
-		
+	newListener->eventID = spec.eventID;
+	newListener->actionName = spec.actionName;
+	newListener->actionSet = spec.actionSet;
+	newListener->predicate = predicate;
+	newListener->slot = bucket.size();
+
+	bucket.push_back(newListener);
+	gListenersByKey[key] = newListener;
+
 	newListener->next = NULL;
-	
-	if (listEnd != NULL)
-		listEnd->next = newListener;
+	newListener->previous = gListenerListEnd;
+	if (gListenerListEnd != NULL)
+		gListenerListEnd->next = newListener;
 	else
 		gListenerList = newListener;
-	
-	return newListener;
+	gListenerListEnd = newListener;
+
+	return kSPNoError;
+}
+
+static SPErr RemoveListener (const string& key)
+{
+	unordered_map<string, Listener_t*>::iterator found = gListenersByKey.find(key);
+	if (found == gListenersByKey.end())
+		return kSPNoError;
+
+	Listener_t* listener = found->second;
+	gListenersByKey.erase(found);
+
+	SPErr error = kSPNoError;
+	ListenerBucket& bucket = gListenersByEvent[listener->eventID];
+
+	bucket[listener->slot] = bucket.back();
+	bucket[listener->slot]->slot = listener->slot;
+	bucket.pop_back();
+
+	// and the last is when it can stop telling us, but EventDumper
+	// keeps "eventAll" for the log
+	if (bucket.empty())
+	{
+		if (listener->eventID != eventAll)
+			error = sPSActionControl->RemoveNotify(gPlugInRef, listener->eventID);
+		gListenersByEvent.erase(listener->eventID);
+	}
+
+	if (listener->previous != NULL)
+		listener->previous->next = listener->next;
+	else
+		gListenerList = listener->next;
+	if (listener->next != NULL)
+		listener->next->previous = listener->previous;
+	else
+		gListenerListEnd = listener->previous;
+
+	ReleaseListenerPredicate(listener->predicate);
+	delete listener;
+
+	return error;
+}
+
+SPErr AddListeners (const vector<ListenerSpec>& specs)
+{
+	SPErr error = kSPNoError;
+
+	for (size_t s = 0; s < specs.size(); s++)
+	{
+		SPErr added = AddListener(specs[s]);
+		if (error == kSPNoError)
+			error = added;
+	}
+
+	return error;
+}
+
+SPErr RemoveListeners (const vector<ListenerSpec>& specs)
+{
+	SPErr error = kSPNoError;
+
+	for (size_t s = 0; s < specs.size(); s++)
+	{
+		SPErr removed = RemoveListener(ListenerKey(specs[s].eventID, specs[s].actionSet, specs[s].actionName));
+		if (error == kSPNoError)
+			error = removed;
+	}
+
+	return error;
+}
+
+SPErr RemoveAllListeners (void)
+{
+	SPErr error = kSPNoError;
+
+	for (unordered_map<DescriptorEventID, ListenerBucket>::iterator event = gListenersByEvent.begin();
+		 event != gListenersByEvent.end();
+		 ++event)
+	{
+		if (event->first == eventAll)
+			continue;
+
+		SPErr removed = sPSActionControl->RemoveNotify(gPlugInRef, event->first);
+		if (error == kSPNoError)
+			error = removed;
+	}
+
+	Listener_t* thisList = gListenerList;
+
+	while (thisList != NULL)
+	{
+		Listener_t* nextList = thisList->next;
+		ReleaseListenerPredicate(thisList->predicate);
+		delete thisList;
+		thisList = nextList;
+	}
+
+	gListenerList = NULL;
+	gListenerListEnd = NULL;
+	gListenersByEvent.clear();
+	gListenersByKey.clear();
+
+	return error;
 }
 
 // end Listener.cpp
\ No newline at end of file
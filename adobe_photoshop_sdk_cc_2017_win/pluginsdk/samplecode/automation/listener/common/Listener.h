@@ -40,6 +40,8 @@
 #include "PIUSuites.h"
 #include "PIUActions.h"
 #include "PIUGet.h"
+#include "PIUDescriptorLog.h"
+#include "ListenerPredicate.h"
 #if __PIMac__
 	#include <stdio.h>
 #endif
@@ -52,14 +54,38 @@ typedef struct Listener_t
 	string 		actionName;
 	string 		actionSet;
 	DescriptorEventID 	eventID;
-	Listener_t*			next;
+	ListenerPredicate*	predicate;	// NULL to play on every event
+	Listener_t*			next;		// every registration, oldest first
+	Listener_t*			previous;
+	size_t				slot;		// index in its event's ListenerBucket
 } Listener_t;
 
+// One event and the action to play when it happens, for registering and
+// unregistering many at once
+typedef struct ListenerSpec
+{
+	DescriptorEventID	eventID;
+	string				actionSet;
+	string				actionName;
+	string				predicate;	// see ListenerPredicate.h; empty for none
+} ListenerSpec;
+
 extern string* gActionName;
 extern string* gActionSet;
 extern DescriptorEventID gEventID;
+extern string* gPredicate;
 extern Listener_t* gListenerList;
 
+// From a scripted call with a list of listeners, and whether to remove
+// them rather than add them.  NULL otherwise.
+extern vector<ListenerSpec>* gListenerBatch;
+extern bool gRemoveListeners;
+
+// From a scripted call with a recording to replay, and whether to keep
+// its pace.  NULL otherwise.
+extern string* gReplayPath;
+extern bool gReplayPaced;
+
 extern SPBasicSuite* sSPBasic;
 extern SPPluginRef gPlugInRef;
 //-------------------------------------------------------------------------------
@@ -76,11 +102,27 @@ void DoAbout (SPPluginRef plugin, int dialogID);
 SPErr DoUI(void);
 Listener_t* FindListenerListEnd( void );
 
+// The registry.  Adding, removing and finding a registration take the same
+// time however many there are, and each event has one notifier with the
+// host however many actions it plays.  Adding one that is already there
+// only changes its predicate, and removing one that is not does nothing.
+SPErr AddListeners( const vector<ListenerSpec>& specs );
+SPErr RemoveListeners( const vector<ListenerSpec>& specs );
+SPErr RemoveAllListeners( void );
+
 //-------------------------------------------------------------------------------
 //	Constants.
 //-------------------------------------------------------------------------------
 const int32 kMaxStr255Len = 255; // Maximum standard string length. (Pascal, etc.)
 
+// Release builds log one event in this many; 0 turns the log off.
+const uint32 kListenerLogSampling = 1;
+
+// Release builds write a binary recording, Listener.pirec, that the
+// DescriptorDecoder tool in misc turns back into text; kDescriptorLogText
+// writes Listener.log as text directly.
+const PIUDescriptorLogFormat kListenerLogFormat = kDescriptorLogRecording;
+
 //-------------------------------------------------------------------------------
 
 #endif // __Listener_H__
@@ -26,12 +26,12 @@
 
 // Dictionary (aete) resources:
 
-#define vendorName			"AdobeSDK"
 #define plugInAETEComment 	"Listener persistent actions plug-in"
 
 #define plugInSuiteID		'sdKG'
 #define plugInClassID		plugInSuiteID
-#define plugInEventID		'lstN'
+
+// vendorName and plugInEventID are in ListenerTerminology.h
 
 //-------------------------------------------------------------------------------
 //	Set up included files for Macintosh and Windows.
@@ -152,7 +152,73 @@ resource 'aete' (ListenerResourceID, plugInName " dictionary", purgeable)
 				// optional description:
 				"",
 				// flags:
-				flagsSingleParameter
+				flagsSingleParameter,
+
+				// name:
+				"event",
+				// key ID:
+				keyPIEvent,
+				// type ID:
+				typeType,
+				// optional description:
+				"",
+				// flags:
+				flagsOptionalSingleParameter,
+
+				// name:
+				"when",
+				// key ID:
+				keyPIWhen,
+				// type ID:
+				typeChar,
+				// optional description:
+				"only play the action for events that match",
+				// flags:
+				flagsOptionalSingleParameter,
+
+				// name:
+				"listeners",
+				// key ID:
+				keyPIListeners,
+				// type ID:
+				typeValueList,
+				// optional description:
+				"event, action set and action of each",
+				// flags:
+				flagsOptionalSingleParameter,
+
+				// name:
+				"remove",
+				// key ID:
+				keyPIRemove,
+				// type ID:
+				typeBoolean,
+				// optional description:
+				"unregister the listeners",
+				// flags:
+				flagsOptionalSingleParameter,
+
+				// name:
+				"replay",
+				// key ID:
+				keyPIReplay,
+				// type ID:
+				typeChar,
+				// optional description:
+				"full path of a recording to play again and time",
+				// flags:
+				flagsOptionalSingleParameter,
+
+				// name:
+				"paced",
+				// key ID:
+				keyPIPaced,
+				// type ID:
+				typeBoolean,
+				// optional description:
+				"replay at the pace it was recorded",
+				// flags:
+				flagsOptionalSingleParameter
 				}
 			},
 			{},	/* non-filter/automation plug-in class here */
@@ -0,0 +1,453 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		ListenerPredicate.cpp
+//
+//	Description:
+//		Compiles and matches listener predicates.  A predicate is read
+//		once, when the first listener with its text is registered, into
+//		terms of sorted IDs and values, so matching an event is a few
+//		descriptor reads and binary searches.
+//
+//-------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+
+#include "Listener.h"
+#include "PITerminology.h"
+#include "PIUStringID.h"
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+#include <unordered_map>
+
+//-------------------------------------------------------------------------------
+//	Globals
+//-------------------------------------------------------------------------------
+
+// Every compiled predicate, by its text
+static unordered_map<string, ListenerPredicate*> gPredicates;
+
+//-------------------------------------------------------------------------------
+//	Prototypes.
+//-------------------------------------------------------------------------------
+
+static SPErr CompilePredicate( const string& text, ListenerPredicate& predicate );
+static SPErr ReadValue( const string& text, size_t& at, PredicateTerm& term );
+static SPErr ReadID( const string& text, size_t& at, uint32& id, string& name );
+static bool MatchTerm( const PredicateTerm& term,
+					   DescriptorEventID event,
+					   PIActionDescriptor descriptor );
+static bool MatchKey( const PredicateTerm& term, PIActionDescriptor descriptor );
+static bool HasID( const PredicateTerm& term, uint32 id );
+static int TermCost( const PredicateTerm& term );
+static bool CheaperTerm( const PredicateTerm& a, const PredicateTerm& b );
+
+//-------------------------------------------------------------------------------
+//
+//	AcquireListenerPredicate
+//
+//	Shares one compiled predicate between the listeners with the same
+//	text.  Empty text is no predicate, NULL and no error.
+//
+//-------------------------------------------------------------------------------
+SPErr AcquireListenerPredicate( const string& text, ListenerPredicate** predicate )
+{
+	*predicate = NULL;
+
+	if ( text.find_first_not_of( " \t\r\n" ) == string::npos )
+		return kSPNoError;
+
+	unordered_map<string, ListenerPredicate*>::iterator found = gPredicates.find( text );
+	if ( found != gPredicates.end() )
+	{
+		found->second->users++;
+		*predicate = found->second;
+		return kSPNoError;
+	}
+
+	ListenerPredicate* compiled = new ListenerPredicate;
+	compiled->text = text;
+	compiled->users = 1;
+	compiled->tested = 0;
+	compiled->hits = 0;
+
+	SPErr error = CompilePredicate( text, *compiled );
+	if ( error != kSPNoError )
+	{
+		delete compiled;
+		return error;
+	}
+
+	gPredicates[text] = compiled;
+	*predicate = compiled;
+
+	return kSPNoError;
+}
+
+void ReleaseListenerPredicate( ListenerPredicate* predicate )
+{
+	if ( predicate == NULL || --predicate->users > 0 )
+		return;
+
+	gPredicates.erase( predicate->text );
+	delete predicate;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	MatchListenerPredicate
+//
+//	Terms are tried cheapest first, and the first that fails decides, so
+//	an event that the event ID rules out costs no descriptor reads.
+//
+//-------------------------------------------------------------------------------
+bool MatchListenerPredicate( ListenerPredicate* predicate,
+							 DescriptorEventID event,
+							 PIActionDescriptor descriptor )
+{
+	if ( predicate == NULL )
+		return true;
+
+	predicate->tested++;
+
+	for ( size_t t = 0; t < predicate->terms.size(); t++ )
+	{
+		if ( !MatchTerm( predicate->terms[t], event, descriptor ) )
+			return false;
+	}
+
+	predicate->hits++;
+
+	return true;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	CompilePredicate
+//
+//	Reads the terms of text into predicate, see ListenerPredicate.h.
+//
+//-------------------------------------------------------------------------------
+static SPErr CompilePredicate( const string& text, ListenerPredicate& predicate )
+{
+	SPErr error = kSPNoError;
+	size_t at = 0;
+
+	for (;;)
+	{
+		while ( at < text.size() && isspace( (unsigned char)text[at] ) )
+			at++;
+		if ( at >= text.size() )
+			break;
+
+		PredicateTerm term;
+		term.subject = PredicateTerm::kKey;
+		term.key = 0;
+		term.negate = false;
+		term.booleans = 0;
+
+		if ( text[at] == '!' )
+		{
+			term.negate = true;
+			at++;
+		}
+
+		string name;
+		error = ReadID( text, at, term.key, name );
+		if ( error != kSPNoError )
+			return error;
+
+		if ( name == "event" )
+			term.subject = PredicateTerm::kEvent;
+		else if ( name == "target" )
+			term.subject = PredicateTerm::kTarget;
+
+		if ( at < text.size() && text[at] == '=' )
+		{
+			do
+			{
+				at++;
+				error = ReadValue( text, at, term );
+				if ( error != kSPNoError )
+					return error;
+			}
+			while ( at < text.size() && text[at] == ',' );
+		}
+
+		// the event and the target are only ever compared with IDs
+		if ( term.subject != PredicateTerm::kKey &&
+			 ( term.ids.empty() || !term.integers.empty() || !term.texts.empty() || term.booleans != 0 ) )
+			return kSPBadParameterError;
+
+		if ( at < text.size() && !isspace( (unsigned char)text[at] ) )
+			return kSPBadParameterError;
+
+		sort( term.ids.begin(), term.ids.end() );
+		sort( term.integers.begin(), term.integers.end() );
+
+		predicate.terms.push_back( term );
+	}
+
+	stable_sort( predicate.terms.begin(), predicate.terms.end(), CheaperTerm );
+
+	return error;
+}
+
+static SPErr ReadValue( const string& text, size_t& at, PredicateTerm& term )
+{
+	if ( at >= text.size() )
+		return kSPBadParameterError;
+
+	char c = text[at];
+
+	if ( c == '"' )
+	{
+		size_t close = text.find( '"', at + 1 );
+		if ( close == string::npos )
+			return kSPBadParameterError;
+		term.texts.push_back( text.substr( at + 1, close - at - 1 ) );
+		at = close + 1;
+		return kSPNoError;
+	}
+
+	if ( c == '-' || isdigit( (unsigned char)c ) )
+	{
+		size_t start = at++;
+		while ( at < text.size() && isdigit( (unsigned char)text[at] ) )
+			at++;
+		if ( at - start > 11 || ( c == '-' && at - start == 1 ) )
+			return kSPBadParameterError;
+		long long value = atoll( text.substr( start, at - start ).c_str() );
+		if ( value < -2147483647LL - 1 || value > 2147483647LL )
+			return kSPBadParameterError;
+		term.integers.push_back( (int32)value );
+		return kSPNoError;
+	}
+
+	uint32 id = 0;
+	string name;
+	SPErr error = ReadID( text, at, id, name );
+
+	if ( error == kSPNoError && name == "true" )
+		term.booleans |= 2;
+	else if ( error == kSPNoError && name == "false" )
+		term.booleans |= 1;
+	else if ( error == kSPNoError )
+		term.ids.push_back( id );
+
+	return error;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	ReadID
+//
+//	Reads a four character ID in single quotes, or a string ID, which the
+//	host turns into its ID.  name is the string ID, or empty.
+//
+//-------------------------------------------------------------------------------
+static SPErr ReadID( const string& text, size_t& at, uint32& id, string& name )
+{
+	name.clear();
+
+	if ( at + 6 <= text.size() && text[at] == '\'' && text[at + 5] == '\'' )
+	{
+		id = 0;
+		for ( size_t c = at + 1; c < at + 5; c++ )
+			id = ( id << 8 ) | (unsigned char)text[c];
+		at += 6;
+		return kSPNoError;
+	}
+
+	size_t start = at;
+	while ( at < text.size() && ( isalnum( (unsigned char)text[at] ) || text[at] == '_' ) )
+		at++;
+
+	if ( at == start || isdigit( (unsigned char)text[start] ) )
+		return kSPBadParameterError;
+
+	name = text.substr( start, at - start );
+
+	// not IDs, but this is where they are read
+	if ( name == "event" || name == "target" || name == "true" || name == "false" )
+	{
+		id = 0;
+		return kSPNoError;
+	}
+
+	return PIUStringIDToTypeID( name.c_str(), &id );
+}
+
+//-------------------------------------------------------------------------------
+//
+//	Matching
+//
+//-------------------------------------------------------------------------------
+static bool MatchTerm( const PredicateTerm& term,
+					   DescriptorEventID event,
+					   PIActionDescriptor descriptor )
+{
+	bool match = false;
+
+	if ( term.subject == PredicateTerm::kEvent )
+	{
+		match = HasID( term, event );
+	}
+	else if ( descriptor != NULL && term.subject == PredicateTerm::kTarget )
+	{
+		PIActionReference reference = NULL;
+		DescriptorClassID desiredClass = 0;
+
+		if ( sPSActionDescriptor->GetReference( descriptor, keyNull, &reference ) == kSPNoError &&
+			 sPSActionReference->GetDesiredClass( reference, &desiredClass ) == kSPNoError )
+			match = HasID( term, desiredClass );
+
+		if ( reference != NULL )
+			sPSActionReference->Free( reference );
+	}
+	else if ( descriptor != NULL )
+	{
+		match = MatchKey( term, descriptor );
+	}
+
+	return match != term.negate;
+}
+
+static bool MatchKey( const PredicateTerm& term, PIActionDescriptor descriptor )
+{
+	Boolean hasKey = false;
+
+	if ( sPSActionDescriptor->HasKey( descriptor, term.key, &hasKey ) != kSPNoError || !hasKey )
+		return false;
+
+	if ( term.ids.empty() && term.integers.empty() && term.texts.empty() && term.booleans == 0 )
+		return true;
+
+	DescriptorTypeID type = 0;
+	if ( sPSActionDescriptor->GetType( descriptor, term.key, &type ) != kSPNoError )
+		return false;
+
+	bool match = false;
+
+	switch ( type )
+	{
+		case typeEnumerated:
+		{
+			DescriptorEnumTypeID enumType = 0;
+			DescriptorEnumID value = 0;
+			if ( sPSActionDescriptor->GetEnumerated( descriptor, term.key, &enumType, &value ) == kSPNoError )
+				match = HasID( term, value );
+			break;
+		}
+
+		case typeType:
+		case typeGlobalClass:
+		{
+			DescriptorClassID value = 0;
+			if ( sPSActionDescriptor->GetClass( descriptor, term.key, &value ) == kSPNoError )
+				match = HasID( term, value );
+			break;
+		}
+
+		case typeObject:
+		case typeGlobalObject:
+		{
+			DescriptorClassID value = 0;
+			PIActionDescriptor object = NULL;
+			if ( sPSActionDescriptor->GetObject( descriptor, term.key, &value, &object ) == kSPNoError )
+				match = HasID( term, value );
+			if ( object != NULL )
+				sPSActionDescriptor->Free( object );
+			break;
+		}
+
+		case typeObjectSpecifier:
+		{
+			PIActionReference reference = NULL;
+			DescriptorClassID value = 0;
+			if ( sPSActionDescriptor->GetReference( descriptor, term.key, &reference ) == kSPNoError &&
+				 sPSActionReference->GetDesiredClass( reference, &value ) == kSPNoError )
+				match = HasID( term, value );
+			if ( reference != NULL )
+				sPSActionReference->Free( reference );
+			break;
+		}
+
+		case typeInteger:
+		{
+			int32 value = 0;
+			if ( sPSActionDescriptor->GetInteger( descriptor, term.key, &value ) == kSPNoError )
+				match = binary_search( term.integers.begin(), term.integers.end(), value );
+			break;
+		}
+
+		case typeBoolean:
+		{
+			Boolean value = false;
+			if ( sPSActionDescriptor->GetBoolean( descriptor, term.key, &value ) == kSPNoError )
+				match = ( term.booleans & ( value ? 2 : 1 ) ) != 0;
+			break;
+		}
+
+		case typeChar:
+		{
+			if ( term.texts.empty() )
+				break;
+
+			uint32 length = 0;
+			if ( sPSActionDescriptor->GetStringLength( descriptor, term.key, &length ) != kSPNoError )
+				break;
+
+			vector<char> value( length + 1 );
+			if ( sPSActionDescriptor->GetString( descriptor, term.key, &value[0], length + 1 ) != kSPNoError )
+				break;
+
+			for ( size_t t = 0; t < term.texts.size() && !match; t++ )
+				match = term.texts[t] == &value[0];
+			break;
+		}
+
+		default:
+			break;
+	}
+
+	return match;
+}
+
+static bool HasID( const PredicateTerm& term, uint32 id )
+{
+	return binary_search( term.ids.begin(), term.ids.end(), id );
+}
+
+// The event ID is in hand, presence is one call, a value a few more, and
+// the target a reference to make and free.
+static int TermCost( const PredicateTerm& term )
+{
+	if ( term.subject == PredicateTerm::kEvent )
+		return 0;
+	if ( term.subject == PredicateTerm::kTarget )
+		return 3;
+	if ( term.ids.empty() && term.integers.empty() && term.texts.empty() && term.booleans == 0 )
+		return 1;
+	return 2;
+}
+
+static bool CheaperTerm( const PredicateTerm& a, const PredicateTerm& b )
+{
+	return TermCost( a ) < TermCost( b );
+}
+
+// end ListenerPredicate.cpp
@@ -0,0 +1,88 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		ListenerPredicate.h
+//
+//	Description:
+//		Conditions on an event that decide whether a listener's action
+//		is played, so that the host only runs the actions that care.
+//
+//-------------------------------------------------------------------------------
+
+#ifndef __ListenerPredicate_H__		// Has this not been defined yet?
+#define __ListenerPredicate_H__		// Only include this once by predefining it
+
+#include "PIUActionUtils.h"
+
+//-------------------------------------------------------------------------------
+//	Predicate text
+//
+//	A predicate is a list of terms, separated by spaces, that must all hold:
+//
+//		term		[!]subject[=value{,value}]
+//		subject		event | target | key
+//		value		a string ID such as layer, a four character ID in single
+//					quotes such as 'Lyr ', an integer, true, false, or text
+//					in double quotes
+//
+//	"event" is the event ID, and "target" the class the event's null
+//	reference points at.  Any other subject is a key of the event
+//	descriptor: alone it holds if the key is there, with values if the
+//	key's value is one of them.  An enumerated value, class, object or
+//	reference is compared by its ID, and integers, booleans and text by
+//	value.  A leading ! turns the term around.  For example,
+//
+//		target=layer,contentLayer !duplicate
+//
+//	An empty predicate always holds.
+//-------------------------------------------------------------------------------
+
+typedef struct PredicateTerm
+{
+	enum Subject { kEvent, kTarget, kKey } subject;
+	DescriptorKeyID		key;
+	bool				negate;
+	vector<uint32>		ids;		// sorted
+	vector<int32>		integers;	// sorted
+	vector<string>		texts;
+	int					booleans;	// bit 0 for false, bit 1 for true
+} PredicateTerm;
+
+// A compiled predicate.  Registrations with the same text share one, and
+// it counts the events it was asked about and the ones that matched.
+typedef struct ListenerPredicate
+{
+	string					text;
+	vector<PredicateTerm>	terms;		// cheapest first
+	size_t					users;
+	uint32					tested;
+	uint32					hits;
+} ListenerPredicate;
+
+//-------------------------------------------------------------------------------
+//	Prototypes
+//-------------------------------------------------------------------------------
+
+// Returns the compiled predicate for text, compiling it the first time,
+// or NULL with kSPBadParameterError if it cannot be read.  Each one
+// returned is given back with ReleaseListenerPredicate.
+SPErr AcquireListenerPredicate( const string& text, ListenerPredicate** predicate );
+void ReleaseListenerPredicate( ListenerPredicate* predicate );
+
+// True if the event passes, counting it either way.
+bool MatchListenerPredicate( ListenerPredicate* predicate,
+							 DescriptorEventID event,
+							 PIActionDescriptor descriptor );
+
+#endif // __ListenerPredicate_H__
+// end ListenerPredicate.h
@@ -29,6 +29,16 @@
 //	Prototypes.
 //-------------------------------------------------------------------------------
 
+// Reads a keyPIListeners list into gListenerBatch.
+static SPErr ReadListenerBatch( PIActionDescriptor descriptor );
+
+// Reads keyPIReplay and keyPIPaced into gReplayPath and gReplayPaced.
+static SPErr ReadReplay( PIActionDescriptor descriptor );
+
+static SPErr GetDescriptorString( PIActionDescriptor descriptor,
+								  DescriptorKeyID key,
+								  string& text );
+
 //-------------------------------------------------------------------------------
 //
 //	ReadScriptParams
@@ -50,6 +60,25 @@ SPErr ReadScriptParams( PIActionParameters* actionParams )
 	// If we got a valid descriptor, grab our key out of it:
 	if ( descriptor != NULL )
 	{
+		Boolean hasKey = false;
+
+		// a whole list of listeners to add or remove
+		error = sPSActionDescriptor->HasKey( descriptor, keyPIListeners, &hasKey );
+		if ( error == kSPNoError && hasKey )
+			return ReadListenerBatch( descriptor );
+
+		// or a recording to replay
+		hasKey = false;
+		error = sPSActionDescriptor->HasKey( descriptor, keyPIReplay, &hasKey );
+		if ( error == kSPNoError && hasKey )
+			return ReadReplay( descriptor );
+
+		// the event is left to the dialog if it isn't given
+		hasKey = false;
+		error = sPSActionDescriptor->HasKey( descriptor, keyPIEvent, &hasKey );
+		if ( error == kSPNoError && hasKey )
+			error = sPSActionDescriptor->GetClass( descriptor, keyPIEvent, &gEventID );
+
 		uint32 stringLength = 0;
 		error = sPSActionDescriptor->GetStringLength( descriptor, 
 													  keyPIActionSet, 
@@ -93,11 +122,146 @@ SPErr ReadScriptParams( PIActionParameters* actionParams )
 		if ( error == kSPNoError )
 			gActionName->assign( vc2.begin(), vc2.begin() + stringLength );
 
+		// and the predicate, if there is one
+		hasKey = false;
+		if ( error == kSPNoError )
+			error = sPSActionDescriptor->HasKey( descriptor, keyPIWhen, &hasKey );
+
+		if ( error == kSPNoError && hasKey )
+		{
+			gPredicate = new string;
+			error = GetDescriptorString( descriptor, keyPIWhen, *gPredicate );
+		}
+
 	}
 
 	return error;
 	
 } // end ReadScriptParams
+
+//-------------------------------------------------------------------------------
+//
+//	ReadListenerBatch
+//
+//	Reads each classPIListener object in the keyPIListeners list, with
+//	its keyPIWhen if it has one, and keyPIRemove, for Execute to register or unregister all at once.
+//
+//-------------------------------------------------------------------------------
+
+static SPErr ReadListenerBatch( PIActionDescriptor descriptor )
+{
+	PIActionList list = NULL;
+	uint32 count = 0;
+	Boolean remove = false;
+	Boolean hasKey = false;
+	vector<ListenerSpec> specs;
+
+	SPErr error = sPSActionDescriptor->GetList( descriptor, keyPIListeners, &list );
+
+	if ( error == kSPNoError )
+		error = sPSActionList->GetCount( list, &count );
+
+	if ( error == kSPNoError )
+		specs.resize( count );
+
+	for ( uint32 index = 0; index < count && error == kSPNoError; index++ )
+	{
+		DescriptorClassID listenerClass = 0;
+		PIActionDescriptor listener = NULL;
+
+		error = sPSActionList->GetObject( list, index, &listenerClass, &listener );
+
+		if ( error == kSPNoError )
+			error = sPSActionDescriptor->GetClass( listener, keyPIEvent, &specs[index].eventID );
+
+		if ( error == kSPNoError )
+			error = GetDescriptorString( listener, keyPIActionSet, specs[index].actionSet );
+
+		if ( error == kSPNoError )
+			error = GetDescriptorString( listener, keyPIAction, specs[index].actionName );
+
+		hasKey = false;
+		if ( error == kSPNoError )
+			error = sPSActionDescriptor->HasKey( listener, keyPIWhen, &hasKey );
+
+		if ( error == kSPNoError && hasKey )
+			error = GetDescriptorString( listener, keyPIWhen, specs[index].predicate );
+
+		if ( listener != NULL )
+			sPSActionDescriptor->Free( listener );
+	}
+
+	if ( list != NULL )
+		sPSActionList->Free( list );
+
+	if ( error == kSPNoError )
+		error = sPSActionDescriptor->HasKey( descriptor, keyPIRemove, &hasKey );
+
+	if ( error == kSPNoError && hasKey )
+		error = sPSActionDescriptor->GetBoolean( descriptor, keyPIRemove, &remove );
+
+	if ( error == kSPNoError )
+	{
+		delete gListenerBatch;
+		gListenerBatch = new vector<ListenerSpec>;
+		gListenerBatch->swap( specs );
+		gRemoveListeners = remove != false;
+	}
+
+	return error;
+
+} // end ReadListenerBatch
+
+//-------------------------------------------------------------------------------
+//
+//	ReadReplay
+//
+//-------------------------------------------------------------------------------
+
+static SPErr ReadReplay( PIActionDescriptor descriptor )
+{
+	string path;
+	Boolean paced = false;
+	Boolean hasKey = false;
+
+	SPErr error = GetDescriptorString( descriptor, keyPIReplay, path );
+
+	if ( error == kSPNoError )
+		error = sPSActionDescriptor->HasKey( descriptor, keyPIPaced, &hasKey );
+
+	if ( error == kSPNoError && hasKey )
+		error = sPSActionDescriptor->GetBoolean( descriptor, keyPIPaced, &paced );
+
+	if ( error == kSPNoError )
+	{
+		delete gReplayPath;
+		gReplayPath = new string( path );
+		gReplayPaced = paced != false;
+	}
+
+	return error;
+
+} // end ReadReplay
+
+static SPErr GetDescriptorString( PIActionDescriptor descriptor,
+								  DescriptorKeyID key,
+								  string& text )
+{
+	uint32 stringLength = 0;
+
+	SPErr error = sPSActionDescriptor->GetStringLength( descriptor, key, &stringLength );
+
+	vector<char> vc( stringLength + 1 );
+
+	if ( error == kSPNoError )
+		error = sPSActionDescriptor->GetString( descriptor, key, &vc[0], stringLength + 1 );
+
+	if ( error == kSPNoError )
+		text.assign( vc.begin(), vc.begin() + strlen( &vc[0] ) );
+
+	return error;
+
+} // end GetDescriptorString
 		
 //-------------------------------------------------------------------------------
 //
@@ -122,9 +286,14 @@ SPErr WriteScriptParams( PIActionParameters* actionParams )
 		
 		if (error == kSPNoError && descriptor != 0)
 		{
-			error = sPSActionDescriptor->PutString( descriptor,
-													keyPIActionSet,
-													(char*)(listener->actionSet.c_str()) );
+			error = sPSActionDescriptor->PutClass( descriptor,
+												   keyPIEvent,
+												   listener->eventID );
+
+			if (error == kSPNoError)
+				error = sPSActionDescriptor->PutString( descriptor,
+														keyPIActionSet,
+														(char*)(listener->actionSet.c_str()) );
 				
 			if (error == kSPNoError)
 			{
@@ -132,6 +301,11 @@ SPErr WriteScriptParams( PIActionParameters* actionParams )
 					                                    keyPIAction,
 														(char*)(listener->actionName.c_str()) );
 			}
+
+			if (error == kSPNoError && listener->predicate != NULL)
+				error = sPSActionDescriptor->PutString( descriptor,
+														keyPIWhen,
+														(char*)(listener->predicate->text.c_str()) );
 				
 		}
 			
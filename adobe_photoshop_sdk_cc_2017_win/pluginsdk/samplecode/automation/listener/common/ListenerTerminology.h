@@ -35,12 +35,33 @@
 #define plugInDescription \
 	"A persistent Actions Module to background listen in Adobe Photoshop."
 
+//-------------------------------------------------------------------------------
+//	Definitions -- The plug-in's own event
+//-------------------------------------------------------------------------------
+
+// The event the host records when this plug-in is played, under plugInEventID
+// or the runtime ID of its unique string, vendorName " " plugInName
+#define vendorName			"AdobeSDK"
+#define plugInEventID		'lstN'
+
 //-------------------------------------------------------------------------------
 //	Definitions -- Scripting keys
 //-------------------------------------------------------------------------------
 
 #define keyPIAction		'actN'
 #define keyPIActionSet	'actS'
+#define keyPIEvent		'evtN'
+#define keyPIRemove		'rmvL'
+#define keyPIWhen		'whnP'		// predicate text, see ListenerPredicate.h
+
+// A list of objects of classPIListener, each with keyPIEvent, keyPIActionSet,
+// keyPIAction and optionally keyPIWhen, registered, or with keyPIRemove unregistered, in one call
+#define keyPIListeners	'lstS'
+#define classPIListener	'lstR'
+
+// A recording to replay, and whether to keep its timing; see Replay in Listener.cpp
+#define keyPIReplay		'rply'
+#define keyPIPaced		'pacd'
 
 //-------------------------------------------------------------------------------
 //	Definitions -- Resources
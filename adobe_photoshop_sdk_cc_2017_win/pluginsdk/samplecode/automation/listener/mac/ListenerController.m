@@ -190,7 +190,16 @@ void EventToText(uint32 inputLong, NSString** returnString)
         [tempDisplay appendString:@"\" of \""];
         if (thisList->actionSet.c_str())
             [tempDisplay appendString:[NSString stringWithUTF8String:thisList->actionSet.c_str()]];
-        [tempDisplay appendString:@"\".\r"];
+        [tempDisplay appendString:@"\""];
+        if (thisList->predicate != NULL)
+        {
+            // and how often the predicate let the event through
+            [tempDisplay appendFormat:@" when %s (%u of %u)",
+                thisList->predicate->text.c_str(),
+                (unsigned)thisList->predicate->hits,
+                (unsigned)thisList->predicate->tested];
+        }
+        [tempDisplay appendString:@".\r"];
         
         thisList = thisList->next;
         size++;
@@ -429,7 +429,19 @@ void PIInstalledStaticText::Init(PIItem in)
 		tempDisplay += thisList->actionName;
 		tempDisplay += "\" of \"";
 		tempDisplay += thisList->actionSet;
-		tempDisplay += "\".\r";
+		tempDisplay += "\"";
+		if (thisList->predicate != NULL)
+		{
+			// and how often the predicate let the event through
+			char hits[64];
+			sprintf(hits, " (%u of %u)",
+					(unsigned)thisList->predicate->hits,
+					(unsigned)thisList->predicate->tested);
+			tempDisplay += " when ";
+			tempDisplay += thisList->predicate->text;
+			tempDisplay += hits;
+		}
+		tempDisplay += ".\r";
 
 		display += tempDisplay;
 
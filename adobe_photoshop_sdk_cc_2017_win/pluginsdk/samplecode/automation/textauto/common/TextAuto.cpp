@@ -33,6 +33,7 @@
 
 #include "ASZStringSuite.h"
 #include "PIUSuites.h"
+#include "PIUStringID.h"
 #include "PITerminology.h"
 
 #if __PIMac__
@@ -191,9 +192,12 @@ void OpenEvent( DescriptorEventID event,
 
 	if (error) return;
 	
-	error = sPSActionControl->StringIDToTypeID("9E3AF9BA-CBDD-4b26-920C-5FE8A5C61B59", &runtimeID);
+	// the open-as class this plug-in registers, asked for once
+	PIU_DECLARE_STRING_ID(textAutoClassID, "9E3AF9BA-CBDD-4b26-920C-5FE8A5C61B59");
 
-	if (error) return;
+	runtimeID = textAutoClassID;
+
+	if (runtimeID == 0) return;
 
 	if (runtimeID != classID) return;
 
@@ -75,11 +75,23 @@
 	OSErr PSSDKWrite(intptr_t refNum, int32 * count, void * buffPtr); 
 	OSErr PSSDKRead(intptr_t refNum, int32 * count, void * buffPtr); 
 	OSErr PSSDKSetFPos(intptr_t refNum, short posMode, long posOff);
+	OSErr PSSDKSetFPos64(intptr_t refNum, short posMode, int64 posOff);
+	OSErr PSSDKGetFPos(intptr_t refNum, int64 * position);
+	OSErr PSSDKGetEOF(intptr_t refNum, int64 * size);
+	OSErr PSSDKSetEOF(intptr_t refNum, int64 size);
+	OSErr PSSDKMapFile(intptr_t refNum, const void ** address, int64 * size, intptr_t * mapping);
+	OSErr PSSDKUnmapFile(intptr_t mapping, const void * address, int64 size);
 #elif defined(__PIMac__)
 	OSErr PSSDKWrite(int32 refNum, int32 * count, void * buffPtr); 
     OSErr PSSDKWrite(FileHandle refNum, int32 * count, void * buffPtr);
 	OSErr PSSDKRead(int32 refNum, int32 * count, void * buffPtr);
 	OSErr PSSDKSetFPos(int32 refNum, short posMode, long posOff);
+	OSErr PSSDKSetFPos64(int32 refNum, short posMode, int64 posOff);
+	OSErr PSSDKGetFPos(int32 refNum, int64 * position);
+	OSErr PSSDKGetEOF(int32 refNum, int64 * size);
+	OSErr PSSDKSetEOF(int32 refNum, int64 size);
+	OSErr PSSDKMapFile(int32 refNum, const void ** address, int64 * size, intptr_t * mapping);
+	OSErr PSSDKUnmapFile(intptr_t mapping, const void * address, int64 size);
 #endif
 
 
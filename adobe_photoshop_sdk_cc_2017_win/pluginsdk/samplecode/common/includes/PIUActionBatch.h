@@ -0,0 +1,131 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUActionBatch.h
+//
+//	Description:
+//		Queues commands and plays them together as one history state,
+//		with one redraw at the end.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIUActionBatch_H__
+#define __PIUActionBatch_H__
+
+#include "PIUActionUtils.h"
+
+// Checks the result of one command; returns non-zero if it failed.
+typedef SPErr (*PIUActionBatchCheck)(PIActionDescriptor result);
+
+// The error of a command that was not played because the one it depends
+// on failed.
+#define kPIUActionBatchSkipped	'skip'
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+/** A list of commands played one after the other, as one step.
+
+	Playing each command on its own makes a history state for each, and
+	whoever plays them usually asks for a redraw after each one too; with
+	hundreds of commands that is most of the time spent.  Play runs all of
+	them inside SuspendHistory, so the document gets one history state
+	named for the whole batch, and asks for one redraw at the end.
+
+	Each command keeps its own error and result.  A command added with
+	dependsOnPrevious is skipped, with kPIUActionBatchSkipped, if the one
+	before it did not succeed, so a select and the command that works on
+	what was selected can be kept together.
+
+	Usage:
+		PIUActionBatch batch;
+		for (...)
+		{
+			batch.Add(eventSelect, selectDescriptor);
+			batch.Add(filterEventID, filterDescriptor, plugInDialogSilent, NULL, true);
+		}
+		batch.Play("Filter Layers");
+		for (size_t c = 0; c < batch.Commands(); c++)
+			... batch.Error(c) ...
+*/
+class PIUActionBatch {
+public:
+	PIUActionBatch();
+	~PIUActionBatch();
+
+	// Queues a command.  The batch owns descriptor from here on, even if
+	// this fails; it may be NULL for a command with no parameters.  check
+	// is called with the result of the command; NULL fails only a result
+	// that has keyMessage.
+	SPErr Add(DescriptorEventID event,
+			  PIActionDescriptor descriptor,
+			  PIDialogPlayOptions options = plugInDialogSilent,
+			  PIUActionBatchCheck check = NULL,
+			  bool dependsOnPrevious = false);
+
+	// Queues playing an action, as PIUActionsPlayByName does.
+	SPErr AddPlayByName(const char* setName,
+						const char* actionName,
+						bool dependsOnPrevious = false);
+
+	// Queues selecting something of a class by name, as PIUSelectByName does.
+	SPErr AddSelectByName(DescriptorClassID desiredClass,
+						  const char* name,
+						  bool dependsOnPrevious = false);
+
+	// Plays every command not yet played, as one history state called
+	// operationName on the target document, then redraws once if asked.
+	// With no document open, the commands are played without it.  Pass
+	// NULL when already inside SuspendHistory, as a whole plug-in run
+	// often is.  Returns the first error of any command, or of suspending
+	// history.
+	SPErr Play(const char* operationName, bool redraw = true);
+
+	// Frees every command and result.
+	void Clear(void);
+
+	size_t Commands(void) const { return commands.size(); }
+
+	// What happened to a command that has been played.
+	SPErr Error(size_t command) const { return commands[command].error; }
+
+	// The result of a command; the batch still owns it.
+	PIActionDescriptor Result(size_t command) const { return commands[command].result; }
+
+private:
+	typedef struct Command {
+		DescriptorEventID event;
+		PIActionDescriptor descriptor;
+		PIDialogPlayOptions options;
+		PIUActionBatchCheck check;
+		bool dependsOnPrevious;
+		SPErr error;
+		PIActionDescriptor result;
+	} Command;
+
+	static SPErr PlayCommands(void* data);
+	void PlayCommand(size_t command);
+	SPErr SuspendHistory(const char* operationName);
+	SPErr Redraw(void);
+
+	vector<Command> commands;
+	size_t firstToPlay;					// commands before this have been played
+	bool playing;						// PlayCommands was called
+
+	PIUActionBatch(const PIUActionBatch&);
+	PIUActionBatch& operator=(const PIUActionBatch&);
+};
+
+#endif
+// end PIUActionBatch.h
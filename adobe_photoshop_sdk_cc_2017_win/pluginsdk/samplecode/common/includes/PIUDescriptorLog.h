@@ -0,0 +1,164 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUDescriptorLog.h
+//
+//	Description:
+//		Event logging that can stay on in a release build.  Descriptors
+//		are copied into a compact snapshot on the host thread, and the
+//		snapshots are formatted and written on a background thread, so
+//		the host only ever waits for the copy.  The log is either text or
+//		a binary recording, see PIURecording.h.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIUDescriptorLog_H__
+#define __PIUDescriptorLog_H__
+
+#include "PIUActionUtils.h"
+#include "PIURecording.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <stdio.h>
+#include <string>
+#include <thread>
+
+//-------------------------------------------------------------------------------
+//	Snapshot layout
+//
+//	An event snapshot is the event ID followed by its descriptor, flattened
+//	into bytes in host byte order:
+//
+//		event		id, descriptor
+//		descriptor	count:uint32, then count times key:id value
+//		value		type:uint32, then the payload for the type
+//		id			uint32; a runtime ID, below SmallestHashValue, is
+//					followed by its string ID as a string
+//		string		length:uint32, then that many UTF-8 bytes
+//
+//	Payloads, by type:
+//
+//		typeSInt64					int64
+//		typeSInt32					int32
+//		typeIEEE64BitFloatingPoint	double
+//		typeUnitFloat				unit:id, double
+//		typeChar					string
+//		typeBoolean					uint8
+//		typeObject, typeGlobalObject	class:id, descriptor
+//		typeEnumerated				type:id, value:id
+//		typePath, typeAlias, typeBookmark	string, the full path
+//		typeValueList				count:uint32, then count values
+//		typeObjectSpecifier			count:uint32, then count parts of
+//									form:uint32 class:id and the form's
+//									payload
+//		typeType, typeGlobalClass	class:id
+//		typeRawData					length:int32; the data is not kept
+//
+//	Reference forms: formName a string, formIndex and formIdentifier a
+//	uint32, formOffset an int32, formEnumerated type:id value:id,
+//	formProperty key:id, and formClass nothing.  Any other type or form
+//	has no payload.
+//-------------------------------------------------------------------------------
+
+// Appends the snapshot of an event to snapshot.  Host thread only.
+void PIUSnapshotEvent(DescriptorEventID event,
+					  PIActionDescriptor descriptor,
+					  vector<uint8>& snapshot);
+
+// Writes a snapshot out as indented text.  Uses no suites, so it can run
+// on any thread.  Returns false if the snapshot is cut short.
+bool PIUFormatSnapshot(const uint8* snapshot, size_t size, ostream& out);
+
+//-------------------------------------------------------------------------------
+//	PIUDescriptorLog
+//
+//	Appends events to a file from a writer thread.  The queue is bounded;
+//	when the writer falls behind, events are dropped rather than making
+//	the host wait, and the next event written says how many.
+//
+//	A recording is appended through a memory map that grows in steps of
+//	kDescriptorLogMapBytes, and is cut back to its length when the log
+//	is deleted.  A file that is there already but is not a recording is
+//	left alone, and nothing is logged.
+//-------------------------------------------------------------------------------
+
+// Most events, and most snapshot bytes, waiting for the writer at once
+const size_t kDescriptorLogMaxEvents = 256;
+const size_t kDescriptorLogMaxBytes = 16 << 20;
+
+// How much more of a recording is mapped each time it runs out of room
+const size_t kDescriptorLogMapBytes = 4 << 20;
+
+enum PIUDescriptorLogFormat
+{
+	kDescriptorLogText,				// indented text, as PIUFormatSnapshot writes
+	kDescriptorLogRecording			// binary, for the DescriptorDecoder tool
+};
+
+class MappedLogFile;
+
+class PIUDescriptorLog {
+public:
+	PIUDescriptorLog(const char* fullpathtofile,
+					 uint32 sampling = 1,
+					 PIUDescriptorLogFormat format = kDescriptorLogText);
+	~PIUDescriptorLog();		// writes everything still queued
+
+	// Host thread.  Snapshots the event if the sampling picks it.
+	void Log(DescriptorEventID event, PIActionDescriptor descriptor);
+
+	// Log one event in every sampling; 0 turns logging off.
+	void SetSampling(uint32 sampling);
+
+private:
+	typedef struct Entry {
+		double seconds;			// since the log was made
+		uint32 dropped;			// events dropped just before this one
+		vector<uint8> snapshot;
+	} Entry;
+
+	void Run(void);
+	void WriteText(const deque<Entry>& batch, FILE*& file);
+	void WriteRecording(const deque<Entry>& batch, MappedLogFile*& file);
+
+	string path;
+	PIUDescriptorLogFormat format;
+	uint32 sampling;
+	uint32 seen;
+	uint32 dropped;
+	chrono::steady_clock::time_point start;
+
+	deque<Entry> entries;
+	size_t queuedBytes;
+	bool stopping;
+
+	mutex lock;
+	condition_variable entryAdded;
+	thread writer;
+
+	// writer thread only
+	PIURecordingIDs recordedIDs;
+	double lastSeconds;
+	bool broken;				// the recording could not be opened or grown
+
+	PIUDescriptorLog(const PIUDescriptorLog&);
+	PIUDescriptorLog& operator=(const PIUDescriptorLog&);
+};
+
+#endif
+// end PIUDescriptorLog.h
@@ -0,0 +1,118 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIULayerTable.h
+//
+//	Description:
+//		Collects chosen properties of every layer into a table with one
+//		column per property, without getting whole layer descriptors.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIULayerTable_H__
+#define __PIULayerTable_H__
+
+#include "PIUActionUtils.h"
+#include <stdio.h>
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+/** A table of layer properties, a row per layer and a column per property.
+
+	Each property of each layer is asked for on its own, with a keyProperty
+	reference, so the host only builds that one value; a whole layer
+	descriptor has every property and costs far more to make.  Getting
+	names and bounds of 2000 layers is 4000 small gets and no whole
+	descriptors.
+
+	A property whose value is an object, such as bounds, also gets a
+	column for each key of the object, keyTop of bounds for example, so
+	that they can be read like any other column.  A layer that does not
+	have a property has type 0 in its column.
+
+	Usage:
+		PIULayerTable table;
+		table.AddProperty(keyName);
+		table.AddProperty(boundsKey);
+		table.Collect();
+		int32 top = table.FindColumn(boundsKey, keyTop);
+		for (size_t row = 0; row < table.Rows(); row++)
+			... table.Text(0, row), table.Number(top, row) ...
+*/
+class PIULayerTable {
+public:
+	PIULayerTable();
+
+	// Adds a property to get.  Call before collecting.
+	void AddProperty(DescriptorKeyID key);
+
+	// Appends a row for each layer of every open document, or of one,
+	// by its index.  A property the host will not get for a layer leaves
+	// its cell empty; anything else that fails stops the collecting.
+	SPErr Collect(void);
+	SPErr CollectDocument(uint32 documentIndex);
+
+	// Forgets the rows, and any object member columns.
+	void Clear(void);
+
+	size_t Rows(void) const { return documents.size(); }
+	size_t Columns(void) const { return columns.size(); }
+
+	// The column of a property, or of a key of its object; -1 if there is
+	// none.
+	int32 FindColumn(DescriptorKeyID key, DescriptorKeyID member = 0) const;
+
+	// Where a row came from.
+	uint32 Document(size_t row) const { return documents[row]; }
+	uint32 Layer(size_t row) const { return layers[row]; }
+
+	// A cell.  Number holds integers, booleans, floats and unit floats;
+	// ID holds the unit of a unit float, an enumerated value, or a class.
+	DescriptorTypeID Type(size_t column, size_t row) const { return columns[column].types[row]; }
+	double Number(size_t column, size_t row) const { return columns[column].numbers[row]; }
+	uint32 ID(size_t column, size_t row) const { return columns[column].ids[row]; }
+	const string& Text(size_t column, size_t row) const { return columns[column].texts[row]; }
+
+	// Column name, the string ID of the key, or key.member for a member.
+	const string& Name(size_t column) const { return columns[column].name; }
+
+	// Writes a header line of column names, then the rows, tab separated.
+	void Write(FILE* file) const;
+
+private:
+	typedef struct Column {
+		DescriptorKeyID key;
+		DescriptorKeyID member;				// 0 for the property itself
+		string name;
+		vector<DescriptorTypeID> types;
+		vector<double> numbers;
+		vector<uint32> ids;
+		vector<string> texts;
+	} Column;
+
+	SPErr GetCell(uint32 documentIndex, uint32 layerIndex, size_t column);
+	void PutValue(size_t column, size_t row, PIActionDescriptor descriptor, DescriptorKeyID key);
+	size_t MemberColumn(size_t column, DescriptorKeyID member);
+	void AddColumn(DescriptorKeyID key, DescriptorKeyID member, const string& name);
+	static string KeyName(DescriptorKeyID key);
+
+	size_t properties;						// the first columns, one per property
+	vector<Column> columns;
+	vector<uint32> documents;
+	vector<uint32> layers;
+};
+
+#endif
+// end PIULayerTable.h
@@ -0,0 +1,232 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIURecording.h
+//
+//	Description:
+//		Compact binary recordings of action events, written by
+//		PIUDescriptorLog and read by the DescriptorDecoder tool.  Only
+//		uses the C++ library, so the decoder builds on any system.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIURecording_H__
+#define __PIURecording_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+//	File layout
+//
+//	header		"PIUREC\r\n", then version and 0, both uint32 little endian
+//	records		tag:uint8 length:varint payload, up to the end of the file
+//				or a 0 tag, which is where a recording that was not closed
+//				properly stops
+//
+//	Records:
+//
+//	kRecordSession	empty; the ID table starts over
+//	kRecordID		id:varint, then for a runtime ID its string ID as a
+//					string.  IDs are numbered 0, 1, ... in the order they
+//					are defined in a session, and everything after refers
+//					to them by that number.
+//	kRecordEvent	microseconds since the last event:varint, event:id,
+//					descriptor
+//	kRecordDropped	count:varint, events that were not recorded
+//
+//	Encodings:
+//
+//	varint		unsigned LEB128
+//	signed		zigzag, then varint
+//	id			varint, a number from the ID table
+//	string		length:varint, then UTF-8 bytes
+//	double		8 bytes little endian
+//	descriptor	count:varint, then count times key:id value
+//	value		kind:uint8, then by kind:
+//				kValueInteger64, kValueInteger		signed
+//				kValueFloat							double
+//				kValueUnitFloat						unit:id double
+//				kValueString, kValuePath			string
+//				kValueFalse, kValueTrue				nothing
+//				kValueObject, kValueGlobalObject	class:id descriptor
+//				kValueEnumerated					type:id value:id
+//				kValueList							count:varint, values
+//				kValueReference						count:varint, parts
+//				kValueClass, kValueGlobalClass		class:id
+//				kValueData							length:varint
+//				kValueOther							type:varint
+//	part		form:uint8 class:id, then by form:
+//				kFormName							string
+//				kFormIndex, kFormIdentifier			varint
+//				kFormOffset							signed
+//				kFormEnumerated						type:id value:id
+//				kFormProperty						key:id
+//				kFormClass							nothing
+//				kFormOther							form:varint
+//-------------------------------------------------------------------------------
+
+const char kRecordingMagic [8] = { 'P', 'I', 'U', 'R', 'E', 'C', '\r', '\n' };
+const uint32_t kRecordingVersion = 1;
+const size_t kRecordingHeaderSize = 16;
+
+// IDs below this are runtime IDs, which are recorded with their string ID
+const uint32_t kRecordingRuntimeIDLimit = 0x20202020;		// '    '
+
+enum
+{
+	kRecordEnd = 0,
+	kRecordSession,
+	kRecordID,
+	kRecordEvent,
+	kRecordDropped
+};
+
+enum
+{
+	kValueInteger64 = 1,
+	kValueInteger,
+	kValueFloat,
+	kValueUnitFloat,
+	kValueString,
+	kValuePath,
+	kValueFalse,
+	kValueTrue,
+	kValueObject,
+	kValueGlobalObject,
+	kValueEnumerated,
+	kValueList,
+	kValueReference,
+	kValueClass,
+	kValueGlobalClass,
+	kValueData,
+	kValueOther
+};
+
+enum
+{
+	kFormName = 1,
+	kFormIndex,
+	kFormIdentifier,
+	kFormOffset,
+	kFormEnumerated,
+	kFormProperty,
+	kFormClass,
+	kFormOther
+};
+
+//-------------------------------------------------------------------------------
+//	Encoding helpers
+//-------------------------------------------------------------------------------
+
+void PIURecordingPutVarint(std::vector<uint8_t>& out, uint64_t value);
+void PIURecordingPutSigned(std::vector<uint8_t>& out, int64_t value);
+void PIURecordingPutDouble(std::vector<uint8_t>& out, double value);
+void PIURecordingPutString(std::vector<uint8_t>& out, const char* text, size_t length);
+
+// Appends a record with payload to out.
+void PIURecordingPutRecord(std::vector<uint8_t>& out, uint8_t tag, const std::vector<uint8_t>& payload);
+
+//-------------------------------------------------------------------------------
+//	PIURecordingIDs
+//
+//	The writer's ID table.  Number returns the number for an ID, first
+//	appending its kRecordID record to out if it is new.  Runtime IDs are
+//	told apart by their string ID.
+//-------------------------------------------------------------------------------
+
+class PIURecordingIDs {
+public:
+	PIURecordingIDs();
+
+	void Reset(void);
+	uint32_t Number(uint32_t id, const std::string& name, std::vector<uint8_t>& out);
+
+private:
+	std::vector<uint64_t> slots;		// open addressing, hash to number + 1
+	std::vector<uint32_t> ids;
+	std::vector<std::string> names;
+
+	uint64_t Hash(uint32_t id, const std::string& name) const;
+	void Grow(void);
+};
+
+//-------------------------------------------------------------------------------
+//	Reading
+//-------------------------------------------------------------------------------
+
+typedef struct RecordedID {
+	uint32_t id;
+	std::string name;			// string ID of a runtime ID
+} RecordedID;
+
+// A value, a descriptor or a reference part.  Which fields mean something
+// depends on kind; IDs are numbers in the reader's ID table.
+typedef struct RecordedValue {
+	uint8_t kind;				// kValue..., or kForm... for a reference part
+	int64_t integer;			// integers, data length, index, identifier, offset
+	double number;
+	uint32_t id1;				// unit, class, enumerated type; a part's class
+	uint32_t id2;				// enumerated value; a part's property key or enumerated type
+	uint32_t id3;				// a part's enumerated value
+	std::string text;
+	std::vector<uint32_t> keys;				// of a descriptor, one per child
+	std::vector<RecordedValue> children;	// descriptor values, list values, reference parts
+} RecordedValue;
+
+typedef struct RecordedEvent {
+	double seconds;				// since the session started
+	uint32_t event;
+	RecordedValue descriptor;	// children and keys only
+} RecordedEvent;
+
+class PIURecordingReader {
+public:
+	PIURecordingReader(const uint8_t* data, size_t size);
+
+	// False if the header is wrong.
+	bool IsRecording(void) const { return header; }
+
+	// Reads up to the next event, dropped count or session start and
+	// returns its tag, or kRecordEnd at the end.  ID records are taken
+	// in along the way.
+	int Next(RecordedEvent& event, uint64_t& dropped);
+
+	// False once something could not be read.
+	bool IsOK(void) const { return ok; }
+
+	const RecordedID& ID(uint32_t number) const;
+
+private:
+	bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value);
+	bool ReadID(const uint8_t*& p, const uint8_t* end, uint32_t& number);
+	bool ReadString(const uint8_t*& p, const uint8_t* end, std::string& text);
+	bool ReadDescriptor(const uint8_t*& p, const uint8_t* end, RecordedValue& value, int depth);
+	bool ReadValue(const uint8_t*& p, const uint8_t* end, RecordedValue& value, int depth);
+	bool ReadPart(const uint8_t*& p, const uint8_t* end, RecordedValue& part);
+
+	const uint8_t* next;
+	const uint8_t* end;
+	bool header;
+	bool ok;
+	double seconds;
+	std::vector<RecordedID> ids;
+	RecordedID unknown;
+};
+
+#endif
+// end PIURecording.h
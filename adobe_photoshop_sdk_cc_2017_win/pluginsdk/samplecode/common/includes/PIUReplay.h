@@ -0,0 +1,135 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUReplay.h
+//
+//	Description:
+//		Plays the events of a recording (see PIURecording.h) again and
+//		times each one.  Like PIURecording, only uses the C++ library; what
+//		actually plays an event is a PIUReplayTarget, the host in a
+//		plug-in, or a stand-in in the DescriptorDecoder tool.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIUReplay_H__
+#define __PIUReplay_H__
+
+#include <stdio.h>
+#include "PIURecording.h"
+
+//-------------------------------------------------------------------------------
+//	PIUReplayTarget
+//
+//	Plays one event at a time for PIUReplay.  Build makes whatever Play
+//	needs out of the recorded event, a descriptor for the host, and Free
+//	gets rid of it; they are timed apart from Play, so the cost of making
+//	descriptors is not counted against the host.  Free is called after
+//	every Build, even one that failed.  A non-zero error from Build skips
+//	Play.
+//-------------------------------------------------------------------------------
+
+class PIUReplayTarget {
+public:
+	virtual ~PIUReplayTarget() {}
+
+	// A new session starts; the reader's ID numbers start over.
+	virtual void StartSession(const PIURecordingReader& reader) { (void)reader; }
+
+	virtual int Build(const PIURecordingReader& reader, const RecordedEvent& event) = 0;
+	virtual int Play(const PIURecordingReader& reader, const RecordedEvent& event) = 0;
+	virtual void Free(void) = 0;
+};
+
+//-------------------------------------------------------------------------------
+//	PIUReplayOptions
+//-------------------------------------------------------------------------------
+
+typedef struct PIUReplayOptions {
+	bool paced;					// wait to play each event when it was recorded
+	double speed;				// when paced, 2 plays twice as fast as recorded
+
+	PIUReplayOptions() : paced(false), speed(1.0) {}
+} PIUReplayOptions;
+
+// How one event went; times in seconds.
+typedef struct PIUReplayTiming {
+	std::string event;			// see PIUReplay::EventName
+	uint32_t session;			// from 1
+	double recorded;			// when it was recorded, since its session started
+	double late;				// paced only, how long after its time it started
+	double build;
+	double play;
+	double free;
+	int error;					// from Build or Play
+} PIUReplayTiming;
+
+//-------------------------------------------------------------------------------
+//	PIUReplay
+//
+//	Run plays every event of a recording on the target, as fast as it will
+//	go or, paced, at the times they were recorded, and keeps a timing for
+//	each.  The report is a summary table per event, and the same times as
+//	collapsed stacks,
+//
+//		replay;select;play 1520
+//
+//	a line per event and stage with microseconds, which flame graph tools
+//	(flamegraph.pl, speedscope) draw as one box per event, split into
+//	build, play and free.  A recording of what an artist says is slow,
+//	replayed this way, is a benchmark that can be run again after a change.
+//-------------------------------------------------------------------------------
+
+class PIUReplay {
+public:
+	PIUReplay(PIUReplayTarget& target);
+
+	// False if it is not a recording, or it is damaged; everything up to
+	// the damage is played.  Timings from an earlier Run are kept.
+	bool Run(const uint8_t* data, size_t size, const PIUReplayOptions& options);
+
+	const std::vector<PIUReplayTiming>& Timings(void) const { return timings; }
+
+	// Events the recording says were not recorded.
+	uint64_t Dropped(void) const { return dropped; }
+
+	// Seconds from the first event played to the end of the last.
+	double Elapsed(void) const { return elapsed; }
+
+	void Clear(void);
+
+	// One line per event name: count, errors, and total, mean, median,
+	// 95th percentile and longest build + play, in milliseconds, longest
+	// total first.
+	void WriteSummary(FILE* file) const;
+
+	// Collapsed stacks, see above.
+	void WriteFolded(FILE* file) const;
+
+	// The string ID of a runtime ID, otherwise the four characters, or
+	// the number if they are not printable.
+	static std::string EventName(const PIURecordingReader& reader, uint32_t number);
+
+private:
+	PIUReplayTarget& target;
+	std::vector<PIUReplayTiming> timings;
+	uint64_t dropped;
+	double elapsed;
+
+	PIUReplay(const PIUReplay&);
+	PIUReplay& operator=(const PIUReplay&);
+};
+
+#endif
+// end PIUReplay.h
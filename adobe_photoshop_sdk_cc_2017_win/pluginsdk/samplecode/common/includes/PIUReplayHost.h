@@ -0,0 +1,91 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUReplayHost.h
+//
+//	Description:
+//		Replays a recording on the host, see PIUReplay.h.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIUReplayHost_H__
+#define __PIUReplayHost_H__
+
+#include "PIUActionUtils.h"
+#include "PIUReplay.h"
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+/** Plays recorded events with sPSActionControl.
+
+	Build makes the event's descriptor again from the recording.  Runtime
+	IDs are looked up by their string ID, once per session, so a
+	recording made with one version of the host plays on another.  A path
+	is put back as an alias, which fails to play if the file is gone, as
+	it would have then.  Raw data was not recorded, only its length, so
+	an event with any fails to build and is not played; values of a kind
+	the recording did not know are left out.
+
+	Usage:
+		PIUReplayHost host;
+		PIUReplay replay(host);
+		replay.Run(&recording[0], recording.size(), PIUReplayOptions());
+		replay.WriteSummary(file);
+*/
+class PIUReplayHost : public PIUReplayTarget {
+public:
+	PIUReplayHost(PIDialogPlayOptions options = plugInDialogSilent);
+	virtual ~PIUReplayHost();
+
+	virtual void StartSession(const PIURecordingReader& reader);
+	virtual int Build(const PIURecordingReader& reader, const RecordedEvent& event);
+	virtual int Play(const PIURecordingReader& reader, const RecordedEvent& event);
+	virtual void Free(void);
+
+protected:
+	// The host's ID for a number in the recording, looked up once a session.
+	DescriptorTypeID ID(const PIURecordingReader& reader, uint32_t number);
+
+private:
+
+	// Puts value in list if it is not NULL, otherwise in descriptor at key.
+	SPErr PutValue(const PIURecordingReader& reader,
+				   const RecordedValue& value,
+				   PIActionDescriptor descriptor,
+				   DescriptorKeyID key,
+				   PIActionList list);
+
+	SPErr MakeDescriptor(const PIURecordingReader& reader,
+						 const RecordedValue& value,
+						 PIActionDescriptor* descriptor);
+
+	SPErr MakeList(const PIURecordingReader& reader,
+				   const RecordedValue& value,
+				   PIActionList* list);
+
+	SPErr MakeReference(const PIURecordingReader& reader,
+						const RecordedValue& value,
+						PIActionReference* reference);
+
+	PIDialogPlayOptions options;
+	vector<DescriptorTypeID> ids;		// by number, 0 if not looked up yet
+	PIActionDescriptor built;
+
+	PIUReplayHost(const PIUReplayHost&);
+	PIUReplayHost& operator=(const PIUReplayHost&);
+};
+
+#endif
+// end PIUReplayHost.h
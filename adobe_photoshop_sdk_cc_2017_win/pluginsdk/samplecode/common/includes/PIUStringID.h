@@ -0,0 +1,97 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUStringID.h
+//
+//	Description:
+//		Remembers what the host said a string ID and a type ID are, so
+//		each one is asked for once.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#ifndef __PIUStringID_H__
+#define __PIUStringID_H__
+
+#include "PIActions.h"
+#include <atomic>
+
+// StringIDToTypeID and TypeIDToStringID of PSActionControlProcs or
+// PSBasicActionControlProcs
+typedef SPAPI OSErr (*PIUStringIDProc)(const char* stringID, DescriptorTypeID* typeID);
+typedef SPAPI OSErr (*PIUTypeIDProc)(DescriptorTypeID typeID, char* stringID, uint32 stringLength);
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+/**	StringIDToTypeID and TypeIDToStringID, asking the host only the first
+	time for each ID.  The host's answer does not change while it runs,
+	so both are kept for good: there is one table for each direction,
+	shared by every thread.  Finding an ID that is there takes no lock;
+	only adding one does.  Failures are not kept.
+
+	proc is the host routine to ask; NULL asks sPSActionControl.  Plug-ins
+	that have the basic action control suite instead pass its routine.
+*/
+SPErr PIUStringIDToTypeID(const char* stringID,
+						  DescriptorTypeID* typeID,
+						  PIUStringIDProc proc = NULL);
+
+SPErr PIUTypeIDToStringID(DescriptorTypeID typeID,
+						  char* stringID,
+						  uint32 stringLength,
+						  PIUTypeIDProc proc = NULL);
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+/**	A string ID that is looked up the first time it is used, and then is
+	just a load.  Declare one static with PIU_DECLARE_STRING_ID, in a
+	function or at file scope, for a string ID used over and over:
+
+		PIU_DECLARE_STRING_ID(layerTimeID, "layerTime");
+		...
+		actionDescriptorProcs->GetFloat(descriptor, layerTimeID, &time);
+
+	It is 0 if the host could not say, and is asked again next time.
+*/
+class PIUStringID {
+public:
+	explicit PIUStringID(const char* inStringID) : stringID(inStringID), typeID(0) {}
+
+	DescriptorTypeID ID(PIUStringIDProc proc = NULL)
+	{
+		DescriptorTypeID id = typeID.load(std::memory_order_acquire);
+		if (id == 0)
+		{
+			if (PIUStringIDToTypeID(stringID, &id, proc) == kSPNoError)
+				typeID.store(id, std::memory_order_release);
+			else
+				id = 0;
+		}
+		return id;
+	}
+
+	operator DescriptorTypeID() { return ID(); }
+
+private:
+	const char* stringID;
+	std::atomic<DescriptorTypeID> typeID;
+
+	PIUStringID(const PIUStringID&);
+	PIUStringID& operator=(const PIUStringID&);
+};
+
+#define PIU_DECLARE_STRING_ID(name, stringID) static PIUStringID name(stringID)
+
+#endif
+// end PIUStringID.h
@@ -27,6 +27,9 @@
 #include "FileUtilities.h"
 #if __PIMac__
 #include <Cocoa/Cocoa.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 /*****************************************************************************/
@@ -133,6 +136,96 @@ OSErr PSSDKSetFPos(int32 refNum, short posMode, long posOff)
 
 /*****************************************************************************/
 
+OSErr PSSDKSetFPos64(int32 refNum, short posMode, int64 posOff)
+{
+	return FSSetForkPosition(refNum, posMode, posOff);
+}
+
+/*****************************************************************************/
+
+OSErr PSSDKGetFPos(int32 refNum, int64 * position)
+{
+	if (NULL == position)
+		return readErr;
+
+	SInt64 forkPosition = 0;
+	OSErr err = FSGetForkPosition(refNum, &forkPosition);
+	*position = forkPosition;
+	return err;
+}
+
+/*****************************************************************************/
+
+OSErr PSSDKGetEOF(int32 refNum, int64 * size)
+{
+	if (NULL == size)
+		return readErr;
+
+	SInt64 forkSize = 0;
+	OSErr err = FSGetForkSize(refNum, &forkSize);
+	*size = forkSize;
+	return err;
+}
+
+/*****************************************************************************/
+
+OSErr PSSDKSetEOF(int32 refNum, int64 size)
+{
+	return FSSetForkSize(refNum, fsFromStart, size);
+}
+
+/*****************************************************************************/
+
+// Maps the whole file for reading.  An empty file maps to a NULL address.
+OSErr PSSDKMapFile(int32 refNum, const void ** address, int64 * size, intptr_t * mapping)
+{
+	if (NULL == address || NULL == size || NULL == mapping)
+		return readErr;
+
+	*address = NULL;
+	*mapping = 0;
+
+	OSErr err = PSSDKGetEOF(refNum, size);
+	if (err != noErr || *size == 0)
+		return err;
+
+	// a fork cannot be mapped, the file it belongs to can
+	FSRef fileRef;
+	err = FSGetForkCBInfo(refNum, 0, NULL, NULL, NULL, &fileRef, NULL);
+	if (err != noErr)
+		return err;
+
+	UInt8 path [PATH_MAX];
+	if (FSRefMakePath(&fileRef, path, sizeof(path)) != noErr)
+		return readErr;
+
+	int fd = open(reinterpret_cast<const char *>(path), O_RDONLY);
+	if (fd < 0)
+		return readErr;
+
+	void * view = mmap(NULL, static_cast<size_t>(*size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (view == MAP_FAILED)
+		return memFullErr;
+
+	*address = view;
+
+	return noErr;
+}
+
+/*****************************************************************************/
+
+OSErr PSSDKUnmapFile(intptr_t /*mapping*/, const void * address, int64 size)
+{
+	if (address != NULL)
+		munmap(const_cast<void *>(address), static_cast<size_t>(size));
+
+	return noErr;
+}
+
+/*****************************************************************************/
+
 OSErr PSSDKRead(int32 refNum, int32 * count, void * buffPtr)
 {
 	if (NULL == count || NULL == buffPtr)
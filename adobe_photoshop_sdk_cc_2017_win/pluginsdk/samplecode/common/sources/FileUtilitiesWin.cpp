@@ -54,6 +54,104 @@ OSErr PSSDKSetFPos(intptr_t refNum, short posMode, long posOff)
 	return noErr;
 }
 
+OSErr PSSDKSetFPos64(intptr_t refNum, short posMode, int64 posOff)
+{
+	LARGE_INTEGER distance;
+	distance.QuadPart = posOff;
+
+	if (!SetFilePointerEx((HANDLE)refNum, distance, NULL, posMode))
+		return writErr;
+
+	return noErr;
+}
+
+OSErr PSSDKGetFPos(intptr_t refNum, int64 * position)
+{
+	if (NULL == position)
+		return readErr;
+
+	LARGE_INTEGER distance;
+	LARGE_INTEGER moved;
+	distance.QuadPart = 0;
+
+	if (!SetFilePointerEx((HANDLE)refNum, distance, &moved, FILE_CURRENT))
+		return readErr;
+
+	*position = moved.QuadPart;
+
+	return noErr;
+}
+
+OSErr PSSDKGetEOF(intptr_t refNum, int64 * size)
+{
+	if (NULL == size)
+		return readErr;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx((HANDLE)refNum, &fileSize))
+		return readErr;
+
+	*size = fileSize.QuadPart;
+
+	return noErr;
+}
+
+OSErr PSSDKSetEOF(intptr_t refNum, int64 size)
+{
+	LARGE_INTEGER distance;
+	distance.QuadPart = size;
+
+	if (!SetFilePointerEx((HANDLE)refNum, distance, NULL, FILE_BEGIN))
+		return writErr;
+
+	if (!SetEndOfFile((HANDLE)refNum))
+		return writErr;
+
+	return noErr;
+}
+
+// Maps the whole file for reading.  An empty file maps to a NULL address.
+OSErr PSSDKMapFile(intptr_t refNum, const void ** address, int64 * size, intptr_t * mapping)
+{
+	if (NULL == address || NULL == size || NULL == mapping)
+		return readErr;
+
+	*address = NULL;
+	*mapping = 0;
+
+	OSErr err = PSSDKGetEOF(refNum, size);
+	if (err != noErr || *size == 0)
+		return err;
+
+	HANDLE fileMapping = CreateFileMapping((HANDLE)refNum, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (fileMapping == NULL)
+		return readErr;
+
+	void * view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(fileMapping);
+		return memFullErr;
+	}
+
+	*address = view;
+	*mapping = (intptr_t)fileMapping;
+
+	return noErr;
+}
+
+OSErr PSSDKUnmapFile(intptr_t mapping, const void * address, int64 /*size*/)
+{
+	if (address != NULL)
+		UnmapViewOfFile(address);
+
+	if (mapping != 0)
+		CloseHandle((HANDLE)mapping);
+
+	return noErr;
+}
+
 OSErr PSSDKRead(intptr_t refNum, int32 * count, void * buffPtr)
 {
 	if (NULL == count || NULL == buffPtr)
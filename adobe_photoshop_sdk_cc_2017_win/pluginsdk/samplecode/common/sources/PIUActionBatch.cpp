@@ -0,0 +1,300 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUActionBatch.cpp
+//
+//	Description:
+//		Queues commands and plays them together as one history state.
+//		See PIUActionBatch.h for more information.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#include "PIUActionBatch.h"
+#include <string.h>
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+PIUActionBatch::PIUActionBatch() : firstToPlay(0), playing(false)
+{
+}
+
+PIUActionBatch::~PIUActionBatch()
+{
+	Clear();
+}
+
+void PIUActionBatch::Clear(void)
+{
+	for (size_t c = 0; c < commands.size(); c++)
+	{
+		if (commands[c].descriptor != NULL)
+			sPSActionDescriptor->Free(commands[c].descriptor);
+		if (commands[c].result != NULL)
+			sPSActionDescriptor->Free(commands[c].result);
+	}
+	commands.clear();
+	firstToPlay = 0;
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+SPErr PIUActionBatch::Add(DescriptorEventID event,
+						  PIActionDescriptor descriptor,
+						  PIDialogPlayOptions options,
+						  PIUActionBatchCheck check,
+						  bool dependsOnPrevious)
+{
+	Command command;
+	command.event = event;
+	command.descriptor = descriptor;
+	command.options = options;
+	command.check = check;
+	command.dependsOnPrevious = dependsOnPrevious;
+	command.error = kSPNoError;
+	command.result = NULL;
+
+	try
+	{
+		commands.push_back(command);
+	}
+	catch (...)
+	{
+		if (descriptor != NULL)
+			sPSActionDescriptor->Free(descriptor);
+		return kSPOutOfMemoryError;
+	}
+
+	return kSPNoError;
+}
+
+SPErr PIUActionBatch::AddPlayByName(const char* setName,
+									const char* actionName,
+									bool dependsOnPrevious)
+{
+	PIActionReference reference = NULL;
+	PIActionDescriptor descriptor = NULL;
+
+	SPErr error = sPSActionReference->Make(&reference);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutName(reference, classAction, (char*)actionName);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutName(reference, classActionSet, (char*)setName);
+	if (error) goto returnError;
+
+	error = sPSActionDescriptor->Make(&descriptor);
+	if (error) goto returnError;
+
+	error = sPSActionDescriptor->PutReference(descriptor, keyNull, reference);
+	if (error) goto returnError;
+
+	error = Add(eventPlay, descriptor, plugInDialogSilent, PIUCheckPlayResult, dependsOnPrevious);
+	descriptor = NULL;
+
+returnError:
+
+	if (reference != NULL) sPSActionReference->Free(reference);
+	if (descriptor != NULL) sPSActionDescriptor->Free(descriptor);
+
+	return error;
+}
+
+SPErr PIUActionBatch::AddSelectByName(DescriptorClassID desiredClass,
+									  const char* name,
+									  bool dependsOnPrevious)
+{
+	PIActionReference reference = NULL;
+	PIActionDescriptor descriptor = NULL;
+
+	SPErr error = sPSActionReference->Make(&reference);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutName(reference, desiredClass, (char*)name);
+	if (error) goto returnError;
+
+	error = sPSActionDescriptor->Make(&descriptor);
+	if (error) goto returnError;
+
+	error = sPSActionDescriptor->PutReference(descriptor, keyNull, reference);
+	if (error) goto returnError;
+
+	error = Add(eventSelect, descriptor, plugInDialogSilent, PIUCheckPlayResult, dependsOnPrevious);
+	descriptor = NULL;
+
+returnError:
+
+	if (reference != NULL) sPSActionReference->Free(reference);
+	if (descriptor != NULL) sPSActionDescriptor->Free(descriptor);
+
+	return error;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	Play
+//
+//	SuspendHistory calls PlayCommands back with history turned off.  If it
+//	fails before calling back, there is no document to put the state on,
+//	so the commands are played as they are.  Each command's error is kept
+//	in the batch, not returned through SuspendHistory, which older hosts
+//	did not pass back.
+//
+//-------------------------------------------------------------------------------
+SPErr PIUActionBatch::Play(const char* operationName, bool redraw)
+{
+	size_t first = firstToPlay;
+
+	if (first == commands.size())
+		return kSPNoError;
+
+	playing = false;
+
+	SPErr suspendError = kSPNoError;
+	if (operationName != NULL)
+		suspendError = SuspendHistory(operationName);
+
+	if (!playing)
+	{
+		suspendError = kSPNoError;
+		(void)PlayCommands(this);
+	}
+
+	SPErr error = kSPNoError;
+	bool played = false;
+
+	for (size_t c = first; c < commands.size(); c++)
+	{
+		if (commands[c].error == kSPNoError)
+			played = true;
+		else if (error == kSPNoError)
+			error = commands[c].error;
+	}
+
+	// once, however many commands changed the document
+	if (redraw && played)
+		(void)Redraw();
+
+	return error != kSPNoError ? error : suspendError;
+}
+
+SPErr PIUActionBatch::PlayCommands(void* data)
+{
+	PIUActionBatch* batch = (PIUActionBatch*)data;
+
+	batch->playing = true;
+
+	for (size_t c = batch->firstToPlay; c < batch->commands.size(); c++)
+		batch->PlayCommand(c);
+
+	batch->firstToPlay = batch->commands.size();
+
+	// each command has its own error; the batch as a whole went through
+	return kSPNoError;
+}
+
+void PIUActionBatch::PlayCommand(size_t c)
+{
+	Command& command = commands[c];
+
+	if (command.dependsOnPrevious && c > 0 && commands[c - 1].error != kSPNoError)
+	{
+		command.error = kPIUActionBatchSkipped;
+	}
+	else
+	{
+		command.error = sPSActionControl->Play(&command.result,
+											   command.event,
+											   command.descriptor,
+											   command.options);
+
+		if (command.error == kSPNoError)
+		{
+			if (command.check != NULL)
+			{
+				command.error = command.check(command.result);
+			}
+			else if (command.result != NULL)
+			{
+				Boolean hasKey = false;
+				(void)sPSActionDescriptor->HasKey(command.result, keyMessage, &hasKey);
+				if (hasKey)
+					command.error = -1;
+			}
+		}
+	}
+
+	// played or not, it will not be played again
+	if (command.descriptor != NULL)
+	{
+		sPSActionDescriptor->Free(command.descriptor);
+		command.descriptor = NULL;
+	}
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+SPErr PIUActionBatch::SuspendHistory(const char* operationName)
+{
+	PIActionReference reference = NULL;
+	ASZString name = NULL;
+
+	SPErr error = sPSActionReference->Make(&reference);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutEnumerated(reference, classDocument, typeOrdinal, enumTarget);
+	if (error) goto returnError;
+
+	if (!sASZString.IsAvailable())
+	{
+		error = kSPSuiteNotFoundError;
+		goto returnError;
+	}
+
+	error = sASZString->MakeFromCString(operationName, strlen(operationName), &name);
+	if (error) goto returnError;
+
+	error = sPSActionControl->SuspendHistory(reference, PlayCommands, this, name);
+
+returnError:
+
+	if (reference != NULL) sPSActionReference->Free(reference);
+	if (name != NULL) sASZString->Release(name);
+
+	return error;
+}
+
+SPErr PIUActionBatch::Redraw(void)
+{
+	PIActionDescriptor descriptor = NULL;
+	PIActionDescriptor result = NULL;
+
+	SPErr error = sPSActionDescriptor->Make(&descriptor);
+	if (error) goto returnError;
+
+	error = sPSActionDescriptor->PutEnumerated(descriptor, keyState, typeState, enumRedrawComplete);
+	if (error) goto returnError;
+
+	error = sPSActionControl->Play(&result, eventWait, descriptor, plugInDialogSilent);
+
+returnError:
+
+	if (descriptor != NULL) sPSActionDescriptor->Free(descriptor);
+	if (result != NULL) sPSActionDescriptor->Free(result);
+
+	return error;
+}
+
+// end PIUActionBatch.cpp
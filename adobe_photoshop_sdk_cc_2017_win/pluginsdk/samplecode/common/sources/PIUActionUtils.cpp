@@ -27,6 +27,10 @@
 
 #ifdef _DEBUG
 	#include "PSConstantArray.cpp"
+	#include <algorithm>
+	#include <cassert>
+	#include <set>
+	#include <string.h>
 #endif
 
 #if __PIMac__
@@ -37,7 +41,8 @@
 //	Classes
 //-------------------------------------------------------------------------------
 // Handy class for the listener debug output
-// Keeps track of objects that need to be freed
+// Keeps track of objects that need to be freed, side by side in one
+// vector so adding one does not allocate
 class FreeZone {
 public:
 	FreeZone();
@@ -51,8 +56,13 @@ public:
 	void Output(ofstream&);
 	
 private:
-	void Add(const char* text, intptr_t value);
-	vector<char*> v_array;
+	typedef struct FreeEntry {
+		char kind;			// r, l, d, a or b; see Output
+		intptr_t value;
+	} FreeEntry;
+
+	void Add(char kind, intptr_t value);
+	vector<FreeEntry> entries;
 };
 
 
@@ -207,9 +217,9 @@ void PIUDumpDescriptor(const DescriptorEventID event,
 	        sPSActionControl.IsAvailable()))
 	    return;
 	
-	freeZone = new FreeZone;
-	if (freeZone == NULL)	
-		return;
+	// freed when this returns, however it returns
+	FreeZone zone;
+	freeZone = &zone;
 
 	char* eventIDAsString = new char[maxHashStringSize];// the string name of the event
 	if (eventIDAsString == NULL) 
@@ -307,7 +317,7 @@ void PIUDumpDescriptor(const DescriptorEventID event,
 	fileOut << "}" << endl << endl;
 
 	delete [] eventIDAsString;
-	delete freeZone;
+	freeZone = NULL;
 
 	#if __PIWin__
 		if ( NULL != fd )
@@ -2261,6 +2271,334 @@ unsigned long PIUCharToID (const char* inChars)
 // a debug build:
 #ifdef _DEBUG
 
+//-------------------------------------------------------------------------------
+//
+//	PerfectHash
+//
+//	Hash and displace: keys are spread over buckets of about four, and each
+//	bucket, biggest first, gets the first seed that sends all of its keys to
+//	free slots in a table twice the size of the key set.  A lookup is two
+//	hashes, and the caller compares the one entry in the slot it gets.
+//
+//-------------------------------------------------------------------------------
+static inline uint64 MixHash(uint64 value)
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33;
+	return value;
+}
+
+static uint64 NameHash(const char* name)
+{
+	uint64 hash = 14695981039346656037ULL;
+	while (*name)
+	{
+		hash ^= static_cast<uint8>(*name++);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+class PerfectHash {
+public:
+	// keys must be distinct; returns false if no seeds were found
+	bool Build(const vector<uint64>& keys);
+
+	size_t Slot(uint64 key) const
+	{
+		uint64 seed = seeds[MixHash(key) % seeds.size()];
+		return static_cast<size_t>(MixHash(key + seed * 0x9e3779b97f4a7c15ULL)) & mask;
+	}
+
+	size_t Size(void) const { return mask + 1; }
+
+private:
+	vector<uint32> seeds;
+	size_t mask;
+};
+
+bool PerfectHash::Build(const vector<uint64>& keys)
+{
+	size_t size = 1;
+	while (size < 2 * keys.size())
+		size <<= 1;
+	mask = size - 1;
+
+	vector< vector<size_t> > buckets(keys.size() / 4 + 1);
+	for (size_t key = 0; key < keys.size(); key++)
+		buckets[MixHash(keys[key]) % buckets.size()].push_back(key);
+
+	vector<size_t> order(buckets.size());
+	for (size_t bucket = 0; bucket < order.size(); bucket++)
+		order[bucket] = bucket;
+	stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b)
+	{
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	seeds.assign(buckets.size(), 0);
+	vector<bool> used(size, false);
+	vector<size_t> slots;
+
+	for (size_t a = 0; a < order.size(); a++)
+	{
+		const vector<size_t>& bucket = buckets[order[a]];
+		bool placed = bucket.empty();
+
+		for (uint32 seed = 1; !placed && seed < 0x100000; seed++)
+		{
+			seeds[order[a]] = seed;
+			slots.clear();
+
+			size_t key = 0;
+			for (; key < bucket.size(); key++)
+			{
+				size_t slot = Slot(keys[bucket[key]]);
+				if (used[slot] || find(slots.begin(), slots.end(), slot) != slots.end())
+					break;
+				slots.push_back(slot);
+			}
+
+			placed = key == bucket.size();
+		}
+
+		if (!placed)
+			return false;
+
+		for (size_t key = 0; key < slots.size(); key++)
+			used[slots[key]] = true;
+	}
+
+	return true;
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	ConstantIndex
+//
+//	Lookups into the PSConstA table above.  Several constants can share an
+//	ID, a key and a class for instance, so the ID hash finds the run of
+//	constants with that ID, in table order, and LongToStr picks the first
+//	one of the kind it wants.  The name hash finds the first constant with
+//	that name.  The index is built the first time a dump needs it.
+//
+//	It is checked against the table scans when it is built, a scan per
+//	constant, which the debug builds that have the dump can afford.  Define
+//	PIU_CHECK_CONSTANT_INDEX to 0 to leave the check out.
+//
+//-------------------------------------------------------------------------------
+#ifndef PIU_CHECK_CONSTANT_INDEX
+	#define PIU_CHECK_CONSTANT_INDEX 1
+#endif
+
+class ConstantIndex {
+public:
+	ConstantIndex();
+
+	// NULL if there is no constant of that kind with that ID
+	const char* FindName(int32 id, const char* kind) const;
+
+	// 0 if there is no constant with that name
+	int32 FindID(const char* name) const;
+
+private:
+	bool Build(void);
+#if PIU_CHECK_CONSTANT_INDEX
+	bool Check(void) const;
+#endif
+
+	bool ready;							// false falls back to the table scans
+
+	PerfectHash idHash;
+	vector<int32> byID;					// PSConstA entries, sorted by ID
+	vector<int32> idFirst;				// per slot, into byID
+	vector<int32> idCount;
+
+	PerfectHash nameHash;
+	vector<int32> nameEntry;			// per slot, into PSConstA, -1 if empty
+};
+
+static const int32 ConstantCount = sizeof(PSConstA) / sizeof(PSConstantArray);
+
+static const char* FindNameLinear(int32 id, const char* kind)
+{
+	for (int32 counter = 0; counter < ConstantCount; counter++)
+		if (PSConstA[counter].longVal == id && strstr(PSConstA[counter].strStr, kind))
+			return PSConstA[counter].strStr;
+	return NULL;
+}
+
+static int32 FindIDLinear(const char* name)
+{
+	for (int32 counter = 0; counter < ConstantCount; counter++)
+		if (strcmp(name, PSConstA[counter].strStr) == 0)
+			return PSConstA[counter].longVal;
+	return 0;
+}
+
+ConstantIndex::ConstantIndex() : ready(false)
+{
+	ready = Build();
+#if PIU_CHECK_CONSTANT_INDEX
+	// no hash is a reason to scan, but a wrong one is a bug in the index
+	bool checked = ready && Check();
+	assert(checked == ready);
+	ready = checked;
+#endif
+}
+
+bool ConstantIndex::Build(void)
+{
+	byID.resize(ConstantCount);
+	for (int32 counter = 0; counter < ConstantCount; counter++)
+		byID[counter] = counter;
+	stable_sort(byID.begin(), byID.end(), [](int32 a, int32 b)
+	{
+		return PSConstA[a].longVal < PSConstA[b].longVal;
+	});
+
+	vector<uint64> ids;
+	vector<int32> runs;
+	for (int32 counter = 0; counter < ConstantCount; counter++)
+	{
+		if (counter == 0 || PSConstA[byID[counter]].longVal != PSConstA[byID[counter - 1]].longVal)
+		{
+			ids.push_back(static_cast<uint32>(PSConstA[byID[counter]].longVal));
+			runs.push_back(counter);
+		}
+	}
+	runs.push_back(ConstantCount);
+
+	if (!idHash.Build(ids))
+		return false;
+
+	idFirst.assign(idHash.Size(), 0);
+	idCount.assign(idHash.Size(), 0);
+	for (size_t id = 0; id < ids.size(); id++)
+	{
+		size_t slot = idHash.Slot(ids[id]);
+		idFirst[slot] = runs[id];
+		idCount[slot] = runs[id + 1] - runs[id];
+	}
+
+	// the first of any repeated name wins, as it did in the table scan
+	vector<uint64> names;
+	vector<int32> entries;
+	set<uint64> seen;
+	for (int32 counter = 0; counter < ConstantCount; counter++)
+	{
+		uint64 hash = NameHash(PSConstA[counter].strStr);
+		if (seen.insert(hash).second)
+		{
+			names.push_back(hash);
+			entries.push_back(counter);
+		}
+	}
+
+	if (!nameHash.Build(names))
+		return false;
+
+	nameEntry.assign(nameHash.Size(), -1);
+	for (size_t name = 0; name < names.size(); name++)
+		nameEntry[nameHash.Slot(names[name])] = entries[name];
+
+	return true;
+}
+
+const char* ConstantIndex::FindName(int32 id, const char* kind) const
+{
+	if (!ready)
+		return FindNameLinear(id, kind);
+
+	size_t slot = idHash.Slot(static_cast<uint32>(id));
+	for (int32 run = 0; run < idCount[slot]; run++)
+	{
+		const PSConstantArray& constant = PSConstA[byID[idFirst[slot] + run]];
+		if (constant.longVal != id)
+			break;
+		if (strstr(constant.strStr, kind))
+			return constant.strStr;
+	}
+	return NULL;
+}
+
+int32 ConstantIndex::FindID(const char* name) const
+{
+	if (!ready)
+		return FindIDLinear(name);
+
+	int32 entry = nameEntry[nameHash.Slot(NameHash(name))];
+	if (entry >= 0 && strcmp(name, PSConstA[entry].strStr) == 0)
+		return PSConstA[entry].longVal;
+	return 0;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	ConstantIndex::Check
+//
+//	Compares every lookup the dump can make against the table scans, once,
+//	when the index is built: every ID in the table and the IDs next to it,
+//	for every kind LongToStr asks for, and every name in the table.  Any
+//	difference asserts, and the scans are used instead.
+//
+//-------------------------------------------------------------------------------
+#if PIU_CHECK_CONSTANT_INDEX
+bool ConstantIndex::Check(void) const
+{
+	static const char* kinds[] = { "event", "class", "type", "enum", "key", "form", "unit", "xxxx" };
+
+	for (int32 counter = 0; counter < ConstantCount; counter++)
+	{
+		int32 id = PSConstA[counter].longVal;
+		int32 neighbors[] = { id - 1, id, id + 1 };
+
+		for (size_t n = 0; n < sizeof(neighbors) / sizeof(neighbors[0]); n++)
+		{
+			// one scan gives what FindNameLinear would for every kind
+			vector<const char*> matches;
+			for (int32 other = 0; other < ConstantCount; other++)
+				if (PSConstA[other].longVal == neighbors[n])
+					matches.push_back(PSConstA[other].strStr);
+
+			for (size_t kind = 0; kind < sizeof(kinds) / sizeof(kinds[0]); kind++)
+			{
+				const char* expected = NULL;
+				for (size_t match = 0; match < matches.size() && expected == NULL; match++)
+					if (strstr(matches[match], kinds[kind]))
+						expected = matches[match];
+
+				if (FindName(neighbors[n], kinds[kind]) != expected)
+					return false;
+			}
+		}
+
+		string name(PSConstA[counter].strStr);
+		if (FindID(name.c_str()) != FindIDLinear(name.c_str()))
+			return false;
+
+		name += "x";
+		if (FindID(name.c_str()) != FindIDLinear(name.c_str()))
+			return false;
+	}
+
+	return true;
+}
+#endif // PIU_CHECK_CONSTANT_INDEX
+
+static const ConstantIndex& GetConstantIndex(void)
+{
+	static const ConstantIndex index;
+	return index;
+}
+
+
+
 //-------------------------------------------------------------------------------
 //
 //	LongToStr
@@ -2271,8 +2609,6 @@ unsigned long PIUCharToID (const char* inChars)
 //-------------------------------------------------------------------------------
 static void LongToStr(int32 inputLong, const char* inputKeyType, char* returnString, int32 maxStringSize)
 {
-	// don't want to recalculate this all the time
-	static const int32 ArraySize = sizeof(PSConstA) / sizeof(PSConstantArray);
 	bool found = false;
 
 	// blank it out
@@ -2290,20 +2626,18 @@ static void LongToStr(int32 inputLong, const char* inputKeyType, char* returnStr
     	}
     }
 
-	// loop through all the above constants looking for the one that matches
-	// in an ideal world you wouldn't need the inputKeyType but there are constants
-	// that break the hash code creation world so we want to make sure if you are
-	// asking for a key you will get a key and not a class or something else
+	// look for the constant with this ID.  In an ideal world you wouldn't need
+	// the inputKeyType but there are constants that break the hash code creation
+	// world so we want to make sure if you are asking for a key you will get a
+	// key and not a class or something else
 	if (!found)
 	{
-	    for (int32 counter = 0; counter < ArraySize; counter++)
-    	    if (PSConstA[counter].longVal == inputLong)
-				if (strstr(PSConstA[counter].strStr, inputKeyType))
-				{
-					strcpy_s(returnString, maxStringSize-1, PSConstA[counter].strStr);
-					counter = ArraySize;// and stop the for loop
-					found = true;
-				}
+		const char* name = GetConstantIndex().FindName(inputLong, inputKeyType);
+		if (name != NULL)
+		{
+			strcpy_s(returnString, maxStringSize-1, name);
+			found = true;
+		}
 	}
 
 	// didn't find a match so convert the number to its 'Hash' code
@@ -2327,17 +2661,9 @@ static void LongToStr(int32 inputLong, const char* inputKeyType, char* returnStr
 //-------------------------------------------------------------------------------
 static unsigned long StrToLong(const char* inputStr)
 {
-	// don't want to recalculate this all the time
-	static const int32 ArraySize = sizeof(PSConstA) / sizeof(PSConstantArray);
-
 	unsigned long returnLong = 0;
 	if (inputStr)
-		for(int32 counter = 0; counter < ArraySize; counter++)
-			if (strcmp(inputStr, PSConstA[counter].strStr) == 0)
-			{
-				returnLong = PSConstA[counter].longVal;
-				break;
-			}
+		returnLong = GetConstantIndex().FindID(inputStr);
 	return (returnLong);
 }
 
@@ -2347,10 +2673,13 @@ static unsigned long StrToLong(const char* inputStr)
 //
 //	FreeZone::FreeZone
 //
-//	Constructor for the FreeZone. Doesn't do anything.
+//	Constructor for the FreeZone. Makes room for a typical event.
 //
 //-------------------------------------------------------------------------------
-FreeZone::FreeZone() {}
+FreeZone::FreeZone()
+{
+	entries.reserve(32);
+}
 
 
 
@@ -2358,19 +2687,10 @@ FreeZone::FreeZone() {}
 //
 //	FreeZone::~FreeZone
 //
-//	Destructor for the FreeZone class. Deletes all the char []'s in the vector.
+//	Destructor for the FreeZone class. The entries hold no memory of their own.
 //
 //-------------------------------------------------------------------------------
-FreeZone::~FreeZone()
-{
-	vector<char*>::iterator array_iter = v_array.begin();
-	vector<char*>::iterator array_end = v_array.end();
-	while(array_iter != array_end)
-	{
-		delete [] *array_iter;
-		array_iter++;
-	}
-}
+FreeZone::~FreeZone() {}
 
 
 
@@ -2383,7 +2703,7 @@ FreeZone::~FreeZone()
 //-------------------------------------------------------------------------------
 void FreeZone::Add(PIActionReference reference)
 {
-	Add("ref", (intptr_t)reference);
+	Add('r', (intptr_t)reference);
 }
 
 
@@ -2397,7 +2717,7 @@ void FreeZone::Add(PIActionReference reference)
 //-------------------------------------------------------------------------------
 void FreeZone::Add(PIActionList list)
 {
-	Add("list", (intptr_t)list);
+	Add('l', (intptr_t)list);
 }
 
 
@@ -2411,7 +2731,7 @@ void FreeZone::Add(PIActionList list)
 //-------------------------------------------------------------------------------
 void FreeZone::Add(PIActionDescriptor descriptor)
 {
-	Add("desc", (intptr_t)descriptor);
+	Add('d', (intptr_t)descriptor);
 }
 
 
@@ -2420,17 +2740,12 @@ void FreeZone::Add(PIActionDescriptor descriptor)
 //
 //	FreeZone::Add
 //
-//	Add a handle to the vector using a special routine.
+//	Add a handle to the vector. The generated code always calls it aliasValue.
 //
 //-------------------------------------------------------------------------------
 void FreeZone::Add(Handle /*aliasValue*/)
 {
-	const size_t s = strlen("aliasValue") + 1;
-	char* ptr = new char[s];
-	if (ptr == NULL) 
-		return;
-	strcpy_s(ptr, s, "aliasValue");
-	v_array.push_back(ptr);
+	Add('a', 0);
 }
 
 
@@ -2439,17 +2754,13 @@ void FreeZone::Add(Handle /*aliasValue*/)
 //
 //	FreeZone::Add
 //
-//	Add a CFDataRef to the vector using a special routine.
+//	Add a CFDataRef to the vector. The generated code always calls it
+//	bookmarkValue.
 //
 //-------------------------------------------------------------------------------
 void FreeZone::Add(CFDataRef /*dataRef*/)
 {
-	const size_t s = strlen("bookmarkValue") + 1;
-	char* ptr = new char[s];
-	if (ptr == NULL) 
-		return;
-	strcpy_s(ptr, s, "bookmarkValue");
-	v_array.push_back(ptr);
+	Add('b', 0);
 }
 
 
@@ -2458,21 +2769,15 @@ void FreeZone::Add(CFDataRef /*dataRef*/)
 //
 //	FreeZone::Add
 //
-//	The generic add.
+//	The generic add. The variable name is only made when it is output.
 //
 //-------------------------------------------------------------------------------
-void FreeZone::Add(const char* text, intptr_t value)
+void FreeZone::Add(char kind, intptr_t value)
 {
-	const size_t s = strlen(text) + 1;
-	const size_t sa = s + 20;
-	char* ptr = new char[sa];
-	if (ptr == NULL) 
-		return;
-	std::ostringstream temp;
-    temp << text << std::setw(sizeof(void*) * 2) << std::hex << std::setfill('0') << value;
-	strncpy(ptr, temp.str().c_str(), sa - 1);
-	ptr[sa-1] = '\0';
-	v_array.push_back(ptr);
+	FreeEntry entry;
+	entry.kind = kind;
+	entry.value = value;
+	entries.push_back(entry);
 }
 
 
@@ -2481,60 +2786,54 @@ void FreeZone::Add(const char* text, intptr_t value)
 //
 //	FreeZone::Output
 //
-//	Dump the vector to the stream.
+//	Dump the vector to the stream, newest first, so the generated code frees
+//	things in the reverse of the order it made them.
 //
 //-------------------------------------------------------------------------------
 void FreeZone::Output(ofstream& fileOut)
 {
-	vector<char*>::iterator array_iter = v_array.begin();
-	vector<char*>::iterator array_end = v_array.end();
-	while(array_iter != array_end)
+	vector<FreeEntry>::reverse_iterator entry_iter = entries.rbegin();
+	vector<FreeEntry>::reverse_iterator entry_end = entries.rend();
+	while(entry_iter != entry_end)
 	{
-		char freeType = (*array_iter)[0];
-		switch (freeType)
+		// the same names the generated code gave them when it made them
+		std::ostringstream name;
+		const char* freeCall = NULL;
+		switch (entry_iter->kind)
 		{
 			case 'r':
-				TabOver(fileOut);
-				fileOut << "if (" 
-					   << *array_iter 
-						<< " != NULL) sPSActionReference->Free(" 
-						<< *array_iter << ");" 
-						<< endl;
+				name << "ref";
+				freeCall = "sPSActionReference->Free(";
 				break;
 			case 'l':
-				TabOver(fileOut);
-				fileOut << "if (" 
-					    << *array_iter 
-						<< " != NULL) sPSActionList->Free(" 
-						<< *array_iter << ");" 
-						<< endl;
+				name << "list";
+				freeCall = "sPSActionList->Free(";
 				break;
 			case 'd':
-				TabOver(fileOut);
-				fileOut << "if (" 
-					    << *array_iter 
-						<< " != NULL) sPSActionDescriptor->Free(" 
-						<< *array_iter << ");" 
-						<< endl;
+				name << "desc";
+				freeCall = "sPSActionDescriptor->Free(";
 				break;
 			case 'a':
-				TabOver(fileOut);
-				fileOut << "if (" 
-					    << *array_iter 
-						<< " != NULL) sPSHandle->DisposeRegularHandle(" 
-						<< *array_iter << ");" 
-						<< endl;
+				name << "aliasValue";
+				freeCall = "sPSHandle->DisposeRegularHandle(";
 				break;
 			case 'b':
-				TabOver(fileOut);
-				fileOut << "if ("
-					    << *array_iter
-						<< " != NULL) CFRelease("
-						<< *array_iter << ");"
-						<< endl;
+				name << "bookmarkValue";
+				freeCall = "CFRelease(";
 				break;
 		}
-		array_iter++;
+		if (entry_iter->kind == 'r' || entry_iter->kind == 'l' || entry_iter->kind == 'd')
+			name << std::setw(sizeof(void*) * 2) << std::hex << std::setfill('0') << entry_iter->value;
+		if (freeCall != NULL)
+		{
+			TabOver(fileOut);
+			fileOut << "if (" 
+				    << name.str() 
+					<< " != NULL) " << freeCall 
+					<< name.str() << ");" 
+					<< endl;
+		}
+		entry_iter++;
 	}
 }
 
@@ -0,0 +1,1392 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUDescriptorLog.cpp
+//
+//	Description:
+//		Event logging that can stay on in a release build.  See
+//		PIUDescriptorLog.h for the snapshot layout, and PIURecording.h
+//		for the binary recordings.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#include "PIUDescriptorLog.h"
+#include "PIUFile.h"
+#include "PIUStringID.h"
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#if __PIMac__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-------------------------------------------------------------------------------
+//	Locals
+//-------------------------------------------------------------------------------
+// Descriptors nested deeper than this are cut off
+static const int32 kMaxSnapshotDepth = 64;
+
+static bool IsRuntimeID(uint32 id)
+{
+	return id < static_cast<uint32>(SmallestHashValue);
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	ValueSlot
+//
+//	One value in a descriptor or a list, so the snapshot reads both the
+//	same way.
+//
+//-------------------------------------------------------------------------------
+class ValueSlot {
+public:
+	ValueSlot(PIActionDescriptor inDescriptor, DescriptorKeyID inKey)
+		: descriptor(inDescriptor), key(inKey), list(NULL), index(0) {}
+	ValueSlot(PIActionList inList, uint32 inIndex)
+		: descriptor(NULL), key(0), list(inList), index(inIndex) {}
+
+	OSErr GetType(DescriptorTypeID* type) const
+	{ return descriptor ? sPSActionDescriptor->GetType(descriptor, key, type) : sPSActionList->GetType(list, index, type); }
+	OSErr GetInteger64(int64* value) const
+	{ return descriptor ? sPSActionDescriptor->GetInteger64(descriptor, key, value) : sPSActionList->GetInteger64(list, index, value); }
+	OSErr GetInteger(int32* value) const
+	{ return descriptor ? sPSActionDescriptor->GetInteger(descriptor, key, value) : sPSActionList->GetInteger(list, index, value); }
+	OSErr GetFloat(double* value) const
+	{ return descriptor ? sPSActionDescriptor->GetFloat(descriptor, key, value) : sPSActionList->GetFloat(list, index, value); }
+	OSErr GetUnitFloat(DescriptorUnitID* unit, double* value) const
+	{ return descriptor ? sPSActionDescriptor->GetUnitFloat(descriptor, key, unit, value) : sPSActionList->GetUnitFloat(list, index, unit, value); }
+	OSErr GetZString(ASZString* value) const
+	{ return descriptor ? sPSActionDescriptor->GetZString(descriptor, key, value) : sPSActionList->GetZString(list, index, value); }
+	OSErr GetBoolean(Boolean* value) const
+	{ return descriptor ? sPSActionDescriptor->GetBoolean(descriptor, key, value) : sPSActionList->GetBoolean(list, index, value); }
+	OSErr GetObject(DescriptorClassID* type, PIActionDescriptor* value) const
+	{ return descriptor ? sPSActionDescriptor->GetObject(descriptor, key, type, value) : sPSActionList->GetObject(list, index, type, value); }
+	OSErr GetGlobalObject(DescriptorClassID* type, PIActionDescriptor* value) const
+	{ return descriptor ? sPSActionDescriptor->GetGlobalObject(descriptor, key, type, value) : sPSActionList->GetGlobalObject(list, index, type, value); }
+	OSErr GetEnumerated(DescriptorEnumTypeID* type, DescriptorEnumID* value) const
+	{ return descriptor ? sPSActionDescriptor->GetEnumerated(descriptor, key, type, value) : sPSActionList->GetEnumerated(list, index, type, value); }
+	OSErr GetAlias(Handle* value) const
+	{ return descriptor ? sPSActionDescriptor->GetAlias(descriptor, key, value) : sPSActionList->GetAlias(list, index, value); }
+	OSErr GetBookmark(CFDataRef* value) const
+	{ return descriptor ? sPSActionDescriptor->GetBookmark(descriptor, key, value) : sPSActionList->GetBookmark(list, index, value); }
+	OSErr GetList(PIActionList* value) const
+	{ return descriptor ? sPSActionDescriptor->GetList(descriptor, key, value) : sPSActionList->GetList(list, index, value); }
+	OSErr GetReference(PIActionReference* value) const
+	{ return descriptor ? sPSActionDescriptor->GetReference(descriptor, key, value) : sPSActionList->GetReference(list, index, value); }
+	OSErr GetClass(DescriptorClassID* value) const
+	{ return descriptor ? sPSActionDescriptor->GetClass(descriptor, key, value) : sPSActionList->GetClass(list, index, value); }
+	OSErr GetGlobalClass(DescriptorClassID* value) const
+	{ return descriptor ? sPSActionDescriptor->GetGlobalClass(descriptor, key, value) : sPSActionList->GetGlobalClass(list, index, value); }
+	OSErr GetDataLength(int32* value) const
+	{ return descriptor ? sPSActionDescriptor->GetDataLength(descriptor, key, value) : sPSActionList->GetDataLength(list, index, value); }
+
+private:
+	PIActionDescriptor descriptor;
+	DescriptorKeyID key;
+	PIActionList list;
+	uint32 index;
+};
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	Snapshot writing
+//
+//	Runs on the host thread; everything the writer thread will need,
+//	including the names of runtime IDs, is copied here.
+//
+//-------------------------------------------------------------------------------
+static void PutBytes(vector<uint8>& snapshot, const void* bytes, size_t count)
+{
+	const uint8* first = static_cast<const uint8*>(bytes);
+	snapshot.insert(snapshot.end(), first, first + count);
+}
+
+template <typename T>
+static void Put(vector<uint8>& snapshot, T value)
+{
+	PutBytes(snapshot, &value, sizeof(value));
+}
+
+static void PutString(vector<uint8>& snapshot, const char* text, size_t length)
+{
+	Put(snapshot, static_cast<uint32>(length));
+	PutBytes(snapshot, text, length);
+}
+
+static void PutID(vector<uint8>& snapshot, uint32 id)
+{
+	Put(snapshot, id);
+
+	if (IsRuntimeID(id))
+	{
+		char name[BigStrMaxLen];
+		if (PIUTypeIDToStringID(id, name, BigStrMaxLen))
+			name[0] = '\0';
+		PutString(snapshot, name, strlen(name));
+	}
+}
+
+static void PutZString(vector<uint8>& snapshot, ASZString zString)
+{
+	ASUInt32 length = sASZString->LengthAsUnicodeCString(zString);
+	vector<ASUnicode> unicode(length + 1);
+	sASZString->AsUnicodeCString(zString, &unicode[0], length + 1, false);
+
+	// UTF-16 to UTF-8
+	string text;
+	for (ASUInt32 a = 0; a < length && unicode[a] != 0; a++)
+	{
+		uint32 c = unicode[a];
+		if (c >= 0xd800 && c < 0xdc00 && a + 1 < length &&
+			unicode[a + 1] >= 0xdc00 && unicode[a + 1] < 0xe000)
+		{
+			c = 0x10000 + ((c - 0xd800) << 10) + (unicode[++a] - 0xdc00);
+		}
+
+		if (c < 0x80)
+		{
+			text += static_cast<char>(c);
+		}
+		else if (c < 0x800)
+		{
+			text += static_cast<char>(0xc0 | (c >> 6));
+			text += static_cast<char>(0x80 | (c & 0x3f));
+		}
+		else if (c < 0x10000)
+		{
+			text += static_cast<char>(0xe0 | (c >> 12));
+			text += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+			text += static_cast<char>(0x80 | (c & 0x3f));
+		}
+		else
+		{
+			text += static_cast<char>(0xf0 | (c >> 18));
+			text += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+			text += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+			text += static_cast<char>(0x80 | (c & 0x3f));
+		}
+	}
+
+	PutString(snapshot, text.c_str(), text.size());
+}
+
+static void SnapshotDescriptor(PIActionDescriptor descriptor, vector<uint8>& snapshot, int32 depth);
+static void SnapshotList(PIActionList list, vector<uint8>& snapshot, int32 depth);
+static void SnapshotReference(PIActionReference reference, vector<uint8>& snapshot);
+
+static void SnapshotValue(const ValueSlot& slot, vector<uint8>& snapshot, int32 depth)
+{
+	DescriptorTypeID type = 0;
+	if (slot.GetType(&type))
+		type = 0;
+
+	Put(snapshot, type);
+
+	switch (type)
+	{
+		case typeSInt64:
+		{
+			int64 value = 0;
+			slot.GetInteger64(&value);
+			Put(snapshot, value);
+			break;
+		}
+		case typeSInt32:
+		{
+			int32 value = 0;
+			slot.GetInteger(&value);
+			Put(snapshot, value);
+			break;
+		}
+		case typeIEEE64BitFloatingPoint:
+		{
+			double value = 0;
+			slot.GetFloat(&value);
+			Put(snapshot, value);
+			break;
+		}
+		case typeUnitFloat:
+		{
+			DescriptorUnitID unit = 0;
+			double value = 0;
+			slot.GetUnitFloat(&unit, &value);
+			PutID(snapshot, unit);
+			Put(snapshot, value);
+			break;
+		}
+		case typeChar:
+		{
+			ASZString zString = NULL;
+			if (slot.GetZString(&zString) == noErr && zString != NULL)
+			{
+				PutZString(snapshot, zString);
+				sASZString->Release(zString);
+			}
+			else
+			{
+				PutString(snapshot, "", 0);
+			}
+			break;
+		}
+		case typeBoolean:
+		{
+			Boolean value = false;
+			slot.GetBoolean(&value);
+			Put(snapshot, static_cast<uint8>(value ? 1 : 0));
+			break;
+		}
+		case typeObject:
+		case typeGlobalObject:
+		{
+			DescriptorClassID classID = 0;
+			PIActionDescriptor object = NULL;
+			if (type == typeObject)
+				slot.GetObject(&classID, &object);
+			else
+				slot.GetGlobalObject(&classID, &object);
+			PutID(snapshot, classID);
+			SnapshotDescriptor(object, snapshot, depth + 1);
+			if (object != NULL)
+				sPSActionDescriptor->Free(object);
+			break;
+		}
+		case typeEnumerated:
+		{
+			DescriptorEnumTypeID enumType = 0;
+			DescriptorEnumID enumValue = 0;
+			slot.GetEnumerated(&enumType, &enumValue);
+			PutID(snapshot, enumType);
+			PutID(snapshot, enumValue);
+			break;
+		}
+		case typePath:
+		case typeAlias:
+		{
+			Handle alias = NULL;
+			char fullPath[BigStrMaxLen * 2];
+			fullPath[0] = '\0';
+			if (slot.GetAlias(&alias) == noErr && alias != NULL)
+			{
+				AliasToFullPath(alias, fullPath, BigStrMaxLen * 2);
+				sPSHandle->DisposeRegularHandle(alias);
+			}
+			PutString(snapshot, fullPath, strlen(fullPath));
+			break;
+		}
+		case typeBookmark:
+		{
+			char fullPath[BigStrMaxLen * 2];
+			fullPath[0] = '\0';
+			#if __PIMac__
+				CFDataRef bookmark = NULL;
+				if (slot.GetBookmark(&bookmark) == noErr && bookmark != NULL)
+				{
+					BookmarkToFullPath(bookmark, fullPath, BigStrMaxLen * 2);
+					CFRelease(bookmark);
+				}
+			#endif
+			PutString(snapshot, fullPath, strlen(fullPath));
+			break;
+		}
+		case typeValueList:
+		{
+			PIActionList list = NULL;
+			slot.GetList(&list);
+			SnapshotList(list, snapshot, depth + 1);
+			if (list != NULL)
+				sPSActionList->Free(list);
+			break;
+		}
+		case typeObjectSpecifier:
+		{
+			PIActionReference reference = NULL;
+			slot.GetReference(&reference);
+			SnapshotReference(reference, snapshot);
+			if (reference != NULL)
+				sPSActionReference->Free(reference);
+			break;
+		}
+		case typeType:
+		case typeGlobalClass:
+		{
+			DescriptorClassID classID = 0;
+			if (type == typeType)
+				slot.GetClass(&classID);
+			else
+				slot.GetGlobalClass(&classID);
+			PutID(snapshot, classID);
+			break;
+		}
+		case typeRawData:
+		{
+			int32 length = 0;
+			slot.GetDataLength(&length);
+			Put(snapshot, length);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+static void SnapshotDescriptor(PIActionDescriptor descriptor, vector<uint8>& snapshot, int32 depth)
+{
+	uint32 count = 0;
+	if (descriptor == NULL || depth > kMaxSnapshotDepth ||
+		sPSActionDescriptor->GetCount(descriptor, &count))
+		count = 0;
+
+	Put(snapshot, count);
+
+	for (uint32 counter = 0; counter < count; counter++)
+	{
+		DescriptorKeyID key = 0;
+		sPSActionDescriptor->GetKey(descriptor, counter, &key);
+		PutID(snapshot, key);
+		SnapshotValue(ValueSlot(descriptor, key), snapshot, depth);
+	}
+}
+
+static void SnapshotList(PIActionList list, vector<uint8>& snapshot, int32 depth)
+{
+	uint32 count = 0;
+	if (list == NULL || depth > kMaxSnapshotDepth ||
+		sPSActionList->GetCount(list, &count))
+		count = 0;
+
+	Put(snapshot, count);
+
+	for (uint32 counter = 0; counter < count; counter++)
+		SnapshotValue(ValueSlot(list, counter), snapshot, depth);
+}
+
+static void SnapshotReference(PIActionReference reference, vector<uint8>& snapshot)
+{
+	// the count goes in front once the containers have been walked
+	size_t countOffset = snapshot.size();
+	uint32 count = 0;
+	Put(snapshot, count);
+
+	PIActionReference part = reference;
+
+	while (part != NULL)
+	{
+		DescriptorFormID form = 0;
+		DescriptorClassID desiredClass = 0;
+		if (sPSActionReference->GetForm(part, &form) ||
+			sPSActionReference->GetDesiredClass(part, &desiredClass))
+			break;
+
+		Put(snapshot, form);
+		PutID(snapshot, desiredClass);
+		count++;
+
+		switch (form)
+		{
+			case formName:
+			{
+				uint32 length = 0;
+				sPSActionReference->GetNameLength(part, &length);
+				vector<char> name(length + 1, '\0');
+				sPSActionReference->GetName(part, &name[0], length + 1);
+				PutString(snapshot, &name[0], strlen(&name[0]));
+				break;
+			}
+			case formIndex:
+			{
+				uint32 value = 0;
+				sPSActionReference->GetIndex(part, &value);
+				Put(snapshot, value);
+				break;
+			}
+			case formIdentifier:
+			{
+				uint32 value = 0;
+				sPSActionReference->GetIdentifier(part, &value);
+				Put(snapshot, value);
+				break;
+			}
+			case formOffset:
+			{
+				int32 value = 0;
+				sPSActionReference->GetOffset(part, &value);
+				Put(snapshot, value);
+				break;
+			}
+			case formEnumerated:
+			{
+				DescriptorEnumTypeID enumType = 0;
+				DescriptorEnumID enumValue = 0;
+				sPSActionReference->GetEnumerated(part, &enumType, &enumValue);
+				PutID(snapshot, enumType);
+				PutID(snapshot, enumValue);
+				break;
+			}
+			case formProperty:
+			{
+				DescriptorKeyID key = 0;
+				sPSActionReference->GetProperty(part, &key);
+				PutID(snapshot, key);
+				break;
+			}
+			default:
+				break;
+		}
+
+		PIActionReference container = NULL;
+		if (sPSActionReference->GetContainer(part, &container))
+			container = NULL;
+
+		if (part != reference)
+			sPSActionReference->Free(part);
+
+		part = container;
+	}
+
+	if (part != NULL && part != reference)
+		sPSActionReference->Free(part);
+
+	memcpy(&snapshot[countOffset], &count, sizeof(count));
+}
+
+void PIUSnapshotEvent(DescriptorEventID event,
+					  PIActionDescriptor descriptor,
+					  vector<uint8>& snapshot)
+{
+	PutID(snapshot, event);
+	SnapshotDescriptor(descriptor, snapshot, 0);
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	Snapshot formatting
+//
+//	Uses no suites; runs on the writer thread.
+//
+//-------------------------------------------------------------------------------
+class SnapshotReader {
+public:
+	SnapshotReader(const uint8* snapshot, size_t size)
+		: next(snapshot), end(snapshot + size), ok(true) {}
+
+	template <typename T>
+	T Get(void)
+	{
+		T value = T();
+		if (static_cast<size_t>(end - next) < sizeof(value))
+		{
+			Fail();
+			return value;
+		}
+		memcpy(&value, next, sizeof(value));
+		next += sizeof(value);
+		return value;
+	}
+
+	string GetString(void)
+	{
+		uint32 length = Get<uint32>();
+		if (static_cast<size_t>(end - next) < length)
+		{
+			Fail();
+			return string();
+		}
+		string text(reinterpret_cast<const char*>(next), length);
+		next += length;
+		return text;
+	}
+
+	// The ID, and the string ID of a runtime ID
+	uint32 GetRawID(string& name)
+	{
+		uint32 id = Get<uint32>();
+
+		if (IsRuntimeID(id))
+			name = GetString();
+		else
+			name.clear();
+		return id;
+	}
+
+	// 'Hash' for a four character ID, "name" for a runtime ID
+	string GetID(void)
+	{
+		uint32 id = Get<uint32>();
+
+		if (IsRuntimeID(id))
+			return "\"" + GetString() + "\"";
+
+		char text[7] = { '\'', 0, 0, 0, 0, '\'', 0 };
+		for (int32 a = 0; a < 4; a++)
+		{
+			text[a + 1] = static_cast<char>(id >> (24 - 8 * a));
+			if (text[a + 1] < ' ' || text[a + 1] > '~')
+			{
+				ostringstream number;
+				number << id;
+				return number.str();
+			}
+		}
+		return text;
+	}
+
+	bool IsOK(void) const { return ok; }
+	bool AtEnd(void) const { return next == end; }
+
+private:
+	void Fail(void)
+	{
+		ok = false;
+		next = end;
+	}
+
+	const uint8* next;
+	const uint8* end;
+	bool ok;
+};
+
+static void Indent(ostream& out, int32 depth)
+{
+	for (int32 a = 0; a < depth; a++)
+		out << '\t';
+}
+
+static void FormatDescriptor(SnapshotReader& reader, ostream& out, int32 depth);
+static void FormatList(SnapshotReader& reader, ostream& out, int32 depth);
+static void FormatReference(SnapshotReader& reader, ostream& out, int32 depth);
+
+// Finishes the line that the caller started with the key, if any.
+static void FormatValue(SnapshotReader& reader, ostream& out, int32 depth)
+{
+	DescriptorTypeID type = reader.Get<DescriptorTypeID>();
+
+	switch (type)
+	{
+		case typeSInt64:
+			out << "integer64 " << reader.Get<int64>() << endl;
+			break;
+		case typeSInt32:
+			out << "integer " << reader.Get<int32>() << endl;
+			break;
+		case typeIEEE64BitFloatingPoint:
+			out << "float " << reader.Get<double>() << endl;
+			break;
+		case typeUnitFloat:
+		{
+			string unit = reader.GetID();
+			out << "unitFloat " << unit << " " << reader.Get<double>() << endl;
+			break;
+		}
+		case typeChar:
+			out << "string \"" << reader.GetString() << "\"" << endl;
+			break;
+		case typeBoolean:
+			out << "boolean " << (reader.Get<uint8>() ? "true" : "false") << endl;
+			break;
+		case typeObject:
+		case typeGlobalObject:
+			out << (type == typeObject ? "object " : "globalObject ") << reader.GetID() << endl;
+			FormatDescriptor(reader, out, depth + 1);
+			break;
+		case typeEnumerated:
+		{
+			string enumType = reader.GetID();
+			out << "enumerated " << enumType << " " << reader.GetID() << endl;
+			break;
+		}
+		case typePath:
+		case typeAlias:
+		case typeBookmark:
+			out << "path \"" << reader.GetString() << "\"" << endl;
+			break;
+		case typeValueList:
+			out << "list" << endl;
+			FormatList(reader, out, depth + 1);
+			break;
+		case typeObjectSpecifier:
+			out << "reference" << endl;
+			FormatReference(reader, out, depth + 1);
+			break;
+		case typeType:
+		case typeGlobalClass:
+			out << (type == typeType ? "class " : "globalClass ") << reader.GetID() << endl;
+			break;
+		case typeRawData:
+			out << "data, " << reader.Get<int32>() << " bytes" << endl;
+			break;
+		default:
+			out << "type " << type << endl;
+			break;
+	}
+}
+
+static void FormatDescriptor(SnapshotReader& reader, ostream& out, int32 depth)
+{
+	uint32 count = reader.Get<uint32>();
+
+	for (uint32 counter = 0; counter < count && reader.IsOK(); counter++)
+	{
+		Indent(out, depth);
+		out << reader.GetID() << ": ";
+		FormatValue(reader, out, depth);
+	}
+}
+
+static void FormatList(SnapshotReader& reader, ostream& out, int32 depth)
+{
+	uint32 count = reader.Get<uint32>();
+
+	for (uint32 counter = 0; counter < count && reader.IsOK(); counter++)
+	{
+		Indent(out, depth);
+		out << counter << ": ";
+		FormatValue(reader, out, depth);
+	}
+}
+
+static void FormatReference(SnapshotReader& reader, ostream& out, int32 depth)
+{
+	uint32 count = reader.Get<uint32>();
+
+	for (uint32 counter = 0; counter < count && reader.IsOK(); counter++)
+	{
+		DescriptorFormID form = reader.Get<DescriptorFormID>();
+		string desiredClass = reader.GetID();
+
+		Indent(out, depth);
+		out << desiredClass;
+
+		switch (form)
+		{
+			case formName:
+				out << " name \"" << reader.GetString() << "\"";
+				break;
+			case formIndex:
+				out << " index " << reader.Get<uint32>();
+				break;
+			case formIdentifier:
+				out << " identifier " << reader.Get<uint32>();
+				break;
+			case formOffset:
+				out << " offset " << reader.Get<int32>();
+				break;
+			case formEnumerated:
+			{
+				string enumType = reader.GetID();
+				out << " enumerated " << enumType << " " << reader.GetID();
+				break;
+			}
+			case formProperty:
+				out << " property " << reader.GetID();
+				break;
+			case formClass:
+				break;
+			default:
+				out << " form " << form;
+				break;
+		}
+
+		out << endl;
+	}
+}
+
+bool PIUFormatSnapshot(const uint8* snapshot, size_t size, ostream& out)
+{
+	SnapshotReader reader(snapshot, size);
+
+	out << "event " << reader.GetID() << endl;
+	FormatDescriptor(reader, out, 1);
+
+	return reader.IsOK() && reader.AtEnd();
+}
+
+
+//-------------------------------------------------------------------------------
+//
+//	Recording
+//
+//	Snapshots are transcoded into records on the writer thread.  IDs that
+//	have not been seen yet this session go into ids' kRecordID records,
+//	in records, ahead of the event that uses them.
+//
+//-------------------------------------------------------------------------------
+static void RecordID(SnapshotReader& reader, PIURecordingIDs& ids, vector<uint8>& records, vector<uint8>& payload)
+{
+	string name;
+	uint32 id = reader.GetRawID(name);
+	PIURecordingPutVarint(payload, ids.Number(id, name, records));
+}
+
+static void RecordDescriptor(SnapshotReader& reader, PIURecordingIDs& ids, vector<uint8>& records, vector<uint8>& payload);
+static void RecordReference(SnapshotReader& reader, PIURecordingIDs& ids, vector<uint8>& records, vector<uint8>& payload);
+
+static void RecordValue(SnapshotReader& reader, PIURecordingIDs& ids, vector<uint8>& records, vector<uint8>& payload)
+{
+	DescriptorTypeID type = reader.Get<DescriptorTypeID>();
+
+	switch (type)
+	{
+		case typeSInt64:
+			payload.push_back(kValueInteger64);
+			PIURecordingPutSigned(payload, reader.Get<int64>());
+			break;
+		case typeSInt32:
+			payload.push_back(kValueInteger);
+			PIURecordingPutSigned(payload, reader.Get<int32>());
+			break;
+		case typeIEEE64BitFloatingPoint:
+			payload.push_back(kValueFloat);
+			PIURecordingPutDouble(payload, reader.Get<double>());
+			break;
+		case typeUnitFloat:
+			payload.push_back(kValueUnitFloat);
+			RecordID(reader, ids, records, payload);
+			PIURecordingPutDouble(payload, reader.Get<double>());
+			break;
+		case typeChar:
+		case typePath:
+		case typeAlias:
+		case typeBookmark:
+		{
+			string text = reader.GetString();
+			payload.push_back(type == typeChar ? kValueString : kValuePath);
+			PIURecordingPutString(payload, text.data(), text.size());
+			break;
+		}
+		case typeBoolean:
+			payload.push_back(reader.Get<uint8>() ? kValueTrue : kValueFalse);
+			break;
+		case typeObject:
+		case typeGlobalObject:
+			payload.push_back(type == typeObject ? kValueObject : kValueGlobalObject);
+			RecordID(reader, ids, records, payload);
+			RecordDescriptor(reader, ids, records, payload);
+			break;
+		case typeEnumerated:
+			payload.push_back(kValueEnumerated);
+			RecordID(reader, ids, records, payload);
+			RecordID(reader, ids, records, payload);
+			break;
+		case typeValueList:
+		{
+			uint32 count = reader.Get<uint32>();
+			payload.push_back(kValueList);
+			PIURecordingPutVarint(payload, count);
+			for (uint32 counter = 0; counter < count && reader.IsOK(); counter++)
+				RecordValue(reader, ids, records, payload);
+			break;
+		}
+		case typeObjectSpecifier:
+			payload.push_back(kValueReference);
+			RecordReference(reader, ids, records, payload);
+			break;
+		case typeType:
+		case typeGlobalClass:
+			payload.push_back(type == typeType ? kValueClass : kValueGlobalClass);
+			RecordID(reader, ids, records, payload);
+			break;
+		case typeRawData:
+			payload.push_back(kValueData);
+			PIURecordingPutVarint(payload, static_cast<uint32>(reader.Get<int32>()));
+			break;
+		default:
+			payload.push_back(kValueOther);
+			PIURecordingPutVarint(payload, type);
+			break;
+	}
+}
+
+static void RecordDescriptor(SnapshotReader& reader, PIURecordingIDs& ids, vector<uint8>& records, vector<uint8>& payload)
+{
+	uint32 count = reader.Get<uint32>();
+	PIURecordingPutVarint(payload, count);
+
+	for (uint32 counter = 0; counter < count && reader.IsOK(); counter++)
+	{
+		RecordID(reader, ids, records, payload);
+		RecordValue(reader, ids, records, payload);
+	}
+}
+
+static void RecordReference(SnapshotReader& reader, PIURecordingIDs& ids, vector<uint8>& records, vector<uint8>& payload)
+{
+	uint32 count = reader.Get<uint32>();
+	PIURecordingPutVarint(payload, count);
+
+	for (uint32 counter = 0; counter < count && reader.IsOK(); counter++)
+	{
+		DescriptorFormID form = reader.Get<DescriptorFormID>();
+		size_t formAt = payload.size();
+		payload.push_back(kFormOther);
+		RecordID(reader, ids, records, payload);
+
+		switch (form)
+		{
+			case formName:
+			{
+				string name = reader.GetString();
+				payload[formAt] = kFormName;
+				PIURecordingPutString(payload, name.data(), name.size());
+				break;
+			}
+			case formIndex:
+			case formIdentifier:
+				payload[formAt] = form == formIndex ? kFormIndex : kFormIdentifier;
+				PIURecordingPutVarint(payload, reader.Get<uint32>());
+				break;
+			case formOffset:
+				payload[formAt] = kFormOffset;
+				PIURecordingPutSigned(payload, reader.Get<int32>());
+				break;
+			case formEnumerated:
+				payload[formAt] = kFormEnumerated;
+				RecordID(reader, ids, records, payload);
+				RecordID(reader, ids, records, payload);
+				break;
+			case formProperty:
+				payload[formAt] = kFormProperty;
+				RecordID(reader, ids, records, payload);
+				break;
+			case formClass:
+				payload[formAt] = kFormClass;
+				break;
+			default:
+				PIURecordingPutVarint(payload, form);
+				break;
+		}
+	}
+}
+
+static void RecordDropped(uint64 count, vector<uint8>& records)
+{
+	if (count == 0)
+		return;
+
+	vector<uint8> payload;
+	PIURecordingPutVarint(payload, count);
+	PIURecordingPutRecord(records, kRecordDropped, payload);
+}
+
+// Appends the records for an event to records.  False, with nothing
+// but perhaps some ID records appended, if the snapshot is cut short.
+static bool RecordSnapshot(const uint8* snapshot, size_t size, uint64 micros,
+						   PIURecordingIDs& ids, vector<uint8>& records)
+{
+	SnapshotReader reader(snapshot, size);
+	vector<uint8> payload;
+
+	PIURecordingPutVarint(payload, micros);
+	RecordID(reader, ids, records, payload);
+	RecordDescriptor(reader, ids, records, payload);
+
+	if (!reader.IsOK() || !reader.AtEnd())
+		return false;
+
+	PIURecordingPutRecord(records, kRecordEvent, payload);
+	return true;
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	MappedLogFile
+//
+//	A file that is appended to through a window mapped over its end.  The
+//	file is made longer a window at a time and cut back on Close, so a
+//	recording that is never closed ends in zeros, which read as kRecordEnd.
+//
+//-------------------------------------------------------------------------------
+class MappedLogFile {
+public:
+	MappedLogFile();
+	~MappedLogFile() { Close(); }
+
+	// Opens a recording, or makes a new one.  False if the file is
+	// something else.
+	bool Open(const char* fullpathtofile);
+	bool Append(const uint8* data, size_t size);
+	void Close(void);
+
+private:
+	bool Map(uint64 offset, size_t size);
+	void Unmap(void);
+	bool SetSize(uint64 size);
+	uint64 GetSize(void);
+	uint64 Granularity(void);
+
+	uint64 used;				// bytes of the file in use
+	uint64 length;				// bytes in the file
+	uint64 windowStart;
+	size_t windowSize;
+	uint8* window;
+#if __PIMac__
+	int file;
+#else
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+	MappedLogFile(const MappedLogFile&);
+	MappedLogFile& operator=(const MappedLogFile&);
+};
+
+MappedLogFile::MappedLogFile()
+	: used(0), length(0), windowStart(0), windowSize(0), window(NULL),
+#if __PIMac__
+	  file(-1)
+#else
+	  file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+{
+}
+
+#if __PIMac__
+
+bool MappedLogFile::Map(uint64 offset, size_t size)
+{
+	void* view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, static_cast<off_t>(offset));
+	if (view == MAP_FAILED)
+		return false;
+	window = static_cast<uint8*>(view);
+	windowStart = offset;
+	windowSize = size;
+	return true;
+}
+
+void MappedLogFile::Unmap(void)
+{
+	if (window != NULL)
+		munmap(window, windowSize);
+	window = NULL;
+	windowSize = 0;
+}
+
+bool MappedLogFile::SetSize(uint64 size)
+{
+	if (ftruncate(file, static_cast<off_t>(size)) != 0)
+		return false;
+	length = size;
+	return true;
+}
+
+uint64 MappedLogFile::GetSize(void)
+{
+	struct stat info;
+	return fstat(file, &info) == 0 ? static_cast<uint64>(info.st_size) : 0;
+}
+
+uint64 MappedLogFile::Granularity(void)
+{
+	return static_cast<uint64>(getpagesize());
+}
+
+#else
+
+bool MappedLogFile::Map(uint64 offset, size_t size)
+{
+	uint64 mapEnd = offset + size;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+								 static_cast<DWORD>(mapEnd >> 32), static_cast<DWORD>(mapEnd), NULL);
+	if (mapping == NULL)
+		return false;
+
+	window = static_cast<uint8*>(MapViewOfFile(mapping, FILE_MAP_WRITE,
+											   static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), size));
+	if (window == NULL)
+	{
+		CloseHandle(mapping);
+		mapping = NULL;
+		return false;
+	}
+	windowStart = offset;
+	windowSize = size;
+	return true;
+}
+
+void MappedLogFile::Unmap(void)
+{
+	if (window != NULL)
+		UnmapViewOfFile(window);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	window = NULL;
+	mapping = NULL;
+	windowSize = 0;
+}
+
+bool MappedLogFile::SetSize(uint64 size)
+{
+	LARGE_INTEGER distance;
+	distance.QuadPart = static_cast<LONGLONG>(size);
+	if (!SetFilePointerEx(file, distance, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+		return false;
+	length = size;
+	return true;
+}
+
+uint64 MappedLogFile::GetSize(void)
+{
+	LARGE_INTEGER size;
+	return GetFileSizeEx(file, &size) ? static_cast<uint64>(size.QuadPart) : 0;
+}
+
+uint64 MappedLogFile::Granularity(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+#endif
+
+bool MappedLogFile::Open(const char* fullpathtofile)
+{
+#if __PIMac__
+	file = open(fullpathtofile, O_RDWR | O_CREAT, 0644);
+	if (file < 0)
+		return false;
+#else
+	file = CreateFileA(fullpathtofile, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+					   NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+#endif
+
+	length = GetSize();
+
+	if (length == 0)
+	{
+		uint8 header[kRecordingHeaderSize] = { 0 };
+		memcpy(header, kRecordingMagic, sizeof(kRecordingMagic));
+		header[8] = static_cast<uint8>(kRecordingVersion);
+		return Append(header, sizeof(header));
+	}
+
+	if (length < kRecordingHeaderSize ||
+		length != static_cast<size_t>(length) ||
+		!Map(0, static_cast<size_t>(length)))
+	{
+		Close();
+		return false;
+	}
+
+	// pick up after the last whole record
+	bool isRecording = memcmp(window, kRecordingMagic, sizeof(kRecordingMagic)) == 0;
+	uint64 next = kRecordingHeaderSize;
+
+	while (isRecording && next < length && window[next] != kRecordEnd)
+	{
+		uint64 recordLength = 0;
+		uint64 at = next + 1;
+		int32 shift = 0;
+		while (at < length && shift < 64)
+		{
+			recordLength |= static_cast<uint64>(window[at] & 0x7F) << shift;
+			shift += 7;
+			if ((window[at++] & 0x80) == 0)
+				break;
+		}
+		if (at >= length || recordLength > length - at)
+			break;
+		next = at + recordLength;
+	}
+
+	Unmap();
+
+	if (!isRecording)
+	{
+		Close();
+		return false;
+	}
+
+	used = next;
+	return true;
+}
+
+bool MappedLogFile::Append(const uint8* data, size_t size)
+{
+	if (used + size > windowStart + windowSize)
+	{
+		Unmap();
+
+		uint64 granularity = Granularity();
+		uint64 start = used - used % granularity;
+		uint64 needed = used + size - start;
+		uint64 windowLength = needed + kDescriptorLogMapBytes;
+		windowLength -= windowLength % granularity;
+
+		if (windowLength != static_cast<size_t>(windowLength) ||
+			(start + windowLength > length && !SetSize(start + windowLength)) ||
+			!Map(start, static_cast<size_t>(windowLength)))
+			return false;
+	}
+
+	memcpy(window + (used - windowStart), data, size);
+	used += size;
+	return true;
+}
+
+void MappedLogFile::Close(void)
+{
+	Unmap();
+
+#if __PIMac__
+	if (file >= 0)
+	{
+		if (length > used)
+			SetSize(used);
+		close(file);
+	}
+	file = -1;
+#else
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		if (length > used)
+			SetSize(used);
+		CloseHandle(file);
+	}
+	file = INVALID_HANDLE_VALUE;
+#endif
+	used = 0;
+	length = 0;
+}
+
+
+
+//-------------------------------------------------------------------------------
+//
+//	PIUDescriptorLog
+//
+//-------------------------------------------------------------------------------
+PIUDescriptorLog::PIUDescriptorLog(const char* fullpathtofile,
+								   uint32 inSampling,
+								   PIUDescriptorLogFormat inFormat)
+	: path(fullpathtofile),
+	  format(inFormat),
+	  sampling(inSampling),
+	  seen(0),
+	  dropped(0),
+	  start(chrono::steady_clock::now()),
+	  queuedBytes(0),
+	  stopping(false),
+	  lastSeconds(0),
+	  broken(false)
+{
+	writer = thread(&PIUDescriptorLog::Run, this);
+}
+
+PIUDescriptorLog::~PIUDescriptorLog()
+{
+	{
+		lock_guard<mutex> guard(lock);
+
+		// an empty entry just reports the events dropped at the end
+		if (dropped)
+		{
+			entries.push_back(Entry());
+			entries.back().seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			entries.back().dropped = dropped;
+			dropped = 0;
+		}
+
+		stopping = true;
+	}
+	entryAdded.notify_one();
+	writer.join();
+}
+
+void PIUDescriptorLog::SetSampling(uint32 inSampling)
+{
+	sampling = inSampling;
+	seen = 0;
+}
+
+void PIUDescriptorLog::Log(DescriptorEventID event, PIActionDescriptor descriptor)
+{
+	if (sampling == 0 || seen++ % sampling != 0)
+		return;
+
+	{
+		// don't bother copying what there is no room for
+		lock_guard<mutex> guard(lock);
+		if (entries.size() >= kDescriptorLogMaxEvents)
+		{
+			dropped++;
+			return;
+		}
+	}
+
+	Entry entry;
+	entry.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	PIUSnapshotEvent(event, descriptor, entry.snapshot);
+
+	lock_guard<mutex> guard(lock);
+
+	if (entries.size() >= kDescriptorLogMaxEvents ||
+		queuedBytes + entry.snapshot.size() > kDescriptorLogMaxBytes)
+	{
+		dropped++;
+		return;
+	}
+
+	entry.dropped = dropped;
+	dropped = 0;
+	queuedBytes += entry.snapshot.size();
+
+	entries.push_back(Entry());
+	entries.back().seconds = entry.seconds;
+	entries.back().dropped = entry.dropped;
+	entries.back().snapshot.swap(entry.snapshot);
+
+	entryAdded.notify_one();
+}
+
+//-------------------------------------------------------------------------------
+//
+//	PIUDescriptorLog::Run
+//
+//	The writer thread.  Takes everything queued at once, and writes it
+//	with a single call, so the file is touched once per batch rather than
+//	once per event.
+//
+//-------------------------------------------------------------------------------
+void PIUDescriptorLog::Run(void)
+{
+	FILE* file = NULL;
+	MappedLogFile* recording = NULL;
+	unique_lock<mutex> guard(lock);
+
+	for (;;)
+	{
+		entryAdded.wait(guard, [this] { return stopping || !entries.empty(); });
+
+		if (entries.empty())
+			break;
+
+		deque<Entry> batch;
+		batch.swap(entries);
+		queuedBytes = 0;
+
+		guard.unlock();
+
+		if (format == kDescriptorLogRecording)
+			WriteRecording(batch, recording);
+		else
+			WriteText(batch, file);
+
+		guard.lock();
+	}
+
+	if (file != NULL)
+		fclose(file);
+	delete recording;
+}
+
+void PIUDescriptorLog::WriteText(const deque<Entry>& batch, FILE*& file)
+{
+	ostringstream text;
+	text.precision(15);
+
+	for (size_t a = 0; a < batch.size(); a++)
+	{
+		if (batch[a].dropped)
+			text << "// " << batch[a].dropped << " events dropped" << endl;
+
+		if (batch[a].snapshot.empty())
+			continue;
+
+		text << "// " << batch[a].seconds << " s" << endl;
+
+		if (!PIUFormatSnapshot(&batch[a].snapshot[0], batch[a].snapshot.size(), text))
+			text << "// snapshot cut short" << endl;
+
+		text << endl;
+	}
+
+	// j systems have trouble opening the file with Shift-JIS chars
+	// in an ofstream, so use fopen as PIUDumpDescriptor does
+	if (file == NULL)
+		file = fopen(path.c_str(), "a");
+
+	if (file != NULL)
+	{
+		string out = text.str();
+		fwrite(out.data(), 1, out.size(), file);
+		fflush(file);
+	}
+}
+
+void PIUDescriptorLog::WriteRecording(const deque<Entry>& batch, MappedLogFile*& file)
+{
+	if (broken)
+		return;
+
+	vector<uint8> records;
+
+	if (file == NULL)
+	{
+		file = new MappedLogFile;
+		if (!file->Open(path.c_str()))
+		{
+			broken = true;
+			return;
+		}
+		PIURecordingPutRecord(records, kRecordSession, vector<uint8>());
+	}
+
+	for (size_t a = 0; a < batch.size(); a++)
+	{
+		uint64 lost = batch[a].dropped;
+
+		if (!batch[a].snapshot.empty())
+		{
+			double seconds = batch[a].seconds > lastSeconds ? batch[a].seconds : lastSeconds;
+			uint64 micros = static_cast<uint64>((seconds - lastSeconds) * 1e6 + 0.5);
+			vector<uint8> event;
+
+			if (RecordSnapshot(&batch[a].snapshot[0], batch[a].snapshot.size(), micros, recordedIDs, event))
+			{
+				RecordDropped(lost, records);
+				lost = 0;
+				lastSeconds += micros / 1e6;
+			}
+			else
+			{
+				lost++;
+			}
+
+			// holds the ID records even when the event itself is lost
+			records.insert(records.end(), event.begin(), event.end());
+		}
+
+		RecordDropped(lost, records);
+	}
+
+	if (!records.empty() && !file->Append(&records[0], records.size()))
+		broken = true;
+}
+
+// end PIUDescriptorLog.cpp
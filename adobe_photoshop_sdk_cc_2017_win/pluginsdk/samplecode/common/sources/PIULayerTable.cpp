@@ -0,0 +1,350 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIULayerTable.cpp
+//
+//	Description:
+//		Collects chosen properties of every layer into a table.
+//		See PIULayerTable.h for more information.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#include "PIULayerTable.h"
+#include "PIUGet.h"
+#include "PIUStringID.h"
+#include "PITerminology.h"
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+PIULayerTable::PIULayerTable() : properties(0)
+{
+}
+
+void PIULayerTable::AddProperty(DescriptorKeyID key)
+{
+	// property columns come first, before any member columns
+	Clear();
+	AddColumn(key, 0, KeyName(key));
+	properties = columns.size();
+}
+
+void PIULayerTable::Clear(void)
+{
+	columns.resize(properties);
+	for (size_t c = 0; c < columns.size(); c++)
+	{
+		columns[c].types.clear();
+		columns[c].numbers.clear();
+		columns[c].ids.clear();
+		columns[c].texts.clear();
+	}
+	documents.clear();
+	layers.clear();
+}
+
+int32 PIULayerTable::FindColumn(DescriptorKeyID key, DescriptorKeyID member) const
+{
+	for (size_t c = 0; c < columns.size(); c++)
+		if (columns[c].key == key && columns[c].member == member)
+			return (int32)c;
+	return -1;
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+SPErr PIULayerTable::Collect(void)
+{
+	int32 numDocuments = 0;
+
+	SPErr error = PIUGetInfo(classApplication, keyNumberOfDocuments, &numDocuments, NULL);
+
+	for (int32 docCounter = 1; docCounter <= numDocuments && error == kSPNoError; docCounter++)
+		error = CollectDocument(docCounter);
+
+	return error;
+}
+
+SPErr PIULayerTable::CollectDocument(uint32 documentIndex)
+{
+	int32 numLayers = 0;
+
+	SPErr error = PIUGetInfoByIndex(documentIndex,
+									classDocument,
+									keyNumberOfLayers,
+									&numLayers,
+									NULL);
+
+	for (int32 layCounter = 1; layCounter <= numLayers && error == kSPNoError; layCounter++)
+	{
+		documents.push_back(documentIndex);
+		layers.push_back(layCounter);
+		for (size_t c = 0; c < columns.size(); c++)
+		{
+			columns[c].types.push_back(0);
+			columns[c].numbers.push_back(0);
+			columns[c].ids.push_back(0);
+			columns[c].texts.push_back(string());
+		}
+
+		for (size_t c = 0; c < properties && error == kSPNoError; c++)
+			error = GetCell(documentIndex, layCounter, c);
+	}
+
+	return error;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	GetCell
+//
+//	Gets one property of one layer into the last row.  The host fails the
+//	get for a property the layer does not have, which leaves the cell
+//	empty; only failing to make the reference is an error.
+//
+//-------------------------------------------------------------------------------
+SPErr PIULayerTable::GetCell(uint32 documentIndex, uint32 layerIndex, size_t column)
+{
+	PIActionReference reference = NULL;
+	PIActionDescriptor result = NULL;
+
+	SPErr error = sPSActionReference->Make(&reference);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutProperty(reference, classProperty, columns[column].key);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutIndex(reference, classLayer, layerIndex);
+	if (error) goto returnError;
+
+	error = sPSActionReference->PutIndex(reference, classDocument, documentIndex);
+	if (error) goto returnError;
+
+	if (sPSActionControl->Get(&result, reference) == kSPNoError && result != NULL)
+		PutValue(column, Rows() - 1, result, columns[column].key);
+
+returnError:
+
+	if (reference != NULL) sPSActionReference->Free(reference);
+	if (result != NULL) sPSActionDescriptor->Free(result);
+
+	return error;
+}
+
+void PIULayerTable::PutValue(size_t column, size_t row, PIActionDescriptor descriptor, DescriptorKeyID key)
+{
+	Boolean hasKey = false;
+	DescriptorTypeID type = 0;
+
+	if (sPSActionDescriptor->HasKey(descriptor, key, &hasKey) || !hasKey)
+		return;
+	if (sPSActionDescriptor->GetType(descriptor, key, &type))
+		return;
+
+	columns[column].types[row] = type;
+
+	switch (type)
+	{
+		case typeInteger:
+		{
+			int32 value = 0;
+			if (!sPSActionDescriptor->GetInteger(descriptor, key, &value))
+				columns[column].numbers[row] = value;
+			break;
+		}
+		case typeFloat:
+		{
+			real64 value = 0;
+			if (!sPSActionDescriptor->GetFloat(descriptor, key, &value))
+				columns[column].numbers[row] = value;
+			break;
+		}
+		case typeUnitFloat:
+		{
+			DescriptorUnitID unit = 0;
+			real64 value = 0;
+			if (!sPSActionDescriptor->GetUnitFloat(descriptor, key, &unit, &value))
+			{
+				columns[column].numbers[row] = value;
+				columns[column].ids[row] = unit;
+			}
+			break;
+		}
+		case typeBoolean:
+		{
+			Boolean value = false;
+			if (!sPSActionDescriptor->GetBoolean(descriptor, key, &value))
+				columns[column].numbers[row] = value ? 1 : 0;
+			break;
+		}
+		case typeChar:
+		{
+			uint32 length = 0;
+			if (sPSActionDescriptor->GetStringLength(descriptor, key, &length))
+				break;
+			vector<char> value(length + 1);
+			if (!sPSActionDescriptor->GetString(descriptor, key, &value[0], length + 1))
+				columns[column].texts[row] = &value[0];
+			break;
+		}
+		case typeEnumerated:
+		{
+			DescriptorEnumTypeID enumType = 0;
+			DescriptorEnumID value = 0;
+			if (!sPSActionDescriptor->GetEnumerated(descriptor, key, &enumType, &value))
+				columns[column].ids[row] = value;
+			break;
+		}
+		case typeType:
+		case typeGlobalClass:
+		{
+			DescriptorClassID value = 0;
+			if (!sPSActionDescriptor->GetClass(descriptor, key, &value))
+				columns[column].ids[row] = value;
+			break;
+		}
+		case typeObject:
+		case typeGlobalObject:
+		{
+			DescriptorClassID value = 0;
+			PIActionDescriptor object = NULL;
+			uint32 count = 0;
+
+			if (!sPSActionDescriptor->GetObject(descriptor, key, &value, &object))
+			{
+				columns[column].ids[row] = value;
+
+				// one level down only; a member's own objects keep their class
+				if (columns[column].member == 0 &&
+					!sPSActionDescriptor->GetCount(object, &count))
+				{
+					for (uint32 k = 0; k < count; k++)
+					{
+						DescriptorKeyID member = 0;
+						if (!sPSActionDescriptor->GetKey(object, k, &member))
+							PutValue(MemberColumn(column, member), row, object, member);
+					}
+				}
+			}
+
+			if (object != NULL) sPSActionDescriptor->Free(object);
+			break;
+		}
+		default:
+			// the type says it is there, and that is all that is kept
+			break;
+	}
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+size_t PIULayerTable::MemberColumn(size_t column, DescriptorKeyID member)
+{
+	DescriptorKeyID key = columns[column].key;
+
+	for (size_t c = properties; c < columns.size(); c++)
+		if (columns[c].key == key && columns[c].member == member)
+			return c;
+
+	AddColumn(key, member, columns[column].name + "." + KeyName(member));
+
+	return columns.size() - 1;
+}
+
+void PIULayerTable::AddColumn(DescriptorKeyID key, DescriptorKeyID member, const string& name)
+{
+	Column added;
+	added.key = key;
+	added.member = member;
+	added.name = name;
+	added.types.assign(Rows(), 0);
+	added.numbers.assign(Rows(), 0);
+	added.ids.assign(Rows(), 0);
+	added.texts.assign(Rows(), string());
+	columns.push_back(added);
+}
+
+string PIULayerTable::KeyName(DescriptorKeyID key)
+{
+	char name[BigStrMaxLen];
+
+	if (PIUTypeIDToStringID(key, name, BigStrMaxLen) == kSPNoError && name[0] != '\0')
+		return name;
+
+	name[0] = (char)(key >> 24);
+	name[1] = (char)(key >> 16);
+	name[2] = (char)(key >> 8);
+	name[3] = (char)key;
+	name[4] = '\0';
+
+	return name;
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+void PIULayerTable::Write(FILE* file) const
+{
+	fprintf(file, "document\tlayer");
+	for (size_t c = 0; c < columns.size(); c++)
+		fprintf(file, "\t%s", columns[c].name.c_str());
+	fprintf(file, "\n");
+
+	for (size_t row = 0; row < Rows(); row++)
+	{
+		fprintf(file, "%u\t%u", (unsigned)documents[row], (unsigned)layers[row]);
+
+		for (size_t c = 0; c < columns.size(); c++)
+		{
+			const Column& column = columns[c];
+
+			fprintf(file, "\t");
+
+			switch (column.types[row])
+			{
+				case 0:
+					break;
+				case typeInteger:
+				case typeFloat:
+				case typeUnitFloat:
+				case typeBoolean:
+					fprintf(file, "%.15g", column.numbers[row]);
+					break;
+				case typeChar:
+				{
+					// keep the table one line a row
+					string text = column.texts[row];
+					for (size_t t = 0; t < text.size(); t++)
+						if (text[t] == '\t' || text[t] == '\r' || text[t] == '\n')
+							text[t] = ' ';
+					fprintf(file, "%s", text.c_str());
+					break;
+				}
+				case typeEnumerated:
+				case typeType:
+				case typeGlobalClass:
+				case typeObject:
+				case typeGlobalObject:
+					fprintf(file, "%s", KeyName(column.ids[row]).c_str());
+					break;
+				default:
+					fprintf(file, "%s", KeyName(column.types[row]).c_str());
+					break;
+			}
+		}
+
+		fprintf(file, "\n");
+	}
+}
+
+// end PIULayerTable.cpp
@@ -0,0 +1,377 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIURecording.cpp
+//
+//	Description:
+//		Encoding and decoding of the binary recordings described in
+//		PIURecording.h.
+//
+//-------------------------------------------------------------------------------
+
+#include "PIURecording.h"
+#include <string.h>
+
+// Deepest nesting of descriptors, lists and objects that is read
+static const int kMaxDepth = 64;
+
+//-------------------------------------------------------------------------------
+//	Encoding helpers
+//-------------------------------------------------------------------------------
+
+void PIURecordingPutVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+void PIURecordingPutSigned(std::vector<uint8_t>& out, int64_t value)
+{
+	PIURecordingPutVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void PIURecordingPutDouble(std::vector<uint8_t>& out, double value)
+{
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int b = 0; b < 8; b++)
+		out.push_back((uint8_t)(bits >> (8 * b)));
+}
+
+void PIURecordingPutString(std::vector<uint8_t>& out, const char* text, size_t length)
+{
+	PIURecordingPutVarint(out, length);
+	out.insert(out.end(), text, text + length);
+}
+
+void PIURecordingPutRecord(std::vector<uint8_t>& out, uint8_t tag, const std::vector<uint8_t>& payload)
+{
+	out.push_back(tag);
+	PIURecordingPutVarint(out, payload.size());
+	out.insert(out.end(), payload.begin(), payload.end());
+}
+
+//-------------------------------------------------------------------------------
+//	PIURecordingIDs
+//-------------------------------------------------------------------------------
+
+PIURecordingIDs::PIURecordingIDs()
+{
+	Reset();
+}
+
+void PIURecordingIDs::Reset(void)
+{
+	slots.assign(256, 0);
+	ids.clear();
+	names.clear();
+}
+
+uint64_t PIURecordingIDs::Hash(uint32_t id, const std::string& name) const
+{
+	// FNV-1a over the ID and the name
+	uint64_t hash = 14695981039346656037ULL;
+	for (int b = 0; b < 4; b++)
+		hash = (hash ^ ((id >> (8 * b)) & 0xFF)) * 1099511628211ULL;
+	for (size_t c = 0; c < name.size(); c++)
+		hash = (hash ^ (uint8_t)name[c]) * 1099511628211ULL;
+	return hash;
+}
+
+void PIURecordingIDs::Grow(void)
+{
+	std::vector<uint64_t> old;
+	old.swap(slots);
+	slots.assign(old.size() * 2, 0);
+	size_t mask = slots.size() - 1;
+
+	for (size_t s = 0; s < old.size(); s++)
+	{
+		if (old[s] == 0) continue;
+		size_t number = (size_t)(old[s] - 1);
+		size_t slot = (size_t)Hash(ids[number], names[number]) & mask;
+		while (slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		slots[slot] = old[s];
+	}
+}
+
+uint32_t PIURecordingIDs::Number(uint32_t id, const std::string& name, std::vector<uint8_t>& out)
+{
+	std::string key = id < kRecordingRuntimeIDLimit ? name : std::string();
+	size_t mask = slots.size() - 1;
+	size_t slot = (size_t)Hash(id < kRecordingRuntimeIDLimit ? 0 : id, key) & mask;
+
+	while (slots[slot] != 0)
+	{
+		size_t number = (size_t)(slots[slot] - 1);
+		if (id < kRecordingRuntimeIDLimit ? (ids[number] < kRecordingRuntimeIDLimit && names[number] == key)
+										  : ids[number] == id)
+			return (uint32_t)number;
+		slot = (slot + 1) & mask;
+	}
+
+	uint32_t number = (uint32_t)ids.size();
+	ids.push_back(id < kRecordingRuntimeIDLimit ? 0 : id);
+	names.push_back(key);
+	slots[slot] = (uint64_t)number + 1;
+	if (ids.size() * 2 > slots.size())
+		Grow();
+
+	std::vector<uint8_t> payload;
+	PIURecordingPutVarint(payload, id);
+	if (id < kRecordingRuntimeIDLimit)
+		PIURecordingPutString(payload, key.data(), key.size());
+	PIURecordingPutRecord(out, kRecordID, payload);
+
+	return number;
+}
+
+//-------------------------------------------------------------------------------
+//	PIURecordingReader
+//-------------------------------------------------------------------------------
+
+PIURecordingReader::PIURecordingReader(const uint8_t* data, size_t size)
+	: next(data), end(data + size), header(false), ok(true), seconds(0)
+{
+	unknown.id = 0;
+	unknown.name = "?";
+
+	if (size >= kRecordingHeaderSize &&
+		memcmp(data, kRecordingMagic, sizeof(kRecordingMagic)) == 0 &&
+		data[8] == kRecordingVersion && data[9] == 0 && data[10] == 0 && data[11] == 0)
+	{
+		header = true;
+		next = data + kRecordingHeaderSize;
+	}
+	else
+	{
+		ok = false;
+	}
+}
+
+const RecordedID& PIURecordingReader::ID(uint32_t number) const
+{
+	return number < ids.size() ? ids[number] : unknown;
+}
+
+bool PIURecordingReader::ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 64 && p < end; shift += 7)
+	{
+		uint8_t byte = *p++;
+		value |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+bool PIURecordingReader::ReadID(const uint8_t*& p, const uint8_t* end, uint32_t& number)
+{
+	uint64_t value;
+	if (!ReadVarint(p, end, value) || value >= ids.size()) return false;
+	number = (uint32_t)value;
+	return true;
+}
+
+bool PIURecordingReader::ReadString(const uint8_t*& p, const uint8_t* end, std::string& text)
+{
+	uint64_t length;
+	if (!ReadVarint(p, end, length) || length > (uint64_t)(end - p)) return false;
+	text.assign((const char*)p, (size_t)length);
+	p += length;
+	return true;
+}
+
+bool PIURecordingReader::ReadDescriptor(const uint8_t*& p, const uint8_t* end, RecordedValue& value, int depth)
+{
+	uint64_t count;
+	if (depth > kMaxDepth || !ReadVarint(p, end, count) || count > (uint64_t)(end - p))
+		return false;
+
+	value.keys.resize((size_t)count);
+	value.children.resize((size_t)count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!ReadID(p, end, value.keys[i]) || !ReadValue(p, end, value.children[i], depth + 1))
+			return false;
+	}
+	return true;
+}
+
+bool PIURecordingReader::ReadValue(const uint8_t*& p, const uint8_t* end, RecordedValue& value, int depth)
+{
+	uint64_t number;
+
+	if (p >= end) return false;
+	value.kind = *p++;
+
+	switch (value.kind)
+	{
+		case kValueInteger64:
+		case kValueInteger:
+			if (!ReadVarint(p, end, number)) return false;
+			value.integer = (int64_t)(number >> 1) ^ -(int64_t)(number & 1);
+			return true;
+		case kValueUnitFloat:
+			if (!ReadID(p, end, value.id1)) return false;
+			// fall through
+		case kValueFloat:
+		{
+			if (end - p < 8) return false;
+			uint64_t bits = 0;
+			for (int b = 0; b < 8; b++)
+				bits |= (uint64_t)p[b] << (8 * b);
+			memcpy(&value.number, &bits, sizeof(bits));
+			p += 8;
+			return true;
+		}
+		case kValueString:
+		case kValuePath:
+			return ReadString(p, end, value.text);
+		case kValueFalse:
+		case kValueTrue:
+			return true;
+		case kValueObject:
+		case kValueGlobalObject:
+			return ReadID(p, end, value.id1) && ReadDescriptor(p, end, value, depth);
+		case kValueEnumerated:
+			return ReadID(p, end, value.id1) && ReadID(p, end, value.id2);
+		case kValueList:
+			if (depth > kMaxDepth || !ReadVarint(p, end, number) || number > (uint64_t)(end - p))
+				return false;
+			value.children.resize((size_t)number);
+			for (size_t i = 0; i < number; i++)
+				if (!ReadValue(p, end, value.children[i], depth + 1)) return false;
+			return true;
+		case kValueReference:
+			if (!ReadVarint(p, end, number) || number > (uint64_t)(end - p))
+				return false;
+			value.children.resize((size_t)number);
+			for (size_t i = 0; i < number; i++)
+				if (!ReadPart(p, end, value.children[i])) return false;
+			return true;
+		case kValueClass:
+		case kValueGlobalClass:
+			return ReadID(p, end, value.id1);
+		case kValueData:
+		case kValueOther:
+			if (!ReadVarint(p, end, number)) return false;
+			value.integer = (int64_t)number;
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool PIURecordingReader::ReadPart(const uint8_t*& p, const uint8_t* end, RecordedValue& part)
+{
+	uint64_t number;
+
+	if (p >= end) return false;
+	part.kind = *p++;
+	if (!ReadID(p, end, part.id1)) return false;
+
+	switch (part.kind)
+	{
+		case kFormName:
+			return ReadString(p, end, part.text);
+		case kFormIndex:
+		case kFormIdentifier:
+		case kFormOther:
+			if (!ReadVarint(p, end, number)) return false;
+			part.integer = (int64_t)number;
+			return true;
+		case kFormOffset:
+			if (!ReadVarint(p, end, number)) return false;
+			part.integer = (int64_t)(number >> 1) ^ -(int64_t)(number & 1);
+			return true;
+		case kFormEnumerated:
+			return ReadID(p, end, part.id2) && ReadID(p, end, part.id3);
+		case kFormProperty:
+			return ReadID(p, end, part.id2);
+		case kFormClass:
+			return true;
+		default:
+			return false;
+	}
+}
+
+int PIURecordingReader::Next(RecordedEvent& event, uint64_t& dropped)
+{
+	while (ok && next < end && *next != kRecordEnd)
+	{
+		const uint8_t* p = next + 1;
+		uint8_t tag = *next;
+		uint64_t length;
+
+		if (!ReadVarint(p, end, length) || length > (uint64_t)(end - p))
+		{
+			ok = false;
+			break;
+		}
+		const uint8_t* stop = p + length;
+		next = stop;
+
+		switch (tag)
+		{
+			case kRecordSession:
+				ids.clear();
+				seconds = 0;
+				return tag;
+
+			case kRecordID:
+			{
+				RecordedID id;
+				uint64_t value;
+				if (!ReadVarint(p, stop, value) || value > 0xFFFFFFFF) { ok = false; break; }
+				id.id = (uint32_t)value;
+				if (id.id < kRecordingRuntimeIDLimit && !ReadString(p, stop, id.name)) { ok = false; break; }
+				ids.push_back(id);
+				break;
+			}
+
+			case kRecordEvent:
+			{
+				uint64_t micros;
+				event.descriptor = RecordedValue();
+				if (!ReadVarint(p, stop, micros) ||
+					!ReadID(p, stop, event.event) ||
+					!ReadDescriptor(p, stop, event.descriptor, 0))
+				{
+					ok = false;
+					break;
+				}
+				seconds += micros / 1e6;
+				event.seconds = seconds;
+				return tag;
+			}
+
+			case kRecordDropped:
+				if (!ReadVarint(p, stop, dropped)) { ok = false; break; }
+				return tag;
+
+			default:
+				// from a later version; skip it
+				break;
+		}
+	}
+	return kRecordEnd;
+}
+
+// end PIURecording.cpp
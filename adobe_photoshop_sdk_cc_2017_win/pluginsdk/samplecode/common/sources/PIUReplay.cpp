@@ -0,0 +1,262 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUReplay.cpp
+//
+//	Description:
+//		Plays the events of a recording again and times each one.
+//		See PIUReplay.h for more information.
+//
+//-------------------------------------------------------------------------------
+
+#include "PIUReplay.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <thread>
+
+typedef std::chrono::steady_clock ReplayClock;
+
+static double Seconds(ReplayClock::duration duration)
+{
+	return std::chrono::duration<double>(duration).count();
+}
+
+//-------------------------------------------------------------------------------
+//	PIUReplay
+//-------------------------------------------------------------------------------
+
+PIUReplay::PIUReplay(PIUReplayTarget& inTarget)
+	: target(inTarget), dropped(0), elapsed(0)
+{
+}
+
+void PIUReplay::Clear(void)
+{
+	timings.clear();
+	dropped = 0;
+	elapsed = 0;
+}
+
+bool PIUReplay::Run(const uint8_t* data, size_t size, const PIUReplayOptions& options)
+{
+	PIURecordingReader reader(data, size);
+	if (!reader.IsRecording())
+		return false;
+
+	double speed = options.speed > 0 ? options.speed : 1.0;
+	uint32_t session = timings.empty() ? 0 : timings.back().session;
+	bool started = false;
+	ReplayClock::time_point first;
+	ReplayClock::time_point last;
+	ReplayClock::time_point sessionStart;
+	RecordedEvent event;
+	uint64_t recordedDropped = 0;
+	int tag;
+
+	while ((tag = reader.Next(event, recordedDropped)) != kRecordEnd)
+	{
+		if (tag == kRecordDropped)
+		{
+			dropped += recordedDropped;
+			continue;
+		}
+
+		// a recording always starts with a session, but be kind to one that does not
+		if (tag == kRecordSession || !started)
+		{
+			session++;
+			sessionStart = ReplayClock::now();
+			target.StartSession(reader);
+			if (!started)
+			{
+				first = sessionStart;
+				started = true;
+			}
+			if (tag == kRecordSession)
+				continue;
+		}
+
+		PIUReplayTiming timing;
+		timing.event = EventName(reader, event.event);
+		timing.session = session;
+		timing.recorded = event.seconds;
+		timing.late = 0;
+		timing.build = 0;
+		timing.play = 0;
+		timing.free = 0;
+		timing.error = 0;
+
+		ReplayClock::time_point start = ReplayClock::now();
+
+		if (options.paced)
+		{
+			ReplayClock::time_point due = sessionStart +
+				std::chrono::duration_cast<ReplayClock::duration>(
+					std::chrono::duration<double>(event.seconds / speed));
+			if (start < due)
+			{
+				std::this_thread::sleep_until(due);
+				start = ReplayClock::now();
+			}
+			// sleeping always wakes a little after; that is not the host's fault
+			timing.late = Seconds(start - due);
+		}
+
+		timing.error = target.Build(reader, event);
+		ReplayClock::time_point built = ReplayClock::now();
+
+		if (timing.error == 0)
+			timing.error = target.Play(reader, event);
+		ReplayClock::time_point played = ReplayClock::now();
+
+		target.Free();
+		last = ReplayClock::now();
+
+		timing.build = Seconds(built - start);
+		timing.play = Seconds(played - built);
+		timing.free = Seconds(last - played);
+
+		timings.push_back(timing);
+	}
+
+	if (started)
+		elapsed += Seconds(last - first);
+
+	return reader.IsOK();
+}
+
+//-------------------------------------------------------------------------------
+//	Report
+//-------------------------------------------------------------------------------
+
+typedef struct EventTotals {
+	std::vector<double> times;		// build + play of each
+	size_t errors;
+	double build;
+	double play;
+	double free;
+
+	EventTotals() : errors(0), build(0), play(0), free(0) {}
+} EventTotals;
+
+typedef std::pair<double, std::string> ByTotal;
+
+static double Percentile(const std::vector<double>& sorted, double fraction)
+{
+	if (sorted.empty())
+		return 0;
+	size_t rank = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+	return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void PIUReplay::WriteSummary(FILE* file) const
+{
+	std::map<std::string, EventTotals> totals;
+
+	for (size_t t = 0; t < timings.size(); t++)
+	{
+		const PIUReplayTiming& timing = timings[t];
+		EventTotals& total = totals[timing.event];
+		total.times.push_back(timing.build + timing.play);
+		total.build += timing.build;
+		total.play += timing.play;
+		total.free += timing.free;
+		if (timing.error != 0)
+			total.errors++;
+	}
+
+	std::vector<ByTotal> order;
+	for (std::map<std::string, EventTotals>::const_iterator i = totals.begin(); i != totals.end(); ++i)
+		order.push_back(ByTotal(-(i->second.build + i->second.play), i->first));
+	std::sort(order.begin(), order.end());
+
+	fprintf(file, "%-32s %7s %6s %11s %9s %9s %9s %9s\n",
+			"event", "count", "errors", "total ms", "mean ms", "median", "95%", "longest");
+
+	for (size_t o = 0; o < order.size(); o++)
+	{
+		EventTotals& total = totals[order[o].second];
+		std::vector<double>& times = total.times;
+		std::sort(times.begin(), times.end());
+		double sum = total.build + total.play;
+
+		fprintf(file, "%-32s %7lu %6lu %11.3f %9.3f %9.3f %9.3f %9.3f\n",
+				order[o].second.c_str(),
+				(unsigned long)times.size(),
+				(unsigned long)total.errors,
+				sum * 1e3,
+				sum * 1e3 / times.size(),
+				Percentile(times, 0.5) * 1e3,
+				Percentile(times, 0.95) * 1e3,
+				times.back() * 1e3);
+	}
+
+	fprintf(file, "%lu events in %.3f s", (unsigned long)timings.size(), elapsed);
+	if (dropped != 0)
+		fprintf(file, ", %llu were not recorded", (unsigned long long)dropped);
+	fprintf(file, "\n");
+}
+
+void PIUReplay::WriteFolded(FILE* file) const
+{
+	std::map<std::string, double> stacks;
+
+	for (size_t t = 0; t < timings.size(); t++)
+	{
+		const PIUReplayTiming& timing = timings[t];
+
+		// ';' separates frames and ' ' the count, so neither can be in a name
+		std::string name = timing.event;
+		std::replace(name.begin(), name.end(), ';', '_');
+		std::replace(name.begin(), name.end(), ' ', '_');
+
+		std::string frame = "replay;" + name + ";";
+		stacks[frame + "build"] += timing.build;
+		stacks[frame + "play"] += timing.play;
+		stacks[frame + "free"] += timing.free;
+		if (timing.late > 0)
+			stacks["replay;late"] += timing.late;
+	}
+
+	for (std::map<std::string, double>::const_iterator i = stacks.begin(); i != stacks.end(); ++i)
+	{
+		unsigned long long micros = (unsigned long long)(i->second * 1e6 + 0.5);
+		if (micros != 0)
+			fprintf(file, "%s %llu\n", i->first.c_str(), micros);
+	}
+}
+
+std::string PIUReplay::EventName(const PIURecordingReader& reader, uint32_t number)
+{
+	const RecordedID& id = reader.ID(number);
+
+	if (id.id < kRecordingRuntimeIDLimit)
+		return id.name;
+
+	std::string text(4, ' ');
+	for (int a = 0; a < 4; a++)
+	{
+		char c = (char)(id.id >> (24 - 8 * a));
+		if (c < ' ' || c > '~')
+		{
+			char digits[16];
+			snprintf(digits, sizeof(digits), "%lu", (unsigned long)id.id);
+			return digits;
+		}
+		text[a] = c;
+	}
+	return text;
+}
+
+// end PIUReplay.cpp
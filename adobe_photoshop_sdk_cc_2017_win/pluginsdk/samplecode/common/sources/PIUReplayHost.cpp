@@ -0,0 +1,370 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUReplayHost.cpp
+//
+//	Description:
+//		Replays a recording on the host.
+//		See PIUReplayHost.h for more information.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#include "PIUReplayHost.h"
+#include "PIUFile.h"
+#include "PIUStringID.h"
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+PIUReplayHost::PIUReplayHost(PIDialogPlayOptions inOptions)
+	: options(inOptions), built(NULL)
+{
+}
+
+PIUReplayHost::~PIUReplayHost()
+{
+	Free();
+}
+
+void PIUReplayHost::StartSession(const PIURecordingReader& /*reader*/)
+{
+	ids.clear();
+}
+
+DescriptorTypeID PIUReplayHost::ID(const PIURecordingReader& reader, uint32_t number)
+{
+	if (number < ids.size() && ids[number] != 0)
+		return ids[number];
+
+	const RecordedID& recorded = reader.ID(number);
+	DescriptorTypeID id = recorded.id;
+
+	if (recorded.id < kRecordingRuntimeIDLimit)
+	{
+		id = 0;
+		if (recorded.name.empty() ||
+			PIUStringIDToTypeID(recorded.name.c_str(), &id) != kSPNoError)
+			return 0;
+	}
+
+	if (number >= ids.size())
+		ids.resize(number + 1, 0);
+	ids[number] = id;
+
+	return id;
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+int PIUReplayHost::Build(const PIURecordingReader& reader, const RecordedEvent& event)
+{
+	if (ID(reader, event.event) == 0)
+		return kSPBadParameterError;
+
+	// an event recorded with nothing plays with no descriptor, as most did
+	if (event.descriptor.children.empty())
+		return kSPNoError;
+
+	return MakeDescriptor(reader, event.descriptor, &built);
+}
+
+int PIUReplayHost::Play(const PIURecordingReader& reader, const RecordedEvent& event)
+{
+	PIActionDescriptor result = NULL;
+
+	SPErr error = sPSActionControl->Play(&result, ID(reader, event.event), built, options);
+
+	if (error == kSPNoError && result != NULL)
+	{
+		Boolean hasKey = false;
+		(void)sPSActionDescriptor->HasKey(result, keyMessage, &hasKey);
+		if (hasKey)
+			error = -1;
+	}
+
+	if (result != NULL)
+		sPSActionDescriptor->Free(result);
+
+	return error;
+}
+
+void PIUReplayHost::Free(void)
+{
+	if (built != NULL)
+	{
+		sPSActionDescriptor->Free(built);
+		built = NULL;
+	}
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+SPErr PIUReplayHost::MakeDescriptor(const PIURecordingReader& reader,
+									const RecordedValue& value,
+									PIActionDescriptor* descriptor)
+{
+	*descriptor = NULL;
+
+	SPErr error = sPSActionDescriptor->Make(descriptor);
+
+	for (size_t c = 0; c < value.children.size() && error == kSPNoError; c++)
+	{
+		DescriptorKeyID key = ID(reader, value.keys[c]);
+		if (key != 0)
+			error = PutValue(reader, value.children[c], *descriptor, key, NULL);
+	}
+
+	if (error != kSPNoError && *descriptor != NULL)
+	{
+		sPSActionDescriptor->Free(*descriptor);
+		*descriptor = NULL;
+	}
+
+	return error;
+}
+
+SPErr PIUReplayHost::MakeList(const PIURecordingReader& reader,
+							  const RecordedValue& value,
+							  PIActionList* list)
+{
+	*list = NULL;
+
+	SPErr error = sPSActionList->Make(list);
+
+	for (size_t c = 0; c < value.children.size() && error == kSPNoError; c++)
+		error = PutValue(reader, value.children[c], NULL, 0, *list);
+
+	if (error != kSPNoError && *list != NULL)
+	{
+		sPSActionList->Free(*list);
+		*list = NULL;
+	}
+
+	return error;
+}
+
+SPErr PIUReplayHost::MakeReference(const PIURecordingReader& reader,
+								   const RecordedValue& value,
+								   PIActionReference* reference)
+{
+	*reference = NULL;
+
+	SPErr error = sPSActionReference->Make(reference);
+
+	for (size_t p = 0; p < value.children.size() && error == kSPNoError; p++)
+	{
+		const RecordedValue& part = value.children[p];
+		DescriptorClassID desiredClass = ID(reader, part.id1);
+
+		switch (part.kind)
+		{
+			case kFormName:
+				error = sPSActionReference->PutName(*reference, desiredClass, part.text.c_str());
+				break;
+			case kFormIndex:
+				error = sPSActionReference->PutIndex(*reference, desiredClass, (uint32)part.integer);
+				break;
+			case kFormIdentifier:
+				error = sPSActionReference->PutIdentifier(*reference, desiredClass, (uint32)part.integer);
+				break;
+			case kFormOffset:
+				error = sPSActionReference->PutOffset(*reference, desiredClass, (int32)part.integer);
+				break;
+			case kFormEnumerated:
+				error = sPSActionReference->PutEnumerated(*reference,
+														  desiredClass,
+														  ID(reader, part.id2),
+														  ID(reader, part.id3));
+				break;
+			case kFormProperty:
+				error = sPSActionReference->PutProperty(*reference, desiredClass, ID(reader, part.id2));
+				break;
+			case kFormClass:
+				error = sPSActionReference->PutClass(*reference, desiredClass);
+				break;
+			default:
+				// the recording did not keep what it was
+				error = kSPBadParameterError;
+				break;
+		}
+	}
+
+	if (error != kSPNoError && *reference != NULL)
+	{
+		sPSActionReference->Free(*reference);
+		*reference = NULL;
+	}
+
+	return error;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	PutValue
+//
+//	The host copies what it is given, so anything made for a value is freed
+//	here once it is put.
+//
+//-------------------------------------------------------------------------------
+SPErr PIUReplayHost::PutValue(const PIURecordingReader& reader,
+							  const RecordedValue& value,
+							  PIActionDescriptor descriptor,
+							  DescriptorKeyID key,
+							  PIActionList list)
+{
+	SPErr error = kSPNoError;
+
+	switch (value.kind)
+	{
+		case kValueInteger64:
+			if (list != NULL)
+				error = sPSActionList->PutInteger64(list, value.integer);
+			else
+				error = sPSActionDescriptor->PutInteger64(descriptor, key, value.integer);
+			break;
+
+		case kValueInteger:
+			if (list != NULL)
+				error = sPSActionList->PutInteger(list, (int32)value.integer);
+			else
+				error = sPSActionDescriptor->PutInteger(descriptor, key, (int32)value.integer);
+			break;
+
+		case kValueFloat:
+			if (list != NULL)
+				error = sPSActionList->PutFloat(list, value.number);
+			else
+				error = sPSActionDescriptor->PutFloat(descriptor, key, value.number);
+			break;
+
+		case kValueUnitFloat:
+			if (list != NULL)
+				error = sPSActionList->PutUnitFloat(list, ID(reader, value.id1), value.number);
+			else
+				error = sPSActionDescriptor->PutUnitFloat(descriptor, key, ID(reader, value.id1), value.number);
+			break;
+
+		case kValueString:
+			if (list != NULL)
+				error = sPSActionList->PutString(list, value.text.c_str());
+			else
+				error = sPSActionDescriptor->PutString(descriptor, key, value.text.c_str());
+			break;
+
+		case kValuePath:
+		{
+			Handle alias = NULL;
+			vector<char> path(value.text.begin(), value.text.end());
+			path.push_back('\0');
+			FullPathToAlias(&path[0], alias);
+			if (alias == NULL)
+				return kSPBadParameterError;
+			if (list != NULL)
+				error = sPSActionList->PutAlias(list, alias);
+			else
+				error = sPSActionDescriptor->PutAlias(descriptor, key, alias);
+			sPSHandle->DisposeRegularHandle(alias);
+			break;
+		}
+
+		case kValueFalse:
+		case kValueTrue:
+			if (list != NULL)
+				error = sPSActionList->PutBoolean(list, value.kind == kValueTrue);
+			else
+				error = sPSActionDescriptor->PutBoolean(descriptor, key, value.kind == kValueTrue);
+			break;
+
+		case kValueObject:
+		case kValueGlobalObject:
+		{
+			PIActionDescriptor object = NULL;
+			error = MakeDescriptor(reader, value, &object);
+			if (error != kSPNoError)
+				break;
+			DescriptorClassID objectClass = ID(reader, value.id1);
+			if (value.kind == kValueObject)
+				error = list != NULL ? sPSActionList->PutObject(list, objectClass, object)
+									 : sPSActionDescriptor->PutObject(descriptor, key, objectClass, object);
+			else
+				error = list != NULL ? sPSActionList->PutGlobalObject(list, objectClass, object)
+									 : sPSActionDescriptor->PutGlobalObject(descriptor, key, objectClass, object);
+			sPSActionDescriptor->Free(object);
+			break;
+		}
+
+		case kValueEnumerated:
+			if (list != NULL)
+				error = sPSActionList->PutEnumerated(list, ID(reader, value.id1), ID(reader, value.id2));
+			else
+				error = sPSActionDescriptor->PutEnumerated(descriptor, key, ID(reader, value.id1), ID(reader, value.id2));
+			break;
+
+		case kValueList:
+		{
+			PIActionList values = NULL;
+			error = MakeList(reader, value, &values);
+			if (error != kSPNoError)
+				break;
+			if (list != NULL)
+				error = sPSActionList->PutList(list, values);
+			else
+				error = sPSActionDescriptor->PutList(descriptor, key, values);
+			sPSActionList->Free(values);
+			break;
+		}
+
+		case kValueReference:
+		{
+			PIActionReference reference = NULL;
+			error = MakeReference(reader, value, &reference);
+			if (error != kSPNoError)
+				break;
+			if (list != NULL)
+				error = sPSActionList->PutReference(list, reference);
+			else
+				error = sPSActionDescriptor->PutReference(descriptor, key, reference);
+			sPSActionReference->Free(reference);
+			break;
+		}
+
+		case kValueClass:
+			if (list != NULL)
+				error = sPSActionList->PutClass(list, ID(reader, value.id1));
+			else
+				error = sPSActionDescriptor->PutClass(descriptor, key, ID(reader, value.id1));
+			break;
+
+		case kValueGlobalClass:
+			if (list != NULL)
+				error = sPSActionList->PutGlobalClass(list, ID(reader, value.id1));
+			else
+				error = sPSActionDescriptor->PutGlobalClass(descriptor, key, ID(reader, value.id1));
+			break;
+
+		case kValueData:
+			// only the length was recorded, and the host would take any
+			// bytes made up for it as the real thing, so the event fails
+			error = kSPUnimplementedError;
+			break;
+
+		default:
+			// kValueOther, nothing to put back
+			break;
+	}
+
+	return error;
+}
+
+// end PIUReplayHost.cpp
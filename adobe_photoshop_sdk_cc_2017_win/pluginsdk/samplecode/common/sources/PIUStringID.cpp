@@ -0,0 +1,180 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		PIUStringID.cpp
+//
+//	Description:
+//		Keeps the host's string IDs and type IDs.
+//		See PIUStringID.h for more information.
+//
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+#include "PIUStringID.h"
+#include "PIUSuites.h"
+#include <mutex>
+#include <string.h>
+
+//-------------------------------------------------------------------------------
+//	Tables
+//
+//	Open addressing, one table for each direction.  An entry is made once,
+//	never changes and is never freed, so a reader that sees a slot filled
+//	can use the entry without a lock.  Writers take gAddLock.  When a
+//	table is three quarters full nothing more is added, and the rest are
+//	asked of the host every time.
+//-------------------------------------------------------------------------------
+
+typedef struct StringIDEntry {
+	DescriptorTypeID typeID;
+	size_t length;
+	char stringID[1];			// length + 1 bytes
+} StringIDEntry;
+
+static const size_t kSlots = 4096;
+static const size_t kMostEntries = kSlots / 4 * 3;
+
+static std::atomic<const StringIDEntry*> gByString[kSlots];
+static std::atomic<const StringIDEntry*> gByTypeID[kSlots];
+static size_t gStringCount = 0;
+static size_t gTypeIDCount = 0;
+static std::mutex gAddLock;
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+static size_t HashString(const char* stringID, size_t length)
+{
+	// FNV-1a
+	uint32 hash = 2166136261u;
+	for (size_t c = 0; c < length; c++)
+		hash = (hash ^ (unsigned char)stringID[c]) * 16777619u;
+	return hash & (kSlots - 1);
+}
+
+static size_t HashTypeID(DescriptorTypeID typeID)
+{
+	return (size_t)((typeID * 2654435769u) >> 20) & (kSlots - 1);
+}
+
+static const StringIDEntry* FindString(const char* stringID, size_t length, size_t& slot)
+{
+	slot = HashString(stringID, length);
+	for (;;)
+	{
+		const StringIDEntry* entry = gByString[slot].load(std::memory_order_acquire);
+		if (entry == NULL ||
+			(entry->length == length && memcmp(entry->stringID, stringID, length) == 0))
+			return entry;
+		slot = (slot + 1) & (kSlots - 1);
+	}
+}
+
+static const StringIDEntry* FindTypeID(DescriptorTypeID typeID, size_t& slot)
+{
+	slot = HashTypeID(typeID);
+	for (;;)
+	{
+		const StringIDEntry* entry = gByTypeID[slot].load(std::memory_order_acquire);
+		if (entry == NULL || entry->typeID == typeID)
+			return entry;
+		slot = (slot + 1) & (kSlots - 1);
+	}
+}
+
+static StringIDEntry* MakeEntry(DescriptorTypeID typeID, const char* stringID, size_t length)
+{
+	StringIDEntry* entry = (StringIDEntry*)new char[sizeof(StringIDEntry) + length];
+	entry->typeID = typeID;
+	entry->length = length;
+	memcpy(entry->stringID, stringID, length);
+	entry->stringID[length] = '\0';
+	return entry;
+}
+
+//-------------------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+SPErr PIUStringIDToTypeID(const char* stringID,
+						  DescriptorTypeID* typeID,
+						  PIUStringIDProc proc)
+{
+	size_t length = strlen(stringID);
+	size_t slot;
+
+	const StringIDEntry* found = FindString(stringID, length, slot);
+	if (found != NULL)
+	{
+		*typeID = found->typeID;
+		return kSPNoError;
+	}
+
+	SPErr error = proc != NULL ? proc(stringID, typeID)
+							   : sPSActionControl->StringIDToTypeID(stringID, typeID);
+	if (error)
+		return error;
+
+	std::lock_guard<std::mutex> lock(gAddLock);
+
+	// someone else may have added it in the meantime
+	if (FindString(stringID, length, slot) == NULL && gStringCount < kMostEntries)
+	{
+		gByString[slot].store(MakeEntry(*typeID, stringID, length), std::memory_order_release);
+		gStringCount++;
+	}
+
+	return kSPNoError;
+}
+
+SPErr PIUTypeIDToStringID(DescriptorTypeID typeID,
+						  char* stringID,
+						  uint32 stringLength,
+						  PIUTypeIDProc proc)
+{
+	size_t slot;
+
+	if (stringLength == 0)
+		return kSPBadParameterError;
+
+	const StringIDEntry* found = FindTypeID(typeID, slot);
+	if (found != NULL)
+	{
+		size_t length = found->length < stringLength - 1 ? found->length : stringLength - 1;
+		memcpy(stringID, found->stringID, length);
+		stringID[length] = '\0';
+		return kSPNoError;
+	}
+
+	stringID[0] = '\0';
+
+	SPErr error = proc != NULL ? proc(typeID, stringID, stringLength)
+							   : sPSActionControl->TypeIDToStringID(typeID, stringID, stringLength);
+	if (error)
+		return error;
+
+	// one that filled the buffer may have been cut short, so is not kept
+	size_t length = strnlen(stringID, stringLength);
+	if (length + 1 >= stringLength)
+		return kSPNoError;
+
+	std::lock_guard<std::mutex> lock(gAddLock);
+
+	if (FindTypeID(typeID, slot) == NULL && gTypeIDCount < kMostEntries)
+	{
+		gByTypeID[slot].store(MakeEntry(typeID, stringID, length), std::memory_order_release);
+		gTypeIDCount++;
+	}
+
+	return kSPNoError;
+}
+
+// end PIUStringID.cpp
@@ -33,6 +33,7 @@
 //-------------------------------------------------------------------------------
 
 #include "Outbound.h"
+#include "OutboundTargets.h"
 
 //-------------------------------------------------------------------------------
 //	Prototypes.
@@ -239,6 +240,8 @@ void ValidateParameters (GPtr globals)
 {
 	gQueryForParameters = true;
 	gAliasHandle = nil; // no handle, yet
+	gTargets = kOutboundTargetRaw;
+	gPreviewScale = kOutboundDefaultPreviewScale;
 
 } // end ValidateParameters
 
@@ -340,11 +343,31 @@ void DoFinish (GPtr globals)
 
 Boolean WriteExportFile (GPtr globals)
 {
-	/* We write out the file as an interleaved raw file. */ 
+	/* We write out the file as an interleaved raw file.  Every other target
+	   is fed from the same pass, so the host delivers each pixel once. */ 
+	
+	OutboundImageInfo info;
+	
+	info.width = gStuff->imageSize.h;
+	info.height = gStuff->imageSize.v;
+	info.planes = gStuff->planes;
+	info.depth = gStuff->depth;
+	info.bytesPerRow = info.width * info.planes * ((info.depth + 7) / 8);
+	
+	OutboundTargetList targets;
+	
+	if (!TSR (CreateOutboundTargets (globals, targets))) return FALSE;
+	
+	for (size_t t = 0; t < targets.size(); ++t)
+		targets[t]->Start (info);
 	
 	/* We need to figure out how many rows to write at one time. */
 	
-	long chunk = gStuff->maxData / gStuff->imageSize.h / gStuff->planes;
+	long chunk = gStuff->maxData / info.bytesPerRow;
+	if (chunk < 1)
+		chunk = 1;
+	if (chunk > 0x7FFF)
+		chunk = 0x7FFF;	/* RANGE_ITER steps in shorts */
 	
 	ExportRegion region;
 	
@@ -357,34 +380,42 @@ Boolean WriteExportFile (GPtr globals)
 				0, gStuff->imageSize.v, chunk)
 		{
 		
-		int16 row;
-		long rowCount = gStuff->imageSize.h * (long) gStuff->planes;
 		void *data = 0;
 		int32 rowBytes = 0;
-		unsigned8 *rowData;
 		
 		if (!TSC (TestAbort ())) return FALSE;
 			
 		if (!TSR (FetchData (gStuff, &region, &data, &rowBytes))) return FALSE;
 		
-		for (row = region.rect.top, rowData = (unsigned8 *) data;
-			 row < region.rect.bottom;
-			 ++row, rowData += rowBytes)
-			{
-			
-			int32 count = rowCount;
-			
-			PIUpdateProgress (row, gStuff->imageSize.v);
-			
-			if (!TSC (TestAbort ())) return FALSE;
-			
-			if (!TSR (PSSDKWrite (gFRefNum, &count, rowData))) return FALSE;
-			
-			}
+		/* Copy the band out of the host buffer; the targets share it. */
 		
-		}
+		std::shared_ptr<OutboundChunk> band (new OutboundChunk);
+		band->top = region.rect.top;
+		band->rows = region.rect.bottom - region.rect.top;
+		band->pixels.resize ((size_t)band->rows * info.bytesPerRow);
+		
+		const unsigned8 *rowData = (const unsigned8 *) data;
+		for (int32 row = 0; row < band->rows; ++row, rowData += rowBytes)
+			memcpy (&band->pixels[(size_t)row * info.bytesPerRow], rowData, info.bytesPerRow);
+		
+		for (size_t t = 0; t < targets.size(); ++t)
+			targets[t]->Post (band);
 		
-	return TRUE;
+		PIUpdateProgress (region.rect.bottom, gStuff->imageSize.v);
+		
+		}
+	
+	/* Wait for every target and report the first error. */
+	
+	OSErr err = noErr;
+	for (size_t t = 0; t < targets.size(); ++t)
+		{
+		OSErr targetErr = targets[t]->Finish ();
+		if (err == noErr)
+			err = targetErr;
+		}
+	
+	return TSR (err);
 	
 }
 
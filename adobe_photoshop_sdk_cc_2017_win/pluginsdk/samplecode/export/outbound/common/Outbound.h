@@ -51,6 +51,20 @@ typedef struct ExportRegion
 
 } ExportRegion;
 
+// Output targets fed from the single pass over the host data.  The raw
+// target writes the export file itself and is always on; the others
+// write side files next to it:
+
+enum
+{
+	kOutboundTargetRaw		= 0x01,
+	kOutboundTargetPNG		= 0x02,
+	kOutboundTargetPreview	= 0x04,
+	kOutboundTargetChecksum	= 0x08
+};
+
+#define kOutboundDefaultPreviewScale	4
+
 typedef struct Globals
 { // This is our structure that we use to pass globals between routines:
 
@@ -61,6 +75,9 @@ typedef struct Globals
 	Boolean					sameNames;
 	FileHandle				fRefNum;
 
+	int32					targets;			// kOutboundTarget* flags
+	int16					previewScale;		// 1:n downscale of the preview
+
 	// AliasHandle on Mac, Handle on Windows:
 	PIPlatformFileHandle	aliasHandle;
     
@@ -86,6 +103,8 @@ typedef struct Globals
 #define gSameNames				(globals->sameNames)
 #define gAliasHandle			(globals->aliasHandle)
 #define gFRefNum				(globals->fRefNum)
+#define gTargets				(globals->targets)
+#define gPreviewScale			(globals->previewScale)
 #define gFileName               (globals->fileNameNSString)
 #define gFilePOSIX              (globals->filePOSIX)
 #define gUsePOSIX               (globals->usePOSIX)
@@ -104,6 +123,7 @@ Boolean DoUI (GPtr globals);				// Show the UI.
 Boolean CreateExportFile (GPtr globals);
 Boolean WriteExportFile (GPtr globals);
 Boolean CloseExportFile (GPtr globals);
+const char * GetExportFilePath (GPtr globals);	// UTF-8/ANSI path of the export file.
 
 void MarkExportFinished (ExportRecord *stuff);
 
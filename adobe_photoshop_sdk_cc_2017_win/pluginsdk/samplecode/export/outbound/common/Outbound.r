@@ -176,6 +176,18 @@ resource 'aete' (ResourceID, plugInName " dictionary", purgeable)
 				keyIn,										/* common key */
 				typePlatformFilePath,						/* correct path for platform */
 				"file path",								/* optional description */
+				flagsSingleProperty,
+
+				"targets",									/* output targets */
+				keyTargets,
+				typeInteger,
+				"output target flags",						/* optional description */
+				flagsSingleProperty,
+
+				"preview scale",							/* preview downscale */
+				keyPreviewScale,
+				typeInteger,
+				"preview downscale factor",					/* optional description */
 				flagsSingleProperty
 				
 				/* no more properties */
@@ -94,6 +94,23 @@ Boolean ReadScriptParams (GPtr globals)
         return TRUE;
     }
 
+    // the output targets are optional and default to the raw file only
+    int32 targets = 0;
+    hasKey = FALSE;
+    err = sPSActionDescriptor2->HasKey(desc, keyTargets, &hasKey);
+    if ( ! err && hasKey)
+        err = sPSActionDescriptor2->GetInteger(desc, keyTargets, &targets);
+    if ( ! err && hasKey)
+        gTargets = targets | kOutboundTargetRaw;
+
+    int32 previewScale = 0;
+    hasKey = FALSE;
+    err = sPSActionDescriptor2->HasKey(desc, keyPreviewScale, &hasKey);
+    if ( ! err && hasKey)
+        err = sPSActionDescriptor2->GetInteger(desc, keyPreviewScale, &previewScale);
+    if ( ! err && hasKey && previewScale > 0 && previewScale <= 0x7FFF)
+        gPreviewScale = (int16)previewScale;
+
     hasKey = FALSE;
     err = sPSActionDescriptor2->HasKey(desc, keyInBookmark, &hasKey);
     if ( ! err && hasKey && sPSActionDescriptor.IsAvailable())
@@ -168,6 +185,12 @@ OSErr WriteScriptParams (GPtr globals)
         gAliasHandle = NULL;
     }
 
+    if ( ! err)
+        err = sPSActionDescriptor2->PutInteger(desc, keyTargets, gTargets);
+
+    if ( ! err)
+        err = sPSActionDescriptor2->PutInteger(desc, keyPreviewScale, gPreviewScale);
+
     if (err)
     {
         sPSActionDescriptor2->Free(desc);
@@ -0,0 +1,502 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		OutboundTargets.cpp
+//
+//	Description:
+//		This file contains the output targets for the Export
+//		module Outbound: raw interleaved data, PNG, a box
+//		filtered preview PNG and a per-tile checksum file.
+//
+//	Use:
+//		WriteExportFile fetches every band of rows from the
+//		host once and posts a copy to each target.  The
+//		targets encode on their own worker threads.
+//
+//-------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OutboundTargets.h"
+
+#define STBI_MSC_SECURE_CRT
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+//-------------------------------------------------------------------------------
+//	Helpers
+//-------------------------------------------------------------------------------
+
+// Number of planes written to PNG files.  stb handles gray, gray+alpha,
+// RGB and RGBA; extra planes (alpha channels, spot colors) are dropped.
+static int PNGComponents (const OutboundImageInfo & info)
+{
+	return info.planes > 4 ? 4 : info.planes;
+}
+
+// Reduce one sample of the host data to 8 bits.  16 bit data in Photoshop
+// runs from 0 to 32768, 32 bit data is floating point from 0.0 to 1.0.
+static inline unsigned8 SampleTo8 (const unsigned8 * sample, int16 depth)
+{
+	if (depth == 16)
+	{
+		uint32 value = *(const unsigned16 *)sample;
+		if (value >= 32768)
+			return 255;
+		return (unsigned8)((value * 255 + 16384) >> 15);
+	}
+	else if (depth == 32)
+	{
+		float value = *(const float *)sample;
+		if (!(value > 0.0f))
+			return 0;
+		if (value >= 1.0f)
+			return 255;
+		return (unsigned8)(value * 255.0f + 0.5f);
+	}
+	return *sample;
+}
+
+// Convert one interleaved host row to 8 bit samples, keeping 'components'
+// of every pixel.
+static void RowTo8 (const OutboundImageInfo & info,
+					const unsigned8 * row,
+					unsigned8 * out,
+					int components)
+{
+	const int32 sampleBytes = info.depth / 8;
+	const int32 pixelBytes = sampleBytes * info.planes;
+
+	for (int32 x = 0; x < info.width; ++x, row += pixelBytes)
+		for (int c = 0; c < components; ++c)
+			*out++ = SampleTo8(row + c * sampleBytes, info.depth);
+}
+
+static OSErr WritePNG (const std::string & path,
+					   int32 width,
+					   int32 height,
+					   int components,
+					   const std::vector<unsigned8> & pixels)
+{
+	if (!stbi_write_png(path.c_str(),
+						width,
+						height,
+						components,
+						&pixels[0],
+						width * components))
+		return writErr;
+	return noErr;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	OutboundTarget
+//
+//-------------------------------------------------------------------------------
+
+OutboundTarget::OutboundTarget (OutboundEncoder * outboundEncoder)
+	: encoder(outboundEncoder), closed(false), canceled(false), error(noErr)
+{
+}
+
+OutboundTarget::~OutboundTarget ()
+{
+	// Join before the encoder goes away, even on an early exit.
+	Cancel();
+}
+
+void OutboundTarget::Start (const OutboundImageInfo & info)
+{
+	closed = false;
+	canceled = false;
+	error = noErr;
+	worker = std::thread(&OutboundTarget::Run, this, info);
+}
+
+void OutboundTarget::Post (const OutboundChunkPtr & chunk)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return queue.size() < kOutboundQueueDepth || canceled; });
+	if (canceled)
+		return;
+	queue.push_back(chunk);
+	changed.notify_all();
+}
+
+OSErr OutboundTarget::Finish (void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		changed.notify_all();
+	}
+	if (worker.joinable())
+		worker.join();
+	return error;
+}
+
+void OutboundTarget::Cancel (void)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		canceled = true;
+		queue.clear();
+		changed.notify_all();
+	}
+	if (worker.joinable())
+		worker.join();
+}
+
+void OutboundTarget::Run (OutboundImageInfo info)
+{
+	OSErr err = encoder->Begin(info);
+	bool begun = err == noErr;
+	bool wasCanceled = false;
+
+	for (;;)
+	{
+		OutboundChunkPtr chunk;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return !queue.empty() || closed; });
+			if (queue.empty())
+			{
+				wasCanceled = canceled;
+				break;
+			}
+			chunk = queue.front();
+			queue.pop_front();
+			changed.notify_all();
+		}
+
+		// Keep draining after an error so Post never blocks for good.
+		if (err == noErr)
+			err = encoder->Encode(*chunk);
+	}
+
+	// An encoder that failed to begin has nothing to end.
+	if (begun && !wasCanceled)
+	{
+		OSErr endErr = encoder->End();
+		if (err == noErr)
+			err = endErr;
+	}
+
+	error = err;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	RawEncoder
+//
+//	Writes the interleaved rows to the export file, as Outbound always did.
+//
+//-------------------------------------------------------------------------------
+
+class RawEncoder : public OutboundEncoder
+{
+public:
+	explicit RawEncoder (FileHandle fRefNum) : file(fRefNum) {}
+
+protected:
+	virtual OSErr Encode (const OutboundChunk & chunk)
+	{
+		int32 count = chunk.rows * info.bytesPerRow;
+		return PSSDKWrite(file, &count, (void *)&chunk.pixels[0]);
+	}
+
+private:
+	FileHandle file;
+};
+
+//-------------------------------------------------------------------------------
+//
+//	PNGEncoder
+//
+//	Collects 8 bit rows and encodes the PNG once the last band arrived.
+//
+//-------------------------------------------------------------------------------
+
+class PNGEncoder : public OutboundEncoder
+{
+public:
+	explicit PNGEncoder (const std::string & filePath) : path(filePath), components(0) {}
+
+protected:
+	virtual OSErr Begin (const OutboundImageInfo & imageInfo)
+	{
+		info = imageInfo;
+		components = PNGComponents(info);
+		image.resize((size_t)info.width * info.height * components);
+		return noErr;
+	}
+
+	virtual OSErr Encode (const OutboundChunk & chunk)
+	{
+		const size_t outRowBytes = (size_t)info.width * components;
+		for (int32 row = 0; row < chunk.rows; ++row)
+			RowTo8(info,
+				   &chunk.pixels[(size_t)row * info.bytesPerRow],
+				   &image[(size_t)(chunk.top + row) * outRowBytes],
+				   components);
+		return noErr;
+	}
+
+	virtual OSErr End (void)
+	{
+		return WritePNG(path, info.width, info.height, components, image);
+	}
+
+private:
+	std::string path;
+	int components;
+	std::vector<unsigned8> image;
+};
+
+//-------------------------------------------------------------------------------
+//
+//	PreviewEncoder
+//
+//	Box filters the image down by 'scale' in both directions.  Rows are summed
+//	as they arrive, so only one output row of accumulators is kept around.
+//
+//-------------------------------------------------------------------------------
+
+class PreviewEncoder : public OutboundEncoder
+{
+public:
+	PreviewEncoder (const std::string & filePath, int16 scaleFactor)
+		: path(filePath), scale(scaleFactor < 1 ? 1 : scaleFactor),
+		  components(0), outWidth(0), outHeight(0), rowsSummed(0), outRow(0) {}
+
+protected:
+	virtual OSErr Begin (const OutboundImageInfo & imageInfo)
+	{
+		info = imageInfo;
+		components = PNGComponents(info);
+		outWidth = (info.width + scale - 1) / scale;
+		outHeight = (info.height + scale - 1) / scale;
+		sums.assign((size_t)outWidth * components, 0);
+		row8.resize((size_t)info.width * components);
+		image.resize((size_t)outWidth * outHeight * components);
+		return noErr;
+	}
+
+	virtual OSErr Encode (const OutboundChunk & chunk)
+	{
+		for (int32 row = 0; row < chunk.rows; ++row)
+		{
+			RowTo8(info, &chunk.pixels[(size_t)row * info.bytesPerRow], &row8[0], components);
+
+			const unsigned8 * in = &row8[0];
+			for (int32 x = 0; x < info.width; ++x)
+			{
+				uint32 * sum = &sums[(size_t)(x / scale) * components];
+				for (int c = 0; c < components; ++c)
+					sum[c] += *in++;
+			}
+
+			if (++rowsSummed == scale || chunk.top + row + 1 == info.height)
+				EmitRow();
+		}
+		return noErr;
+	}
+
+	virtual OSErr End (void)
+	{
+		return WritePNG(path, outWidth, outHeight, components, image);
+	}
+
+private:
+	void EmitRow (void)
+	{
+		unsigned8 * out = &image[(size_t)outRow * outWidth * components];
+		for (int32 ox = 0; ox < outWidth; ++ox)
+		{
+			int32 columns = info.width - ox * scale;
+			if (columns > scale)
+				columns = scale;
+			const uint32 area = (uint32)(columns * rowsSummed);
+
+			uint32 * sum = &sums[(size_t)ox * components];
+			for (int c = 0; c < components; ++c)
+			{
+				*out++ = (unsigned8)((sum[c] + area / 2) / area);
+				sum[c] = 0;
+			}
+		}
+		rowsSummed = 0;
+		++outRow;
+	}
+
+	std::string path;
+	int32 scale;
+	int components;
+	int32 outWidth;
+	int32 outHeight;
+	int32 rowsSummed;
+	int32 outRow;
+	std::vector<uint32> sums;
+	std::vector<unsigned8> row8;
+	std::vector<unsigned8> image;
+};
+
+//-------------------------------------------------------------------------------
+//
+//	ChecksumEncoder
+//
+//	Writes one line per kOutboundChecksumTile square tile: the tile column,
+//	the tile row and a 64 bit FNV-1a hash of the tile's raw bytes, taken row
+//	by row.  Tiles are emitted as soon as their last row has been seen.
+//
+//-------------------------------------------------------------------------------
+
+class ChecksumEncoder : public OutboundEncoder
+{
+public:
+	explicit ChecksumEncoder (const std::string & filePath)
+		: path(filePath), file(NULL), tilesAcross(0), tileRow(0) {}
+
+	virtual ~ChecksumEncoder ()
+	{
+		if (file != NULL)
+			fclose(file);
+	}
+
+protected:
+	virtual OSErr Begin (const OutboundImageInfo & imageInfo)
+	{
+		info = imageInfo;
+		file = fopen(path.c_str(), "w");
+		if (file == NULL)
+			return openErr;
+
+		tilesAcross = (info.width + kOutboundChecksumTile - 1) / kOutboundChecksumTile;
+		ResetHashes();
+
+		fprintf(file, "# %d x %d, %d planes, %d bits, %d pixel tiles\n",
+				(int)info.width, (int)info.height, (int)info.planes,
+				(int)info.depth, (int)kOutboundChecksumTile);
+		return noErr;
+	}
+
+	virtual OSErr Encode (const OutboundChunk & chunk)
+	{
+		const size_t tileBytes = (size_t)kOutboundChecksumTile * (info.bytesPerRow / info.width);
+
+		for (int32 row = 0; row < chunk.rows; ++row)
+		{
+			const unsigned8 * data = &chunk.pixels[(size_t)row * info.bytesPerRow];
+			size_t remaining = info.bytesPerRow;
+
+			for (int32 tile = 0; tile < tilesAcross; ++tile)
+			{
+				size_t count = remaining < tileBytes ? remaining : tileBytes;
+				uint64 hash = hashes[tile];
+				for (size_t i = 0; i < count; ++i)
+					hash = (hash ^ data[i]) * 1099511628211ULL;
+				hashes[tile] = hash;
+				data += count;
+				remaining -= count;
+			}
+
+			const int32 y = chunk.top + row + 1;
+			if (y % kOutboundChecksumTile == 0 || y == info.height)
+			{
+				for (int32 tile = 0; tile < tilesAcross; ++tile)
+					fprintf(file, "%d %d %016llx\n",
+							(int)tile, (int)tileRow,
+							(unsigned long long)hashes[tile]);
+				ResetHashes();
+				++tileRow;
+			}
+		}
+
+		return ferror(file) ? writErr : noErr;
+	}
+
+	virtual OSErr End (void)
+	{
+		if (file == NULL)
+			return writErr;
+
+		int failed = fclose(file);
+		file = NULL;
+		return failed ? writErr : noErr;
+	}
+
+private:
+	void ResetHashes (void)
+	{
+		hashes.assign(tilesAcross, 14695981039346656037ULL);
+	}
+
+	std::string path;
+	FILE * file;
+	int32 tilesAcross;
+	int32 tileRow;
+	std::vector<uint64> hashes;
+};
+
+//-------------------------------------------------------------------------------
+//
+//	CreateOutboundTargets
+//
+//	Side files share the export file's path with the extension replaced.
+//
+//-------------------------------------------------------------------------------
+
+static std::string MakeSidePath (GPtr globals, const char * suffix)
+{
+	std::string path(GetExportFilePath(globals));
+
+	size_t dot = path.find_last_of('.');
+	size_t sep = path.find_last_of("/\\");
+	if (dot != std::string::npos && (sep == std::string::npos || dot > sep))
+		path.erase(dot);
+
+	return path + suffix;
+}
+
+static void AddTarget (OutboundTargetList & targets, OutboundEncoder * encoder)
+{
+	targets.push_back(std::unique_ptr<OutboundTarget>(new OutboundTarget(encoder)));
+}
+
+OSErr CreateOutboundTargets (GPtr globals, OutboundTargetList & targets)
+{
+	targets.clear();
+
+	AddTarget(targets, new RawEncoder(gFRefNum));
+
+	if (gTargets & kOutboundTargetPNG)
+		AddTarget(targets, new PNGEncoder(MakeSidePath(globals, ".png")));
+
+	if (gTargets & kOutboundTargetPreview)
+		AddTarget(targets, new PreviewEncoder(MakeSidePath(globals, "_preview.png"), gPreviewScale));
+
+	if (gTargets & kOutboundTargetChecksum)
+		AddTarget(targets, new ChecksumEncoder(MakeSidePath(globals, ".tiles.txt")));
+
+	return noErr;
+}
+
+//-------------------------------------------------------------------------------
+
+// end OutboundTargets.cpp
@@ -0,0 +1,148 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		OutboundTargets.h
+//
+//	Description:
+//		This file contains the output targets for the Export
+//		module Outbound.  Every target is fed the same chunks
+//		of host pixel data and encodes them on its own worker
+//		thread, so a single pass over the image can produce a
+//		raw dump, a PNG, a scaled preview and a tile checksum
+//		file at once.
+//
+//-------------------------------------------------------------------------------
+
+#ifndef __OutboundTargets_H__		// Has this been defined yet?
+#define __OutboundTargets_H__		// Only include once by predefining it.
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Outbound.h"
+
+//-------------------------------------------------------------------------------
+//	Definitions -- Constants
+//-------------------------------------------------------------------------------
+
+// Number of chunks a target may have queued before the host thread waits:
+const size_t kOutboundQueueDepth = 4;
+
+// Edge length, in pixels, of the tiles hashed by the checksum target:
+const int32 kOutboundChecksumTile = 256;
+
+//-------------------------------------------------------------------------------
+//	Structures
+//-------------------------------------------------------------------------------
+
+// Geometry of the image as it is delivered to the targets:
+
+typedef struct OutboundImageInfo
+{
+	int32 width;
+	int32 height;
+	int16 planes;
+	int16 depth;			// bits per sample: 8, 16 or 32
+	int32 bytesPerRow;		// tightly packed, interleaved
+
+} OutboundImageInfo;
+
+// A band of rows copied out of the host buffer.  Chunks are shared read-only
+// between all targets, so the host buffer can be released right away:
+
+typedef struct OutboundChunk
+{
+	int32 top;
+	int32 rows;
+	std::vector<unsigned8> pixels;	// rows * bytesPerRow
+
+} OutboundChunk;
+
+typedef std::shared_ptr<const OutboundChunk> OutboundChunkPtr;
+
+//-------------------------------------------------------------------------------
+//	OutboundEncoder
+//
+//	Implemented by every output format.  All three calls are made on the
+//	owning target's worker thread, in order: Begin once, Encode for every
+//	chunk from top to bottom, End once unless the export was canceled or
+//	Begin failed.
+//-------------------------------------------------------------------------------
+
+class OutboundEncoder
+{
+public:
+	virtual ~OutboundEncoder () {}
+
+	virtual OSErr Begin (const OutboundImageInfo & imageInfo) { info = imageInfo; return noErr; }
+	virtual OSErr Encode (const OutboundChunk & chunk) = 0;
+	virtual OSErr End (void) { return noErr; }
+
+protected:
+	OutboundImageInfo info;
+};
+
+//-------------------------------------------------------------------------------
+//	OutboundTarget
+//
+//	Runs one encoder on its own worker thread.  Start() spawns the worker,
+//	Post() queues a chunk (blocking while the queue is full) and Finish()
+//	drains the queue, joins the worker and returns the first error the
+//	encoder hit.  Destroying a running target cancels it.
+//-------------------------------------------------------------------------------
+
+class OutboundTarget
+{
+public:
+	explicit OutboundTarget (OutboundEncoder * encoder);
+	~OutboundTarget ();
+
+	void Start (const OutboundImageInfo & info);
+	void Post (const OutboundChunkPtr & chunk);
+	OSErr Finish (void);
+	void Cancel (void);
+
+private:
+	void Run (OutboundImageInfo info);
+
+	std::unique_ptr<OutboundEncoder> encoder;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<OutboundChunkPtr> queue;
+	bool closed;
+	bool canceled;
+	OSErr error;
+
+	OutboundTarget (const OutboundTarget &);
+	OutboundTarget & operator= (const OutboundTarget &);
+};
+
+typedef std::vector< std::unique_ptr<OutboundTarget> > OutboundTargetList;
+
+//-------------------------------------------------------------------------------
+//	Prototypes
+//-------------------------------------------------------------------------------
+
+// Builds the target list for gTargets.  The raw target always writes to
+// gFRefNum; the others write side files named after the export file.
+OSErr CreateOutboundTargets (GPtr globals, OutboundTargetList & targets);
+
+//-------------------------------------------------------------------------------
+
+#endif // __OutboundTargets_H__
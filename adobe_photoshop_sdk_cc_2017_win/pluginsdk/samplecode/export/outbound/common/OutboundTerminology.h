@@ -32,7 +32,8 @@
 //	Definitions -- Scripting keys
 //-------------------------------------------------------------------------------
 
-// None
+#define keyTargets			'oTgt'	// kOutboundTarget* flags
+#define keyPreviewScale		'oPvS'	// 1:n downscale of the preview target
 
 //-------------------------------------------------------------------------------
 //	Definitions -- Resources
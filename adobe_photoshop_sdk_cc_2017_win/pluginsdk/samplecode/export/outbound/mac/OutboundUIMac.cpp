@@ -175,5 +175,12 @@ Boolean CloseExportFile (GPtr globals)
 					               &gStuff->dirty,
 					               &gAliasHandle);
 }
+/*****************************************************************************/
+
+const char * GetExportFilePath (GPtr globals)
+{
+	return [gFileName UTF8String];
+}
+
 //-------------------------------------------------------------------------------
 // end OutboundUIMac.cpp
\ No newline at end of file
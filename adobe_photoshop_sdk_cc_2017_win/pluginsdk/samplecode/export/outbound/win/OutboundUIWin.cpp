@@ -272,6 +272,14 @@ Boolean CloseExportFile (GPtr globals)
 	
 }
 
+/*****************************************************************************/
+/* DoUI leaves the full path of the export file in gStuff->filename. */
+
+const char * GetExportFilePath (GPtr globals)
+{
+	return (const char *)gStuff->filename;
+}
+
 /*****************************************************************************/
 /* Dispose alias handle */
 
@@ -0,0 +1,432 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		LayerCompression.cpp
+//
+//	Description:
+//		This file contains the compressed layer encoding for the
+//		File Format module LayerFormat.
+//
+//-------------------------------------------------------------------------------
+
+#include "LayerCompression.h"
+#include "FileUtilities.h"
+#include <string.h>
+
+//-------------------------------------------------------------------------------
+//	Block coder
+//
+//	Writes and reads the LZ4 block format: a series of sequences, each a
+//	token byte holding the literal and match lengths, the literals, and a
+//	little endian 16 bit offset back to the match.  The last sequence is
+//	literals only.  Matches are found greedily through a hash of the next
+//	four bytes, which is plenty for rows of pixels.
+//-------------------------------------------------------------------------------
+
+const int32 kMinMatch = 4;
+const int32 kLastLiterals = 5;		// the last bytes are always literals
+const int32 kMatchFindLimit = 12;	// and no match starts this close to the end
+const int32 kMaxOffset = 65535;
+const int32 kHashLog = 12;
+
+static inline uint32 Read32 (const uint8 * p)
+{
+	uint32 value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32 HashSequence (uint32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - kHashLog);
+}
+
+static uint8 * WriteLength (uint8 * op, int32 length)
+{
+	while (length >= 255)
+	{
+		*op++ = 255;
+		length -= 255;
+	}
+	*op++ = static_cast<uint8>(length);
+	return op;
+}
+
+static uint8 * WriteSequence (uint8 * op,
+							  const uint8 * literals,
+							  int32 literalLength,
+							  int32 offset,
+							  int32 matchLength)
+{
+	uint8 * token = op++;
+
+	*token = static_cast<uint8>((literalLength < 15 ? literalLength : 15) << 4);
+	if (literalLength >= 15)
+		op = WriteLength(op, literalLength - 15);
+
+	memcpy(op, literals, literalLength);
+	op += literalLength;
+
+	if (offset == 0)
+		return op;
+
+	*op++ = static_cast<uint8>(offset & 0xff);
+	*op++ = static_cast<uint8>(offset >> 8);
+
+	matchLength -= kMinMatch;
+	*token |= static_cast<uint8>(matchLength < 15 ? matchLength : 15);
+	if (matchLength >= 15)
+		op = WriteLength(op, matchLength - 15);
+
+	return op;
+}
+
+int32 LZ4CompressBound (int32 sourceSize)
+{
+	return sourceSize + sourceSize / 255 + 16;
+}
+
+int32 LZ4CompressBlock (const uint8 * source, int32 sourceSize,
+						uint8 * destination, int32 destinationSize)
+{
+	if (sourceSize < 0 || destinationSize < LZ4CompressBound(sourceSize))
+		return 0;
+
+	const uint8 * ip = source;
+	const uint8 * anchor = source;
+	const uint8 * end = source + sourceSize;
+	uint8 * op = destination;
+
+	if (sourceSize > kMatchFindLimit)
+	{
+		int32 table [1 << kHashLog];
+		for (int32 a = 0; a < (1 << kHashLog); a++)
+			table[a] = -1;
+
+		const uint8 * matchLimit = end - kLastLiterals;
+		const uint8 * searchLimit = end - kMatchFindLimit;
+
+		while (ip < searchLimit)
+		{
+			uint32 sequence = Read32(ip);
+			uint32 hash = HashSequence(sequence);
+			int32 reference = table[hash];
+			int32 here = static_cast<int32>(ip - source);
+			table[hash] = here;
+
+			if (reference < 0 || here - reference > kMaxOffset || Read32(source + reference) != sequence)
+			{
+				// skip faster through data that does not compress
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			const uint8 * match = source + reference;
+
+			while (ip > anchor && match > source && ip[-1] == match[-1])
+			{
+				ip--;
+				match--;
+			}
+
+			const uint8 * matchEnd = ip + kMinMatch;
+			const uint8 * reference2 = match + kMinMatch;
+			while (matchEnd < matchLimit && *matchEnd == *reference2)
+			{
+				matchEnd++;
+				reference2++;
+			}
+
+			op = WriteSequence(op,
+							   anchor,
+							   static_cast<int32>(ip - anchor),
+							   static_cast<int32>(ip - match),
+							   static_cast<int32>(matchEnd - ip));
+
+			ip = anchor = matchEnd;
+		}
+	}
+
+	op = WriteSequence(op, anchor, static_cast<int32>(end - anchor), 0, 0);
+
+	return static_cast<int32>(op - destination);
+}
+
+static bool ReadLength (const uint8 *& ip, const uint8 * end, size_t & length)
+{
+	uint8 more;
+	do
+	{
+		if (ip >= end)
+			return false;
+		more = *ip++;
+		length += more;
+	} while (more == 255);
+	return true;
+}
+
+bool LZ4DecompressBlock (const uint8 * source, int32 sourceSize,
+						 uint8 * destination, int32 destinationSize)
+{
+	const uint8 * ip = source;
+	const uint8 * end = source + sourceSize;
+	uint8 * op = destination;
+	uint8 * outEnd = destination + destinationSize;
+
+	while (ip < end)
+	{
+		uint8 token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(ip, end, literalLength))
+			return false;
+
+		if (static_cast<size_t>(end - ip) < literalLength ||
+			static_cast<size_t>(outEnd - op) < literalLength)
+			return false;
+
+		memcpy(op, ip, literalLength);
+		op += literalLength;
+		ip += literalLength;
+
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return false;
+
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if (offset == 0 || offset > static_cast<size_t>(op - destination))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(ip, end, matchLength))
+			return false;
+		matchLength += kMinMatch;
+
+		if (static_cast<size_t>(outEnd - op) < matchLength)
+			return false;
+
+		const uint8 * match = op - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else
+		{
+			// overlapping copy repeats the last offset bytes
+			while (matchLength--)
+				*op++ = *match++;
+		}
+	}
+
+	return op == outEnd;
+}
+
+//-------------------------------------------------------------------------------
+//	LayerBlockWriter
+//-------------------------------------------------------------------------------
+
+LayerBlockWriter::LayerBlockWriter (intptr_t inDataFork, int64 inPosition)
+	: dataFork(inDataFork),
+	  position(inPosition),
+	  error(noErr),
+	  rawBytes(0),
+	  storedBytes(0),
+	  blocksInFlight(0),
+	  stopping(false)
+{
+	unsigned threads = std::thread::hardware_concurrency();
+
+	// leave a core for the host, which keeps delivering the next layer
+	if (threads > 1)
+		threads--;
+	if (threads < 1)
+		threads = 1;
+
+	for (unsigned a = 0; a < threads; a++)
+		workers.push_back(std::thread(&LayerBlockWriter::Run, this));
+}
+
+LayerBlockWriter::~LayerBlockWriter ()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+
+	for (size_t a = 0; a < workers.size(); a++)
+		workers[a].join();
+}
+
+void LayerBlockWriter::Write (const void * buffer, int32 count)
+{
+	const uint8 * bytes = static_cast<const uint8 *>(buffer);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	items.push_back(Item());
+	items.back().kind = kItemBytes;
+	items.back().ready = true;
+	items.back().data.assign(bytes, bytes + count);
+}
+
+void LayerBlockWriter::Compress (std::vector<uint8> & rows)
+{
+	// Keep the memory bounded; the host waits here when it gets too far ahead
+	while (blocksInFlight >= kLayerBlocksInFlight && error == noErr)
+	{
+		size_t before = blocksInFlight;
+		Flush(false);
+		if (blocksInFlight == before)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobDone.wait(lock, [this] { return items.front().ready; });
+		}
+	}
+
+	rawBytes += rows.size();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	items.push_back(Item());
+	Item & item = items.back();
+	item.kind = kItemBlock;
+	item.ready = false;
+	item.data.swap(rows);
+	jobs.push_back(&item);
+	blocksInFlight++;
+	jobAdded.notify_one();
+}
+
+void LayerBlockWriter::Mark (const MarkProc & proc)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	items.push_back(Item());
+	items.back().kind = kItemMark;
+	items.back().ready = true;
+	items.back().mark = proc;
+}
+
+OSErr LayerBlockWriter::Flush (bool wait)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (!items.empty())
+	{
+		if (!items.front().ready)
+		{
+			if (!wait)
+				break;
+			jobDone.wait(lock, [this] { return items.front().ready; });
+		}
+
+		Item item;
+		item.kind = items.front().kind;
+		item.data.swap(items.front().data);
+		item.mark.swap(items.front().mark);
+		items.pop_front();
+		if (item.kind == kItemBlock)
+			blocksInFlight--;
+
+		// The file and the marks belong to the host thread, which is us
+		lock.unlock();
+
+		if (item.kind == kItemMark)
+		{
+			item.mark(position);
+		}
+		else if (error == noErr && !item.data.empty())
+		{
+			int32 count = static_cast<int32>(item.data.size());
+			error = PSSDKWrite(dataFork, &count, &item.data[0]);
+			if (error == noErr && count != static_cast<int32>(item.data.size()))
+				error = dskFulErr;
+			position += item.data.size();
+			if (item.kind == kItemBlock)
+				storedBytes += item.data.size();
+		}
+
+		lock.lock();
+	}
+
+	return error;
+}
+
+OSErr LayerBlockWriter::Rewind (int64 inPosition)
+{
+	if (error == noErr)
+		error = PSSDKSetFPos64(dataFork, fsFromStart, inPosition);
+
+	position = inPosition;
+
+	return error;
+}
+
+void LayerBlockWriter::Run (void)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for (;;)
+	{
+		jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+		if (stopping)
+			return;
+
+		Item * item = jobs.front();
+		jobs.pop_front();
+
+		lock.unlock();
+		Encode(*item);
+		lock.lock();
+
+		item->ready = true;
+		jobDone.notify_all();
+	}
+}
+
+// Replaces the rows in item.data with a LayerBlockHeader and the
+// compressed rows, or the rows as they are if they do not compress.
+void LayerBlockWriter::Encode (Item & item)
+{
+	LayerBlockHeader header;
+	header.rawSize = static_cast<uint32>(item.data.size());
+
+	std::vector<uint8> encoded (sizeof(header) + LZ4CompressBound(header.rawSize));
+
+	int32 compressedSize = LZ4CompressBlock(item.data.empty() ? NULL : &item.data[0],
+											header.rawSize,
+											&encoded[sizeof(header)],
+											static_cast<int32>(encoded.size() - sizeof(header)));
+
+	if (compressedSize > 0 && static_cast<uint32>(compressedSize) < header.rawSize)
+	{
+		header.storedSize = compressedSize;
+		encoded.resize(sizeof(header) + compressedSize);
+	}
+	else
+	{
+		header.storedSize = header.rawSize;
+		encoded.resize(sizeof(header) + header.rawSize);
+		if (header.rawSize)
+			memcpy(&encoded[sizeof(header)], &item.data[0], header.rawSize);
+	}
+
+	memcpy(&encoded[0], &header, sizeof(header));
+	item.data.swap(encoded);
+}
+
+// end LayerCompression.cpp
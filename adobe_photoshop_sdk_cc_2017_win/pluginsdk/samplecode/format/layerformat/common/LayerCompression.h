@@ -0,0 +1,151 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		LayerCompression.h
+//
+//	Description:
+//		This file contains the compressed layer encoding for the
+//		File Format module LayerFormat.  Layer pixels are cut into
+//		blocks of whole rows, each block is compressed with an LZ4
+//		compatible block coder on a pool of worker threads, and the
+//		results go to the file in order on the host thread.
+//
+//-------------------------------------------------------------------------------
+
+#ifndef __LayerCompression_H__		// Has this not been defined yet?
+#define __LayerCompression_H__		// Only include this once by predefining it
+
+#include "PIDefines.h"
+#include "PITypes.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------------------
+//	Definitions -- Constants
+//-------------------------------------------------------------------------------
+
+// LayerDirectoryRecord::compression
+const uint32 LAYERCOMPRESSION_NONE = 0;
+const uint32 LAYERCOMPRESSION_LZ4 = 1;
+
+// Rows are gathered into blocks of about this many bytes
+const int32 kLayerBlockBytes = 256 * 1024;
+
+// Blocks that may be waiting for a worker or for the file at once
+const size_t kLayerBlocksInFlight = 32;
+
+//-------------------------------------------------------------------------------
+//	Structure -- LayerBlockHeader
+//
+//	Every block of a compressed layer starts with one of these.  When
+//	storedSize equals rawSize the block did not compress and is stored as is.
+//-------------------------------------------------------------------------------
+
+typedef struct LayerBlockHeader
+{
+	uint32 rawSize;
+	uint32 storedSize;
+} LayerBlockHeader;
+
+//-------------------------------------------------------------------------------
+//	Prototypes -- block coder
+//-------------------------------------------------------------------------------
+
+// Worst case size of a compressed block.
+int32 LZ4CompressBound (int32 sourceSize);
+
+// Returns the compressed size, or 0 if it would not fit in destination.
+int32 LZ4CompressBlock (const uint8 * source, int32 sourceSize,
+						uint8 * destination, int32 destinationSize);
+
+// Returns false unless the data decodes to exactly destinationSize bytes.
+bool LZ4DecompressBlock (const uint8 * source, int32 sourceSize,
+						 uint8 * destination, int32 destinationSize);
+
+//-------------------------------------------------------------------------------
+//	LayerBlockWriter
+//
+//	Ordered output stream for the layer data.  Everything that goes into the
+//	file while the writer is running goes through it, in file order: plain
+//	bytes, blocks to compress, and marks that report the file offset they
+//	end up at.  Blocks are compressed on the worker threads; Flush writes
+//	whatever is finished at the front of the stream and is only ever called
+//	on the host thread, so marks may touch plug-in globals.
+//-------------------------------------------------------------------------------
+
+class LayerBlockWriter
+{
+public:
+	typedef std::function<void (int64 position)> MarkProc;
+
+	LayerBlockWriter (intptr_t dataFork, int64 position);
+	~LayerBlockWriter ();
+
+	void Write (const void * buffer, int32 count);
+	void Compress (std::vector<uint8> & rows);	// takes the contents of rows
+	void Mark (const MarkProc & proc);
+
+	// Writes out finished items; with wait set, everything.  Returns the
+	// first error hit writing or compressing.
+	OSErr Flush (bool wait);
+
+	// After a Flush (true), moves the stream back to an earlier offset.
+	OSErr Rewind (int64 position);
+
+	int64 Position (void) const { return position; }
+
+	// Bytes given to Compress, and bytes written for them so far
+	int64 RawBytes (void) const { return rawBytes; }
+	int64 StoredBytes (void) const { return storedBytes; }
+
+private:
+	enum ItemKind { kItemBytes, kItemBlock, kItemMark };
+
+	typedef struct Item
+	{
+		ItemKind kind;
+		bool ready;
+		std::vector<uint8> data;
+		MarkProc mark;
+	} Item;
+
+	void Run (void);
+	static void Encode (Item & item);
+
+	intptr_t dataFork;
+	int64 position;
+	OSErr error;
+	int64 rawBytes;
+	int64 storedBytes;
+
+	std::deque<Item> items;			// file order, owned by the host thread
+	std::deque<Item *> jobs;		// blocks waiting for a worker
+	size_t blocksInFlight;
+	bool stopping;
+
+	std::mutex mutex;
+	std::condition_variable jobAdded;
+	std::condition_variable jobDone;
+	std::vector<std::thread> workers;
+
+	LayerBlockWriter (const LayerBlockWriter &);
+	LayerBlockWriter & operator= (const LayerBlockWriter &);
+};
+
+//-------------------------------------------------------------------------------
+
+#endif // __LayerCompression_H__
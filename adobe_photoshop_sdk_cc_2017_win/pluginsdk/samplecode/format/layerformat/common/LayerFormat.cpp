@@ -35,8 +35,11 @@
 #include <vector>
 #include <sstream>
 #include <time.h>
+#include <math.h>
 #include "LayerFormat.h"
+#include "LayerCompression.h"
 #include "PIUI.h"
+#include "PIUStringID.h"
 
 using namespace std;
 //-------------------------------------------------------------------------------
@@ -71,6 +74,7 @@ static void AddComment (void);
 const int32 HEADER_CANT_READ = 0;
 const int32 HEADER_VER1 = 1;
 const int32 HEADER_VER2 = 2;
+const int32 HEADER_VER3 = 3;
 
 // let's use the TIFF spec. to do cross platform files
 const int16 BIGENDIAN = 0x4d4d;
@@ -80,11 +84,13 @@ const int16 TESTENDIAN = 0x002a;
 const int32 DESIREDMATTING = 0;
 
 static int CheckIdentifier (char identifier []);
-static void SetIdentifier (char identifier []);
+static void SetIdentifier (char identifier [], bool needsDirectory);
 static int32 RowBytes (void);
 
 static void ReadSome (int32 count, void * buffer);
 static void WriteSome (int32 count, void * buffer);
+static void GetPosition (int64 & position);
+static void SetPosition (int64 position);
 static void ReadRow (Ptr pixelData, bool needsSwap);
 static void WriteRow (Ptr pixelData);
 static void DisposeImageResources (void);
@@ -93,6 +99,44 @@ static void SwapRow(int32 rowBytes, Ptr pixelData);
 static void DoReadICCProfile(void);
 static void DoWriteICCProfile(void);
 
+static void BeginDirectoryEntry(void);
+static void NoteLayerOffset(int64 LayerDirectoryRecord::* field);
+static void EndDirectoryEntry(void);
+static void HashRow(Ptr pixelData);
+static void WriteLayerDirectory(void);
+static void ReadLayerDirectory(void);
+static bool LoadLayerDirectory(bool needsSwap,
+							   int64 dataStart,
+							   vector<LayerDirectoryEntry> & entries,
+							   int64 & directoryOffset,
+							   int64 & profileOffset);
+static const LayerDirectoryEntry * FindDirectoryEntry(int32 layer);
+static void CopyLayerName(const vector<uint16> & name);
+
+static void WriteHeader(void);
+static void TruncateAtPosition(void);
+static bool BeginIncrementalSave(void);
+static int32 FindPreviousLayer(const LayerDirectoryEntry & entry, bool matchContent);
+static bool ReusePreviousLayer(LayerDirectoryEntry & entry, bool matchContent);
+static void FinishIncrementalSave(void);
+static void AbandonIncrementalSave(void);
+
+static void BeginLayerWriter(void);
+static void EndLayerWriter(bool flush);
+static void WriteLayerBytes(int32 count, void * buffer);
+static void WriteLayerRow(Ptr pixelData);
+static void FinishLayerBlocks(void);
+static void StartLayerRows(const LayerDirectoryEntry * entry);
+static void ReadLayerRow(const LayerDirectoryEntry * entry, Ptr pixelData);
+
+static uint32 EstimateKey(int16 planes, int32 numLayers);
+static bool FindEstimate(uint32 key, LayerEstimate & estimate);
+static void RememberEstimate(const LayerEstimate & estimate);
+static int32 SampleRowsPerBlock(void);
+static bool SampleCompression(LayerEstimate & estimate);
+static void SetDataBytes(const LayerEstimate * estimate);
+static int32 ClampDataBytes(double bytes);
+
 static void InitData(void);
 static void CreateDataHandle(void);
 static void LockHandles(void);
@@ -119,16 +163,10 @@ inline Result GetBigEndian(uint8 *& source)
 
 static void CreateResourceInfoVector(int32 length, 
 									 uint8 * resources, 
-									 vector<ResourceInfo *> & rInfos);
-static void DeleteResourceInfoVector(vector<ResourceInfo *> & rInfos);
+									 vector<ResourceInfo> & rInfos);
 static int32 RemoveResources(int32 resourceLength, 
-							 const vector<ResourceInfo *> & rInfos, 
+							 const vector<ResourceInfo> & rInfos, 
 							 uint8 * resourcePtr);
-static int32 RemoveResource(uint32 type, 
-							uint16 id, 
-							uint8 * imageResource, 
-							int32 size, 
-							uint8 * dest);
 //-------------------------------------------------------------------------------
 //	Globals -- Define global variables for plug-in scope.
 //-------------------------------------------------------------------------------
@@ -143,6 +181,36 @@ int16 * gResult = NULL;
 FileHeader gHeader;
 uint16  gLayerName[256];
 
+// Key of the layer's modification time in its metadata
+PIU_DECLARE_STRING_ID(gLayerTimeID, "layerTime");
+
+// Layer directory of the file being written or read.  gHasDirectory is
+// false for files written before the directory was added.
+vector<LayerDirectoryEntry> gLayerDirectory;
+bool gHasDirectory = false;
+int64 gDirectoryOffset = 0;
+int64 gProfileOffset = 0;
+
+// Incremental save state.  gPreviousDirectory is the directory of the file
+// being saved over, gPreviousEOF is where it ended.  gSkipLayerData is set
+// while the host walks a layer whose pixels are already in the file.
+bool gIncremental = false;
+vector<LayerDirectoryEntry> gPreviousDirectory;
+vector<bool> gPreviousUsed;
+int64 gPreviousEOF = 0;
+bool gSkipLayerData = false;
+
+// Compressed layer state.  gLayerWriter only exists during a save with
+// compression turned on; gLayerBlock gathers rows for the next block.
+// gReadBlock holds the rows of the block being read.
+LayerBlockWriter * gLayerWriter = NULL;
+vector<uint8> gLayerBlock;
+vector<uint8> gReadBlock;
+size_t gReadBlockUsed = 0;
+
+// Ratios of the documents estimated or saved lately, the latest last
+vector<LayerEstimate> gEstimates;
+
 #define gCountResources gFormatRecord->resourceProcs->countProc
 #define gGetResources   gFormatRecord->resourceProcs->getProc
 #define gAddResource	gFormatRecord->resourceProcs->addProc
@@ -340,6 +408,13 @@ DLLExport MACPASCAL void PluginMain (const int16 selector,
 				DoWriteLayerFinish();
 				break;
 		}
+		
+		// Put the file back the way it was if an incremental save failed
+		if (*gResult != noErr)
+		{
+			EndLayerWriter(false);
+			AbandonIncrementalSave();
+		}
 			
 		//-----------------------------------------------------------------------
 		//	(5) Unlock data, and exit resource.
@@ -390,6 +465,7 @@ DLLExport MACPASCAL void PluginMain (const int16 selector,
 static void InitData (void)
 {	
 	gData->needsSwap = false;
+	gData->compressLayers = false;
 } // end InitData
 
 
@@ -405,6 +481,8 @@ static void InitData (void)
 //		HEADER_CANT_READ		= I have no idea what this file is
 //		HEADER_VER1	= This is my old header, it has 16 bit rows and columns
 //		HEADER_VER2	= This is my NEW header, it has 32 bit rows and columns
+//		HEADER_VER3	= The VER2 header, but the layers can only be found
+//					  through the layer directory
 //
 //-------------------------------------------------------------------------------
 
@@ -427,6 +505,11 @@ static int CheckIdentifier (char identifier [])
 		identifier[2] == 'g')
 		return HEADER_VER2;
 
+	if (identifier[0] == 'd' && 
+		identifier[1] == 'i' && 
+		identifier[2] == 'r')
+		return HEADER_VER3;
+
 	return HEADER_CANT_READ;
 }
 
@@ -438,17 +521,19 @@ static int CheckIdentifier (char identifier [])
 //
 //  Inputs:
 //		array of characters representing the identifier
+//		needsDirectory, the layers are not all in order after the header
 //	Outputs:
-//		array of characters = "bigbrain"
+//		array of characters = "bigbrain", or "dirbrain" so readers that
+//		only know how to read the layers in order turn the file down
 //
 //-------------------------------------------------------------------------------
 
-static void SetIdentifier (char identifier [])
+static void SetIdentifier (char identifier [], bool needsDirectory)
 {
 	
-	identifier[0] = 'b';
+	identifier[0] = needsDirectory ? 'd' : 'b';
     identifier[1] = 'i';
-    identifier[2] = 'g';
+    identifier[2] = needsDirectory ? 'r' : 'g';
     identifier[3] = 'b';
     identifier[4] = 'r';
     identifier[5] = 'a';
@@ -457,6 +542,26 @@ static void SetIdentifier (char identifier [])
 	
 }
 
+//-------------------------------------------------------------------------------
+//
+//	CheckDirectoryIdentifier / SetDirectoryIdentifier
+//	
+//	The layer directory footer is tagged "layerdir".
+//
+//-------------------------------------------------------------------------------
+
+static const char kDirectoryIdentifier [8] = { 'l', 'a', 'y', 'e', 'r', 'd', 'i', 'r' };
+
+static bool CheckDirectoryIdentifier (const char identifier [])
+{
+	return memcmp(identifier, kDirectoryIdentifier, sizeof(kDirectoryIdentifier)) == 0;
+}
+
+static void SetDirectoryIdentifier (char identifier [])
+{
+	memcpy(identifier, kDirectoryIdentifier, sizeof(kDirectoryIdentifier));
+}
+
 /*****************************************************************************/
 
 static int32 RowBytes (void)
@@ -509,6 +614,32 @@ static void WriteSome (int32 count, void * buffer)
 
 /*****************************************************************************/
 
+static void GetPosition (int64 & position)
+{
+	
+	position = 0;
+	
+	if (*gResult != noErr)
+		return;
+	
+	*gResult = PSSDKGetFPos (gFormatRecord->dataFork, &position);
+	
+}
+
+/*****************************************************************************/
+
+static void SetPosition (int64 position)
+{
+	
+	if (*gResult != noErr)
+		return;
+	
+	*gResult = PSSDKSetFPos64 (gFormatRecord->dataFork, fsFromStart, position);
+	
+}
+
+/*****************************************************************************/
+
 static void ReadRow (Ptr pixelData, bool needsSwap)
 {
 	ReadSome (RowBytes(), pixelData);
@@ -596,7 +727,7 @@ static void DoReadStart (void)
 		gHeader.transparencyPlane = 0;
 		gHeader.resourceLength = headerVer1.resourceLength;
 	}
-	else if (headerID == HEADER_VER2)
+	else if (headerID == HEADER_VER2 || headerID == HEADER_VER3)
 	{
 		ReadSome(sizeof(HeaderVer2) - sizeof(gHeader.identifier), &gHeader.endian);
 		// determine machine endian-ness
@@ -658,6 +789,20 @@ static void DoReadStart (void)
 		
 	}
 	
+	/* Pick up the layer directory if the file has one.  The file position
+	   is left at the first layer either way. */
+	
+	ReadLayerDirectory ();
+	
+	/* Reading the layers in order would give the stale copies an
+	   incremental save left behind, or compressed blocks as pixels. */
+	
+	if (*gResult == noErr && headerID == HEADER_VER3 && !gHasDirectory)
+		*gResult = formatCannotRead;
+	
+	if (*gResult != noErr)
+		goto CleanUp;
+	
 	return;
 		
 	/* The following code does any clean-up work in the event of an error. */
@@ -699,18 +844,29 @@ static void DoReadContinue (void)
 	}
 	
 	uint32 layerNameLen;
-	ReadSome(sizeof(uint32), &layerNameLen);
+	const LayerDirectoryEntry * firstLayer = FindDirectoryEntry(0);
 	
-	if(layerNameLen)
+	if (firstLayer != NULL)
 	{
-		if (gData->needsSwap)
-			Swap(layerNameLen);
-		
-		ReadSome(layerNameLen*sizeof(uint16), gLayerName);
+		CopyLayerName(firstLayer->name);
+		SetPosition(firstLayer->record.dataOffset);
+		StartLayerRows(firstLayer);
+	}
+	else
+	{
+		ReadSome(sizeof(uint32), &layerNameLen);
 		
-		if (gData->needsSwap)
-			for(uint32 index=0;index<layerNameLen;index++)
-				Swap(gLayerName[index]);
+		if(layerNameLen)
+		{
+			if (gData->needsSwap)
+				Swap(layerNameLen);
+			
+			ReadSome(layerNameLen*sizeof(uint16), gLayerName);
+			
+			if (gData->needsSwap)
+				for(uint32 index=0;index<layerNameLen;index++)
+					Swap(gLayerName[index]);
+		}
 	}
 
 	/* Set up to start returning chunks of data. */
@@ -739,7 +895,7 @@ static void DoReadContinue (void)
 
 			SetFormatTheRect(theRect);
 			
-			ReadRow (pixelData, gData->needsSwap);
+			ReadLayerRow (firstLayer, pixelData);
 			
 			if (*gResult == noErr)
 				*gResult = gFormatRecord->advanceState();
@@ -750,8 +906,11 @@ static void DoReadContinue (void)
 		
 	}
 	
-	//Read through the rest of the layers and do nothing with it
-	for (int32 layer = 0; *gResult == noErr && layer < gHeader.numLayers-1; ++layer)
+	//With a directory we can jump straight past the rest of the layers,
+	//otherwise read through them and do nothing with it
+	if (gHasDirectory)
+		SetPosition(gProfileOffset);
+	else for (int32 layer = 0; *gResult == noErr && layer < gHeader.numLayers-1; ++layer)
 	{
 		ReadSome(sizeof(uint32), &layerNameLen);
 	
@@ -777,8 +936,23 @@ static void DoReadContinue (void)
 static void DoReadFinish (void)
 {
 	
+	/* The profile follows the last layer.  Layers may have been read out of
+	   order through the directory, so go back there first.  No profile was
+	   written if the directory starts right where it would be. */
+	if (gHasDirectory)
+	{
+		if (gProfileOffset != gDirectoryOffset)
+		{
+			SetPosition (gProfileOffset);
+			DoReadICCProfile ();
+		}
+	}
+	else
+	{
+		DoReadICCProfile ();
+	}
+
 	/* Dispose of the image resource data if it exists. */
-	DoReadICCProfile ();
 	//DisposeImageResources ();
 	WriteScriptParamsOnRead (); // should be different for read/write
 	AddComment (); // write a history comment
@@ -823,25 +997,33 @@ static void DoEstimatePrepare (void)
 static void DoEstimateStart (void)
 {
 	
-	int32 dataBytes;
+	ReadScriptParamsOnEstimate ();
 	
-	VPoint imageSize = GetFormatImageSize();
-	
-	int32 numLayers=1;
-	if(gFormatRecord->layerData)
-		numLayers=gFormatRecord->layerData;
-		
-	dataBytes = sizeof (FileHeader) +
-				gFormatRecord->imageRsrcSize +
-				RowBytes () * gFormatRecord->planes * imageSize.v * numLayers;
-					  
-	if (gFormatRecord->imageMode == plugInModeIndexedColor)
-		dataBytes += 3 * sizeof (LookUpTable);
-		
-	gFormatRecord->minDataBytes = dataBytes;
-	gFormatRecord->maxDataBytes = dataBytes;
+	if (*gResult != noErr) return;
 	
 	gFormatRecord->data = NULL;
+	
+	SetDataBytes (NULL);
+	
+	// Compressed layers are only written when the host hands us layers
+	if (!gData->compressLayers || gFormatRecord->layerData <= 0)
+		return;
+	
+	LayerEstimate estimate;
+	uint32 key = EstimateKey(gFormatRecord->planes, gFormatRecord->layerData);
+	
+	if (FindEstimate(key, estimate))
+	{
+		SetDataBytes (&estimate);
+		return;
+	}
+	
+	/* Otherwise ask for EstimateContinue, where the host can hand us pixels
+	   to sample.  The buffer is the one the samples are read into. */
+	
+	uint32 bufferSize = SampleRowsPerBlock() * RowBytes();
+	if (bufferSize > 0)
+		gFormatRecord->data = sPSBuffer->New( &bufferSize, bufferSize );
 
 }
 
@@ -849,12 +1031,40 @@ static void DoEstimateStart (void)
 
 static void DoEstimateContinue (void)
 {
+	
+	Ptr pixelData = (Ptr)gFormatRecord->data;
+	
+	if (pixelData == NULL) return;
+	
+	LayerEstimate sampled;
+	if (SampleCompression(sampled))
+	{
+		sampled.key = EstimateKey(gFormatRecord->planes, gFormatRecord->layerData);
+		RememberEstimate(sampled);
+		SetDataBytes (&sampled);
+	}
+	
+	/* Done; a NULL data tells the host there is nothing more to ask for. */
+	
+	gFormatRecord->data = NULL;
+	
+	sPSBuffer->Dispose(&pixelData);
+
 }
 
 /*****************************************************************************/
 
 static void DoEstimateFinish (void)
 {
+	
+	Ptr pixelData = (Ptr)gFormatRecord->data;
+	
+	if (pixelData != NULL)
+	{
+		gFormatRecord->data = NULL;
+		sPSBuffer->Dispose(&pixelData);
+	}
+
 }
 
 /*****************************************************************************/
@@ -877,7 +1087,9 @@ static void DoWriteStart (void)
 	*gResult = PSSDKSetFPos (gFormatRecord->dataFork, fsFromStart, 0);
 	if (*gResult != noErr) return;
 	
-	SetIdentifier (gHeader.identifier);
+	/* Compressed layers can only be found through the directory. */
+	
+	SetIdentifier (gHeader.identifier, gData->compressLayers && gFormatRecord->layerData > 0);
 	VPoint imageSize = GetFormatImageSize();
 
 	uint32 tempLong = 0x11223344;
@@ -894,17 +1106,23 @@ static void DoWriteStart (void)
 	gHeader.numLayers=gFormatRecord->layerData;
 	
 	gHeader.resourceLength = 0;
-	WriteSome (sizeof (FileHeader), &gHeader);
 	
+	gLayerDirectory.clear();
+	
+	/* If we are saving over one of our own files only the layers that
+	   changed get written, and the header is written last. */
+	
+	gIncremental = BeginIncrementalSave ();
 	if (*gResult != noErr) return;
 	
-	/* Write the lookup tables if appropriate. */
+	/* Write the header and the lookup tables if appropriate. */
 	
-	if (gHeader.mode == plugInModeIndexedColor)
-	{
-		WriteSome (3 * sizeof (LookUpTable), &gFormatRecord->redLUT);
-		if (*gResult != noErr) return;
-	}
+	if (!gIncremental)
+		WriteHeader ();
+	
+	/* Layers are compressed on worker threads from here on. */
+	
+	BeginLayerWriter ();
 }
 
 /*****************************************************************************/
@@ -928,8 +1146,11 @@ static void DoWriteContinue (void)
 	}
 	
 	//Write out a layer name length of 0
+	BeginDirectoryEntry();
+	NoteLayerOffset(&LayerDirectoryRecord::recordOffset);
 	uint32 layerNameLength=0;
 	WriteSome (sizeof (uint32), &layerNameLength);
+	GetPosition (gLayerDirectory.back().record.dataOffset);
 
 	/* Set up to start receiving chunks of data. */
 	gFormatRecord->colBytes = (gFormatRecord->depth + 7) >> 3;
@@ -964,7 +1185,10 @@ static void DoWriteContinue (void)
 				*gResult = gFormatRecord->advanceState ();
 				
 			if (*gResult == noErr)
+			{
 				WriteRow (pixelData);
+				HashRow (pixelData);
+			}
 			
 			gFormatRecord->progressProc (++done, total);
 			
@@ -972,6 +1196,8 @@ static void DoWriteContinue (void)
 		
 	}
 	
+	EndDirectoryEntry();
+	
 	gFormatRecord->data = NULL;
 	
 	sPSBuffer->Dispose(&pixelData);
@@ -981,7 +1207,12 @@ static void DoWriteContinue (void)
 
 static void DoWriteFinish (void)
 {
+	EndLayerWriter (true);
+	GetPosition (gProfileOffset);
 	DoWriteICCProfile ();
+	WriteLayerDirectory ();
+	TruncateAtPosition ();
+	FinishIncrementalSave ();
 	WriteScriptParamsOnWrite (); // should be different for read/write
 }
 
@@ -1090,287 +1321,1111 @@ static void DoWriteICCProfile(void)
 	}
 }
 
-static VPoint GetFormatImageSize(void)
+/**************************************************************************/
+// Layer directory
+//
+// Every layer record is noted while it is written: where it starts, where
+// its pixels start and how long they are, its name and modification time,
+// and a 64 bit FNV-1a hash of the pixels.  DoWriteFinish writes the lot
+// after the ICC profile followed by a fixed size footer, so a reader can
+// go straight to any layer instead of reading through the ones in front.
+
+const uint64 kFNVOffsetBasis = 14695981039346656037ULL;
+const uint64 kFNVPrime = 1099511628211ULL;
+
+// Largest name we will accept from a directory, guards against bad files
+const uint32 kMaxDirectoryNameLength = 0x10000;
+
+static void BeginDirectoryEntry(void)
 {
-	VPoint returnPoint = { 0, 0};
-	if (gFormatRecord->HostSupports32BitCoordinates && gFormatRecord->PluginUsing32BitCoordinates)
-	{
-		returnPoint.v = gFormatRecord->imageSize32.v;
-		returnPoint.h = gFormatRecord->imageSize32.h;
-	}
-	else
-	{
-		returnPoint.v = gFormatRecord->imageSize.v;
-		returnPoint.h = gFormatRecord->imageSize.h;
-	}
-	return returnPoint;
+	LayerDirectoryEntry entry;
+	memset(&entry.record, 0, sizeof(entry.record));
+	
+	VPoint imageSize = GetFormatImageSize();
+	entry.record.bottom = imageSize.v;
+	entry.record.right = imageSize.h;
+	entry.record.contentHash = kFNVOffsetBasis;
+	entry.record.compression = gLayerWriter ? LAYERCOMPRESSION_LZ4 : LAYERCOMPRESSION_NONE;
+	
+	gLayerDirectory.push_back(entry);
 }
 
-static void SetFormatImageSize(VPoint inPoint)
+// Sets a field of the current entry to the file position.  With the layer
+// writer running the data may not be in the file yet, so the writer fills
+// it in when it gets there.
+static void NoteLayerOffset(int64 LayerDirectoryRecord::* field)
 {
-	if (gFormatRecord->HostSupports32BitCoordinates && 
-		gFormatRecord->PluginUsing32BitCoordinates)
+	size_t index = gLayerDirectory.size() - 1;
+	
+	if (gLayerWriter == NULL)
 	{
-		gFormatRecord->imageSize32.v = inPoint.v;
-		gFormatRecord->imageSize32.h = inPoint.h;
+		GetPosition(gLayerDirectory[index].record.*field);
+		return;
 	}
-	else
+	
+	gLayerWriter->Mark([index, field](int64 position)
 	{
-		gFormatRecord->imageSize.v = static_cast<int16>(inPoint.v);
-		gFormatRecord->imageSize.h = static_cast<int16>(inPoint.h);
-	}
+		gLayerDirectory[index].record.*field = position;
+	});
 }
-static void SetFormatTheRect(VRect inRect)
+
+static void EndDirectoryEntry(void)
 {
-	if (gFormatRecord->HostSupports32BitCoordinates && 
-		gFormatRecord->PluginUsing32BitCoordinates)
+	if (gLayerDirectory.empty())
+		return;
+	
+	NoteLayerOffset(&LayerDirectoryRecord::dataSize);
+	
+	if (gLayerWriter == NULL)
 	{
-		gFormatRecord->theRect32.top = inRect.top;
-		gFormatRecord->theRect32.left = inRect.left;
-		gFormatRecord->theRect32.bottom = inRect.bottom;
-		gFormatRecord->theRect32.right = inRect.right;
+		LayerDirectoryRecord & record = gLayerDirectory.back().record;
+		record.dataSize -= record.dataOffset;
+		return;
 	}
-	else
+	
+	size_t index = gLayerDirectory.size() - 1;
+	gLayerWriter->Mark([index](int64)
 	{
-		gFormatRecord->theRect.top = static_cast<int16>(inRect.top);
-		gFormatRecord->theRect.left = static_cast<int16>(inRect.left);
-		gFormatRecord->theRect.bottom = static_cast<int16>(inRect.bottom);
-		gFormatRecord->theRect.right = static_cast<int16>(inRect.right);
-	}
+		LayerDirectoryRecord & record = gLayerDirectory[index].record;
+		record.dataSize -= record.dataOffset;
+	});
 }
 
-//-------------------------------------------------------------------------------
-//
-// CreateDataHandle
-//
-// Create a handle to our Data structure. Photoshop will take ownership of this
-// handle and delete it when necessary.
-//-------------------------------------------------------------------------------
-static void CreateDataHandle(void)
+static void HashRow(Ptr pixelData)
 {
-	Handle h = sPSHandle->New(sizeof(Data));
-	if (h != NULL)
-		*gDataHandle = reinterpret_cast<intptr_t>(h);
-	else
-		*gResult = memFullErr;
+	if (gLayerDirectory.empty())
+		return;
+	
+	uint64 hash = gLayerDirectory.back().record.contentHash;
+	const uint8 * bytes = reinterpret_cast<const uint8 *>(pixelData);
+	
+	for (int32 a = 0, count = RowBytes(); a < count; a++)
+	{
+		hash ^= bytes[a];
+		hash *= kFNVPrime;
+	}
+	
+	gLayerDirectory.back().record.contentHash = hash;
 }
 
-//-------------------------------------------------------------------------------
-//
-// LockHandles
-//
-// Lock the handles and get the pointers for gData and gParams
-// Set the global error, *gResult, if there is trouble
-//
-//-------------------------------------------------------------------------------
-static void LockHandles(void)
+static void WriteLayerDirectory(void)
 {
-	if (*gDataHandle == 0)
-	{
-		*gResult = formatBadParameters;
+	if (*gResult != noErr)
 		return;
-	}
 	
-	sPSHandle->SetLock(reinterpret_cast<Handle>(*gDataHandle), true, 
-		               reinterpret_cast<Ptr *>(&gData), NULL);
+	LayerDirectoryFooter footer;
+	SetDirectoryIdentifier(footer.identifier);
+	footer.endian = gHeader.endian;
+	footer.version = LAYERDIRECTORY_VERSION;
+	footer.numLayers = static_cast<int32>(gLayerDirectory.size());
+	footer.profileOffset = gProfileOffset;
+	GetPosition(footer.directoryOffset);
 	
-	if (gData == NULL)
+	for (size_t a = 0; *gResult == noErr && a < gLayerDirectory.size(); a++)
 	{
-		*gResult = memFullErr;
-		return;
+		LayerDirectoryEntry & entry = gLayerDirectory[a];
+		entry.record.nameLength = static_cast<uint32>(entry.name.size());
+		WriteSome(sizeof(LayerDirectoryRecord), &entry.record);
+		if (entry.record.nameLength)
+			WriteSome(entry.record.nameLength * sizeof(uint16), &entry.name[0]);
 	}
+	
+	WriteSome(sizeof(LayerDirectoryFooter), &footer);
+	
+	gLayerDirectory.clear();
 }
 
-//-------------------------------------------------------------------------------
-//
-// UnlockHandles
-//
-// Unlock the handles used by the data and params pointers
-//
-//-------------------------------------------------------------------------------
-static void UnlockHandles(void)
+// The directory is optional, so nothing in here touches *gResult other than
+// failing to get back to where we started.  Anything that does not look
+// right simply leaves gHasDirectory false and the file is read the old way.
+static void ReadLayerDirectory(void)
 {
-	if (*gDataHandle != 0)
-		sPSHandle->SetLock(reinterpret_cast<Handle>(*gDataHandle), false, 
-		                   reinterpret_cast<Ptr *>(&gData), FALSE);
+	gLayerDirectory.clear();
+	gHasDirectory = false;
+	
+	if (*gResult != noErr)
+		return;
+	
+	int64 resume = 0;
+	if (PSSDKGetFPos(gFormatRecord->dataFork, &resume) != noErr)
+		return;
+	
+	gHasDirectory = LoadLayerDirectory(gData->needsSwap,
+									   resume,
+									   gLayerDirectory,
+									   gDirectoryOffset,
+									   gProfileOffset);
+	
+	*gResult = PSSDKSetFPos64(gFormatRecord->dataFork, fsFromStart, resume);
 }
 
-static void CreateResourceInfoVector(int32 length, 
-									 uint8 * resources, 
-									 vector<ResourceInfo *> & rInfos)
+// Reads and checks the footer and directory at the end of the file.  Every
+// offset has to land between dataStart, the end of the header and lookup
+// tables, and the footer.  Leaves the file position anywhere.
+static bool LoadLayerDirectory(bool needsSwap,
+							   int64 dataStart,
+							   vector<LayerDirectoryEntry> & entries,
+							   int64 & directoryOffset,
+							   int64 & profileOffset)
 {
-	rInfos.clear();
-
-	int32 calculatedLength = 0;
-
-	uint8 * resourcesEnd = resources + length;
-
-	while (resources < resourcesEnd)
+	entries.clear();
+	
+	intptr_t dataFork = gFormatRecord->dataFork;
+	int64 fileSize = 0;
+	
+	if (PSSDKGetEOF(dataFork, &fileSize) != noErr ||
+		fileSize < dataStart + (int64)sizeof(LayerDirectoryFooter))
+		return false;
+	
+	LayerDirectoryFooter footer;
+	int32 count = sizeof(footer);
+	OSErr err = PSSDKSetFPos64(dataFork, fsFromStart, fileSize - sizeof(footer));
+	if (err == noErr)
+		err = PSSDKRead(dataFork, &count, &footer);
+	
+	if (err != noErr || count != sizeof(footer) || !CheckDirectoryIdentifier(footer.identifier))
+		return false;
+	
+	if (needsSwap)
 	{
-		ResourceInfo * thisResource = new ResourceInfo;
-
-		thisResource->totalSize = 0;
-		
-		thisResource->type = GetBigEndian<uint32>(resources);
-		thisResource->totalSize += sizeof(thisResource->type);
+		Swap(footer.version);
+		Swap(footer.numLayers);
+		Swap(footer.directoryOffset);
+		Swap(footer.profileOffset);
+	}
+	
+	int64 directoryEnd = fileSize - sizeof(footer);
+	bool valid = footer.version >= 1 &&
+				 footer.version <= LAYERDIRECTORY_VERSION &&
+				 footer.numLayers >= 0 &&
+				 footer.directoryOffset >= dataStart &&
+				 footer.directoryOffset <= directoryEnd &&
+				 footer.profileOffset >= dataStart &&
+				 footer.profileOffset <= footer.directoryOffset;
+	
+	if (valid)
+		err = PSSDKSetFPos64(dataFork, fsFromStart, footer.directoryOffset);
+	
+	for (int32 layer = 0; valid && err == noErr && layer < footer.numLayers; layer++)
+	{
+		LayerDirectoryEntry entry;
+		count = sizeof(entry.record);
+		err = PSSDKRead(dataFork, &count, &entry.record);
+		if (err != noErr || count != sizeof(entry.record))
+		{
+			valid = false;
+			break;
+		}
 		
-		thisResource->id = GetBigEndian<uint16>(resources);
-		thisResource->totalSize += sizeof(thisResource->id);
-
-		uint8 nameLength = *resources++;
-		thisResource->totalSize++;
-
-		thisResource->name.reserve(nameLength);
-		ostringstream inputName;
-		for (int a = 0; a < nameLength; a++)
+		LayerDirectoryRecord & record = entry.record;
+		if (needsSwap)
 		{
-			inputName << *resources++;
-			thisResource->totalSize++;
+			Swap(record.recordOffset);
+			Swap(record.dataOffset);
+			Swap(record.dataSize);
+			Swap(record.top);
+			Swap(record.left);
+			Swap(record.bottom);
+			Swap(record.right);
+			Swap(record.modTime);
+			Swap(record.contentHash);
+			Swap(record.nameLength);
+			Swap(record.compression);
 		}
-		thisResource->name = inputName.str();
+		
+		// Layers saved incrementally can sit anywhere in front of the
+		// profile, including past an older directory.
+		if (record.nameLength > kMaxDirectoryNameLength ||
+			record.compression > LAYERCOMPRESSION_LZ4 ||
+			record.recordOffset < dataStart ||
+			record.dataOffset < record.recordOffset ||
+			record.dataSize < 0 ||
+			record.dataOffset + record.dataSize > footer.profileOffset)
+		{
+			valid = false;
+			break;
+		}
+		
+		if (record.nameLength)
+		{
+			entry.name.resize(record.nameLength);
+			count = record.nameLength * sizeof(uint16);
+			err = PSSDKRead(dataFork, &count, &entry.name[0]);
+			if (err != noErr || count != (int32)(record.nameLength * sizeof(uint16)))
+			{
+				valid = false;
+				break;
+			}
+			if (needsSwap)
+				for (size_t index = 0; index < entry.name.size(); index++)
+					Swap(entry.name[index]);
+		}
+		
+		entries.push_back(entry);
+	}
+	
+	if (!valid || err != noErr)
+	{
+		entries.clear();
+		return false;
+	}
+	
+	directoryOffset = footer.directoryOffset;
+	profileOffset = footer.profileOffset;
+	return true;
+}
 
-		resources += nameLength | uint8(1); // Add one if even for alignment;
-		thisResource->totalSize += nameLength | uint8(1);
+static const LayerDirectoryEntry * FindDirectoryEntry(int32 layer)
+{
+	if (!gHasDirectory || layer < 0 || layer >= (int32)gLayerDirectory.size())
+		return NULL;
+	
+	return &gLayerDirectory[layer];
+}
 
-		thisResource->size = GetBigEndian<uint32>(resources);
-		thisResource->totalSize += sizeof(thisResource->size);
+static void CopyLayerName(const vector<uint16> & name)
+{
+	const size_t maxLength = sizeof(gLayerName) / sizeof(gLayerName[0]) - 1;
+	size_t length = name.size() < maxLength ? name.size() : maxLength;
+	
+	for (size_t index = 0; index < length; index++)
+		gLayerName[index] = name[index];
+	
+	gLayerName[length] = 0;
+}
 
-		resources += (thisResource->size + 1) & ~uint32(1); // Add one if odd for alignment;
-		thisResource->totalSize += (thisResource->size + 1) & ~uint32(1); // Add one if odd for alignment;
+/**************************************************************************/
+// Incremental save
+//
+// When the host hands us one of our own files to save over, and the image
+// geometry has not changed, the layers already in the file are kept where
+// they are.  New and changed layers are appended after the old footer,
+// followed by the profile, a new directory and a new footer.  A layer with
+// the same name and modification time as one in the old directory is not
+// even requested from the host; one that was written but hashes the same as
+// an old layer is dropped again.  The header goes in last, so until then
+// the old directory is still the one the file ends with, and on any error
+// the file is cut back to its old length.  It is tagged HEADER_VER3, as the
+// layers in file order are no longer the document's, so readers that do not
+// know about the directory turn it down rather than read stale pixels.
+//
+// Layers that are no longer referenced are left behind as dead space.  Once
+// that is more than LAYERDIRECTORY_COMPACT_RATIO of the file the next save
+// writes the whole file again from the top.
 
-		thisResource->keep = true;
-		
-		rInfos.push_back(thisResource);
-		
-		calculatedLength += thisResource->totalSize;
-	} 
+static void WriteHeader(void)
+{
+	WriteSome (sizeof (FileHeader), &gHeader);
+	
+	if (*gResult != noErr) return;
+	
+	if (gHeader.mode == plugInModeIndexedColor)
+		WriteSome (3 * sizeof (LookUpTable), &gFormatRecord->redLUT);
 }
 
-static void DeleteResourceInfoVector(vector<ResourceInfo *> & rInfos)
+// A full save over a larger file would leave the old footer at the end
+static void TruncateAtPosition(void)
 {
-	size_t count = rInfos.size();
-	for (size_t a = 0; a < count; a++)
+	int64 position = 0;
+	int64 fileSize = 0;
+	
+	GetPosition(position);
+	
+	if (*gResult == noErr && PSSDKGetEOF(gFormatRecord->dataFork, &fileSize) == noErr && fileSize > position)
+		*gResult = PSSDKSetEOF(gFormatRecord->dataFork, position);
+}
+
+static bool BeginIncrementalSave(void)
+{
+	gPreviousDirectory.clear();
+	gPreviousUsed.clear();
+	gSkipLayerData = false;
+	
+	if (*gResult != noErr || gHeader.numLayers <= 0)
+		return false;
+	
+	intptr_t dataFork = gFormatRecord->dataFork;
+	int64 fileSize = 0;
+	
+	if (PSSDKGetEOF(dataFork, &fileSize) != noErr || fileSize < (int64)sizeof(FileHeader))
+		return false;
+	
+	// Only our own native endian files with the same geometry qualify
+	FileHeader header;
+	int32 count = sizeof(header);
+	OSErr err = PSSDKRead(dataFork, &count, &header);
+	
+	if (err != noErr || count != sizeof(header) ||
+		CheckIdentifier(header.identifier) < HEADER_VER2 ||
+		header.endian != gHeader.endian ||
+		header.mode != gHeader.mode ||
+		header.depth != gHeader.depth ||
+		header.rows != gHeader.rows ||
+		header.cols != gHeader.cols ||
+		header.planes != gHeader.planes ||
+		header.transparencyPlane != gHeader.transparencyPlane ||
+		header.resourceLength != 0)
+	{
+		*gResult = PSSDKSetFPos64(dataFork, fsFromStart, 0);
+		return false;
+	}
+	
+	int64 dataStart = sizeof(FileHeader);
+	if (gHeader.mode == plugInModeIndexedColor)
+		dataStart += 3 * sizeof(LookUpTable);
+	
+	int64 directoryOffset = 0;
+	int64 profileOffset = 0;
+	bool loaded = LoadLayerDirectory(false,
+									 dataStart,
+									 gPreviousDirectory,
+									 directoryOffset,
+									 profileOffset);
+	
+	// Everything that is not a referenced layer, the header or the
+	// trailing profile and directory is dead space
+	int64 liveBytes = dataStart + (fileSize - profileOffset);
+	for (size_t a = 0; a < gPreviousDirectory.size(); a++)
 	{
-		ResourceInfo * thisResource = rInfos.at(a);
-		delete thisResource;
+		const LayerDirectoryRecord & record = gPreviousDirectory[a].record;
+		liveBytes += record.dataOffset - record.recordOffset + record.dataSize;
 	}
+	
+	if (!loaded || fileSize - liveBytes > fileSize * LAYERDIRECTORY_COMPACT_RATIO)
+	{
+		gPreviousDirectory.clear();
+		*gResult = PSSDKSetFPos64(dataFork, fsFromStart, 0);
+		return false;
+	}
+	
+	gPreviousUsed.assign(gPreviousDirectory.size(), false);
+	gPreviousEOF = fileSize;
+	
+	*gResult = PSSDKSetFPos64(dataFork, fsFromStart, fileSize);
+	
+	return *gResult == noErr;
 }
 
-static int32 RemoveResources(int32 resourceLength, 
-							 const vector<ResourceInfo *> & rInfos, 
-							 uint8 * resourcePtr)
+// Looks for an unclaimed layer in the old directory that can stand in for
+// entry.  Before the pixels are written only the name and modification time
+// can be compared; afterwards the content hash can.  The hash is taken over
+// the raw rows, so it does not matter how either copy is encoded.
+static int32 FindPreviousLayer(const LayerDirectoryEntry & entry, bool matchContent)
 {
-	size_t count = rInfos.size();
-
-	for (size_t a = 0; a < count; a++)
+	if (!matchContent && entry.record.modTime < 0)
+		return -1;
+	
+	for (size_t a = 0; a < gPreviousDirectory.size(); a++)
 	{
-		if (! rInfos.at(a)->keep)
+		const LayerDirectoryRecord & previous = gPreviousDirectory[a].record;
+		
+		if (gPreviousUsed[a])
+			continue;
+		
+		if (matchContent)
 		{
-			resourceLength = RemoveResource(rInfos.at(a)->type,
-				                            rInfos.at(a)->id,
-											resourcePtr,
-											resourceLength,
-											resourcePtr);
+			if (previous.contentHash != entry.record.contentHash ||
+				previous.bottom != entry.record.bottom ||
+				previous.right != entry.record.right)
+				continue;
+		}
+		else if (previous.modTime != entry.record.modTime ||
+				 gPreviousDirectory[a].name != entry.name)
+		{
+			continue;
 		}
-	}
 		
-	return resourceLength;
+		return static_cast<int32>(a);
+	}
+	
+	return -1;
+}
+
+// On a match the record offsets in entry are pointed at the old copy.
+static bool ReusePreviousLayer(LayerDirectoryEntry & entry, bool matchContent)
+{
+	int32 index = FindPreviousLayer(entry, matchContent);
+	if (index < 0)
+		return false;
+	
+	gPreviousUsed[index] = true;
+	
+	double modTime = entry.record.modTime;
+	entry.record = gPreviousDirectory[index].record;
+	entry.record.modTime = modTime;
+	return true;
 }
 
+static void FinishIncrementalSave(void)
+{
+	if (!gIncremental || *gResult != noErr)
+		return;
+	
+	SetIdentifier(gHeader.identifier, true);
+	SetPosition(0);
+	WriteHeader();
+	
+	if (*gResult != noErr)
+		return;
+	
+	gIncremental = false;
+	gPreviousDirectory.clear();
+	gPreviousUsed.clear();
+}
 
-static int32 RemoveResource(uint32 type,
-							uint16 id,
-							uint8 * imageResource,
-							int32 size,
-							uint8 * dest)
+static void AbandonIncrementalSave(void)
 {
-	/*
-	[first, last) is the source range. first will close on last as we
-	search for the resource.
-	*/
-	uint8 * first  = imageResource;
-	uint8 * last  = first + size;
+	if (!gIncremental)
+		return;
 	
-	/*
-	[resFirst, resLast) marks the range enclosing the found resource
-	if the resource has not been found then the range is empty but within
-	[first, last).
-	*/
+	PSSDKSetEOF(gFormatRecord->dataFork, gPreviousEOF);
 	
-	uint8 * resFirst  = first;
-	uint8 * resLast = first;
+	gIncremental = false;
+	gSkipLayerData = false;
+	gPreviousDirectory.clear();
+	gPreviousUsed.clear();
+}
+
+/**************************************************************************/
+// Compressed layers
+//
+// With compression turned on, the layer record, pixel blocks and directory
+// marks all go through gLayerWriter so they land in the file in order
+// while the blocks are compressed on its worker threads.  The host thread
+// only copies rows, so it can get on with the next layer while the last
+// one is still being compressed.  Layers are read back one block at a
+// time, see ReadLayerRow.  Only the directory says which layers are
+// compressed, so these files are tagged HEADER_VER3 like incremental ones
+// and are not read without it.
+
+static void BeginLayerWriter(void)
+{
+	if (*gResult != noErr || !gData->compressLayers || gHeader.numLayers <= 0)
+		return;
 	
-	// min bytes is the minimum number of bytes in the resource header.
+	int64 position = 0;
+	GetPosition(position);
 	
-	const ptrdiff_t minBytes(sizeof(uint32) + sizeof(uint16) + sizeof(int8));
+	if (*gResult == noErr)
+		gLayerWriter = new LayerBlockWriter(gFormatRecord->dataFork, position);
+}
 
-	while ((last - first) >= minBytes) 
+static void EndLayerWriter(bool flush)
+{
+	if (gLayerWriter == NULL)
+		return;
+	
+	if (flush && *gResult == noErr)
+		*gResult = gLayerWriter->Flush(true);
+	
+	// What this save really got is the best estimate for the next one
+	if (flush && *gResult == noErr && gLayerWriter->RawBytes() > 0)
 	{
-		resFirst = first;
-		resLast = first;
+		LayerEstimate written;
+		written.key = EstimateKey(gHeader.planes, gHeader.numLayers);
+		written.ratio = static_cast<float>(double(gLayerWriter->StoredBytes()) / 
+										   double(gLayerWriter->RawBytes()));
+		written.low = written.ratio;
+		written.high = written.ratio;
+		RememberEstimate(written);
+	}
 	
-		// Read the type
-		uint32 readType = GetBigEndian<uint32>(first);
-		
-		// Read the id
-		uint16 readID (GetBigEndian<uint16>(first));
+	delete gLayerWriter;
+	gLayerWriter = NULL;
+	
+	gLayerBlock.clear();
+}
+
+static void WriteLayerBytes(int32 count, void * buffer)
+{
+	if (gLayerWriter == NULL)
+		WriteSome(count, buffer);
+	else if (*gResult == noErr)
+		gLayerWriter->Write(buffer, count);
+}
+
+static void WriteLayerRow(Ptr pixelData)
+{
+	if (gLayerWriter == NULL)
+	{
+		WriteRow(pixelData);
+		return;
+	}
+	
+	int32 rowBytes = RowBytes();
+	const uint8 * row = reinterpret_cast<const uint8 *>(pixelData);
+	gLayerBlock.insert(gLayerBlock.end(), row, row + rowBytes);
+	
+	if (gLayerBlock.size() + rowBytes > static_cast<size_t>(kLayerBlockBytes))
+	{
+		gLayerWriter->Compress(gLayerBlock);
+		gLayerBlock.clear();
+		*gResult = gLayerWriter->Flush(false);
+	}
+}
+
+static void FinishLayerBlocks(void)
+{
+	if (gLayerWriter == NULL || gLayerBlock.empty())
+		return;
+	
+	gLayerWriter->Compress(gLayerBlock);
+	gLayerBlock.clear();
+	
+	if (*gResult == noErr)
+		*gResult = gLayerWriter->Flush(false);
+}
+
+static void StartLayerRows(const LayerDirectoryEntry * /*entry*/)
+{
+	gReadBlock.clear();
+	gReadBlockUsed = 0;
+}
+
+// Reads the next row of the layer, decoding the next block as needed
+static void ReadLayerRow(const LayerDirectoryEntry * entry, Ptr pixelData)
+{
+	if (entry == NULL || entry->record.compression == LAYERCOMPRESSION_NONE)
+	{
+		ReadRow(pixelData, gData->needsSwap);
+		return;
+	}
+	
+	if (*gResult != noErr)
+		return;
+	
+	size_t rowBytes = RowBytes();
+	
+	if (gReadBlockUsed + rowBytes > gReadBlock.size())
+	{
+		LayerBlockHeader header;
+		ReadSome(sizeof(header), &header);
 		
-		// Skip the name
-		uint8 length = *first++;
-		first += length | uint8(1); // Add one if even for alignment;
+		if (gData->needsSwap)
+		{
+			Swap(header.rawSize);
+			Swap(header.storedSize);
+		}
 		
-		// Make sure we have enough space to read the blockSize
-		if ((last - first) < sizeof(uint32)) break;
+		if (*gResult == noErr &&
+			(header.rawSize == 0 ||
+			 header.rawSize % rowBytes != 0 ||
+			 header.rawSize > static_cast<uint32>(kLayerBlockBytes) + rowBytes ||
+			 header.storedSize > header.rawSize))
+			*gResult = formatCannotRead;
 		
-		// Read the block size
-		uint32 blockSize (GetBigEndian<uint32>(first));
+		if (*gResult != noErr)
+			return;
 		
-		// Skip the block
-		first += (blockSize + 1) & ~uint32(1); // Add one if odd for alignment;
+		gReadBlock.resize(header.rawSize);
+		gReadBlockUsed = 0;
 		
-		if ((readType == type) && (readID == id)) {
-			resLast = first;
-			break;
+		if (header.storedSize == header.rawSize)
+		{
+			ReadSome(header.rawSize, &gReadBlock[0]);
 		}
+		else
+		{
+			vector<uint8> stored (header.storedSize);
+			ReadSome(header.storedSize, &stored[0]);
+			if (*gResult == noErr &&
+				!LZ4DecompressBlock(&stored[0], header.storedSize, &gReadBlock[0], header.rawSize))
+				*gResult = formatCannotRead;
+		}
+		
+		if (*gResult != noErr)
+			return;
 	}
 	
-	/*
-	Handle the copy as two pieces. If the resource was found then this will omit it.
-	Otherwise it is simply copied as all but the last resoruce, and then the last resource.
-	*/
+	memcpy(pixelData, &gReadBlock[gReadBlockUsed], rowBytes);
+	gReadBlockUsed += rowBytes;
+	
+	if (gFormatRecord->depth == 16 && gData->needsSwap)
+		SwapRow(RowBytes(), pixelData);
+}
+
+//-------------------------------------------------------------------------------
+//
+// EstimateKey
+//
+// Identifies the size, depth, mode, planes and layer count of a document, so
+// a remembered ratio is not used once the document has changed shape.
+//
+//-------------------------------------------------------------------------------
+static uint32 EstimateKey(int16 planes, int32 numLayers)
+{
+	VPoint imageSize = GetFormatImageSize();
 	
-	uint8 * destEnd = NULL;
+	int32 values [] = { imageSize.h, 
+						imageSize.v, 
+						gFormatRecord->depth, 
+						gFormatRecord->imageMode, 
+						planes, 
+						numLayers };
+	
+	uint32 key = 2166136261U;
+	const uint8 * bytes = reinterpret_cast<const uint8 *>(values);
+	for (size_t a = 0; a < sizeof(values); a++)
+		key = (key ^ bytes[a]) * 16777619U;
+	
+	return key;
+}
 
-	if (resFirst == resLast)
+//-------------------------------------------------------------------------------
+//
+// FindEstimate / RememberEstimate
+//
+// The ratios live in the plug-in's globals rather than with the document,
+// whose revertInfo belongs to reading it back.  Only the latest
+// LAYERESTIMATE_REMEMBERED are kept; a ratio that is gone or not loaded
+// any more only costs the next estimate another sample.
+//
+//-------------------------------------------------------------------------------
+static bool FindEstimate(uint32 key, LayerEstimate & estimate)
+{
+	for (size_t a = gEstimates.size(); a > 0; a--)
 	{
-		if (dest != imageResource)
+		if (gEstimates[a - 1].key == key)
 		{
-			// nothing was found and I need to copy everything
-			destEnd = copy(imageResource, imageResource + size, dest);
+			estimate = gEstimates[a - 1];
+			return true;
 		}
-		else
+	}
+	
+	return false;
+}
+
+static void RememberEstimate(const LayerEstimate & estimate)
+{
+	for (size_t a = 0; a < gEstimates.size(); a++)
+	{
+		if (gEstimates[a].key == estimate.key)
 		{
-			// nothing was found and I don't need to copy anything
-			destEnd = imageResource + size;
+			gEstimates.erase(gEstimates.begin() + a);
+			break;
 		}
 	}
-	else
+	
+	if (gEstimates.size() >= LAYERESTIMATE_REMEMBERED)
+		gEstimates.erase(gEstimates.begin());
+	
+	gEstimates.push_back(estimate);
+}
+
+//-------------------------------------------------------------------------------
+//
+// SampleRowsPerBlock
+//
+// The rows of one plane that WriteLayerRow puts in a block.
+//
+//-------------------------------------------------------------------------------
+static int32 SampleRowsPerBlock(void)
+{
+	VPoint imageSize = GetFormatImageSize();
+	int32 rowBytes = RowBytes();
+	
+	if (imageSize.v <= 0 || rowBytes <= 0)
+		return 0;
+	
+	int32 rowsPerBlock = kLayerBlockBytes / rowBytes;
+	if (rowsPerBlock < 1)
+		rowsPerBlock = 1;
+	if (rowsPerBlock > imageSize.v)
+		rowsPerBlock = imageSize.v;
+	
+	return rowsPerBlock;
+}
+
+//-------------------------------------------------------------------------------
+//
+// SampleCompression
+//
+// Compresses one block from each of LAYERESTIMATE_SAMPLES equal strata of
+// the composite and returns the ratio of stored to raw bytes, with a 95%
+// interval from the spread of the samples.  A block is what WriteLayerRow
+// hands the writer: the rows of one plane that fit in kLayerBlockBytes.
+// The host only gives us the composite here, so this stands in for every
+// layer.  The blocks are read into the buffer DoEstimateStart left in
+// data.  Returns false if there is nothing to sample.
+//
+//-------------------------------------------------------------------------------
+static bool SampleCompression(LayerEstimate & estimate)
+{
+	VPoint imageSize = GetFormatImageSize();
+	int32 rowBytes = RowBytes();
+	int16 planes = gFormatRecord->planes;
+	int32 rowsPerBlock = SampleRowsPerBlock();
+	Ptr pixelData = (Ptr)gFormatRecord->data;
+	
+	if (rowsPerBlock <= 0 || planes <= 0 || pixelData == NULL)
+		return false;
+	
+	int64 blocksPerPlane = (imageSize.v + rowsPerBlock - 1) / rowsPerBlock;
+	int64 population = blocksPerPlane * planes;
+	int32 samples = population < LAYERESTIMATE_SAMPLES ? 
+					static_cast<int32>(population) : LAYERESTIMATE_SAMPLES;
+	
+	vector<uint8> compressed (LZ4CompressBound(rowsPerBlock * rowBytes));
+	vector<double> raw;
+	vector<double> stored;
+	
+	gFormatRecord->colBytes = (gFormatRecord->depth + 7) >> 3;
+	gFormatRecord->rowBytes = rowBytes;
+	gFormatRecord->planeBytes = 0;
+	gFormatRecord->transparencyMatting = DESIREDMATTING;
+	
+	VRect theRect;
+	
+	theRect.left = 0;
+	theRect.right = imageSize.h;
+	
+	for (int32 s = 0; *gResult == noErr && s < samples; s++)
 	{
-		if (dest != imageResource)
+		// one block from each stratum, at a fixed but irregular spot in it
+		int64 first = population * s / samples;
+		int64 count = population * (s + 1) / samples - first;
+		int64 block = first + (uint32(s + 1) * 2654435761U) % count;
+		
+		gFormatRecord->loPlane = gFormatRecord->hiPlane = static_cast<int16>(block / blocksPerPlane);
+		
+		theRect.top = static_cast<int32>(block % blocksPerPlane) * rowsPerBlock;
+		theRect.bottom = theRect.top + rowsPerBlock;
+		if (theRect.bottom > imageSize.v)
+			theRect.bottom = imageSize.v;
+		
+		SetFormatTheRect(theRect);
+		
+		*gResult = gFormatRecord->advanceState ();
+		
+		if (*gResult == noErr)
 		{
-			// something was found and I need to copy over the start
-			destEnd = copy(imageResource, resFirst, dest);
-			// skipping the resource that I found
-			destEnd = copy(resLast, last, destEnd);
+			int32 rawSize = (theRect.bottom - theRect.top) * rowBytes;
+			int32 storedSize = LZ4CompressBlock(reinterpret_cast<const uint8 *>(pixelData), 
+												rawSize, 
+												&compressed[0], 
+												static_cast<int32>(compressed.size()));
+			if (storedSize <= 0 || storedSize > rawSize)
+				storedSize = rawSize;
+			
+			raw.push_back(rawSize);
+			stored.push_back(storedSize + sizeof(LayerBlockHeader));
 		}
-		else
+	}
+	
+	if (*gResult != noErr || raw.empty())
+		return false;
+	
+	double n = static_cast<double>(raw.size());
+	double rawTotal = 0;
+	double storedTotal = 0;
+	
+	for (size_t a = 0; a < raw.size(); a++)
+	{
+		rawTotal += raw[a];
+		storedTotal += stored[a];
+	}
+	
+	double ratio = storedTotal / rawTotal;
+	double low = ratio;
+	double high = ratio;
+	
+	// Standard error of a ratio estimate, less as the sample nears the whole
+	if (n < population && n > 1)
+	{
+		double residuals = 0;
+		for (size_t a = 0; a < raw.size(); a++)
 		{
-			// skip over the resource only
-			destEnd = copy(resLast, last, resFirst); //destEnd);
+			double residual = stored[a] - ratio * raw[a];
+			residuals += residual * residual;
 		}
+		
+		double meanRaw = rawTotal / n;
+		double error = sqrt((1.0 - n / population) * residuals / (n - 1) / n) / meanRaw;
+		
+		low = ratio - LAYERESTIMATE_Z * error;
+		high = ratio + LAYERESTIMATE_Z * error;
 	}
+	
+	// LZ4 cannot do better than about 1:255, and a block that does not
+	// compress is stored as is behind its header
+	double best = 1.0 / 255.0;
+	double worst = 1.0 + double(sizeof(LayerBlockHeader)) / (rowsPerBlock * rowBytes);
+	
+	if (low < best) low = best;
+	if (high > worst) high = worst;
+	if (ratio < low) ratio = low;
+	if (ratio > high) ratio = high;
+	
+	estimate.ratio = static_cast<float>(ratio);
+	estimate.low = static_cast<float>(low);
+	estimate.high = static_cast<float>(high);
+	
+	return true;
+}
+
+// Sets minDataBytes and maxDataBytes for layers stored at the ratios of
+// estimate, or as they are without one
+static void SetDataBytes(const LayerEstimate * estimate)
+{
+	VPoint imageSize = GetFormatImageSize();
+	
+	int32 numLayers=1;
+	if(gFormatRecord->layerData)
+		numLayers=gFormatRecord->layerData;
+		
+	double fixedBytes = sizeof (FileHeader) +
+						gFormatRecord->imageRsrcSize;
+					  
+	if (gFormatRecord->imageMode == plugInModeIndexedColor)
+		fixedBytes += 3 * sizeof (LookUpTable);
+		
+	double layerBytes = double(RowBytes ()) * gFormatRecord->planes * imageSize.v * numLayers;
+	
+	double minBytes = fixedBytes + layerBytes;
+	double maxBytes = minBytes;
+	
+	if (estimate != NULL)
+	{
+		minBytes = fixedBytes + layerBytes * estimate->low;
+		maxBytes = fixedBytes + layerBytes * estimate->high;
+	}
+	
+	gFormatRecord->minDataBytes = ClampDataBytes(minBytes);
+	gFormatRecord->maxDataBytes = ClampDataBytes(maxBytes);
+}
+
+// minDataBytes and maxDataBytes are 32 bit; saturate rather than wrap
+static int32 ClampDataBytes(double bytes)
+{
+	if (bytes >= 2147483647.0)
+		return 2147483647;
+	if (bytes <= 0)
+		return 0;
+	return static_cast<int32>(ceil(bytes));
+}
+
+static VPoint GetFormatImageSize(void)
+{
+	VPoint returnPoint = { 0, 0};
+	if (gFormatRecord->HostSupports32BitCoordinates && gFormatRecord->PluginUsing32BitCoordinates)
+	{
+		returnPoint.v = gFormatRecord->imageSize32.v;
+		returnPoint.h = gFormatRecord->imageSize32.h;
+	}
+	else
+	{
+		returnPoint.v = gFormatRecord->imageSize.v;
+		returnPoint.h = gFormatRecord->imageSize.h;
+	}
+	return returnPoint;
+}
+
+static void SetFormatImageSize(VPoint inPoint)
+{
+	if (gFormatRecord->HostSupports32BitCoordinates && 
+		gFormatRecord->PluginUsing32BitCoordinates)
+	{
+		gFormatRecord->imageSize32.v = inPoint.v;
+		gFormatRecord->imageSize32.h = inPoint.h;
+	}
+	else
+	{
+		gFormatRecord->imageSize.v = static_cast<int16>(inPoint.v);
+		gFormatRecord->imageSize.h = static_cast<int16>(inPoint.h);
+	}
+}
+static void SetFormatTheRect(VRect inRect)
+{
+	if (gFormatRecord->HostSupports32BitCoordinates && 
+		gFormatRecord->PluginUsing32BitCoordinates)
+	{
+		gFormatRecord->theRect32.top = inRect.top;
+		gFormatRecord->theRect32.left = inRect.left;
+		gFormatRecord->theRect32.bottom = inRect.bottom;
+		gFormatRecord->theRect32.right = inRect.right;
+	}
+	else
+	{
+		gFormatRecord->theRect.top = static_cast<int16>(inRect.top);
+		gFormatRecord->theRect.left = static_cast<int16>(inRect.left);
+		gFormatRecord->theRect.bottom = static_cast<int16>(inRect.bottom);
+		gFormatRecord->theRect.right = static_cast<int16>(inRect.right);
+	}
+}
+
+//-------------------------------------------------------------------------------
+//
+// CreateDataHandle
+//
+// Create a handle to our Data structure. Photoshop will take ownership of this
+// handle and delete it when necessary.
+//-------------------------------------------------------------------------------
+static void CreateDataHandle(void)
+{
+	Handle h = sPSHandle->New(sizeof(Data));
+	if (h != NULL)
+		*gDataHandle = reinterpret_cast<intptr_t>(h);
+	else
+		*gResult = memFullErr;
+}
+
+//-------------------------------------------------------------------------------
+//
+// LockHandles
+//
+// Lock the handles and get the pointers for gData and gParams
+// Set the global error, *gResult, if there is trouble
+//
+//-------------------------------------------------------------------------------
+static void LockHandles(void)
+{
+	if (*gDataHandle == 0)
+	{
+		*gResult = formatBadParameters;
+		return;
+	}
+	
+	sPSHandle->SetLock(reinterpret_cast<Handle>(*gDataHandle), true, 
+		               reinterpret_cast<Ptr *>(&gData), NULL);
+	
+	if (gData == NULL)
+	{
+		*gResult = memFullErr;
+		return;
+	}
+}
+
+//-------------------------------------------------------------------------------
+//
+// UnlockHandles
+//
+// Unlock the handles used by the data and params pointers
+//
+//-------------------------------------------------------------------------------
+static void UnlockHandles(void)
+{
+	if (*gDataHandle != 0)
+		sPSHandle->SetLock(reinterpret_cast<Handle>(*gDataHandle), false, 
+		                   reinterpret_cast<Ptr *>(&gData), FALSE);
+}
+
+//-------------------------------------------------------------------------------
+//	ResourceBlockIterator
+//
+//	Walks the image resource blocks where they sit in the locked handle: type,
+//	id, padded Pascal name, size and padded data.  Nothing is allocated or
+//	copied; the name in each ResourceInfo points into the block.  Iteration
+//	stops at the first block that runs past the end.
+//-------------------------------------------------------------------------------
+
+class ResourceBlockIterator
+{
+public:
+	ResourceBlockIterator(uint8 * resources, int32 length)
+		: start(resources), next(resources), end(resources + length) {}
+
+	bool Next(ResourceInfo & info);
+
+private:
+	uint8 * start;
+	uint8 * next;
+	uint8 * end;
+};
+
+bool ResourceBlockIterator::Next(ResourceInfo & info)
+{
+	// type, id, an empty name and its pad byte, and the size
+	const ptrdiff_t minBytes(sizeof(uint32) + sizeof(uint16) + 2 * sizeof(uint8) + sizeof(uint32));
+
+	if ((end - next) < minBytes) return false;
+
+	uint8 * first = next;
+
+	info.offset = uint32(first - start);
+	info.type = GetBigEndian<uint32>(first);
+	info.id = GetBigEndian<uint16>(first);
+
+	info.nameLength = *first++;
+	info.name = reinterpret_cast<const char *>(first);
+	first += info.nameLength | uint8(1); // Add one if even for alignment;
+
+	if ((end - first) < ptrdiff_t(sizeof(uint32))) return false;
+
+	info.size = GetBigEndian<uint32>(first);
+
+	if (uint32(end - first) < info.size) return false;
+
+	// Add one if odd for alignment, unless the last block left it off
+	first += info.size;
+	if ((info.size & 1) && first < end)
+		first++;
+
+	info.totalSize = uint32(first - next);
+	info.keep = true;
 
-	return int32(destEnd - dest);
+	next = first;
+
+	return true;
+}
+
+static void CreateResourceInfoVector(int32 length, 
+									 uint8 * resources, 
+									 vector<ResourceInfo> & rInfos)
+{
+	rInfos.clear();
+
+	ResourceInfo thisResource;
+
+	// Count first so the vector is allocated once
+	size_t count = 0;
+	ResourceBlockIterator counter(resources, length);
+	while (counter.Next(thisResource))
+		count++;
+
+	rInfos.reserve(count);
+
+	ResourceBlockIterator blocks(resources, length);
+	while (blocks.Next(thisResource))
+		rInfos.push_back(thisResource);
+}
+
+static int32 RemoveResources(int32 resourceLength, 
+							 const vector<ResourceInfo> & rInfos, 
+							 uint8 * resourcePtr)
+{
+	/*
+	One pass from front to back.  rInfos is in file order, so each run of
+	kept blocks slides down over the removed blocks before it with a single
+	copy, and nothing moves until the first removed block.  Bytes past the
+	last block we could parse are kept as they are.
+	*/
+	uint8 * dest = resourcePtr;
+	uint8 * runFirst = resourcePtr;
+
+	size_t count = rInfos.size();
+
+	for (size_t a = 0; a < count; a++)
+	{
+		if (rInfos[a].keep) continue;
+
+		uint8 * resFirst = resourcePtr + rInfos[a].offset;
+
+		if (dest != runFirst)
+			dest = copy(runFirst, resFirst, dest);
+		else
+			dest = resFirst;
+
+		runFirst = resFirst + rInfos[a].totalSize;
+	}
+
+	uint8 * last = resourcePtr + resourceLength;
+
+	if (dest != runFirst)
+		dest = copy(runFirst, last, dest);
+	else
+		dest = last;
+
+	return int32(dest - resourcePtr);
 }
 
 void DoWriteLayerStart (void)
@@ -1404,12 +2459,13 @@ void DoWriteLayerStart (void)
 	// don't forget the trailing NULL
 	layerNameLength++;
 	
-	//We'll start with the length
-	WriteSome (sizeof (uint32), &layerNameLength);
-	
-	//Write the layer name
-	if(layerNameLength)
-		WriteSome ((layerNameLength)*sizeof (uint16), gFormatRecord->layerName);
+	//Remember where this layer starts for the directory
+	BeginDirectoryEntry();
+	LayerDirectoryEntry & entry = gLayerDirectory.back();
+	if(gFormatRecord->layerName)
+		entry.name.assign(gFormatRecord->layerName, gFormatRecord->layerName + layerNameLength);
+	else
+		entry.name.assign(1, 0);
 	
 	double modTime=-1.0;
 	
@@ -1442,9 +2498,8 @@ void DoWriteLayerStart (void)
 		actionDescriptorProcs->HandleToDescriptor(gFormatRecord->layerMetaData->descriptor,&metadataDescriptor);
 	
 		Boolean hasKey = 0;
-        DescriptorTypeID typeID = 0;
+        DescriptorTypeID typeID = gLayerTimeID.ID(actionControlProcs->StringIDToTypeID);
 		
-		actionControlProcs->StringIDToTypeID("layerTime",&typeID);
 		actionDescriptorProcs->HasKey(metadataDescriptor,typeID,&hasKey);
 		if(hasKey)
 			{
@@ -1464,7 +2519,25 @@ void DoWriteLayerStart (void)
 
 		}
 		
-	WriteSome (sizeof (double), &modTime);
+	entry.record.modTime = modTime;
+	
+	//An unchanged layer is already in the file, don't even ask for the pixels
+	gSkipLayerData = gIncremental && ReusePreviousLayer(entry, false);
+	if (gSkipLayerData)
+		return;
+	
+	NoteLayerOffset(&LayerDirectoryRecord::recordOffset);
+	
+	//We'll start with the length
+	WriteLayerBytes (sizeof (uint32), &layerNameLength);
+	
+	//Write the layer name
+	if(layerNameLength)
+		WriteLayerBytes ((layerNameLength)*sizeof (uint16), &entry.name[0]);
+	
+	WriteLayerBytes (sizeof (double), &modTime);
+	
+	NoteLayerOffset(&LayerDirectoryRecord::dataOffset);
 }
 
 void DoWriteLayerContinue (void)
@@ -1481,6 +2554,9 @@ void DoWriteLayerContinue (void)
 	// We don't need this in this example.  But, if you need it, it's there.
 	// int32 currentLayer = gFormatRecord->layerData;
 	
+	if (gSkipLayerData)
+		return;
+	
 	/* Set up the progress variables. */
 	done = 0;
 	total = gHeader.rows * gHeader.planes * numLayers;
@@ -1508,13 +2584,18 @@ void DoWriteLayerContinue (void)
 				*gResult = gFormatRecord->advanceState ();
 				
 			if (*gResult == noErr)
-				WriteRow (pixelData);
+			{
+				WriteLayerRow (pixelData);
+				HashRow (pixelData);
+			}
 			
 			gFormatRecord->progressProc (++done, total);
 			
 		}
 		
 	}
+	
+	FinishLayerBlocks();
 }
 
 void DoWriteLayerFinish (void)
@@ -1527,29 +2608,67 @@ void DoWriteLayerFinish (void)
 	gFormatRecord->data = NULL;
 	
 	sPSBuffer->Dispose(&pixelData);
+	
+	if (gSkipLayerData)
+	{
+		gSkipLayerData = false;
+		return;
+	}
+	
+	EndDirectoryEntry();
+	
+	//The layer may have been touched without changing, if so drop what
+	//we just appended and point at the copy that is already there
+	LayerDirectoryEntry & entry = gLayerDirectory.back();
+	if (gIncremental && *gResult == noErr && FindPreviousLayer(entry, true) >= 0)
+	{
+		if (gLayerWriter != NULL)
+			*gResult = gLayerWriter->Flush(true);
+		
+		int64 appendOffset = entry.record.recordOffset;
+		ReusePreviousLayer(entry, true);
+		
+		if (gLayerWriter != NULL && *gResult == noErr)
+			*gResult = gLayerWriter->Rewind(appendOffset);
+		else
+			SetPosition(appendOffset);
+	}
 }
 
 void DoReadLayerStart (void)
 {
-	uint32 layerNameLen = 0;
-	ReadSome(sizeof(uint32), &layerNameLen);
+	double modTime = 0;
+	const LayerDirectoryEntry * entry = FindDirectoryEntry(gFormatRecord->layerData);
 	
-	if(layerNameLen)
+	if (entry != NULL)
 	{
-		if (gData->needsSwap)
-			Swap(layerNameLen);
-		
-		ReadSome(layerNameLen*sizeof(uint16), gLayerName);
+		// Everything in the layer record is in the directory as well, so
+		// nothing is read from the file until the pixels are requested.
+		CopyLayerName(entry->name);
+		gFormatRecord->layerName=gLayerName;
+		modTime = entry->record.modTime;
+	}
+	else
+	{
+		uint32 layerNameLen = 0;
+		ReadSome(sizeof(uint32), &layerNameLen);
 		
-		if (gData->needsSwap)
-			for(uint32 index=0;index<layerNameLen;index++)
-				Swap(gLayerName[index]);
+		if(layerNameLen)
+		{
+			if (gData->needsSwap)
+				Swap(layerNameLen);
+			
+			ReadSome(layerNameLen*sizeof(uint16), gLayerName);
+			
+			if (gData->needsSwap)
+				for(uint32 index=0;index<layerNameLen;index++)
+					Swap(gLayerName[index]);
+			
+			gFormatRecord->layerName=gLayerName;
+		}
 		
-		gFormatRecord->layerName=gLayerName;
+		ReadSome(sizeof(double), &modTime);
 	}
-	
-	double modTime = 0;
-	ReadSome(sizeof(double), &modTime);
 	if(gFormatRecord->layerMetaData)
 		{
 		PSBasicActionControlProcs *actionControlProcs=NULL;
@@ -1577,9 +2696,8 @@ void DoReadLayerStart (void)
 		actionDescriptorProcs->Make(&metadataDescriptor);
 		if(metadataDescriptor)
 			{
-			DescriptorTypeID typeID = 0;
+			DescriptorTypeID typeID = gLayerTimeID.ID(actionControlProcs->StringIDToTypeID);
 		
-			actionControlProcs->StringIDToTypeID("layerTime",&typeID);
 			actionDescriptorProcs->PutFloat(metadataDescriptor, typeID, modTime);
 			
 			actionDescriptorProcs->AsHandle(metadataDescriptor, &gFormatRecord->layerMetaData->descriptor);
@@ -1638,6 +2756,12 @@ void DoReadLayerContinue (void)
 	if (gFormatRecord->depth == 16)
 		gFormatRecord->maxValue = 0x8000; // I read them like Photoshop writes them
 
+	// The host may skip layers, so seek straight to the pixels when we can
+	const LayerDirectoryEntry * entry = FindDirectoryEntry(gFormatRecord->layerData);
+	if (entry != NULL)
+		SetPosition(entry->record.dataOffset);
+	StartLayerRows(entry);
+
 	for (plane = 0; *gResult == noErr && plane < gFormatRecord->planes; ++plane)
 	{
 		
@@ -1651,7 +2775,7 @@ void DoReadLayerContinue (void)
 
 			SetFormatTheRect(theRect);
 			
-			ReadRow (pixelData, gData->needsSwap);
+			ReadLayerRow (entry, pixelData);
 			
 			if (*gResult == noErr)
 				*gResult = gFormatRecord->advanceState();
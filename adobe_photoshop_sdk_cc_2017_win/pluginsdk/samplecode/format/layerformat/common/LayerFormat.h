@@ -71,6 +71,79 @@ typedef struct HeaderVer1
 	int32 resourceLength;
 } Header16BitRowsCols;
 
+//-------------------------------------------------------------------------------
+//	Structure -- Layer directory
+//
+//	The directory is written after the ICC profile, at the very end of the
+//	file.  The footer sits a fixed distance from the end, so a reader can find
+//	any layer, or just the layer names, without scanning the layers in front.
+//	Files without a footer are read sequentially as before.  Files saved
+//	incrementally or with compressed layers are tagged "dirbrain" and cannot
+//	be read without it.
+//-------------------------------------------------------------------------------
+
+// Version 2 added compressed layers
+const int16 LAYERDIRECTORY_VERSION = 2;
+
+// Saving over one of our files only appends the layers that changed.  Once
+// more than this fraction of the file is unreferenced layers, the next save
+// writes the whole file again.
+const double LAYERDIRECTORY_COMPACT_RATIO = 0.5;
+
+typedef struct LayerDirectoryRecord
+{
+	int64 recordOffset;			// start of the layer record (name length)
+	int64 dataOffset;			// first pixel row
+	int64 dataSize;				// bytes of pixel data
+	int32 top;
+	int32 left;
+	int32 bottom;
+	int32 right;
+	double modTime;
+	uint64 contentHash;			// 64 bit FNV-1a of the pixel data
+	uint32 nameLength;			// utf16 units that follow, including the NULL
+	uint32 compression;			// LAYERCOMPRESSION_NONE or _LZ4, see LayerCompression.h
+} LayerDirectoryRecord;
+
+typedef struct LayerDirectoryFooter
+{
+	char identifier [8];		// "layerdir"
+	int16 endian;
+	int16 version;
+	int32 numLayers;
+	int64 directoryOffset;
+	int64 profileOffset;		// the ICC profile follows the last layer
+} LayerDirectoryFooter;
+
+typedef struct LayerDirectoryEntry
+{
+	LayerDirectoryRecord record;
+	vector<uint16> name;
+} LayerDirectoryEntry;
+
+//-------------------------------------------------------------------------------
+//	Structure -- Size estimate for compressed layers
+//
+//	The estimate compresses a few blocks of the composite, spread evenly over
+//	the planes and rows, and extrapolates the ratio with a confidence interval.
+//	The ratio is kept in the plug-in's globals, under the document's size,
+//	mode, planes and layer count, and a real save replaces the sampled ratio
+//	with the one it got, so the save dialog samples a document at most once.
+//	A ratio is only used again while the document's size and mode stay the
+//	same.
+//-------------------------------------------------------------------------------
+
+const int32 LAYERESTIMATE_SAMPLES = 16;		// blocks compressed per estimate
+const double LAYERESTIMATE_Z = 1.96;		// 95% interval around the ratio
+const size_t LAYERESTIMATE_REMEMBERED = 16;	// ratios kept for later estimates
+
+typedef struct LayerEstimate
+{
+	uint32 key;				// EstimateKey of the document when it was taken
+	float ratio;			// stored bytes over raw bytes
+	float low;
+	float high;
+} LayerEstimate;
 
 //-------------------------------------------------------------------------------
 //	Data -- structures
@@ -79,13 +152,19 @@ typedef struct HeaderVer1
 typedef struct Data
 { 
 	bool needsSwap;
+	bool compressLayers;		// write layers as LZ4 blocks, scripting key keyLayerCompression
 } Data;
 	
+// One image resource block, seen in place in the locked resource handle.
+// name is not NULL terminated; it points into the block, or at a
+// description of the id when the block has no name of its own.
 typedef struct ResourceInfo {
-	uint32 totalSize;
+	uint32 offset;			// of the block from the start of the resources
+	uint32 totalSize;		// of the block, with its header and padding
 	uint32 type;
 	uint16 id;
-	string name;
+	const char * name;
+	uint8 nameLength;
 	uint32 size;
 	bool keep;
 } ResourceInfo;
@@ -101,12 +180,15 @@ extern int16 * gResult;
 
 void DoAbout (AboutRecordPtr about); 	   		// Pop about box.
 
-bool DoUI (vector<ResourceInfo *> & rInfos);
+bool DoUI (vector<ResourceInfo> & rInfos);
 
 // During read phase:
 Boolean ReadScriptParamsOnRead (void);	// Read any scripting params.
 OSErr WriteScriptParamsOnRead (void);	// Write any scripting params.
 
+// During estimate phase:
+void ReadScriptParamsOnEstimate (void);	// Peek at the write params.
+
 // During write phase:
 Boolean ReadScriptParamsOnWrite (void);	// Read any scripting params.
 OSErr WriteScriptParamsOnWrite (void);	// Write any scripting params.
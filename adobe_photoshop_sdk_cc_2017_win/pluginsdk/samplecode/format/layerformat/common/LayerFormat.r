@@ -189,6 +189,12 @@ resource 'aete' (ResourceID, plugInName " dictionary", purgeable)
 				keyMyBar,
 				typeBoolean,
 				"foobar",
+				flagsSingleProperty,
+				
+				"compress layers",
+				keyLayerCompression,
+				typeBoolean,
+				"write layers as compressed blocks",
 				flagsSingleProperty
 				/* no properties */
 			},
@@ -103,6 +103,33 @@ Boolean ReadScriptParamsOnRead (void)
 	return returnValue;
 }
 		
+//-------------------------------------------------------------------------------
+//
+//	ReadWriteKey
+//
+//	Updates the globals from one key of the write parameters.
+//
+//-------------------------------------------------------------------------------
+
+static void ReadWriteKey (ReadDescriptorProcs * readProcs,
+						  PIReadDescriptor token,
+						  DescriptorKeyID key)
+{
+	switch (key)
+		{
+		case keyMyBar:
+			// readProcs->getBooleanProc(token, &gData->barValueForWrite);
+			break;
+		case keyLayerCompression:
+			{
+			Boolean compress = false;
+			readProcs->getBooleanProc(token, &compress);
+			gData->compressLayers = compress != false;
+			}
+			break;
+		}
+}
+
 //-------------------------------------------------------------------------------
 //
 //	ReadScriptParamsOnWrite
@@ -142,14 +169,7 @@ Boolean ReadScriptParamsOnWrite (void)
 	if (token == NULL) return returnValue;
 
     while (readProcs->getKeyProc(token, &key, &type, &flags))
-	{
-		switch (key)
-			{
-			case keyMyBar:
-				// readProcs->getBooleanProc(token, &gData->barValueForWrite);
-				break;
-			}
-	}
+		ReadWriteKey (readProcs, token, key);
 	
 	readProcs->closeReadDescriptorProc(token); // closes & disposes.
 	// Dispose the parameter block descriptor:
@@ -162,6 +182,43 @@ Boolean ReadScriptParamsOnWrite (void)
 	return returnValue;
 }
 
+//-------------------------------------------------------------------------------
+//
+//	ReadScriptParamsOnEstimate
+//
+//	Updates the globals from the write parameters, if any, so the estimate
+//	sees the options the write will get.  The descriptor is left in place
+//	for ReadScriptParamsOnWrite.
+//
+//	Outputs:
+//		gResult				Will return any fatal error.
+//
+//-------------------------------------------------------------------------------
+
+void ReadScriptParamsOnEstimate (void)
+{
+	DescriptorKeyID				key = 0;
+	DescriptorTypeID			type = 0;
+	DescriptorKeyIDArray		array = { NULLID };
+	int32						flags = 0;
+	
+	PIDescriptorParameters *	descParams = gFormatRecord->descriptorParameters;
+	if (descParams == NULL) return;
+	
+	ReadDescriptorProcs * readProcs = descParams->readDescriptorProcs;
+	if (readProcs == NULL) return;
+
+	if (descParams->descriptor == NULL) return;
+    
+	PIReadDescriptor token = readProcs->openReadDescriptorProc(descParams->descriptor, array);
+	if (token == NULL) return;
+
+    while (readProcs->getKeyProc(token, &key, &type, &flags))
+		ReadWriteKey (readProcs, token, key);
+	
+	readProcs->closeReadDescriptorProc(token); // closes & disposes the token only.
+}
+
 //-------------------------------------------------------------------------------
 //
 //	WriteScriptParamsOnRead
@@ -237,6 +294,7 @@ OSErr WriteScriptParamsOnWrite (void)
 	if (token == NULL) return gotErr;
 
     // writeProcs->putBooleanProc(token, keyMyBar, gData->barValueForWrite);
+	writeProcs->putBooleanProc(token, keyLayerCompression, gData->compressLayers);
 
 	sPSHandle->Dispose(descParams->descriptor);
 	writeProcs->closeWriteDescriptorProc(token, &h);
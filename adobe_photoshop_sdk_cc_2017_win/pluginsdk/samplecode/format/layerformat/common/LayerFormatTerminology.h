@@ -33,6 +33,7 @@
 
 #define keyMyFoo		'fooB'
 #define keyMyBar		'barF'
+#define keyLayerCompression	'lyCm'
 
 //-------------------------------------------------------------------------------
 //	Definitions -- Resource types
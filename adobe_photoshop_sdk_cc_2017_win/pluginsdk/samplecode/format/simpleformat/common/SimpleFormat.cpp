@@ -126,16 +126,10 @@ inline Result GetBigEndian(uint8 *& source)
 
 static void CreateResourceInfoVector(int32 length, 
 									 uint8 * resources, 
-									 vector<ResourceInfo *> & rInfos);
-static void DeleteResourceInfoVector(vector<ResourceInfo *> & rInfos);
+									 vector<ResourceInfo> & rInfos);
 static int32 RemoveResources(int32 resourceLength, 
-							 const vector<ResourceInfo *> & rInfos, 
+							 const vector<ResourceInfo> & rInfos, 
 							 uint8 * resourcePtr);
-static int32 RemoveResource(uint32 type, 
-							uint16 id, 
-							uint8 * imageResource, 
-							int32 size, 
-							uint8 * dest);
 //-------------------------------------------------------------------------------
 //	Globals -- Define global variables for plug-in scope.
 //-------------------------------------------------------------------------------
@@ -714,40 +708,32 @@ static void DoReadStart (void)
 		{
 			ReadSome (header.resourceLength, resourcePtr);
 
-			if (!gFormatRecord->openForPreview)
+			int32 keptLength = header.resourceLength;
+
+			if (!gFormatRecord->openForPreview && showDialog)
 			{
-				vector<ResourceInfo *> resources;
+				vector<ResourceInfo> resources;
 				CreateResourceInfoVector(header.resourceLength, 
 					                     reinterpret_cast<uint8 *>(resourcePtr), 
 										 resources);
 
 				// see if the user wants to remove some resources
-				if (showDialog && DoUI(resources))
+				if (DoUI(resources))
 				{
-					header.resourceLength = RemoveResources(header.resourceLength, 
-							                                resources, 
-															reinterpret_cast<uint8 *>(resourcePtr));
-					Handle h = sPSHandle->New(header.resourceLength);
-					if (h == NULL)
-					{
-						*gResult = memFullErr;
-						sPSHandle->Dispose(gFormatRecord->imageRsrcData);
-						return;
-					}
-					Boolean newoldLock = FALSE;
-					Ptr newResourcePtr = NULL;
-					sPSHandle->SetLock(h, true, &newResourcePtr, &newoldLock);
-					if (newResourcePtr != NULL)
-					{
-						copy(resourcePtr, resourcePtr + header.resourceLength, newResourcePtr);
-						sPSHandle->Dispose(gFormatRecord->imageRsrcData);
-						gFormatRecord->imageRsrcData = h;
-					}
+					keptLength = RemoveResources(header.resourceLength, 
+						                         resources, 
+												 reinterpret_cast<uint8 *>(resourcePtr));
 				}
-				DeleteResourceInfoVector(resources);
 			}
 
 			sPSHandle->SetLock(gFormatRecord->imageRsrcData, false, &resourcePtr, &oldLock);
+
+			// the kept resources were compacted to the front, drop the rest
+			if (*gResult == noErr && keptLength != header.resourceLength)
+			{
+				*gResult = sPSHandle->SetSize(gFormatRecord->imageRsrcData, keptLength);
+				header.resourceLength = keptLength;
+			}
 		
 			if (*gResult != noErr)
 				goto CleanUp;
@@ -1028,18 +1014,20 @@ static void DoWriteStart (void)
 		sPSHandle->SetLock(gFormatRecord->imageRsrcData, true, &p, &oldLock);
 		if (p != NULL)
 		{
-			vector<ResourceInfo *> resources;
-			CreateResourceInfoVector(header.resourceLength, 
-				                     reinterpret_cast<uint8 *>(p), 
-									 resources);
-			// see if the user wants to remove some resources
-			if (showDialog && DoUI(resources))
+			if (showDialog)
 			{
-				header.resourceLength = RemoveResources(header.resourceLength, 
-					                                    resources, 
-														reinterpret_cast<uint8 *>(p));
+				vector<ResourceInfo> resources;
+				CreateResourceInfoVector(header.resourceLength, 
+					                     reinterpret_cast<uint8 *>(p), 
+										 resources);
+				// see if the user wants to remove some resources
+				if (DoUI(resources))
+				{
+					header.resourceLength = RemoveResources(header.resourceLength, 
+						                                    resources, 
+															reinterpret_cast<uint8 *>(p));
+				}
 			}
-			DeleteResourceInfoVector(resources);
 
 			WriteSome (sizeof (FileHeader), &header);
 			WriteSome (header.resourceLength, p);
@@ -1361,185 +1349,127 @@ static void UnlockHandles(void)
 		                   reinterpret_cast<Ptr *>(&gData), &oldLock);
 }
 
-static void CreateResourceInfoVector(int32 length, 
-									 uint8 * resources, 
-									 vector<ResourceInfo *> & rInfos)
+//-------------------------------------------------------------------------------
+//	ResourceBlockIterator
+//
+//	Walks the image resource blocks where they sit in the locked handle: type,
+//	id, padded Pascal name, size and padded data.  Nothing is allocated or
+//	copied; the name in each ResourceInfo points into the block.  Iteration
+//	stops at the first block that runs past the end.
+//-------------------------------------------------------------------------------
+
+class ResourceBlockIterator
 {
-	rInfos.clear();
+public:
+	ResourceBlockIterator(uint8 * resources, int32 length)
+		: start(resources), next(resources), end(resources + length) {}
 
-	int32 calculatedLength = 0;
+	bool Next(ResourceInfo & info);
 
-	uint8 * resourcesEnd = resources + length;
+private:
+	uint8 * start;
+	uint8 * next;
+	uint8 * end;
+};
 
-	while (resources < resourcesEnd)
-	{
-		ResourceInfo * thisResource = new ResourceInfo;
+bool ResourceBlockIterator::Next(ResourceInfo & info)
+{
+	// type, id, an empty name and its pad byte, and the size
+	const ptrdiff_t minBytes(sizeof(uint32) + sizeof(uint16) + 2 * sizeof(uint8) + sizeof(uint32));
 
-		thisResource->totalSize = 0;
-		
-		thisResource->type = GetBigEndian<uint32>(resources);
-		thisResource->totalSize += sizeof(thisResource->type);
-		
-		thisResource->id = GetBigEndian<uint16>(resources);
-		thisResource->totalSize += sizeof(thisResource->id);
+	if ((end - next) < minBytes) return false;
 
-		uint8 nameLength = *resources++;
-		thisResource->totalSize++;
+	uint8 * first = next;
 
-		thisResource->name.reserve(nameLength);
-		ostringstream inputName;
-		for (int a = 0; a < nameLength; a++)
-		{
-			inputName << *resources++;
-			thisResource->totalSize++;
-		}
-		thisResource->name = inputName.str();
+	info.offset = uint32(first - start);
+	info.type = GetBigEndian<uint32>(first);
+	info.id = GetBigEndian<uint16>(first);
 
-		resources += nameLength | uint8(1); // Add one if even for alignment;
-		thisResource->totalSize += nameLength | uint8(1);
+	info.nameLength = *first++;
+	info.name = reinterpret_cast<const char *>(first);
+	first += info.nameLength | uint8(1); // Add one if even for alignment;
 
-		thisResource->size = GetBigEndian<uint32>(resources);
-		thisResource->totalSize += sizeof(thisResource->size);
+	if ((end - first) < ptrdiff_t(sizeof(uint32))) return false;
 
-		resources += (thisResource->size + 1) & ~uint32(1); // Add one if odd for alignment;
-		thisResource->totalSize += (thisResource->size + 1) & ~uint32(1); // Add one if odd for alignment;
+	info.size = GetBigEndian<uint32>(first);
 
-		thisResource->keep = true;
-		
-		rInfos.push_back(thisResource);
-		
-		calculatedLength += thisResource->totalSize;
-	} 
+	if (uint32(end - first) < info.size) return false;
+
+	// Add one if odd for alignment, unless the last block left it off
+	first += info.size;
+	if ((info.size & 1) && first < end)
+		first++;
+
+	info.totalSize = uint32(first - next);
+	info.keep = true;
+
+	next = first;
+
+	return true;
 }
 
-static void DeleteResourceInfoVector(vector<ResourceInfo *> & rInfos)
+static void CreateResourceInfoVector(int32 length, 
+									 uint8 * resources, 
+									 vector<ResourceInfo> & rInfos)
 {
-	size_t count = rInfos.size();
-	for (size_t a = 0; a < count; a++)
-	{
-		ResourceInfo * thisResource = rInfos.at(a);
-		delete thisResource;
-	}
+	rInfos.clear();
+
+	ResourceInfo thisResource;
+
+	// Count first so the vector is allocated once
+	size_t count = 0;
+	ResourceBlockIterator counter(resources, length);
+	while (counter.Next(thisResource))
+		count++;
+
+	rInfos.reserve(count);
+
+	ResourceBlockIterator blocks(resources, length);
+	while (blocks.Next(thisResource))
+		rInfos.push_back(thisResource);
 }
 
 static int32 RemoveResources(int32 resourceLength, 
-							 const vector<ResourceInfo *> & rInfos, 
+							 const vector<ResourceInfo> & rInfos, 
 							 uint8 * resourcePtr)
 {
+	/*
+	One pass from front to back.  rInfos is in file order, so each run of
+	kept blocks slides down over the removed blocks before it with a single
+	copy, and nothing moves until the first removed block.  Bytes past the
+	last block we could parse are kept as they are.
+	*/
+	uint8 * dest = resourcePtr;
+	uint8 * runFirst = resourcePtr;
+
 	size_t count = rInfos.size();
 
 	for (size_t a = 0; a < count; a++)
 	{
-		if (! rInfos.at(a)->keep)
-		{
-			resourceLength = RemoveResource(rInfos.at(a)->type,
-				                            rInfos.at(a)->id,
-											resourcePtr,
-											resourceLength,
-											resourcePtr);
-		}
-	}
-		
-	return resourceLength;
-}
+		if (rInfos[a].keep) continue;
 
-static int32 RemoveResource(uint32 type,
-							uint16 id,
-							uint8 * imageResource,
-							int32 size,
-							uint8 * dest)
-{
-	/*
-	[first, last) is the source range. first will close on last as we
-	search for the resource.
-	*/
-	uint8 * first  = imageResource;
-	uint8 * last  = first + size;
-	
-	/*
-	[resFirst, resLast) marks the range enclosing the found resource
-	if the resource has not been found then the range is empty but within
-	[first, last).
-	*/
-	
-	uint8 * resFirst  = first;
-	uint8 * resLast = first;
-	
-	// min bytes is the minimum number of bytes in the resource header.
-	
-	const ptrdiff_t minBytes(sizeof(uint32) + sizeof(uint16) + sizeof(int8));
+		uint8 * resFirst = resourcePtr + rInfos[a].offset;
 
-	while ((last - first) >= minBytes) 
-	{
-		resFirst = first;
-		resLast = first;
-	
-		// Read the type
-		uint32 readType = GetBigEndian<uint32>(first);
-		
-		// Read the id
-		uint16 readID (GetBigEndian<uint16>(first));
-		
-		// Skip the name
-		uint8 length = *first++;
-		first += length | uint8(1); // Add one if even for alignment;
-		
-		// Make sure we have enough space to read the blockSize
-		if ((last - first) < sizeof(uint32)) break;
-		
-		// Read the block size
-		uint32 blockSize (GetBigEndian<uint32>(first));
-		
-		// Skip the block
-		first += (blockSize + 1) & ~uint32(1); // Add one if odd for alignment;
-		
-		if ((readType == type) && (readID == id)) {
-			resLast = first;
-			break;
-		}
-	}
-	
-	/*
-	Handle the copy as two pieces. If the resource was found then this will omit it.
-	Otherwise it is simply copied as all but the last resoruce, and then the last resource.
-	*/
-	
-	uint8 * destEnd = NULL;
-
-	if (resFirst == resLast)
-	{
-		if (dest != imageResource)
-		{
-			// nothing was found and I need to copy everything
-			destEnd = copy(imageResource, imageResource + size, dest);
-		}
+		if (dest != runFirst)
+			dest = copy(runFirst, resFirst, dest);
 		else
-		{
-			// nothing was found and I don't need to copy anything
-			destEnd = imageResource + size;
-		}
+			dest = resFirst;
+
+		runFirst = resFirst + rInfos[a].totalSize;
 	}
+
+	uint8 * last = resourcePtr + resourceLength;
+
+	if (dest != runFirst)
+		dest = copy(runFirst, last, dest);
 	else
-	{
-		if (dest != imageResource)
-		{
-			// something was found and I need to copy over the start
-			destEnd = copy(imageResource, resFirst, dest);
-			// skipping the resource that I found
-			destEnd = copy(resLast, last, destEnd);
-		}
-		else
-		{
-			// skip over the resource only
-			destEnd = copy(resLast, last, resFirst); //destEnd);
-		}
-	}
+		dest = last;
 
-	return int32(destEnd - dest);
+	return int32(dest - resourcePtr);
 }
 
 #if Macintosh
-bool DoUI (vector<ResourceInfo *> & rInfos)
+bool DoUI (vector<ResourceInfo> & rInfos)
 {
 	return false;
 }
@@ -81,11 +81,16 @@ typedef struct Data
 	Boolean openAsSmartObject;
 } Data;
 	
+// One image resource block, seen in place in the locked resource handle.
+// name is not NULL terminated; it points into the block, or at a
+// description of the id when the block has no name of its own.
 typedef struct ResourceInfo {
-	uint32 totalSize;
+	uint32 offset;			// of the block from the start of the resources
+	uint32 totalSize;		// of the block, with its header and padding
 	uint32 type;
 	uint16 id;
-	string name;
+	const char * name;
+	uint8 nameLength;
 	uint32 size;
 	bool keep;
 } ResourceInfo;
@@ -101,7 +106,7 @@ extern int16 * gResult;
 
 void DoAbout (AboutRecordPtr about); 	   		// Pop about box.
 
-bool DoUI (vector<ResourceInfo *> & rInfos);
+bool DoUI (vector<ResourceInfo> & rInfos);
 
 // During read phase:
 Boolean ReadScriptParamsOnRead (void);	// Read any scripting params.
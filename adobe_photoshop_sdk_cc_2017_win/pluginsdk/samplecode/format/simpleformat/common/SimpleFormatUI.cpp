@@ -15,6 +15,7 @@
 
 #include <map>
 #include <sstream>
+#include <string.h>
 #include "SimpleFormat.h"
 #include "PIUI.h"
 
@@ -39,12 +40,12 @@ private:
 	virtual void Init(void);
 	virtual void Notify(int32 item);
 
-	vector<ResourceInfo *> resourceInfos;
+	vector<ResourceInfo> resourceInfos;
 
-	void GetResourceNames(vector<ResourceInfo *> & resourceInfos);
+	void GetResourceNames(vector<ResourceInfo> & resourceInfos);
 
 public:
-	SimpleFormatDialog(vector<ResourceInfo *> rInfos) : PIDialog(),
+	SimpleFormatDialog(vector<ResourceInfo> rInfos) : PIDialog(),
 					   resourceList(), 
 					   resourceType(),
 					   resourceID(),
@@ -53,10 +54,10 @@ public:
 					   resourceKeep() { resourceInfos = rInfos; }
 	~SimpleFormatDialog() {}
 
-	vector<ResourceInfo *> GetResourceInfos(void) { return resourceInfos; }
+	vector<ResourceInfo> GetResourceInfos(void) { return resourceInfos; }
 };
 
-bool DoUI (vector<ResourceInfo *> & rInfos)
+bool DoUI (vector<ResourceInfo> & rInfos)
 {
 	SimpleFormatDialog dialog(rInfos);
 	int result = dialog.Modal(gPluginRef, NULL, 16050);
@@ -86,7 +87,8 @@ void SimpleFormatDialog::Init(void)
 	for (index = 0; index < (int32)count; index++)
 	{
 		stringStream.str("");
-		stringStream << resourceInfos.at(index)->id << " " << resourceInfos.at(index)->name.c_str();
+		stringStream << resourceInfos.at(index).id << " ";
+		stringStream.write(resourceInfos.at(index).name, resourceInfos.at(index).nameLength);
 		nItem = resourceList.AppendItem(stringStream.str().c_str());
 		resourceList.SetUserData(nItem, index);
 	}
@@ -98,30 +100,30 @@ void SimpleFormatDialog::Init(void)
 	item = PIGetDialogItem(dialog, kDType);
 	resourceType.SetItem(item);
 	stringStream.str("");
-	stringStream << resourceInfos.at(index)->type;
+	stringStream << resourceInfos.at(index).type;
 	resourceType.SetText(stringStream.str().c_str());
 
 	item = PIGetDialogItem(dialog, kDID);
 	resourceID.SetItem(item);
 	stringStream.str("");
-	stringStream << resourceInfos.at(index)->id;
+	stringStream << resourceInfos.at(index).id;
 	resourceID.SetText(stringStream.str().c_str());
 
 	item = PIGetDialogItem(dialog, kDName);
 	resourceName.SetItem(item);
 	stringStream.str("");
-	stringStream << resourceInfos.at(index)->name.c_str();
+	stringStream.write(resourceInfos.at(index).name, resourceInfos.at(index).nameLength);
 	resourceName.SetText(stringStream.str().c_str());
 
 	item = PIGetDialogItem(dialog, kDSize);
 	resourceSize.SetItem(item);
 	stringStream.str("");
-	stringStream << resourceInfos.at(index)->size;
+	stringStream << resourceInfos.at(index).size;
 	resourceSize.SetText(stringStream.str().c_str());
 
 	item = PIGetDialogItem(dialog, kDKeep);
 	resourceKeep.SetItem(item);
-	resourceKeep.SetChecked(resourceInfos.at(index)->keep);
+	resourceKeep.SetChecked(resourceInfos.at(index).keep);
 }
 
 void SimpleFormatDialog::Notify(int32 item)
@@ -130,37 +132,37 @@ void SimpleFormatDialog::Notify(int32 item)
 
 	if (item == kDKeep)
 	{
-		resourceKeep.SetChecked(!(resourceInfos.at(index)->keep));
-		resourceInfos.at(index)->keep = resourceKeep.GetChecked();
+		resourceKeep.SetChecked(!(resourceInfos.at(index).keep));
+		resourceInfos.at(index).keep = resourceKeep.GetChecked();
 	}
 	else if (item == kDListBox)
 	{
 		ostringstream stringStream;
-		stringStream << resourceInfos.at(index)->type;
+		stringStream << resourceInfos.at(index).type;
 		resourceType.SetText(stringStream.str().c_str());
 
 		stringStream.str("");
-		stringStream << resourceInfos.at(index)->id;
+		stringStream << resourceInfos.at(index).id;
 		resourceID.SetText(stringStream.str().c_str());
 
 		stringStream.str("");
-		stringStream << resourceInfos.at(index)->name.c_str();
+		stringStream.write(resourceInfos.at(index).name, resourceInfos.at(index).nameLength);
 		resourceName.SetText(stringStream.str().c_str());
 
 		stringStream.str("");
-		stringStream << resourceInfos.at(index)->size;
+		stringStream << resourceInfos.at(index).size;
 		resourceSize.SetText(stringStream.str().c_str());
 
-		resourceKeep.SetChecked(resourceInfos.at(index)->keep);
+		resourceKeep.SetChecked(resourceInfos.at(index).keep);
 	}
 }
 
-void SimpleFormatDialog::GetResourceNames(vector<ResourceInfo *> & resourceInfos)
+void SimpleFormatDialog::GetResourceNames(vector<ResourceInfo> & resourceInfos)
 {
 	size_t count = resourceInfos.size();
 	if (count == 0) return;
 
-	map<int16, string> resourceNames;
+	map<int16, const char *> resourceNames;
 
 	resourceNames[1000] = "Obsolete channels, rows, columns, depth, and mode";
 	resourceNames[1001] = "Macintosh print manager print info record";
@@ -224,13 +226,19 @@ void SimpleFormatDialog::GetResourceNames(vector<ResourceInfo *> & resourceInfos
 	
 	for (size_t a = 0; a < count; a++)
 	{
-		if (resourceInfos.at(a)->name.length() == 0)
+		if (resourceInfos.at(a).nameLength == 0)
 		{
-			int16 ID = resourceInfos.at(a)->id;
+			int16 ID = resourceInfos.at(a).id;
+			const char * description = NULL;
 			if (ID >= 2000 && ID <= 2998)
-				resourceInfos.at(a)->name = "Path Information";
+				description = "Path Information";
 			else
-                resourceInfos.at(a)->name = resourceNames[ID];
+                description = resourceNames[ID];
+			if (description != NULL)
+			{
+				resourceInfos.at(a).name = description;
+				resourceInfos.at(a).nameLength = uint8(strlen(description));
+			}
 		}
 	}
 }
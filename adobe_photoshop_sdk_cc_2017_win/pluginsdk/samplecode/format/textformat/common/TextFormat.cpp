@@ -11,11 +11,15 @@
 //-------------------------------------------------------------------------------
 //
 //	File:
-//		TextFormat.h
+//		TextFormat.cpp
 //
 //	Description:
+//		This file contains the source and routines for the
+//		File Format module TextFormat, which reads ASCII PGM
+//		and PPM files and CSV matrices of numbers.
 //
 //	Use:
+//		Format modules are called from the Open dialog.
 //
 //-------------------------------------------------------------------------------
 
@@ -23,10 +27,7 @@
 //	Includes
 //-------------------------------------------------------------------------------
 
-#include "PIDefines.h"
-#include "PIFormat.h"					// Format Photoshop header file.
-#include "PIUtilities.h"				// SDK Utility library.
-#include "FileUtilities.h"				// File Utility library.
+#include "TextFormat.h"
 #include "PIUI.h"
 
 //-------------------------------------------------------------------------------
@@ -36,10 +37,15 @@
 // everyone needs access to the sPSBasic pointer 
 SPBasicSuite * sSPBasic = NULL;
 
+// the file being read, from ReadStart to ReadFinish
+static TextRaster gRaster;
+
 DLLExport MACPASCAL void PluginMain (const int16 selector, FormatRecordPtr formatParamBlock, intptr_t * data, int16 * result);
 
-void DoReadStart(FormatRecordPtr formatRecord);
+void DoReadStart(FormatRecordPtr formatRecord, int16 * result);
+void DoReadContinue(FormatRecordPtr formatRecord, int16 * result);
 void DoReadFinish(FormatRecordPtr formatRecord);
+void DoFilterFile(FormatRecordPtr formatRecord, int16 * result);
 
 //-------------------------------------------------------------------------------
 //
@@ -115,14 +121,24 @@ DLLExport MACPASCAL void PluginMain (const int16 selector,
 		switch (selector)
 		{
 			case formatSelectorReadStart:
-				DoReadStart(formatParamBlock);
+				DoReadStart(formatParamBlock, result);
+				break;
+			case formatSelectorReadContinue:
+				DoReadContinue(formatParamBlock, result);
 				break;
 			case formatSelectorReadFinish:
 				DoReadFinish(formatParamBlock);
 				break;
+			case formatSelectorFilterFile:
+				DoFilterFile(formatParamBlock, result);
+				break;
 			default:
 				break;
 		}
+
+		// ReadFinish is not called after an error
+		if (*result != noErr)
+			CloseTextRaster(gRaster);
 			
 
 	} // about selector special		
@@ -142,6 +158,8 @@ DLLExport MACPASCAL void PluginMain (const int16 selector,
 
 	catch(...)
 	{
+		CloseTextRaster(gRaster);
+
 		if (NULL != result)
 		{
 			*result = -1;
@@ -151,27 +169,126 @@ DLLExport MACPASCAL void PluginMain (const int16 selector,
 } // end PluginMain
 
 
-void DoReadStart(FormatRecordPtr formatRecord)
+//-------------------------------------------------------------------------------
+//
+//	DoReadStart
+//
+//	Maps and indexes the file and tells the host what image is in it.
+//
+//-------------------------------------------------------------------------------
+
+void DoReadStart(FormatRecordPtr formatRecord, int16 * result)
 {
-	formatRecord->planes = 3;
-	formatRecord->imageMode = plugInModeRGBColor;
-	formatRecord->depth = 8;
+	*result = OpenTextRaster(formatRecord->dataFork, gRaster);
+	if (*result != noErr) return;
 
-	if (formatRecord->openForPreview)
+	if (!formatRecord->HostSupports32BitCoordinates &&
+		(gRaster.width > 30000 || gRaster.height > 30000))
 	{
-		formatRecord->imageSize.v = 256;
-		formatRecord->imageSize.h = 256;
+		*result = formatCannotRead;
+		return;
+	}
+
+	formatRecord->PluginUsing32BitCoordinates = formatRecord->HostSupports32BitCoordinates;
+
+	formatRecord->planes = gRaster.planes;
+	formatRecord->imageMode = gRaster.planes == 3 ? plugInModeRGBColor : plugInModeGrayScale;
+	formatRecord->depth = gRaster.depth;
+
+	if (gRaster.depth == 16)
+		formatRecord->maxValue = 32768;
+
+	if (formatRecord->PluginUsing32BitCoordinates)
+	{
+		formatRecord->imageSize32.v = gRaster.height;
+		formatRecord->imageSize32.h = gRaster.width;
 	}
 	else
-	{	
-		formatRecord->imageSize.v = 10 * 72;
-		formatRecord->imageSize.h = 8 * 72;
+	{
+		formatRecord->imageSize.v = static_cast<int16>(gRaster.height);
+		formatRecord->imageSize.h = static_cast<int16>(gRaster.width);
+	}
+}
+
+//-------------------------------------------------------------------------------
+//
+//	DoReadContinue
+//
+//	Parses the image a strip of rows at a time and hands each strip to
+//	the host, all planes interleaved.
+//
+//-------------------------------------------------------------------------------
+
+void DoReadContinue(FormatRecordPtr formatRecord, int16 * result)
+{
+	int32 pixelBytes = gRaster.planes * (gRaster.depth / 8);
+	int64 rowBytes = int64(gRaster.width) * pixelBytes;
+
+	int32 stripRows = static_cast<int32>(kTextStripBytes / rowBytes);
+	if (stripRows < 1)
+		stripRows = 1;
+	if (stripRows > gRaster.height)
+		stripRows = gRaster.height;
+
+	if (rowBytes * stripRows > 0x7fffffff)
+	{
+		*result = memFullErr;
+		return;
 	}
 
+	int32 bufferSize = static_cast<int32>(rowBytes * stripRows);
+	Ptr pixelData = sPSBuffer->New(&bufferSize, bufferSize);
+	if (pixelData == NULL)
+	{
+		*result = memFullErr;
+		return;
+	}
+
+	formatRecord->loPlane = 0;
+	formatRecord->hiPlane = gRaster.planes - 1;
+	formatRecord->colBytes = static_cast<int16>(pixelBytes);
+	formatRecord->rowBytes = static_cast<int32>(rowBytes);
+	formatRecord->planeBytes = gRaster.depth / 8;
+	formatRecord->data = pixelData;
+
+	for (int32 top = 0; *result == noErr && top < gRaster.height; top += stripRows)
+	{
+		int32 bottom = top + stripRows < gRaster.height ? top + stripRows : gRaster.height;
+
+		*result = ParseTextRows(gRaster, top, bottom, pixelData);
+		if (*result != noErr) break;
+
+		if (formatRecord->PluginUsing32BitCoordinates)
+		{
+			formatRecord->theRect32.top = top;
+			formatRecord->theRect32.bottom = bottom;
+			formatRecord->theRect32.left = 0;
+			formatRecord->theRect32.right = gRaster.width;
+		}
+		else
+		{
+			formatRecord->theRect.top = static_cast<int16>(top);
+			formatRecord->theRect.bottom = static_cast<int16>(bottom);
+			formatRecord->theRect.left = 0;
+			formatRecord->theRect.right = static_cast<int16>(gRaster.width);
+		}
+
+		*result = formatRecord->advanceState();
+
+		formatRecord->progressProc(bottom, gRaster.height);
+
+		if (*result == noErr && formatRecord->abortProc())
+			*result = userCanceledErr;
+	}
+
+	formatRecord->data = NULL;
+	sPSBuffer->Dispose(&pixelData);
 }
 
 void DoReadFinish(FormatRecordPtr formatRecord)
 {
+	CloseTextRaster(gRaster);
+
 	PIDescriptorHandle h;
 			
 	PIDescriptorParameters * descParams = formatRecord->descriptorParameters;
@@ -189,5 +306,31 @@ void DoReadFinish(FormatRecordPtr formatRecord)
 	
 }
 
+//-------------------------------------------------------------------------------
+//
+//	DoFilterFile
+//
+//	Looks at the start of the file to see if it is one we read.
+//
+//-------------------------------------------------------------------------------
+
+void DoFilterFile(FormatRecordPtr formatRecord, int16 * result)
+{
+	char sample [4096];
+	int64 size = 0;
+
+	*result = PSSDKGetEOF(formatRecord->dataFork, &size);
+	if (*result != noErr) return;
+
+	int32 count = size < int64(sizeof(sample)) ? static_cast<int32>(size) : static_cast<int32>(sizeof(sample));
+
+	*result = PSSDKSetFPos(formatRecord->dataFork, fsFromStart, 0);
+	if (*result == noErr && count > 0)
+		*result = PSSDKRead(formatRecord->dataFork, &count, sample);
+
+	if (*result == noErr && !IsTextRaster(sample, count, count == size))
+		*result = formatCannotRead;
+}
+
 
 // end TextFormat.cpp
\ No newline at end of file
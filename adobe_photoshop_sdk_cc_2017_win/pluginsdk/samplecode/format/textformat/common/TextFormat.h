@@ -0,0 +1,108 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		TextFormat.h
+//
+//	Description:
+//		This file contains the header prototypes and macros for the
+//		File Format module TextFormat, which reads images stored as
+//		text: ASCII PGM (P2) and PPM (P3) files, and CSV matrices
+//		of numbers.
+//
+//	Use:
+//		Format modules are called from the Open dialog.
+//
+//-------------------------------------------------------------------------------
+
+#ifndef __TextFormat_H__		// Has this not been defined yet?
+#define __TextFormat_H__		// Only include this once by predefining it
+
+#include "PIDefines.h"
+#include "PIFormat.h"					// Format Photoshop header file.
+#include "PIUtilities.h"				// SDK Utility library.
+#include "FileUtilities.h"				// File Utility library.
+#include <vector>
+
+//-------------------------------------------------------------------------------
+//	Definitions -- Constants
+//-------------------------------------------------------------------------------
+
+// The text is split into chunks of about this many bytes, each ending
+// with a newline, and the chunks are parsed in parallel
+const int64 kTextChunkBytes = 1 << 20;
+
+// Pixels are handed to the host in strips of about this many bytes
+const int32 kTextStripBytes = 32 << 20;
+
+// Files that cannot be mapped are read in pieces of this size
+const int32 kTextReadBytes = 64 << 20;
+
+//-------------------------------------------------------------------------------
+//	Structure -- TextRaster
+//
+//	A text file opened for reading.  The body after the header is indexed
+//	once, when the file is opened: chunkFirst holds the number of records
+//	in front of each chunk, where a record is one sample for PGM and PPM
+//	and one row for CSV.  Any strip of rows can then be parsed from just
+//	the chunks that hold it.
+//-------------------------------------------------------------------------------
+
+enum TextRasterKind
+{
+	kTextPGM,							// P2, one plane
+	kTextPPM,							// P3, three planes
+	kTextCSV							// one row of numbers per line
+};
+
+typedef struct TextRaster
+{
+	TextRasterKind kind;
+	int32 width;
+	int32 height;
+	int16 planes;
+	int16 depth;						// 8 or 16 for PGM and PPM, 32 for CSV
+	uint32 maxValue;					// PGM and PPM sample range
+
+	const char * text;					// the whole file
+	int64 size;
+	int64 bodyOffset;					// first byte after the header
+
+	std::vector<int64> chunkStart;		// offsets of the chunks, and of the end
+	std::vector<int64> chunkFirst;		// first record in each chunk, and the total
+	std::vector<uint16> scale;			// PGM and PPM sample to pixel value
+
+	intptr_t mapping;					// from PSSDKMapFile
+	const void * mapped;
+	std::vector<char> copy;				// the file, if it could not be mapped
+} TextRaster;
+
+//-------------------------------------------------------------------------------
+//	Prototypes
+//-------------------------------------------------------------------------------
+
+// Maps the file, reads the header and indexes the body.
+OSErr OpenTextRaster (intptr_t dataFork, TextRaster & raster);
+
+// Parses rows [top, bottom) into pixels, interleaved, planes * depth / 8
+// bytes per pixel.
+OSErr ParseTextRows (const TextRaster & raster, int32 top, int32 bottom, void * pixels);
+
+void CloseTextRaster (TextRaster & raster);
+
+// True if the start of a file looks like something OpenTextRaster reads.
+// Unless it is the whole file, its last line is taken to be cut short.
+bool IsTextRaster (const char * text, int64 size, bool wholeFile);
+
+//-------------------------------------------------------------------------------
+
+#endif // __TextFormat_H__
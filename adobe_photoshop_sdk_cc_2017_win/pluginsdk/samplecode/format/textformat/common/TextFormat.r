@@ -121,7 +121,8 @@ resource 'PiPL' (ResourceID, plugInName " PiPL", purgeable)
 	
 		FmtFileType { 'TEXT', '8BIM' },
 		ReadTypes { { 'TEXT', '    ' } },
-		ReadExtensions { { 'TXT ' } },
+		ReadExtensions { { 'TXT ', 'PGM ', 'PPM ', 'PNM ', 'CSV ' } },
+		FilteredExtensions { { 'TXT ', 'CSV ' } },
 		FormatFlags { fmtSavesImageResources, 
 		              fmtCanRead, 
 					  fmtCannotWrite, 
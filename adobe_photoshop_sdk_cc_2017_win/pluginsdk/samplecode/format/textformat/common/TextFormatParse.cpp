@@ -0,0 +1,841 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		TextFormatParse.cpp
+//
+//	Description:
+//		This file contains the text parsing for the File Format
+//		module TextFormat.  The whole file is mapped into memory,
+//		indexed once in parallel, and then parsed a strip of rows
+//		at a time, also in parallel, as the host asks for pixels.
+//
+//-------------------------------------------------------------------------------
+
+#include "TextFormat.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <new>
+#include <thread>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define TEXTFORMAT_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define TEXTFORMAT_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+//-------------------------------------------------------------------------------
+//	Character classes
+//-------------------------------------------------------------------------------
+
+static inline bool IsSpace (char c)
+{
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// Between the numbers on a CSV line
+static inline bool IsSeparator (char c)
+{
+	return c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool IsDigit (char c)
+{
+	return static_cast<uint8>(c - '0') < 10;
+}
+
+static inline int32 CountTrailingZeros (uint64 value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return static_cast<int32>(index);
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<unsigned long>(value)))
+		return static_cast<int32>(index);
+	_BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+	return static_cast<int32>(index) + 32;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+static inline int32 CountBits16 (uint32 value)
+{
+	value = value - ((value >> 1) & 0x5555);
+	value = (value & 0x3333) + ((value >> 2) & 0x3333);
+	value = (value + (value >> 4)) & 0x0f0f;
+	return static_cast<int32>((value + (value >> 8)) & 0x1f);
+}
+
+//-------------------------------------------------------------------------------
+//	Numbers
+//-------------------------------------------------------------------------------
+
+static const uint64 kPow10 [] =
+{
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+	1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// Powers of ten a double holds exactly
+static const double kPow10Exact [] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline double ScaleByPow10 (double value, int32 exponent)
+{
+	if (exponent >= 0 && exponent <= 22)
+		return value * kPow10Exact[exponent];
+	if (exponent < 0 && exponent >= -22)
+		return value / kPow10Exact[-exponent];
+	return value * pow(10.0, exponent);
+}
+
+// Reads the run of decimal digits at p into value, eight digits per step:
+// the eight bytes are checked for digits all at once and the leading digits
+// are combined pairwise in a single 64 bit register.  digits is the length
+// of the run; value is only meaningful up to 19 digits.
+static inline const char * ParseDigits (const char * p, const char * end, uint64 & value, int32 & digits)
+{
+	value = 0;
+	digits = 0;
+
+	while (end - p >= 8)
+	{
+		uint64 chunk;
+		memcpy(&chunk, p, sizeof(chunk));
+
+		// Digits become 0..9.  Anything else gets a bit in its high nibble,
+		// either from the subtraction or from adding 6 to 10..15.  Borrows
+		// and carries only run into later bytes, so the first non-digit is
+		// always found correctly.
+		chunk -= 0x3030303030303030ULL;
+		uint64 other = (chunk | (chunk + 0x0606060606060606ULL)) & 0xf0f0f0f0f0f0f0f0ULL;
+		int32 count = other != 0 ? CountTrailingZeros(other) >> 3 : 8;
+
+		if (count == 0)
+			return p;
+
+		// Keep the digits, the first in the lowest byte, as the high bytes
+		chunk <<= 8 * (8 - count);
+		chunk = (chunk * 10 + (chunk >> 8)) & 0x00ff00ff00ff00ffULL;
+		chunk = (chunk * 100 + (chunk >> 16)) & 0x0000ffff0000ffffULL;
+		chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000ffffffffULL;
+
+		value = value * kPow10[count] + chunk;
+		digits += count;
+		p += count;
+
+		if (count < 8)
+			return p;
+	}
+
+	while (p < end && IsDigit(*p))
+	{
+		value = value * 10 + (*p++ - '0');
+		digits++;
+	}
+
+	return p;
+}
+
+// More digits than 64 bits hold; a double is plenty for a float pixel.
+static double ParseLongNumber (const char * p, const char * end)
+{
+	double value = 0;
+	int32 exponent = 0;
+	bool fraction = false;
+
+	for (; p < end; p++)
+	{
+		if (IsDigit(*p))
+		{
+			value = value * 10 + (*p - '0');
+			if (fraction)
+				exponent--;
+		}
+		else if (*p == '.')
+		{
+			fraction = true;
+		}
+		else if (*p == 'e' || *p == 'E')
+		{
+			// ParseNumber has checked the exponent
+			bool negative = *++p == '-';
+			if (*p == '-' || *p == '+')
+				p++;
+
+			int32 power = 0;
+			for (; p < end; p++)
+				power = power * 10 + (*p - '0');
+
+			exponent += negative ? -power : power;
+			break;
+		}
+	}
+
+	return ScaleByPow10(value, exponent);
+}
+
+// Reads [+-]digits[.digits][e[+-]digits].  Returns NULL if there is no number.
+static const char * ParseNumber (const char * p, const char * end, double & value)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	const char * start = p;
+
+	uint64 mantissa;
+	int32 integerDigits;
+	p = ParseDigits(p, end, mantissa, integerDigits);
+
+	uint64 fraction = 0;
+	int32 fractionDigits = 0;
+	if (p < end && *p == '.')
+		p = ParseDigits(p + 1, end, fraction, fractionDigits);
+
+	if (integerDigits + fractionDigits == 0)
+		return NULL;
+
+	int32 exponent = 0;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char * q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			negativeExponent = *q++ == '-';
+
+		uint64 exponentValue;
+		int32 exponentDigits;
+		q = ParseDigits(q, end, exponentValue, exponentDigits);
+		if (exponentDigits == 0 || exponentDigits > 4)
+			return NULL;
+
+		exponent = negativeExponent ? -static_cast<int32>(exponentValue) : static_cast<int32>(exponentValue);
+		p = q;
+	}
+
+	if (integerDigits + fractionDigits > 19)
+	{
+		value = ParseLongNumber(start, p);
+	}
+	else
+	{
+		mantissa = mantissa * kPow10[fractionDigits] + fraction;
+		value = ScaleByPow10(static_cast<double>(mantissa), exponent - fractionDigits);
+	}
+
+	if (negative)
+		value = -value;
+
+	return p;
+}
+
+//-------------------------------------------------------------------------------
+//	Lines and tokens
+//-------------------------------------------------------------------------------
+
+static inline const char * LineEnd (const char * p, const char * end)
+{
+	const void * newline = memchr(p, '\n', end - p);
+	return newline != NULL ? static_cast<const char *>(newline) : end;
+}
+
+static bool IsBlank (const char * p, const char * lineEnd)
+{
+	while (p < lineEnd && IsSpace(*p))
+		p++;
+	return p == lineEnd;
+}
+
+// A line of column names, rather than numbers
+static bool IsHeaderLine (const char * p, const char * lineEnd)
+{
+	for (; p < lineEnd; p++)
+	{
+		if (!IsDigit(*p) && !IsSeparator(*p) && strchr("+-.eE", *p) == NULL)
+			return true;
+	}
+	return false;
+}
+
+// Returns the numbers on a CSV line, or -1 if something else is there.
+static int32 CountLineValues (const char * p, const char * lineEnd)
+{
+	int32 count = 0;
+
+	for (;;)
+	{
+		while (p < lineEnd && IsSeparator(*p))
+			p++;
+
+		if (p == lineEnd)
+			return count;
+
+		double value;
+		p = ParseNumber(p, lineEnd, value);
+		if (p == NULL || (p < lineEnd && !IsSeparator(*p)))
+			return -1;
+
+		count++;
+	}
+}
+
+// Counts the whitespace separated tokens in [p, end), sixteen bytes at a
+// time where SSE2 is available.  p must not be inside a token.
+static int64 CountTokens (const char * p, const char * end)
+{
+	int64 count = 0;
+	uint32 inToken = 0;
+
+#if TEXTFORMAT_SSE2
+	const __m128i firstTokenByte = _mm_set1_epi8(' ' + 1);
+
+	while (end - p >= 16)
+	{
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+
+		// token bytes are the ones above ' ', unsigned
+		uint32 token = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(bytes, firstTokenByte), bytes));
+		uint32 starts = token & ~((token << 1) | inToken);
+
+		count += CountBits16(starts);
+		inToken = (token >> 15) & 1;
+		p += 16;
+	}
+#endif
+
+	for (; p < end; p++)
+	{
+		uint32 token = static_cast<uint8>(*p) > ' ';
+		count += token & ~inToken;
+		inToken = token;
+	}
+
+	return count;
+}
+
+static int64 CountRows (const char * p, const char * end)
+{
+	int64 count = 0;
+
+	while (p < end)
+	{
+		const char * lineEnd = LineEnd(p, end);
+		if (!IsBlank(p, lineEnd))
+			count++;
+		p = lineEnd + 1;
+	}
+
+	return count;
+}
+
+//-------------------------------------------------------------------------------
+//	ParallelChunks
+//
+//	Runs task(0) .. task(count - 1) on a thread per core and returns the
+//	first error any of them hit.  The calling thread works too, and does
+//	all of them if no thread can be started.
+//-------------------------------------------------------------------------------
+
+static OSErr ParallelChunks (size_t count, const std::function<OSErr (size_t)> & task)
+{
+	std::atomic<size_t> next (0);
+	std::atomic<int32> error (noErr);
+
+	auto run = [&]()
+	{
+		for (;;)
+		{
+			size_t index = next++;
+			if (index >= count || error.load() != noErr)
+				return;
+
+			OSErr result = task(index);
+			if (result != noErr)
+			{
+				int32 expected = noErr;
+				error.compare_exchange_strong(expected, result);
+			}
+		}
+	};
+
+	size_t threads = std::thread::hardware_concurrency();
+	if (threads > count)
+		threads = count;
+
+	// a thread that fails to start leaves its chunks to the ones that did
+	// and to this one, rather than ending the host in std::terminate
+	std::vector<std::thread> workers;
+	try
+	{
+		workers.reserve(threads);
+		for (size_t a = 1; a < threads; a++)
+			workers.push_back(std::thread(run));
+	}
+	catch (...)
+	{
+	}
+
+	run();
+
+	for (size_t a = 0; a < workers.size(); a++)
+		workers[a].join();
+
+	return static_cast<OSErr>(error.load());
+}
+
+//-------------------------------------------------------------------------------
+//	Header
+//-------------------------------------------------------------------------------
+
+static bool ReadHeaderNumber (const char *& p, const char * end, uint32 & value)
+{
+	for (;;)
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+
+		if (p == end || *p != '#')
+			break;
+
+		p = LineEnd(p, end);
+	}
+
+	uint64 number;
+	int32 digits;
+	p = ParseDigits(p, end, number, digits);
+
+	if (digits == 0 || digits > 10 || number > 0x7fffffff || (p < end && !IsSpace(*p)))
+		return false;
+
+	value = static_cast<uint32>(number);
+	return true;
+}
+
+static bool ReadPNMHeader (TextRaster & raster)
+{
+	const char * p = raster.text + 2;
+	const char * end = raster.text + raster.size;
+
+	uint32 width, height, maxValue;
+	if (!ReadHeaderNumber(p, end, width) ||
+		!ReadHeaderNumber(p, end, height) ||
+		!ReadHeaderNumber(p, end, maxValue))
+		return false;
+
+	if (width == 0 || height == 0 || maxValue == 0 || maxValue > 65535)
+		return false;
+
+	raster.width = width;
+	raster.height = height;
+	raster.planes = raster.kind == kTextPPM ? 3 : 1;
+	raster.depth = maxValue < 256 ? 8 : 16;
+	raster.maxValue = maxValue;
+
+	// one whitespace byte ends the header
+	raster.bodyOffset = (p - raster.text) + (p < end ? 1 : 0);
+
+	// 16 bit pixels run from 0 to 32768
+	uint32 top = raster.depth == 8 ? 255 : 32768;
+	raster.scale.resize(maxValue + 1);
+	for (uint32 a = 0; a <= maxValue; a++)
+		raster.scale[a] = static_cast<uint16>((a * top + maxValue / 2) / maxValue);
+
+	return true;
+}
+
+static bool ReadCSVHeader (TextRaster & raster)
+{
+	const char * p = raster.text;
+	const char * end = raster.text + raster.size;
+	bool firstLine = true;
+
+	while (p < end)
+	{
+		const char * lineEnd = LineEnd(p, end);
+
+		if (!IsBlank(p, lineEnd))
+		{
+			// column names are allowed on the first line only
+			if (firstLine && IsHeaderLine(p, lineEnd))
+			{
+				firstLine = false;
+				p = lineEnd + 1;
+				continue;
+			}
+
+			int32 count = CountLineValues(p, lineEnd);
+			if (count <= 0)
+				return false;
+
+			raster.width = count;
+			raster.planes = 1;
+			raster.depth = 32;
+			raster.bodyOffset = p - raster.text;
+			return true;
+		}
+
+		p = lineEnd + 1;
+	}
+
+	return false;
+}
+
+//-------------------------------------------------------------------------------
+//	Body
+//-------------------------------------------------------------------------------
+
+static OSErr IndexBody (TextRaster & raster)
+{
+	int64 position = raster.bodyOffset;
+
+	raster.chunkStart.push_back(position);
+
+	while (position < raster.size)
+	{
+		int64 next = position + kTextChunkBytes;
+
+		if (next >= raster.size)
+		{
+			next = raster.size;
+		}
+		else
+		{
+			const char * end = raster.text + raster.size;
+			next = LineEnd(raster.text + next, end) - raster.text;
+			if (next < raster.size)
+				next++;
+		}
+
+		raster.chunkStart.push_back(next);
+		position = next;
+	}
+
+	size_t chunks = raster.chunkStart.size() - 1;
+
+	raster.chunkFirst.assign(chunks + 1, 0);
+
+	OSErr err = ParallelChunks(chunks, [&raster](size_t chunk) -> OSErr
+	{
+		const char * p = raster.text + raster.chunkStart[chunk];
+		const char * end = raster.text + raster.chunkStart[chunk + 1];
+
+		raster.chunkFirst[chunk + 1] = raster.kind == kTextCSV ? CountRows(p, end) : CountTokens(p, end);
+		return noErr;
+	});
+
+	if (err != noErr)
+		return err;
+
+	for (size_t chunk = 0; chunk < chunks; chunk++)
+		raster.chunkFirst[chunk + 1] += raster.chunkFirst[chunk];
+
+	int64 records = raster.chunkFirst.back();
+
+	if (raster.kind == kTextCSV)
+	{
+		if (records <= 0 || records > 0x7fffffff)
+			return formatCannotRead;
+
+		raster.height = static_cast<int32>(records);
+	}
+	else if (records < int64(raster.width) * raster.height * raster.planes)
+	{
+		// the file ends early
+		return formatCannotRead;
+	}
+
+	return noErr;
+}
+
+// Parses the samples of one chunk that fall in [first, last).
+static OSErr ParsePNMChunk (const TextRaster & raster, size_t chunk, int64 first, int64 last, void * pixels)
+{
+	const char * p = raster.text + raster.chunkStart[chunk];
+	const char * end = raster.text + raster.chunkStart[chunk + 1];
+	int64 record = raster.chunkFirst[chunk];
+
+	uint8 * pixels8 = static_cast<uint8 *>(pixels);
+	uint16 * pixels16 = static_cast<uint16 *>(pixels);
+
+	while (record < last)
+	{
+		while (p < end && IsSpace(*p))
+			p++;
+
+		if (p == end)
+			break;
+
+		if (record < first)
+		{
+			while (p < end && !IsSpace(*p))
+				p++;
+			record++;
+			continue;
+		}
+
+		uint64 value;
+		int32 digits;
+		p = ParseDigits(p, end, value, digits);
+
+		if (digits == 0 || (p < end && !IsSpace(*p)))
+			return formatCannotRead;
+
+		if (digits > 10 || value > raster.maxValue)
+			value = raster.maxValue;
+
+		if (raster.depth == 8)
+			pixels8[record - first] = static_cast<uint8>(raster.scale[static_cast<size_t>(value)]);
+		else
+			pixels16[record - first] = raster.scale[static_cast<size_t>(value)];
+
+		record++;
+	}
+
+	return noErr;
+}
+
+// Parses the rows of one chunk that fall in [first, last).
+static OSErr ParseCSVChunk (const TextRaster & raster, size_t chunk, int64 first, int64 last, void * pixels)
+{
+	const char * p = raster.text + raster.chunkStart[chunk];
+	const char * end = raster.text + raster.chunkStart[chunk + 1];
+	int64 row = raster.chunkFirst[chunk];
+
+	while (p < end && row < last)
+	{
+		const char * lineEnd = LineEnd(p, end);
+
+		if (IsBlank(p, lineEnd))
+		{
+			p = lineEnd + 1;
+			continue;
+		}
+
+		if (row >= first)
+		{
+			float * out = static_cast<float *>(pixels) + (row - first) * raster.width;
+			int32 column = 0;
+
+			for (;;)
+			{
+				while (p < lineEnd && IsSeparator(*p))
+					p++;
+
+				if (p == lineEnd)
+					break;
+
+				double value;
+				if (column == raster.width)
+					return formatCannotRead;
+
+				p = ParseNumber(p, lineEnd, value);
+				if (p == NULL || (p < lineEnd && !IsSeparator(*p)))
+					return formatCannotRead;
+
+				out[column++] = static_cast<float>(value);
+			}
+
+			// every row must be as wide as the first
+			if (column != raster.width)
+				return formatCannotRead;
+		}
+
+		row++;
+		p = lineEnd + 1;
+	}
+
+	return noErr;
+}
+
+static OSErr ReadWholeFile (intptr_t dataFork, TextRaster & raster)
+{
+	OSErr err = PSSDKGetEOF(dataFork, &raster.size);
+	if (err != noErr)
+		return err;
+
+	if (static_cast<uint64>(raster.size) > static_cast<uint64>(static_cast<size_t>(-1)))
+		return memFullErr;
+
+	try
+	{
+		raster.copy.resize(static_cast<size_t>(raster.size));
+	}
+	catch (const std::bad_alloc &)
+	{
+		return memFullErr;
+	}
+
+	err = PSSDKSetFPos64(dataFork, fsFromStart, 0);
+
+	for (int64 done = 0; err == noErr && done < raster.size; )
+	{
+		int32 count = raster.size - done < kTextReadBytes ?
+					  static_cast<int32>(raster.size - done) : kTextReadBytes;
+
+		err = PSSDKRead(dataFork, &count, &raster.copy[static_cast<size_t>(done)]);
+		if (err == noErr && count <= 0)
+			err = eofErr;
+
+		done += count;
+	}
+
+	raster.text = raster.copy.empty() ? NULL : &raster.copy[0];
+
+	return err;
+}
+
+//-------------------------------------------------------------------------------
+//	TextRaster
+//-------------------------------------------------------------------------------
+
+OSErr OpenTextRaster (intptr_t dataFork, TextRaster & raster)
+{
+	CloseTextRaster(raster);
+
+	OSErr err = PSSDKMapFile(dataFork, &raster.mapped, &raster.size, &raster.mapping);
+
+	if (err == noErr)
+		raster.text = static_cast<const char *>(raster.mapped);
+	else
+		err = ReadWholeFile(dataFork, raster);
+
+	if (err != noErr)
+		return err;
+
+	if (raster.size < 2)
+		return formatCannotRead;
+
+	if (raster.text[0] == 'P' && (raster.text[1] == '2' || raster.text[1] == '3'))
+	{
+		raster.kind = raster.text[1] == '2' ? kTextPGM : kTextPPM;
+		if (!ReadPNMHeader(raster))
+			return formatCannotRead;
+	}
+	else
+	{
+		raster.kind = kTextCSV;
+		if (!ReadCSVHeader(raster))
+			return formatCannotRead;
+	}
+
+	return IndexBody(raster);
+}
+
+OSErr ParseTextRows (const TextRaster & raster, int32 top, int32 bottom, void * pixels)
+{
+	int64 recordsPerRow = raster.kind == kTextCSV ? 1 : int64(raster.width) * raster.planes;
+	int64 first = top * recordsPerRow;
+	int64 last = bottom * recordsPerRow;
+
+	// The chunks holding records [first, last)
+	std::vector<int64>::const_iterator chunksEnd = raster.chunkFirst.end() - 1;
+	size_t firstChunk = std::upper_bound(raster.chunkFirst.begin(), chunksEnd, first) - raster.chunkFirst.begin() - 1;
+	size_t lastChunk = std::lower_bound(raster.chunkFirst.begin(), chunksEnd, last) - raster.chunkFirst.begin();
+
+	return ParallelChunks(lastChunk - firstChunk, [&](size_t index) -> OSErr
+	{
+		if (raster.kind == kTextCSV)
+			return ParseCSVChunk(raster, firstChunk + index, first, last, pixels);
+		else
+			return ParsePNMChunk(raster, firstChunk + index, first, last, pixels);
+	});
+}
+
+void CloseTextRaster (TextRaster & raster)
+{
+	if (raster.mapped != NULL)
+		PSSDKUnmapFile(raster.mapping, raster.mapped, raster.size);
+
+	raster.mapped = NULL;
+	raster.mapping = 0;
+	raster.text = NULL;
+	raster.size = 0;
+	raster.bodyOffset = 0;
+	raster.width = 0;
+	raster.height = 0;
+
+	std::vector<int64>().swap(raster.chunkStart);
+	std::vector<int64>().swap(raster.chunkFirst);
+	std::vector<uint16>().swap(raster.scale);
+	std::vector<char>().swap(raster.copy);
+}
+
+bool IsTextRaster (const char * text, int64 size, bool wholeFile)
+{
+	if (size >= 3 && text[0] == 'P' && (text[1] == '2' || text[1] == '3'))
+		return IsSpace(text[2]);
+
+	const char * p = text;
+	const char * end = text + size;
+	bool firstLine = true;
+
+	while (p < end)
+	{
+		const char * lineEnd = LineEnd(p, end);
+
+		// a sample can stop in the middle of a line, and of a number
+		bool cut = lineEnd == end && !wholeFile;
+
+		if (!IsBlank(p, lineEnd))
+		{
+			if (firstLine && IsHeaderLine(p, lineEnd))
+			{
+				// the numbers are past the sample, for the real read to check
+				if (cut)
+					return true;
+
+				firstLine = false;
+				p = lineEnd + 1;
+				continue;
+			}
+
+			if (cut)
+			{
+				// judge only the numbers that end inside the sample
+				const char * tokensEnd = lineEnd;
+				while (tokensEnd > p && !IsSeparator(tokensEnd[-1]))
+					tokensEnd--;
+
+				if (IsBlank(p, tokensEnd))
+					return !IsHeaderLine(p, lineEnd);
+
+				lineEnd = tokensEnd;
+			}
+
+			return CountLineValues(p, lineEnd) > 0;
+		}
+
+		p = lineEnd + 1;
+	}
+
+	return false;
+}
+
+// end TextFormatParse.cpp
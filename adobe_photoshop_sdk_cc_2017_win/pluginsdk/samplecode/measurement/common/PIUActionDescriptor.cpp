@@ -12,6 +12,7 @@
 #include "PIUActionDescriptor.h"
 
 #include "PIUActionControl.h"
+#include "PIUActionZone.h"
 #include "PIUExceptions.h"
 #include "PIUSuites.h"
 
@@ -33,6 +34,17 @@ PIUActionDescriptor::PIUActionDescriptor (PIActionDescriptor inDescriptor, bool
 
 /******************************************************************************/
 
+PIUActionDescriptor::PIUActionDescriptor (PIUActionDescriptor &&inDescriptor)
+	:	fDescriptor (inDescriptor.fDescriptor),
+		fOwned (inDescriptor.fOwned)
+	{
+	// Only one of us frees it
+	inDescriptor.fDescriptor = NULL;
+	inDescriptor.fOwned = true;
+	}
+
+/******************************************************************************/
+
 PIUActionDescriptor::~PIUActionDescriptor ()
     {
     try
@@ -61,6 +73,24 @@ PIUActionDescriptor &PIUActionDescriptor::operator= (PIActionDescriptor inDescri
 
 /******************************************************************************/
 
+PIUActionDescriptor &PIUActionDescriptor::operator= (PIUActionDescriptor &&inDescriptor)
+	{
+	if (this != &inDescriptor)
+		{
+		Free ();
+		
+		fDescriptor = inDescriptor.fDescriptor;
+		fOwned = inDescriptor.fOwned;
+		
+		inDescriptor.fDescriptor = NULL;
+		inDescriptor.fOwned = true;
+		}
+	
+	return *this;
+	}
+
+/******************************************************************************/
+
 PIUActionDescriptor::operator bool() const
 	{
 	return (fDescriptor != NULL);
@@ -92,6 +122,17 @@ void PIUActionDescriptor::Make ()
 
 /******************************************************************************/
 
+void PIUActionDescriptor::Make (PIUActionZone &inZone)
+	{
+	Free ();
+	
+	// The zone frees it
+	fDescriptor = inZone.MakeDescriptor ();
+	fOwned = false;
+	}
+
+/******************************************************************************/
+
 void PIUActionDescriptor::Free ()
 	{
 	REQUIRE_NON_NULL (sPSActionDescriptor);
@@ -461,6 +502,20 @@ PIActionDescriptor PIUActionDescriptor::GetObject (DescriptorKeyID inKey)
 
 /******************************************************************************/
 
+PIActionDescriptor PIUActionDescriptor::GetObject (const char *inKey, PIUActionZone &inZone)
+	{
+	return GetObject (PIUActionControl::GetStringID (inKey), inZone);
+	}
+
+/******************************************************************************/
+
+PIActionDescriptor PIUActionDescriptor::GetObject (DescriptorKeyID inKey, PIUActionZone &inZone)
+	{
+	return inZone.Adopt (GetObject (inKey));
+	}
+
+/******************************************************************************/
+
 void PIUActionDescriptor::PutObject (const char *inKey, const char *inType, 
 		PIActionDescriptor inValue)
 	{
@@ -503,6 +558,20 @@ PIActionList PIUActionDescriptor::GetList (DescriptorKeyID inKey)
 
 /******************************************************************************/
 
+PIActionList PIUActionDescriptor::GetList (const char *inKey, PIUActionZone &inZone)
+	{
+	return GetList (PIUActionControl::GetStringID (inKey), inZone);
+	}
+
+/******************************************************************************/
+
+PIActionList PIUActionDescriptor::GetList (DescriptorKeyID inKey, PIUActionZone &inZone)
+	{
+	return inZone.Adopt (GetList (inKey));
+	}
+
+/******************************************************************************/
+
 void PIUActionDescriptor::PutList (const char *inKey, PIActionList inValue)
 	{
 	PutList (PIUActionControl::GetStringID (inKey), inValue);
@@ -16,6 +16,8 @@
 
 #include "PIActions.h"
 
+class PIUActionZone;
+
 /**
  * Wrap a PIActionDescriptor object to allow for easy creation, automatic 
  * destruction and cleanup, sane parameter validation and error handling 
@@ -24,7 +26,8 @@
  * PIUExceptions.h for more information about exceptions.
  *
  * The PIActionDescriptor may be owned or not.  If owned, then the wrapper 
- * takes care of freeing the PIActionDescriptor as necessary.
+ * takes care of freeing the PIActionDescriptor as necessary.  One made in
+ * or got into a PIUActionZone is owned by the zone, and freed with it.
  */
 class PIUActionDescriptor
 	{
@@ -32,15 +35,18 @@ class PIUActionDescriptor
 	
 		PIUActionDescriptor ();
 		PIUActionDescriptor (PIActionDescriptor inDescriptor, bool inOwned = true);
+		PIUActionDescriptor (PIUActionDescriptor &&inDescriptor);
 		virtual ~PIUActionDescriptor ();
 		
 		PIUActionDescriptor &operator= (PIActionDescriptor inDescriptor);
+		PIUActionDescriptor &operator= (PIUActionDescriptor &&inDescriptor);
 		
 		operator bool () const;
 
 		operator PIActionDescriptor () const;
 		
 		void Make ();
+		void Make (PIUActionZone &inZone);
 		void Free ();
 		
 		PIActionDescriptor Release ();
@@ -85,11 +91,15 @@ class PIUActionDescriptor
 		
 		PIActionDescriptor GetObject (const char *inKey);
 		PIActionDescriptor GetObject (DescriptorKeyID inKey);
+		PIActionDescriptor GetObject (const char *inKey, PIUActionZone &inZone);
+		PIActionDescriptor GetObject (DescriptorKeyID inKey, PIUActionZone &inZone);
 		void PutObject (const char *inKey, const char *inType, PIActionDescriptor inValue);
 		void PutObject (DescriptorKeyID inKey, DescriptorClassID inType, PIActionDescriptor inValue);
 		
 		PIActionList GetList (const char *inKey);
 		PIActionList GetList (DescriptorKeyID inKey);
+		PIActionList GetList (const char *inKey, PIUActionZone &inZone);
+		PIActionList GetList (DescriptorKeyID inKey, PIUActionZone &inZone);
 		void PutList (const char *inKey, PIActionList inList);
 		void PutList (DescriptorKeyID inKey, PIActionList inList);
 		
@@ -12,6 +12,7 @@
 #include "PIUActionList.h"
 
 #include "PIUActionControl.h"
+#include "PIUActionZone.h"
 #include "PIUExceptions.h"
 #include "PIUSuites.h"
 
@@ -33,6 +34,17 @@ PIUActionList::PIUActionList (PIActionList inList, bool inOwned)
 
 /******************************************************************************/
 
+PIUActionList::PIUActionList (PIUActionList &&inList)
+	:	fList (inList.fList),
+		fOwned (inList.fOwned)
+	{
+	// Only one of us frees it
+	inList.fList = NULL;
+	inList.fOwned = true;
+	}
+
+/******************************************************************************/
+
 PIUActionList::~PIUActionList ()
 	{
     try
@@ -61,6 +73,24 @@ PIUActionList &PIUActionList::operator= (PIActionList inList)
 
 /******************************************************************************/
 
+PIUActionList &PIUActionList::operator= (PIUActionList &&inList)
+	{
+	if (this != &inList)
+		{
+		Free ();
+		
+		fList = inList.fList;
+		fOwned = inList.fOwned;
+		
+		inList.fList = NULL;
+		inList.fOwned = true;
+		}
+	
+	return *this;
+	}
+
+/******************************************************************************/
+
 PIUActionList::operator bool () const
 	{
 	return (fList != NULL);
@@ -92,6 +122,17 @@ void PIUActionList::Make ()
 
 /******************************************************************************/
 
+void PIUActionList::Make (PIUActionZone &inZone)
+	{
+	Free ();
+	
+	// The zone frees it
+	fList = inZone.MakeList ();
+	fOwned = false;
+	}
+
+/******************************************************************************/
+
 void PIUActionList::Free ()
 	{
 	REQUIRE_NON_NULL (sPSActionList);
@@ -329,6 +370,13 @@ PIActionDescriptor PIUActionList::GetObject (uint32 inIndex)
 
 /******************************************************************************/
 
+PIActionDescriptor PIUActionList::GetObject (uint32 inIndex, PIUActionZone &inZone)
+	{
+	return inZone.Adopt (GetObject (inIndex));
+	}
+
+/******************************************************************************/
+
 void PIUActionList::PutObject (const char *inType, PIActionDescriptor inValue)
 	{
 	PutObject (PIUActionControl::GetStringID (inType), inValue);
@@ -361,6 +409,13 @@ PIActionList PIUActionList::GetList (uint32 inIndex)
 
 /******************************************************************************/
 
+PIActionList PIUActionList::GetList (uint32 inIndex, PIUActionZone &inZone)
+	{
+	return inZone.Adopt (GetList (inIndex));
+	}
+
+/******************************************************************************/
+
 void PIUActionList::PutList (PIActionList inValue)
 	{
 	REQUIRE_NON_NULL_PARAMETER (inValue);
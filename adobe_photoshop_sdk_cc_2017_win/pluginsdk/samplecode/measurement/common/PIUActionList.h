@@ -16,6 +16,8 @@
 
 #include "PIActions.h"
 
+class PIUActionZone;
+
 /**
  * Wrap a PIActionList object to allow for easy creation, automatic 
  * destruction and cleanup, sane parameter validation and error handling 
@@ -23,7 +25,8 @@
  * See PIUExceptions.h for more information about exceptions.
  *
  * The PIActionList may be owned or not.  If owned, then the wrapper takes care
- * of freeing the PIActionList as necessary.
+ * of freeing the PIActionList as necessary.  One made in or got into a
+ * PIUActionZone is owned by the zone, and freed with it.
  */
 class PIUActionList
 	{
@@ -31,15 +34,18 @@ class PIUActionList
 
 		PIUActionList ();
 		PIUActionList (PIActionList inList, bool inOwned = true);
+		PIUActionList (PIUActionList &&inList);
 		virtual ~PIUActionList ();
 		
 		PIUActionList &operator= (PIActionList inList);
+		PIUActionList &operator= (PIUActionList &&inList);
 
 		operator bool () const;
 
 		operator PIActionList () const;
 		
 		void Make ();
+		void Make (PIUActionZone &inZone);
 		void Free ();
 		
 		PIActionList Release ();
@@ -65,10 +71,12 @@ class PIUActionList
 		void PutZString (ASZString inValue);
 		
 		PIActionDescriptor GetObject (uint32 inIndex);
+		PIActionDescriptor GetObject (uint32 inIndex, PIUActionZone &inZone);
 		void PutObject (const char *inType, PIActionDescriptor inValue);
 		void PutObject (DescriptorClassID inType, PIActionDescriptor inValue);
 		
 		PIActionList GetList (uint32 inIndex);
+		PIActionList GetList (uint32 inIndex, PIUActionZone &inZone);
 		void PutList (PIActionList inList);
 		
 		int32 GetDataLength (uint32 inIndex);
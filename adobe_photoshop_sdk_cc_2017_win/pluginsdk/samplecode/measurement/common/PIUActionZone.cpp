@@ -0,0 +1,271 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright 2007 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------------------
+
+#include "PIUActionZone.h"
+
+#include "PIUExceptions.h"
+#include "PIUSuites.h"
+
+// Room for a handful before the first grow
+static const size_t kFirstEntries = 16;
+
+/******************************************************************************/
+
+PIUActionZone::PIUActionZone ()
+	:	fCount (0)
+	{
+	}
+
+/******************************************************************************/
+
+PIUActionZone::PIUActionZone (PIUActionZone &&inZone)
+	:	fEntries (std::move (inZone.fEntries)),
+		fCount (inZone.fCount)
+	{
+	inZone.fEntries.clear ();
+	inZone.fCount = 0;
+	}
+
+/******************************************************************************/
+
+PIUActionZone::~PIUActionZone ()
+	{
+	try
+		{
+		Free ();
+		}
+	catch(...)
+		{
+		; // don't throw in a destructor std::terminate gets called on the mac
+		}
+	}
+
+/******************************************************************************/
+
+PIUActionZone &PIUActionZone::operator= (PIUActionZone &&inZone)
+	{
+	if (this != &inZone)
+		{
+		Free ();
+
+		fEntries.swap (inZone.fEntries);
+		fCount = inZone.fCount;
+
+		inZone.fCount = 0;
+		}
+
+	return *this;
+	}
+
+/******************************************************************************/
+
+PIActionDescriptor PIUActionZone::Adopt (PIActionDescriptor inDescriptor)
+	{
+	Add (inDescriptor, kDescriptor);
+	return inDescriptor;
+	}
+
+/******************************************************************************/
+
+PIActionList PIUActionZone::Adopt (PIActionList inList)
+	{
+	Add (inList, kList);
+	return inList;
+	}
+
+/******************************************************************************/
+
+PIActionReference PIUActionZone::Adopt (PIActionReference inReference)
+	{
+	Add (inReference, kReference);
+	return inReference;
+	}
+
+/******************************************************************************/
+
+PIActionDescriptor PIUActionZone::MakeDescriptor ()
+	{
+	REQUIRE_NON_NULL (sPSActionDescriptor);
+
+	PIActionDescriptor		descriptor = NULL;
+
+	ThrowIfOSErr (sPSActionDescriptor->Make (&descriptor));
+	REQUIRE_NON_NULL (descriptor);
+
+	return Adopt (descriptor);
+	}
+
+/******************************************************************************/
+
+PIActionList PIUActionZone::MakeList ()
+	{
+	REQUIRE_NON_NULL (sPSActionList);
+
+	PIActionList		list = NULL;
+
+	ThrowIfOSErr (sPSActionList->Make (&list));
+	REQUIRE_NON_NULL (list);
+
+	return Adopt (list);
+	}
+
+/******************************************************************************/
+
+PIActionReference PIUActionZone::MakeReference ()
+	{
+	REQUIRE_NON_NULL (sPSActionReference);
+
+	PIActionReference		reference = NULL;
+
+	ThrowIfOSErr (sPSActionReference->Make (&reference));
+	REQUIRE_NON_NULL (reference);
+
+	return Adopt (reference);
+	}
+
+/******************************************************************************/
+
+PIActionDescriptor PIUActionZone::Release (PIActionDescriptor inDescriptor)
+	{
+	Forget (inDescriptor);
+	return inDescriptor;
+	}
+
+/******************************************************************************/
+
+PIActionList PIUActionZone::Release (PIActionList inList)
+	{
+	Forget (inList);
+	return inList;
+	}
+
+/******************************************************************************/
+
+PIActionReference PIUActionZone::Release (PIActionReference inReference)
+	{
+	Forget (inReference);
+	return inReference;
+	}
+
+/******************************************************************************/
+
+void PIUActionZone::Free ()
+	{
+	// Newest first, the way nested scopes would have freed them
+	while (!fEntries.empty ())
+		{
+		Entry	entry = fEntries.back ();
+
+		fEntries.pop_back ();
+
+		if (entry.fObject == NULL)
+			continue;
+
+		fCount--;
+
+		FreeObject (entry.fObject, entry.fKind);
+		}
+	}
+
+/******************************************************************************/
+
+uint32 PIUActionZone::GetCount () const
+	{
+	return fCount;
+	}
+
+/******************************************************************************/
+
+void PIUActionZone::Add (void *inObject, Kind inKind)
+	{
+	REQUIRE_NON_NULL_PARAMETER (inObject);
+
+	// Cannot keep it, so do not lose it either
+	try
+		{
+		MakeRoom ();
+		}
+	catch (...)
+		{
+		FreeObject (inObject, inKind);
+		throw;
+		}
+
+	Entry	entry;
+
+	entry.fObject = inObject;
+	entry.fKind = inKind;
+
+	fEntries.push_back (entry);
+	fCount++;
+	}
+
+/******************************************************************************/
+
+void PIUActionZone::MakeRoom ()
+	{
+	if (fEntries.size () < fEntries.capacity ())
+		return;
+
+	if (fEntries.capacity () < kFirstEntries)
+		fEntries.reserve (kFirstEntries);
+	else
+		fEntries.reserve (fEntries.capacity () * 2);
+	}
+
+/******************************************************************************/
+
+void PIUActionZone::FreeObject (void *inObject, Kind inKind)
+	{
+	switch (inKind)
+		{
+		case kDescriptor:
+			REQUIRE_NON_NULL (sPSActionDescriptor);
+			sPSActionDescriptor->Free ((PIActionDescriptor)inObject);
+			break;
+
+		case kList:
+			REQUIRE_NON_NULL (sPSActionList);
+			sPSActionList->Free ((PIActionList)inObject);
+			break;
+
+		case kReference:
+			REQUIRE_NON_NULL (sPSActionReference);
+			sPSActionReference->Free ((PIActionReference)inObject);
+			break;
+		}
+	}
+
+/******************************************************************************/
+
+void PIUActionZone::Forget (void *inObject)
+	{
+	REQUIRE_NON_NULL_PARAMETER (inObject);
+
+	// Most hand outs are of something just made, so look from the end
+	for (size_t index = fEntries.size (); index > 0; index--)
+		{
+		if (fEntries[index - 1].fObject == inObject)
+			{
+			// The last slot goes, any other is left empty so the order holds
+			if (index == fEntries.size ())
+				fEntries.pop_back ();
+			else
+				fEntries[index - 1].fObject = NULL;
+
+			fCount--;
+			return;
+			}
+		}
+
+	// Not one of ours
+	REQUIRE_PARAMETER (false);
+	}
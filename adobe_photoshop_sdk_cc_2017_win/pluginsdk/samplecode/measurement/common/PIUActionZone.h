@@ -0,0 +1,95 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright 2007 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------------------
+
+#ifndef __PIUActionZone__
+#define __PIUActionZone__
+
+#include <utility>
+#include <vector>
+
+#include "PIActions.h"
+
+/**
+ * Owns any number of PIActionDescriptor, PIActionList and PIActionReference
+ * objects for the life of a scope, and frees them all, newest first, when it
+ * ends.  The objects are kept side by side in one array, so adopting one
+ * costs nothing once the array has grown; Free () keeps the array, so a zone
+ * reused around a loop stops allocating after the first pass.
+ *
+ * A zone can be moved but not copied.  Release () hands an object back to
+ * the caller, who then owns it; the zone forgets it and will not free it.
+ *
+ *		PIUActionZone		zone;
+ *		PIUActionDescriptor	descriptor;
+ *
+ *		descriptor.Make (zone);
+ *		list = descriptor.GetList (kchannelsStr, zone);
+ *		...
+ *		// freed here, list then descriptor
+ */
+class PIUActionZone
+	{
+	public:
+
+		PIUActionZone ();
+		PIUActionZone (PIUActionZone &&inZone);
+		~PIUActionZone ();
+
+		PIUActionZone &operator= (PIUActionZone &&inZone);
+
+		PIActionDescriptor Adopt (PIActionDescriptor inDescriptor);
+		PIActionList Adopt (PIActionList inList);
+		PIActionReference Adopt (PIActionReference inReference);
+
+		PIActionDescriptor MakeDescriptor ();
+		PIActionList MakeList ();
+		PIActionReference MakeReference ();
+
+		PIActionDescriptor Release (PIActionDescriptor inDescriptor);
+		PIActionList Release (PIActionList inList);
+		PIActionReference Release (PIActionReference inReference);
+
+		void Free ();
+
+		uint32 GetCount () const;
+
+	private:
+
+		PIUActionZone (const PIUActionZone &inZone);
+		PIUActionZone &operator= (const PIUActionZone &inZone);
+
+		enum Kind
+			{
+			kDescriptor,
+			kList,
+			kReference
+			};
+
+		struct Entry
+			{
+			void	*fObject;
+			Kind	fKind;
+			};
+
+		void Add (void *inObject, Kind inKind);
+		void MakeRoom ();
+		void Forget (void *inObject);
+
+		static void FreeObject (void *inObject, Kind inKind);
+
+	private:
+
+		std::vector<Entry>	fEntries;
+		uint32				fCount;
+
+	};
+
+#endif /* __PIUActionZone__ */
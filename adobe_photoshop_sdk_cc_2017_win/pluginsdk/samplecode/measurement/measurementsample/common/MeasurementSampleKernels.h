@@ -0,0 +1,292 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright 2007 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------------------
+
+#ifndef __MeasurementSampleKernels__
+#define __MeasurementSampleKernels__
+
+// uint64 is defined by the plug-in before this is included
+#include "PITypes.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define MEASUREMENT_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define MEASUREMENT_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+/**
+ * The inner loops of MeasureTile, for spans of pixels that are next to each
+ * other in memory.  With SSE2 each compares a vector of pixels at once; the
+ * scalar loops after them finish the span, and are all there is elsewhere.
+ * Every kernel gives exactly what testing each pixel in turn gives.
+ */
+
+// Interleaved planes up to this many are counted with vectors
+#define kMeasurementVectorPlanes	16
+
+/******************************************************************************/
+
+static inline uint32 MeasurementCountTrailingZeros (uint32 inValue)
+	{
+#if defined(_MSC_VER)
+	unsigned long		index;
+	_BitScanForward (&index, inValue);
+	return index;
+#else
+	return __builtin_ctz (inValue);
+#endif
+	}
+
+/******************************************************************************/
+
+/**
+ * How many mask pixels from inMask on have the value inFeature, up to
+ * inCount.  Eight mask pixels are compared at a time.
+ *
+ * \param inMask the first mask pixel, which has the value inFeature
+ * \param inCount the pixels left in the row
+ * \param inFeature the mask value of the run
+ */
+static inline int32 MeasurementRunLength (const uint16 *inMask, int32 inCount,
+		uint16 inFeature)
+	{
+	int32		column = 0;
+
+#if MEASUREMENT_SSE2
+	const __m128i	feature = _mm_set1_epi16 ((short)inFeature);
+
+	for (; column + 8 <= inCount; column += 8)
+		{
+		__m128i		same = _mm_cmpeq_epi16 (
+				_mm_loadu_si128 ((const __m128i*)(inMask + column)), feature);
+		uint32		bits = (uint32)_mm_movemask_epi8 (same);
+
+		// Two mask bits per pixel; the first clear one ends the run
+		if (bits != 0xFFFF)
+			return column + MeasurementCountTrailingZeros (~bits) / 2;
+		}
+#endif
+
+	while (column < inCount && inMask[column] == inFeature)
+		column++;
+
+	return column;
+	}
+
+/******************************************************************************/
+
+#if MEASUREMENT_SSE2
+
+/**
+ * For each pixel type: how many pixels to a vector, which lanes of a vector
+ * are not zero (all ones) and how to count them into per-lane counters the
+ * width of the pixel.  A float is not zero as (value != 0) has it, so -0 is
+ * zero and NaN is not.
+ */
+template<class T> struct MeasurementLanes;
+
+template<> struct MeasurementLanes<uint8>
+	{
+	enum { kLanes = 16 };
+	typedef uint8 Counter;
+
+	static __m128i NonZero (const uint8 *inData)
+		{
+		__m128i		zero = _mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i*)inData), _mm_setzero_si128 ());
+		return _mm_xor_si128 (zero, _mm_set1_epi32 (-1));
+		}
+
+	static __m128i Count (__m128i inCounters, __m128i inNonZero)
+		{
+		return _mm_sub_epi8 (inCounters, inNonZero);
+		}
+	};
+
+template<> struct MeasurementLanes<uint16>
+	{
+	enum { kLanes = 8 };
+	typedef uint16 Counter;
+
+	static __m128i NonZero (const uint16 *inData)
+		{
+		__m128i		zero = _mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i*)inData), _mm_setzero_si128 ());
+		return _mm_xor_si128 (zero, _mm_set1_epi32 (-1));
+		}
+
+	static __m128i Count (__m128i inCounters, __m128i inNonZero)
+		{
+		return _mm_sub_epi16 (inCounters, inNonZero);
+		}
+	};
+
+template<> struct MeasurementLanes<float>
+	{
+	enum { kLanes = 4 };
+	typedef uint32 Counter;
+
+	static __m128i NonZero (const float *inData)
+		{
+		return _mm_castps_si128 (_mm_cmpneq_ps (_mm_loadu_ps (inData), _mm_setzero_ps ()));
+		}
+
+	static __m128i Count (__m128i inCounters, __m128i inNonZero)
+		{
+		return _mm_sub_epi32 (inCounters, inNonZero);
+		}
+	};
+
+#endif
+
+/******************************************************************************/
+
+/**
+ * Count the non-zero values of each plane in inPixels pixels of inPlanes
+ * interleaved planes, adding to ioCounts[plane].
+ *
+ * With vectors, the values are taken a period at a time: the fewest whole
+ * vectors that are also whole pixels.  Every lane then always holds the same
+ * plane, so each lane only needs its own counter; the counters are the width
+ * of a pixel value, so they are added into wide ones every 255 periods, and
+ * into the planes at the end.
+ *
+ * \param inData the first plane of the first pixel
+ * \param inPixels how many pixels
+ * \param inPlanes planes per pixel
+ * \param ioCounts one count per plane to add to
+ */
+template<class T> void MeasurementCountNonZero (const T *inData, uint32 inPixels,
+		uint32 inPlanes, uint64 *ioCounts)
+	{
+	size_t		values = (size_t)inPixels * inPlanes;
+	size_t		value = 0;
+
+#if MEASUREMENT_SSE2
+	typedef MeasurementLanes<T>		Lanes;
+
+	// A period is at least a vector, so short runs are all tail
+	if (inPlanes <= kMeasurementVectorPlanes && values >= (size_t)Lanes::kLanes)
+		{
+		uint32		common = Lanes::kLanes;
+		uint32		remainder = inPlanes;
+
+		// Greatest common divisor of the lanes and the planes
+		while (remainder != 0)
+			{
+			uint32		next = common % remainder;
+			common = remainder;
+			remainder = next;
+			}
+
+		uint32		vectors = inPlanes / common;
+		uint32		period = vectors * Lanes::kLanes;
+		size_t		periods = values / period;
+		uint64		laneCounts[kMeasurementVectorPlanes * 16];
+		__m128i		counters[kMeasurementVectorPlanes];
+
+		if (periods > 0)
+			for (uint32 lane = 0; lane < period; lane++)
+				laneCounts[lane] = 0;
+
+		for (size_t left = periods; left > 0; )
+			{
+			size_t		batch = left < 255 ? left : 255;
+
+			for (uint32 vector = 0; vector < vectors; vector++)
+				counters[vector] = _mm_setzero_si128 ();
+
+			for (size_t index = 0; index < batch; index++, value += period)
+				for (uint32 vector = 0; vector < vectors; vector++)
+					counters[vector] = Lanes::Count (counters[vector],
+							Lanes::NonZero (inData + value + vector * Lanes::kLanes));
+
+			for (uint32 vector = 0; vector < vectors; vector++)
+				{
+				typename Lanes::Counter		lanes[Lanes::kLanes];
+
+				_mm_storeu_si128 ((__m128i*)lanes, counters[vector]);
+				for (uint32 lane = 0; lane < Lanes::kLanes; lane++)
+					laneCounts[vector * Lanes::kLanes + lane] += lanes[lane];
+				}
+
+			left -= batch;
+			}
+
+		// A period is whole pixels, so lane L always held plane L % planes
+		if (periods > 0)
+			for (uint32 lane = 0; lane < period; lane++)
+				ioCounts[lane % inPlanes] += laneCounts[lane];
+		}
+#endif
+
+	// And the values after the last whole period, which ended a pixel
+	for (uint32 plane = 0; value < values; value++)
+		{
+		if (inData[value] != 0)
+			ioCounts[plane]++;
+		if (++plane == inPlanes)
+			plane = 0;
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * Mix a 64-bit word into a hash.  Both steps can be undone, so two runs of
+ * words that differ in only one word never hash the same.
+ *
+ * \param inHash the hash so far
+ * \param inWord the word to mix in
+ */
+static inline uint64 MeasurementHashWord (uint64 inHash, uint64 inWord)
+	{
+	uint64		hash = (inHash ^ inWord) * 0x9E3779B97F4A7C15ULL;
+
+	return hash ^ (hash >> 32);
+	}
+
+/******************************************************************************/
+
+/**
+ * Mix bytes into a hash, eight at a time, the last few with their count.
+ *
+ * \param inHash the hash so far
+ * \param inData the bytes
+ * \param inBytes how many bytes
+ */
+static inline uint64 MeasurementHashBytes (uint64 inHash, const uint8 *inData,
+		size_t inBytes)
+	{
+	size_t		byte = 0;
+	uint64		word;
+
+	for (; byte + 8 <= inBytes; byte += 8)
+		{
+		std::memcpy (&word, inData + byte, 8);
+		inHash = MeasurementHashWord (inHash, word);
+		}
+
+	if (byte < inBytes)
+		{
+		word = 0;
+		std::memcpy (&word, inData + byte, inBytes - byte);
+		inHash = MeasurementHashWord (inHash, word ^ ((uint64)(inBytes - byte) << 56));
+		}
+
+	return inHash;
+	}
+
+#endif
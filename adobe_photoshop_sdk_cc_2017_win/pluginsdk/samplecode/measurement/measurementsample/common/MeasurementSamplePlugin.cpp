@@ -11,8 +11,18 @@
 
 #include "PIDefines.h"
 
+#include <algorithm>
+#include <clocale>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "DialogUtilities.h"
@@ -25,6 +35,7 @@
 #include "PIUActionControl.h"
 #include "PIUActionDescriptor.h"
 #include "PIUActionList.h"
+#include "PIUActionZone.h"
 #include "PIUASZString.h"
 #include "PIUExceptions.h"
 #include "PIUMeasurementUtilities.h"
@@ -34,10 +45,42 @@ typedef unsigned long long uint64;
 #define snprintf sprintf_s 
 #endif
 
+#include "MeasurementSampleKernels.h"
+#include "MeasurementSampleStatistics.h"
+
 #define kTileHeight_Default			256
 #define kTileWidth_Default			256
 
+// Tiles are measured on worker threads when there are at least this many
+#define kParallelTiles_Minimum		4
+
+// Tile buffers per worker thread, so the host can fetch ahead of them
+#define kBuffersPerWorker			2
+
+// Runs of a feature shorter than this are measured pixel by pixel
+#define kShortRun_Maximum			8
+
+// The most memory the results of earlier tiles are kept in, to measure again
+#define kTileCache_MaximumBytes		(64 * 1024 * 1024)
+
+// Exported files are written through a buffer this big
+#define kExport_BufferBytes			(64 * 1024)
+
+// The most characters one exported number takes, with its delimiter
+#define kExport_NumberBytes			32
+
+// Whether each exported file has a columnar binary copy beside it
+#define kExport_Columnar			0
+
+// The binary copy's file type and version
+#define kExport_ColumnarSignature	"MSPC"
+#define kExport_ColumnarVersion		1
+#define kExport_ColumnarNameBytes	24
+
 #define kMSP_DataPointDataType_PlanePixelsNonZero_Identifier	"ComAdobeMeasurementSamplePlanePixelsNonZero"
+#define kMSP_DataPointDataType_PlaneValues_Identifier			"ComAdobeMeasurementSamplePlaneValues"
+#define kMSP_DataPointDataType_Histograms_Identifier			"ComAdobeMeasurementSampleHistograms"
+#define kMSP_DataPointDataType_Percentiles_Identifier			"ComAdobeMeasurementSamplePercentiles"
 
 #define kMSP_DataPoint_EdgeTouching_Identifier					"ComAdobeMeasurementSampleEdgeTouching"
 #define kMSP_DataPoint_Foreground_Identifier					"ComAdobeMeasurementSampleForeground"
@@ -45,6 +88,24 @@ typedef unsigned long long uint64;
 #define kMSP_DataPoint_CenterY_Identifier						"ComAdobeMeasurementSampleCenterY"
 #define kMSP_DataPoint_ImagePixelsNonZero_Identifier			"ComAdobeMeasurementSampleImagePixelsNonZero"
 #define kMSP_DataPoint_GrayPixelsNonZero_Identifier				"ComAdobeMeasurementSampleGrayPixelsNonZero"
+#define kMSP_DataPoint_GrayMinimum_Identifier					"ComAdobeMeasurementSampleGrayMinimum"
+#define kMSP_DataPoint_GrayMaximum_Identifier					"ComAdobeMeasurementSampleGrayMaximum"
+#define kMSP_DataPoint_GrayMean_Identifier						"ComAdobeMeasurementSampleGrayMean"
+#define kMSP_DataPoint_GrayStandardDeviation_Identifier			"ComAdobeMeasurementSampleGrayStandardDeviation"
+#define kMSP_DataPoint_GrayMedian_Identifier					"ComAdobeMeasurementSampleGrayMedian"
+#define kMSP_DataPoint_GrayPercentiles_Identifier				"ComAdobeMeasurementSampleGrayPercentiles"
+#define kMSP_DataPoint_GrayHistogram_Identifier					"ComAdobeMeasurementSampleGrayHistogram"
+#define kMSP_DataPoint_ImageMinimum_Identifier					"ComAdobeMeasurementSampleImageMinimum"
+#define kMSP_DataPoint_ImageMaximum_Identifier					"ComAdobeMeasurementSampleImageMaximum"
+#define kMSP_DataPoint_ImageMean_Identifier						"ComAdobeMeasurementSampleImageMean"
+#define kMSP_DataPoint_ImageStandardDeviation_Identifier		"ComAdobeMeasurementSampleImageStandardDeviation"
+#define kMSP_DataPoint_ImageMedian_Identifier					"ComAdobeMeasurementSampleImageMedian"
+#define kMSP_DataPoint_ImagePercentiles_Identifier				"ComAdobeMeasurementSampleImagePercentiles"
+#define kMSP_DataPoint_ImageHistograms_Identifier				"ComAdobeMeasurementSampleImageHistograms"
+
+// The percentiles written for the percentile data points
+static const double kMSP_PercentileLevels[] = { 1, 5, 10, 25, 50, 75, 90, 95, 99 };
+#define kMSP_PercentileLevelCount	(sizeof (kMSP_PercentileLevels) / sizeof (kMSP_PercentileLevels[0]))
 
 typedef enum MeasurementSampleDescriptorKey
 	{
@@ -54,22 +115,125 @@ typedef enum MeasurementSampleDescriptorKey
 	kMSDK_CenterY,
 	kMSDK_ImagePixelsNonZero,
 	kMSDK_GrayPixelsNonZero,
+	kMSDK_GrayMinimum,				// Gray statistics, kMSDK_GrayMinimum to kMSDK_GrayHistogram
+	kMSDK_GrayMaximum,
+	kMSDK_GrayMean,
+	kMSDK_GrayStandardDeviation,
+	kMSDK_GrayMedian,
+	kMSDK_GrayPercentiles,
+	kMSDK_GrayHistogram,
+	kMSDK_ImageMinimum,				// Image statistics, kMSDK_ImageMinimum to kMSDK_ImageHistograms
+	kMSDK_ImageMaximum,
+	kMSDK_ImageMean,
+	kMSDK_ImageStandardDeviation,
+	kMSDK_ImageMedian,
+	kMSDK_ImagePercentiles,
+	kMSDK_ImageHistograms,
 	kMSDK_Last						// Determines size of key list
 	}
 	MeasurementSampleDescriptorKey;
 	
+typedef enum MeasurementSampleStatisticsFlag
+	{
+	kMSSF_None = 0,
+	kMSSF_Gray = 1,					// Minimum, maximum, mean and standard deviation
+	kMSSF_GrayHistogram = 2,		// A histogram too, for the median and percentiles
+	kMSSF_Image = 4,				// The same for each image plane
+	kMSSF_ImageHistogram = 8
+	}
+	MeasurementSampleStatisticsFlag;
+	
 typedef std::map<std::string, MeasurementSampleDescriptorKey>	MeasurementSampleDescriptorMap;
 
 template<class T, class U> class MeasurementSampleData;
+template<class T, class U> class MeasurementTileCache;
+
+/**
+ * One column of an exported data point: a name, for the columnar file, and
+ * its values, which are one line of the text file.
+ */
+typedef struct MeasurementExportColumn
+	{
+	std::string				name;
+	std::vector<double>		values;
+	}
+	MeasurementExportColumn;
+
+/**
+ * The pixels of one tile: its rect and, for each of the image, gray and mask
+ * data, the first pixel and the steps between columns and rows in bytes.  The
+ * data is either the host's response buffers or a copy of them.  Data that was
+ * not requested is NULL.
+ */
+typedef struct MeasurementTile
+	{
+	VRect			rect;
+	const uint8		*imageData;
+	int32			imageColumnBytes;
+	int32			imageRowBytes;
+	const uint8		*grayData;
+	int32			grayColumnBytes;
+	int32			grayRowBytes;
+	const uint8		*maskData;
+	int32			maskColumnBytes;
+	int32			maskRowBytes;
+	}
+	MeasurementTile;
 
 template<class T, class U> void RecordMeasurements (
 		MeasurementRecordRecord *inRecord);
 
+template<class T, class U> const typename MeasurementTileCache<T, U>::Results *MeasureTileCached (
+		const MeasurementTile &inTile, MeasurementTileCache<T, U> &ioCache,
+		std::vector< MeasurementSampleData<T, U> > &ioTileData,
+		typename MeasurementTileCache<T, U>::Results &outResults);
+
+template<class T, class U> void AddTileResults (
+		const typename MeasurementTileCache<T, U>::Results &inResults,
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData);
+
 template<class T, class U> void MeasureTile (
-		const MeasurementRecordRecord *inRecord, 
-		MeasurementSampleData<T, U> &ioSummaryData, 
+		const MeasurementTile &inTile, 
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData);
+
+template<class T, class U, bool kImage, bool kGray> void MeasureTileRuns (
+		const MeasurementTile &inTile, uint32 inImagePlanes,
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData);
+
+template<class T, class U> void MeasureTilePixels (
+		const MeasurementTile &inTile, 
 		std::vector< MeasurementSampleData<T, U> > &ioFeatureData);
 
+static MeasurementTile GetResponseTile (const MeasurementRecordRecord *inRecord);
+
+static uint64 HashTile (const MeasurementTile &inTile, uint32 inImagePixelBytes,
+		uint32 inGrayPixelBytes);
+
+static uint64 HashTileData (uint64 inHash, const uint8 *inData, int32 inColumnBytes,
+		int32 inRowBytes, uint32 inPixelBytes, const VRect &inRect);
+
+static uint32 GetWorkerCount (const MeasurementPrepareRecord *inRecord);
+
+template<class T, class U> static uint64 GetSpaceReserve (
+		const MeasurementPrepareRecord *inRecord, uint32 inStatistics);
+
+template<class T, class U> static uint64 GetFeatureDataSize (uint16 inImagePlanes,
+		uint32 inStatistics, uint64 inFeatures, uint64 inPixels);
+
+static void GetDescriptorKeys (const MeasurementPrepareRecord *inRecord,
+		DescriptorKeyID outDescriptorKeys[]);
+
+static uint32 GetStatistics (const DescriptorKeyID inDescriptorKeys[]);
+
+static void RegisterDataPoint (PIUActionList &ioList, const char *inIdentifier,
+		const char *inTypeIdentifier, const char *inName, 
+		const char *inAbbreviatedName, const char *inDescription);
+
+static void GetExportColumn (PIUActionList &inList, const std::string &inName,
+		MeasurementExportColumn &outColumn);
+
+static char *FormatExportNumber (double inValue, char *outText);
+
 SPBasicSuite *sSPBasic = NULL;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -84,16 +248,31 @@ template<class T, class U> class MeasurementSampleData
 	{
 	public:
 	
-		static uint32 GetDataSize (uint16 inImagePlanes);
+		static uint32 GetDataSize (uint16 inImagePlanes, uint32 inStatistics, uint32 inBlocks);
 		
 	public:
 
-		MeasurementSampleData (uint16 inImagePlanes);
+		MeasurementSampleData (uint16 inImagePlanes, uint32 inStatistics = kMSSF_None);
+		MeasurementSampleData (const MeasurementSampleData &inData);
 		virtual ~MeasurementSampleData ();
 		
+		MeasurementSampleData &operator= (const MeasurementSampleData &inData);
+		
+		uint16 GetImagePlanes () const;
+		uint32 GetStatistics () const;
+		bool HasData () const;
+		size_t GetAllocatedSize () const;
+
 		void Record (int32 inRow, int32 inColumn, uint16 inFeature,
 				T *inImageData, T *inGrayData);
 
+		void RecordRun (int32 inRow, int32 inColumnFirst, int32 inColumnLast,
+				uint16 inFeature, const uint64 *inImagePixelsNonZero, 
+				bool inHasGrayData, uint64 inGrayPixelsNonZero);
+
+		void RecordValues (const T *inImageData, const T *inGrayData, 
+				int32 inPixels);
+
 		void Add (const MeasurementSampleData &inData);
 		
 		void Write (const DescriptorKeyID inDescriptorKeys[],
@@ -107,6 +286,20 @@ template<class T, class U> class MeasurementSampleData
 		void WriteImagePixelsNonZero (PIUActionDescriptor &inDescriptor, 
 				DescriptorKeyID inKey);
 		
+		void WritePlaneValues (PIUActionDescriptor &inDescriptor, 
+				DescriptorKeyID inKey, uint32 inStatistic);
+		
+		void WritePercentiles (PIUActionDescriptor &inDescriptor, 
+				DescriptorKeyID inKey, const MeasurementStatistics<T, U> *inStatistics,
+				uint32 inCount);
+		
+		void WriteHistograms (PIUActionDescriptor &inDescriptor, 
+				DescriptorKeyID inKey, const MeasurementStatistics<T, U> *inStatistics,
+				uint32 inCount);
+		
+		static double GetStatistic (const MeasurementStatistics<T, U> &inStatistics,
+				uint32 inStatistic);
+		
 	private:
 
 		MeasurementSampleData ();
@@ -125,15 +318,35 @@ template<class T, class U> class MeasurementSampleData
 		uint64					*fImagePixelsNonZero;
 		bool					fHasGrayData;
 		uint64					fGrayPixelsNonZero;
+		uint32					fStatistics;
+		std::vector< MeasurementStatistics<T, U> >	fImageStatistics;
+		MeasurementStatistics<T, U>					fGrayStatistics;
 		
 	};
 
 //////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * The memory a MeasurementSampleData object takes.  Histograms grow with the
+ * range of values in the feature, up to MeasurementHistogram::GetBlockCount
+ * blocks each, so the caller says how many blocks to count.
+ *
+ * \param inImagePlanes the number of image planes
+ * \param inStatistics the statistics asked for, kMSSF_ flags
+ * \param inBlocks the number of blocks in each histogram
+ */
 template <class T, class U> uint32 MeasurementSampleData<T, U>::GetDataSize (
-		uint16 inImagePlanes)
+		uint16 inImagePlanes, uint32 inStatistics, uint32 inBlocks)
 	{
-	return sizeof (MeasurementSampleData<T, U>) + sizeof (uint64) * inImagePlanes;
+	uint32		dataSize = sizeof (MeasurementSampleData<T, U>) + sizeof (uint64) * inImagePlanes;
+	
+	if ((inStatistics & kMSSF_Image) != 0)
+		dataSize += inImagePlanes * MeasurementStatistics<T, U>::GetDataSize (
+				(inStatistics & kMSSF_ImageHistogram) != 0, inBlocks);
+	if ((inStatistics & kMSSF_GrayHistogram) != 0)
+		dataSize += MeasurementHistogram<T>::GetDataSize (inBlocks);
+		
+	return dataSize;
 	}
 
 /******************************************************************************/
@@ -141,13 +354,16 @@ template <class T, class U> uint32 MeasurementSampleData<T, U>::GetDataSize (
 /**
  * Construct the MeasurementSampleData object for a particular feature.  The only
  * necessary argument is the number of planes in the image.  This is used for
- * the image pixels non zero data.
+ * the image pixels non zero data.  The statistics of the pixel values are only
+ * kept if they are asked for.
  *
  * Initialize the row and column to opposite limits.
  *
  * \param inImagePlanes the number of planes in the original image
+ * \param inStatistics the statistics to keep (MeasurementSampleStatisticsFlag)
  */
-template <class T, class U> MeasurementSampleData<T, U>::MeasurementSampleData (uint16 inImagePlanes)
+template <class T, class U> MeasurementSampleData<T, U>::MeasurementSampleData (
+		uint16 inImagePlanes, uint32 inStatistics)
 	:	fImagePlanes (inImagePlanes),
 		fHasData (false),
 		fEdgeTouching (false),
@@ -159,8 +375,74 @@ template <class T, class U> MeasurementSampleData<T, U>::MeasurementSampleData (
 		fHasImageData (false),
 		fImagePixelsNonZero (NULL),
 		fHasGrayData (false),
-		fGrayPixelsNonZero (0)
+		fGrayPixelsNonZero (0),
+		fStatistics (inStatistics),
+		fImageStatistics ((inStatistics & kMSSF_Image) != 0 ? inImagePlanes : 0,
+				MeasurementStatistics<T, U> ((inStatistics & kMSSF_ImageHistogram) != 0)),
+		fGrayStatistics ((inStatistics & kMSSF_GrayHistogram) != 0)
+	{
+	}
+	
+/******************************************************************************/
+
+/**
+ * Copy the object, including its own copy of the image pixels non zero array
+ * and of the statistics.
+ *
+ * \param inData the object to copy
+ */
+template <class T, class U> MeasurementSampleData<T, U>::MeasurementSampleData (
+		const MeasurementSampleData &inData)
+	:	fImagePlanes (inData.fImagePlanes),
+		fImagePixelsNonZero (NULL)
+	{
+	*this = inData;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Assign the object, including its own copy of the image pixels non zero array
+ * and of the statistics.
+ *
+ * \param inData the object to copy
+ */
+template <class T, class U> MeasurementSampleData<T, U> &MeasurementSampleData<T, U>::operator= (
+		const MeasurementSampleData &inData)
 	{
+	if (this == &inData)
+		return *this;
+		
+	std::vector< MeasurementStatistics<T, U> >	imageStatistics (inData.fImageStatistics);
+	MeasurementStatistics<T, U>					grayStatistics (inData.fGrayStatistics);
+	uint64										*imagePixelsNonZero = NULL;
+	
+	// Copy the statistics and array first, so a failure leaves this object as it was
+	if (inData.fImagePixelsNonZero != NULL)
+		{
+		imagePixelsNonZero = new uint64 [inData.fImagePlanes];
+		std::memcpy (imagePixelsNonZero, inData.fImagePixelsNonZero, sizeof(uint64) * inData.fImagePlanes);
+		}
+		
+	delete [] fImagePixelsNonZero;
+	
+	fImagePlanes = inData.fImagePlanes;
+	fHasData = inData.fHasData;
+	fEdgeTouching = inData.fEdgeTouching;
+	fForeground = inData.fForeground;
+	fRowMinimum = inData.fRowMinimum;
+	fRowMaximum = inData.fRowMaximum;
+	fColumnMinimum = inData.fColumnMinimum;
+	fColumnMaximum = inData.fColumnMaximum;
+	fHasImageData = inData.fHasImageData;
+	fImagePixelsNonZero = imagePixelsNonZero;
+	fHasGrayData = inData.fHasGrayData;
+	fGrayPixelsNonZero = inData.fGrayPixelsNonZero;
+	fStatistics = inData.fStatistics;
+	fImageStatistics.swap (imageStatistics);
+	std::swap (fGrayStatistics, grayStatistics);
+	
+	return *this;
 	}
 	
 /******************************************************************************/
@@ -179,6 +461,56 @@ template <class T, class U> MeasurementSampleData<T, U>::~MeasurementSampleData
 
 /******************************************************************************/
 
+/**
+ * The number of image planes each pixel has.
+ */
+template <class T, class U> uint16 MeasurementSampleData<T, U>::GetImagePlanes () const
+	{
+	return fImagePlanes;
+	}
+
+/******************************************************************************/
+
+/**
+ * The statistics kept (MeasurementSampleStatisticsFlag).
+ */
+template <class T, class U> uint32 MeasurementSampleData<T, U>::GetStatistics () const
+	{
+	return fStatistics;
+	}
+
+/******************************************************************************/
+
+/**
+ * Whether any pixel has been recorded or added.
+ */
+template <class T, class U> bool MeasurementSampleData<T, U>::HasData () const
+	{
+	return fHasData;
+	}
+
+/******************************************************************************/
+
+/**
+ * The memory this object has, beyond its own size, counting the histogram
+ * blocks it has actually made.
+ */
+template <class T, class U> size_t MeasurementSampleData<T, U>::GetAllocatedSize () const
+	{
+	size_t		size = fImageStatistics.capacity () * sizeof (MeasurementStatistics<T, U>) +
+						fGrayStatistics.GetAllocatedSize ();
+	
+	if (fImagePixelsNonZero != NULL)
+		size += sizeof (uint64) * fImagePlanes;
+		
+	for (size_t index = 0; index < fImageStatistics.size (); index++)
+		size += fImageStatistics[index].GetAllocatedSize ();
+		
+	return size;
+	}
+
+/******************************************************************************/
+
 /**
  * Record information about a specific pixels known to be in the feature associated
  * with this data object.
@@ -232,6 +564,10 @@ template <class T, class U> void MeasurementSampleData<T, U>::Record (
 		for (uint32 index = 0; index < fImagePlanes; index++)
 			if (inImageData[index] != 0)
 				fImagePixelsNonZero[index]++;
+				
+		// Account for the value of each plane, if asked for
+		for (uint32 index = 0; index < fImageStatistics.size (); index++)
+			fImageStatistics[index].Add (inImageData[index]);
 		}
 
 	// If we have any gray data
@@ -243,7 +579,94 @@ template <class T, class U> void MeasurementSampleData<T, U>::Record (
 		// Account for the pixel that is non zero
 		if (*inGrayData != 0)
 			fGrayPixelsNonZero++;
+			
+		// Account for its value, if asked for
+		if ((fStatistics & kMSSF_Gray) != 0)
+			fGrayStatistics.Add (*inGrayData);
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * Record a run of pixels in one row, all known to be in the feature associated
+ * with this data object.  This is the same as calling Record for each of them,
+ * with the non zero planes already counted.
+ *
+ * \param inRow the y coordinate of the pixels in the image
+ * \param inColumnFirst the x coordinate of the first pixel in the image
+ * \param inColumnLast the x coordinate of the last pixel in the image
+ * \param inFeature the feature itself (id + background flag + edge touching flag)
+ * \param inImagePixelsNonZero non zero pixels of each image plane, or NULL if no image data
+ * \param inHasGrayData whether there is gray data
+ * \param inGrayPixelsNonZero non zero gray pixels
+ */
+template <class T, class U> void MeasurementSampleData<T, U>::RecordRun (
+		int32 inRow, int32 inColumnFirst, int32 inColumnLast, uint16 inFeature,
+		const uint64 *inImagePixelsNonZero, bool inHasGrayData, 
+		uint64 inGrayPixelsNonZero)
+	{
+	// We have data
+	fHasData = true;
+	
+	// Is it edge touching? Is it foreground?
+	fEdgeTouching = ((inFeature & featureMaskEdgeTouchingMask) != 0);
+	fForeground = ((inFeature & featureMaskForegroundMask) != 0);
+	
+	// Account for row and both ends of the run
+	if (fRowMinimum > inRow)
+		fRowMinimum = inRow;
+	if (fRowMaximum < inRow)
+		fRowMaximum = inRow;
+	if (fColumnMinimum > inColumnFirst)
+		fColumnMinimum = inColumnFirst;
+	if (fColumnMaximum < inColumnLast)
+		fColumnMaximum = inColumnLast;
+		
+	// If we have any image data
+	if (inImagePixelsNonZero != NULL)
+		{
+		fHasImageData = true;
+		
+		if (fImagePixelsNonZero == NULL)
+			{
+			fImagePixelsNonZero = new uint64 [fImagePlanes];
+			std::memset (fImagePixelsNonZero, 0, sizeof(uint64) * fImagePlanes);
+			}
+		
+		for (uint32 index = 0; index < fImagePlanes; index++)
+			fImagePixelsNonZero[index] += inImagePixelsNonZero[index];
 		}
+
+	// If we have any gray data
+	if (inHasGrayData)
+		{
+		fHasGrayData = true;
+		fGrayPixelsNonZero += inGrayPixelsNonZero;
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * Record the values of a run of pixels given to RecordRun, for the statistics
+ * that were asked for.
+ *
+ * \param inImageData the image pixel data of the first pixel ('fImagePlanes' planes each), or NULL
+ * \param inGrayData the gray pixel data of the first pixel, or NULL
+ * \param inPixels the number of pixels in the run
+ */
+template <class T, class U> void MeasurementSampleData<T, U>::RecordValues (
+		const T *inImageData, const T *inGrayData, int32 inPixels)
+	{
+	if (inImageData != NULL && !fImageStatistics.empty ())
+		for (int32 pixel = 0; pixel < inPixels; pixel++, inImageData += fImagePlanes)
+			for (uint32 index = 0; index < fImagePlanes; index++)
+				fImageStatistics[index].Add (inImageData[index]);
+				
+	if (inGrayData != NULL && (fStatistics & kMSSF_Gray) != 0)
+		for (int32 pixel = 0; pixel < inPixels; pixel++)
+			fGrayStatistics.Add (inGrayData[pixel]);
 	}
 
 /******************************************************************************/
@@ -299,6 +722,11 @@ template <class T, class U> void MeasurementSampleData<T, U>::Add (
 		// Account for each plane in the pixel that is non zero	
 		for (uint32 index = 0; index < fImagePlanes; index++)
 			fImagePixelsNonZero[index] += inData.fImagePixelsNonZero[index];
+			
+		// Account for the values of each plane, histograms included
+		if (fImageStatistics.size () == inData.fImageStatistics.size ())
+			for (uint32 index = 0; index < fImageStatistics.size (); index++)
+				fImageStatistics[index].Add (inData.fImageStatistics[index]);
 		}
 		
 	// If the object has gray data
@@ -309,6 +737,10 @@ template <class T, class U> void MeasurementSampleData<T, U>::Add (
 		
 		// Account for gray pixels non zero
 		fGrayPixelsNonZero += inData.fGrayPixelsNonZero;
+		
+		// Account for the gray values, histogram included
+		if ((fStatistics & inData.fStatistics & kMSSF_Gray) != 0)
+			fGrayStatistics.Add (inData.fGrayStatistics);
 		}
 	}
 
@@ -380,6 +812,57 @@ template <class T, class U> void MeasurementSampleData<T, U>::Write (
 					descriptor.PutFloat (descriptorKey, (double)fGrayPixelsNonZero);
 				break;
 
+			case kMSDK_GrayMinimum:
+			case kMSDK_GrayMaximum:
+			case kMSDK_GrayMean:
+			case kMSDK_GrayStandardDeviation:
+			case kMSDK_GrayMedian:
+				if (!fHasGrayData)
+					WriteError (descriptor, descriptorKey, "Image mode not supported.");
+				else
+					descriptor.PutFloat (descriptorKey, GetStatistic (fGrayStatistics, index));
+				break;
+				
+			case kMSDK_GrayPercentiles:
+				if (!fHasGrayData)
+					WriteError (descriptor, descriptorKey, "Image mode not supported.");
+				else
+					WritePercentiles (descriptor, descriptorKey, &fGrayStatistics, 1);
+				break;
+				
+			case kMSDK_GrayHistogram:
+				if (!fHasGrayData)
+					WriteError (descriptor, descriptorKey, "Image mode not supported.");
+				else
+					WriteHistograms (descriptor, descriptorKey, &fGrayStatistics, 1);
+				break;
+				
+			case kMSDK_ImageMinimum:
+			case kMSDK_ImageMaximum:
+			case kMSDK_ImageMean:
+			case kMSDK_ImageStandardDeviation:
+			case kMSDK_ImageMedian:
+				if (!fHasImageData)
+					WriteError (descriptor, descriptorKey, "Image mode not supported.");
+				else
+					WritePlaneValues (descriptor, descriptorKey, index);
+				break;
+				
+			case kMSDK_ImagePercentiles:
+				if (!fHasImageData)
+					WriteError (descriptor, descriptorKey, "Image mode not supported.");
+				else
+					WritePercentiles (descriptor, descriptorKey, 
+							fImageStatistics.data (), (uint32)fImageStatistics.size ());
+				break;
+				
+			case kMSDK_ImageHistograms:
+				if (!fHasImageData)
+					WriteError (descriptor, descriptorKey, "Image mode not supported.");
+				else
+					WriteHistograms (descriptor, descriptorKey, 
+							fImageStatistics.data (), (uint32)fImageStatistics.size ());
+				break;
 			}
 		}
 		
@@ -458,62 +941,1109 @@ template <class T, class U> void MeasurementSampleData<T, U>::WriteImagePixelsNo
 			imagePixelsNonZeroDescriptor);
 	}
 	
-////////////////////////////////////////////////////////////////////////////////
+/******************************************************************************/
 
-class MeasurementSamplePlugin
+/**
+ * Write one statistic of each image plane, as a descriptor with a list of
+ * float values, one for each plane, like the plane pixels non zero data.
+ *
+ * \param inDescriptor the output descriptor to write the values descriptor to
+ * \param inKey the key to use for the data point to write the values descriptor to
+ * \param inStatistic the data point, one of kMSDK_ImageMinimum to kMSDK_ImageMedian
+ */
+template <class T, class U> void MeasurementSampleData<T, U>::WritePlaneValues (
+		PIUActionDescriptor &inDescriptor, DescriptorKeyID inKey, uint32 inStatistic)
 	{
-	public:
-		
-		MeasurementSamplePlugin ();
-		virtual ~MeasurementSamplePlugin ();
-		
-		void HandleSelector (int16 inSelector, void *inRecord);
-		
-	private:
+	REQUIRE_PARAMETER (inDescriptor);
 	
-		void HandleSelectorAbout (AboutRecord *inRecord);
-		void HandleSelectorRegisterDataPointDataTypes (MeasurementRegisterRecord *inRecord);
-		void HandleSelectorRegisterDataPoints (MeasurementRegisterRecord *inRecord);
-		void HandleSelectorPrepareMeasurements (MeasurementPrepareRecord *inRecord);
-		void HandleSelectorRecordMeasurements (MeasurementRecordRecord *inRecord);
-		void HandleSelectorExportMeasurement (MeasurementExportRecord *inRecord);
-		
-		void WriteFile (const std::string &inOutput,
-				const SPPlatformFileSpecificationW &inDataDirectory,
-				PIUASZString &outFilename);
-				
-	private:
-
-		MeasurementSamplePlugin (MeasurementSamplePlugin &);
-		
-	};
-
-////////////////////////////////////////////////////////////////////////////////
+	PIUActionList				channelList;
+	PIUActionDescriptor			valuesDescriptor;
+	
+	// One value for each plane
+	channelList.Make ();
+	for (uint32 index = 0; index < fImageStatistics.size (); index++)
+		channelList.PutFloat (GetStatistic (fImageStatistics[index], inStatistic));
 
-MeasurementSamplePlugin::MeasurementSamplePlugin ()
-	{
+	valuesDescriptor.Make ();
+	valuesDescriptor.PutList (kchannelsStr, channelList);
+	
+	inDescriptor.PutObject (inKey, 
+			PIUActionControl::GetStringID (kmeasurementLogDataPointDataClassStr), 
+			valuesDescriptor);
 	}
-
+	
 /******************************************************************************/
 
-MeasurementSamplePlugin::~MeasurementSamplePlugin () 
+/**
+ * Write the percentiles of each plane.  The descriptor has the percentiles in
+ * a list of floats (kMSP_PercentileLevels) and a list with, for each plane, a
+ * list of the values at those percentiles.
+ *
+ * \param inDescriptor the output descriptor to write the percentiles descriptor to
+ * \param inKey the key to use for the data point to write the percentiles descriptor to
+ * \param inStatistics the statistics of each plane
+ * \param inCount the number of planes
+ */
+template <class T, class U> void MeasurementSampleData<T, U>::WritePercentiles (
+		PIUActionDescriptor &inDescriptor, DescriptorKeyID inKey, 
+		const MeasurementStatistics<T, U> *inStatistics, uint32 inCount)
 	{
+	REQUIRE_PARAMETER (inDescriptor);
+	
+	// Everything made here goes with the zone, a list for each plane included
+	PIUActionZone				zone;
+	PIUActionList				levelList;
+	PIUActionList				channelList;
+	PIUActionDescriptor			percentilesDescriptor;
+	
+	// The percentiles
+	levelList.Make (zone);
+	for (uint32 level = 0; level < kMSP_PercentileLevelCount; level++)
+		levelList.PutFloat (kMSP_PercentileLevels[level]);
+		
+	// The values at them, for each plane
+	channelList.Make (zone);
+	for (uint32 index = 0; index < inCount; index++)
+		{
+		PIUActionList		valueList;
+		
+		valueList.Make (zone);
+		for (uint32 level = 0; level < kMSP_PercentileLevelCount; level++)
+			valueList.PutFloat (inStatistics[index].GetPercentile (kMSP_PercentileLevels[level]));
+			
+		channelList.PutList (valueList);
+		}
+
+	percentilesDescriptor.Make (zone);
+	percentilesDescriptor.PutList (klevelsStr, levelList);
+	percentilesDescriptor.PutList (kchannelsStr, channelList);
+	
+	inDescriptor.PutObject (inKey, 
+			PIUActionControl::GetStringID (kmeasurementLogDataPointDataClassStr), 
+			percentilesDescriptor);
 	}
 	
 /******************************************************************************/
 
 /**
- * Simply switch on the selector and cast the record to the appropriate type.
+ * Write the histogram of each plane.  The descriptor has a list with, for each
+ * plane, a list of kHistogramDisplayBins float counts, 16 and 32-bit values
+ * being put in 256 levels as the Histogram panel does.
  *
- * /param inSelector the selector to invoke in the plugin
- * /param inRecord the record associated with the selector
+ * \param inDescriptor the output descriptor to write the histograms descriptor to
+ * \param inKey the key to use for the data point to write the histograms descriptor to
+ * \param inStatistics the statistics of each plane
+ * \param inCount the number of planes
  */
-void MeasurementSamplePlugin::HandleSelector (int16 inSelector, void *inRecord)
+template <class T, class U> void MeasurementSampleData<T, U>::WriteHistograms (
+		PIUActionDescriptor &inDescriptor, DescriptorKeyID inKey, 
+		const MeasurementStatistics<T, U> *inStatistics, uint32 inCount)
 	{
-	switch (inSelector)
-		{
-		case measurementSelectorAbout:
-			sSPBasic = ((AboutRecord*)inRecord)->sSPBasic;
+	REQUIRE_PARAMETER (inDescriptor);
+	
+	// Everything made here goes with the zone, a list for each plane included
+	PIUActionZone				zone;
+	PIUActionList				channelList;
+	PIUActionDescriptor			histogramsDescriptor;
+	uint64						counts[kHistogramDisplayBins];
+	
+	channelList.Make (zone);
+	for (uint32 index = 0; index < inCount; index++)
+		{
+		PIUActionList		countList;
+		
+		inStatistics[index].GetHistogram (counts);
+		
+		countList.Make (zone);
+		for (uint32 bin = 0; bin < kHistogramDisplayBins; bin++)
+			countList.PutFloat ((double)counts[bin]);
+			
+		channelList.PutList (countList);
+		}
+
+	histogramsDescriptor.Make (zone);
+	histogramsDescriptor.PutList (kchannelsStr, channelList);
+	
+	inDescriptor.PutObject (inKey, 
+			PIUActionControl::GetStringID (kmeasurementLogDataPointDataClassStr), 
+			histogramsDescriptor);
+	}
+	
+/******************************************************************************/
+
+/**
+ * One statistic of one plane, by its data point.
+ *
+ * \param inStatistics the statistics of the plane
+ * \param inStatistic the data point, a gray or image minimum, maximum, mean, standard deviation or median
+ */
+template <class T, class U> double MeasurementSampleData<T, U>::GetStatistic (
+		const MeasurementStatistics<T, U> &inStatistics, uint32 inStatistic)
+	{
+	switch (inStatistic)
+		{
+		case kMSDK_GrayMinimum:
+		case kMSDK_ImageMinimum:
+			return inStatistics.GetMinimum ();
+			
+		case kMSDK_GrayMaximum:
+		case kMSDK_ImageMaximum:
+			return inStatistics.GetMaximum ();
+			
+		case kMSDK_GrayMean:
+		case kMSDK_ImageMean:
+			return inStatistics.GetMean ();
+			
+		case kMSDK_GrayStandardDeviation:
+		case kMSDK_ImageStandardDeviation:
+			return inStatistics.GetStandardDeviation ();
+			
+		case kMSDK_GrayMedian:
+		case kMSDK_ImageMedian:
+			return inStatistics.GetPercentile (50);
+		}
+		
+	ThrowLogicErrorDetailed ("Unknown statistic.");
+	return 0;
+	}
+	
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A copy of a tile's pixels, so it can be measured after the host has moved on
+ * to the next tile.  The buffers are kept from one copy to the next.
+ */
+class MeasurementTileBuffer
+	{
+	public:
+	
+		void Copy (const MeasurementRecordRecord *inRecord, uint32 inImagePixelBytes,
+				uint32 inGrayPixelBytes);
+		
+		const MeasurementTile &GetTile () const { return fTile; }
+		
+	private:
+	
+		static const uint8 *CopyData (const void *inData, int32 inColumnBytes,
+				int32 inRowBytes, uint32 inPixelBytes, const VRect &inRect,
+				std::vector<uint8> &ioBuffer, int32 &outColumnBytes, int32 &outRowBytes);
+	
+	private:
+	
+		MeasurementTile				fTile;
+		std::vector<uint8>			fImage;
+		std::vector<uint8>			fGray;
+		std::vector<uint8>			fMask;
+		
+	};
+	
+/******************************************************************************/
+
+/**
+ * Copy the tile in the record's response fields.  Only the bytes of each pixel
+ * that MeasureTile reads are copied, keeping the host's column and row steps.
+ *
+ * \param inRecord the record with the tile the host just delivered
+ * \param inImagePixelBytes bytes read for each image pixel
+ * \param inGrayPixelBytes bytes read for each gray pixel
+ */
+void MeasurementTileBuffer::Copy (const MeasurementRecordRecord *inRecord,
+		uint32 inImagePixelBytes, uint32 inGrayPixelBytes)
+	{
+	REQUIRE_NON_NULL_PARAMETER (inRecord);
+	
+	fTile.rect = inRecord->requestImageRect;
+	
+	fTile.imageData = CopyData (inRecord->responseImageData,
+			inRecord->responseImageColumnBytes, inRecord->responseImageRowBytes,
+			inImagePixelBytes, fTile.rect, fImage,
+			fTile.imageColumnBytes, fTile.imageRowBytes);
+			
+	fTile.grayData = CopyData (inRecord->responseGrayData,
+			inRecord->responseGrayColumnBytes, inRecord->responseGrayRowBytes,
+			inGrayPixelBytes, fTile.rect, fGray,
+			fTile.grayColumnBytes, fTile.grayRowBytes);
+			
+	fTile.maskData = CopyData (inRecord->responseMaskData,
+			inRecord->responseMaskColumnBytes, inRecord->responseMaskRowBytes,
+			sizeof (uint16), fTile.rect, fMask,
+			fTile.maskColumnBytes, fTile.maskRowBytes);
+	}
+	
+/******************************************************************************/
+
+/**
+ * Copy one of the image, gray or mask data of a tile into a buffer.  Each row
+ * is copied from its first pixel to the end of its last one, so nothing past
+ * the host's data is read.
+ *
+ * \return the copy, or NULL (with zero steps) if there is no data
+ */
+const uint8 *MeasurementTileBuffer::CopyData (const void *inData, int32 inColumnBytes,
+		int32 inRowBytes, uint32 inPixelBytes, const VRect &inRect,
+		std::vector<uint8> &ioBuffer, int32 &outColumnBytes, int32 &outRowBytes)
+	{
+	int32		width = inRect.right - inRect.left;
+	int32		height = inRect.bottom - inRect.top;
+	
+	outColumnBytes = 0;
+	outRowBytes = 0;
+	
+	if (inData == NULL || width <= 0 || height <= 0)
+		return NULL;
+		
+	size_t		rowSpan = (size_t)(width - 1) * inColumnBytes + inPixelBytes;
+	
+	ioBuffer.resize (rowSpan * height);
+	
+	for (int32 row = 0; row < height; row++)
+		std::memcpy (&ioBuffer[row * rowSpan],
+				((const uint8*)inData) + (ptrdiff_t)row * inRowBytes, rowSpan);
+				
+	outColumnBytes = inColumnBytes;
+	outRowBytes = (int32)rowSpan;
+	
+	return &ioBuffer[0];
+	}
+	
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The results of the tiles measured last time, kept from one measurement to
+ * the next, so that re-measuring after a small edit only measures the tiles
+ * that changed.  A tile is known by a hash of its rect and of the mask, image
+ * and gray bytes MeasureTile reads; its results are the feature data of each
+ * feature in it, which only depend on those.  Cached results are added in
+ * the same tile order as measured ones, so a measurement that uses them is
+ * the same as one that does not.  They are for one set of image planes,
+ * statistics and features, so a measurement of any other starts again with
+ * nothing.
+ *
+ * Begin and End are called on the host thread around a measurement; Find and
+ * Insert on any thread in between.  Entries are never removed in between, so
+ * the results Find returns stay put while they are added without the lock.
+ * End drops every entry the measurement did not use, and Insert keeps nothing
+ * past kTileCache_MaximumBytes, counting the histogram blocks each entry has.
+ */
+template<class T, class U> class MeasurementTileCache
+	{
+	public:
+	
+		typedef std::vector< std::pair< uint32, MeasurementSampleData<T, U> > >	Results;
+		
+		static MeasurementTileCache &Get ();
+		
+	public:
+	
+		void Begin (const MeasurementSampleData<T, U> &inEmptyData, size_t inFeatureCount);
+		void End ();
+		
+		const MeasurementSampleData<T, U> &GetEmptyData () const { return *fEmptyData; }
+		
+		const Results *Find (uint64 inHash, const VRect &inRect);
+		const Results *Insert (uint64 inHash, const VRect &inRect, Results &ioResults);
+		
+	private:
+	
+		MeasurementTileCache ();
+		
+		MeasurementTileCache (const MeasurementTileCache &);
+		MeasurementTileCache &operator= (const MeasurementTileCache &);
+		
+	private:
+	
+		typedef struct Entry
+			{
+			VRect			rect;
+			uint64			generation;
+			size_t			bytes;
+			Results			results;
+			}
+			Entry;
+			
+	private:
+	
+		std::unique_ptr< MeasurementSampleData<T, U> >	fEmptyData;
+		size_t											fFeatureCount;
+		uint64											fGeneration;
+		size_t											fBytes;
+		std::unordered_map<uint64, Entry>				fEntries;
+		std::mutex										fMutex;
+		
+	};
+	
+/******************************************************************************/
+
+/**
+ * The cache for one pixel type.
+ */
+template<class T, class U> MeasurementTileCache<T, U> &MeasurementTileCache<T, U>::Get ()
+	{
+	static MeasurementTileCache		sCache;
+	
+	return sCache;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Construct an empty cache.
+ */
+template<class T, class U> MeasurementTileCache<T, U>::MeasurementTileCache ()
+	:	fFeatureCount (0),
+		fGeneration (0),
+		fBytes (0)
+	{
+	}
+	
+/******************************************************************************/
+
+/**
+ * Start a measurement.  The entries are kept if they were measured with the
+ * same image planes, statistics and features, and dropped if not.  Host thread
+ * only.
+ *
+ * \param inEmptyData the feature data, with nothing recorded, each feature starts with
+ * \param inFeatureCount the number of features in the mask
+ */
+template<class T, class U> void MeasurementTileCache<T, U>::Begin (
+		const MeasurementSampleData<T, U> &inEmptyData, size_t inFeatureCount)
+	{
+	std::lock_guard<std::mutex>		lock (fMutex);
+	
+	if (!fEmptyData || fFeatureCount != inFeatureCount ||
+			fEmptyData->GetImagePlanes () != inEmptyData.GetImagePlanes () ||
+			fEmptyData->GetStatistics () != inEmptyData.GetStatistics ())
+		{
+		fEntries.clear ();
+		fBytes = 0;
+		fEmptyData.reset (new MeasurementSampleData<T, U> (inEmptyData));
+		fFeatureCount = inFeatureCount;
+		}
+		
+	fGeneration++;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Finish a measurement, dropping the tiles it did not have.  Host thread only,
+ * once no tile is being measured.
+ */
+template<class T, class U> void MeasurementTileCache<T, U>::End ()
+	{
+	std::lock_guard<std::mutex>		lock (fMutex);
+	
+	for (typename std::unordered_map<uint64, Entry>::iterator entry = fEntries.begin (); 
+			entry != fEntries.end (); )
+		if (entry->second.generation != fGeneration)
+			{
+			fBytes -= entry->second.bytes;
+			entry = fEntries.erase (entry);
+			}
+		else
+			++entry;
+	}
+	
+/******************************************************************************/
+
+/**
+ * The results of a tile measured before, and marks them as used, or NULL.
+ *
+ * \param inHash the tile's hash, from HashTile
+ * \param inRect the tile's rect, which the entry must have too
+ */
+template<class T, class U> const typename MeasurementTileCache<T, U>::Results *
+		MeasurementTileCache<T, U>::Find (uint64 inHash, const VRect &inRect)
+	{
+	std::lock_guard<std::mutex>		lock (fMutex);
+	
+	typename std::unordered_map<uint64, Entry>::iterator	entry = fEntries.find (inHash);
+	
+	if (entry == fEntries.end () ||
+			entry->second.rect.top != inRect.top || entry->second.rect.left != inRect.left ||
+			entry->second.rect.bottom != inRect.bottom || entry->second.rect.right != inRect.right)
+		return NULL;
+		
+	entry->second.generation = fGeneration;
+	
+	return &entry->second.results;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Keep the results of a tile just measured, unless that would take the cache
+ * past kTileCache_MaximumBytes.  The results are taken from ioResults if they
+ * are kept, and left there if not.
+ *
+ * \param inHash the tile's hash, from HashTile
+ * \param inRect the tile's rect
+ * \param ioResults the feature data of each feature in the tile, by feature
+ * \return the results as kept, or NULL
+ */
+template<class T, class U> const typename MeasurementTileCache<T, U>::Results *
+		MeasurementTileCache<T, U>::Insert (uint64 inHash, const VRect &inRect, 
+		Results &ioResults)
+	{
+	// Count the histogram blocks the features really have, which for 16 and
+	// 32-bit values can be a hundred times what a feature starts with
+	size_t		bytes = sizeof (Entry) + 
+						ioResults.capacity () * sizeof (typename Results::value_type);
+	
+	for (size_t index = 0; index < ioResults.size (); index++)
+		bytes += ioResults[index].second.GetAllocatedSize ();
+	
+	std::lock_guard<std::mutex>		lock (fMutex);
+	
+	if (fBytes + bytes > kTileCache_MaximumBytes || fEntries.count (inHash) != 0)
+		return NULL;
+		
+	Entry		&entry = fEntries[inHash];
+	
+	entry.rect = inRect;
+	entry.generation = fGeneration;
+	entry.bytes = bytes;
+	entry.results.swap (ioResults);
+	
+	fBytes += bytes;
+	
+	return &entry.results;
+	}
+	
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Measures tiles on worker threads.  The host thread fetches each tile with
+ * advanceStateProc and hands it to Measure, which copies it into a free buffer
+ * and queues it; a worker measures it, or takes its results from the tile
+ * cache.  The results of the tiles are added into the feature data in the
+ * order the host fetched them, by whichever worker finishes the tile that is
+ * next, and only then is a buffer freed.  There are kBuffersPerWorker buffers
+ * per worker, so the host waits for a free one rather than getting far ahead,
+ * and a tile that is slow to measure holds back only that many others.
+ *
+ * Adding the tiles in order is what makes the result the same as measuring
+ * every tile in turn on one thread, to the last bit: the 32-bit means and
+ * standard deviations round differently when their tiles are added in a
+ * different order.
+ */
+template<class T, class U> class MeasurementWorkers
+	{
+	public:
+	
+		MeasurementWorkers (uint32 inWorkers, size_t inFeatureCount,
+				MeasurementTileCache<T, U> &ioCache);
+		virtual ~MeasurementWorkers ();
+		
+		void Measure (const MeasurementRecordRecord *inRecord);
+		
+		void Finish (std::vector< MeasurementSampleData<T, U> > &ioFeatureData);
+		
+	private:
+	
+		typedef typename MeasurementTileCache<T, U>::Results	Results;
+		
+		void Run (uint32 inWorker);
+		void Merge (size_t inBuffer, const Results *inResults);
+		void Stop (bool inDrain);
+		void ThrowIfFailed ();
+		
+	private:
+	
+		MeasurementWorkers (const MeasurementWorkers &);
+		MeasurementWorkers &operator= (const MeasurementWorkers &);
+		
+	private:
+	
+		uint16												fImagePlanes;
+		MeasurementTileCache<T, U>							&fCache;
+		std::vector< MeasurementSampleData<T, U> >			fFeatureData;
+		std::vector< std::vector< MeasurementSampleData<T, U> > >	fTileData;		// one per worker
+		std::vector<MeasurementTileBuffer>					fBuffers;
+		std::vector<Results>								fResults;		// one per buffer
+		std::vector<const Results *>						fTileResults;	// one per buffer
+		std::vector<bool>									fMeasured;		// one per buffer
+		std::deque<size_t>									fFreeBuffers;
+		std::deque<size_t>									fQueuedBuffers;
+		std::deque<size_t>									fTileOrder;		// buffers not yet merged
+		bool												fMerging;
+		bool												fDraining;
+		bool												fStopping;
+		std::exception_ptr									fError;
+		std::mutex											fMutex;
+		std::condition_variable								fBufferQueued;
+		std::condition_variable								fBufferFreed;
+		std::vector<std::thread>							fThreads;
+		
+	};
+	
+/******************************************************************************/
+
+/**
+ * Start the workers, each with feature data for every feature to measure one
+ * tile in.
+ *
+ * \param inWorkers the number of worker threads
+ * \param inFeatureCount the number of features in the mask
+ * \param ioCache the tile cache, begun with the feature data each feature starts with
+ */
+template<class T, class U> MeasurementWorkers<T, U>::MeasurementWorkers (
+		uint32 inWorkers, size_t inFeatureCount, 
+		MeasurementTileCache<T, U> &ioCache)
+	:	fImagePlanes (ioCache.GetEmptyData ().GetImagePlanes ()),
+		fCache (ioCache),
+		fFeatureData (inFeatureCount, ioCache.GetEmptyData ()),
+		fTileData (inWorkers),
+		fBuffers (inWorkers * kBuffersPerWorker),
+		fResults (fBuffers.size ()),
+		fTileResults (fBuffers.size (), NULL),
+		fMeasured (fBuffers.size (), false),
+		fMerging (false),
+		fDraining (false),
+		fStopping (false)
+	{
+	REQUIRE_PARAMETER (inWorkers > 0);
+	
+	for (uint32 worker = 0; worker < inWorkers; worker++)
+		fTileData[worker].resize (inFeatureCount, ioCache.GetEmptyData ());
+				
+	for (size_t buffer = 0; buffer < fBuffers.size (); buffer++)
+		fFreeBuffers.push_back (buffer);
+		
+	try
+		{
+		for (uint32 worker = 0; worker < inWorkers; worker++)
+			fThreads.push_back (std::thread (&MeasurementWorkers::Run, this, worker));
+		}
+	catch (...)
+		{
+		Stop (false);
+		throw;
+		}
+	}
+	
+/******************************************************************************/
+
+/**
+ * Stop the workers without waiting for the tiles still queued, for when the
+ * measurement is cancelled or fails.
+ */
+template<class T, class U> MeasurementWorkers<T, U>::~MeasurementWorkers ()
+	{
+	Stop (false);
+	}
+	
+/******************************************************************************/
+
+/**
+ * Copy the tile the host just delivered into a free buffer and queue it for a
+ * worker.  Waits while every buffer is in use.  Host thread only.
+ *
+ * \param inRecord the record with the tile in its response fields
+ */
+template<class T, class U> void MeasurementWorkers<T, U>::Measure (
+		const MeasurementRecordRecord *inRecord)
+	{
+	size_t		buffer;
+	
+		{
+		std::unique_lock<std::mutex>	lock (fMutex);
+		
+		fBufferFreed.wait (lock, [this] { return !fFreeBuffers.empty () || fError; });
+		
+		if (fError)
+			std::rethrow_exception (fError);
+			
+		buffer = fFreeBuffers.front ();
+		fFreeBuffers.pop_front ();
+		}
+		
+	// Only this thread has the buffer until it is queued
+	try
+		{
+		fBuffers[buffer].Copy (inRecord, sizeof (T) * fImagePlanes, sizeof (T));
+		}
+	catch (...)
+		{
+		std::lock_guard<std::mutex>		lock (fMutex);
+		fFreeBuffers.push_back (buffer);
+		throw;
+		}
+		
+		{
+		std::lock_guard<std::mutex>		lock (fMutex);
+		fTileOrder.push_back (buffer);
+		fQueuedBuffers.push_back (buffer);
+		}
+		
+	fBufferQueued.notify_one ();
+	}
+	
+/******************************************************************************/
+
+/**
+ * Wait for every queued tile, stop the workers and add the feature data of
+ * the tiles into ioFeatureData.  Throws what a worker threw, if anything.
+ *
+ * \param ioFeatureData the feature data, one per feature, to add into
+ */
+template<class T, class U> void MeasurementWorkers<T, U>::Finish (
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData)
+	{
+	Stop (true);
+	ThrowIfFailed ();
+	
+	for (size_t index = 0; index < ioFeatureData.size (); index++)
+		ioFeatureData[index].Add (fFeatureData[index]);
+	}
+	
+/******************************************************************************/
+
+/**
+ * The worker thread.  Measures queued tiles until stopped; when draining, only
+ * once there are none left.
+ *
+ * \param inWorker which worker, and so which tile data, this is
+ */
+template<class T, class U> void MeasurementWorkers<T, U>::Run (uint32 inWorker)
+	{
+	for (;;)
+		{
+		size_t		buffer;
+		
+			{
+			std::unique_lock<std::mutex>	lock (fMutex);
+			
+			fBufferQueued.wait (lock, [this] 
+					{ return fStopping || fDraining || !fQueuedBuffers.empty (); });
+			
+			if (fStopping || fQueuedBuffers.empty ())
+				return;
+				
+			buffer = fQueuedBuffers.front ();
+			fQueuedBuffers.pop_front ();
+			}
+			
+		const Results	*results = NULL;
+		
+		try
+			{
+			fResults[buffer].clear ();
+			results = MeasureTileCached<T, U> (fBuffers[buffer].GetTile (), fCache,
+					fTileData[inWorker], fResults[buffer]);
+			}
+		catch (...)
+			{
+			std::lock_guard<std::mutex>		lock (fMutex);
+			if (!fError)
+				fError = std::current_exception ();
+			}
+			
+		Merge (buffer, results);
+		}
+	}
+	
+/******************************************************************************/
+
+/**
+ * Mark a tile measured, and, unless another worker is at it, add the results
+ * of the tiles into the feature data for as long as the next one in order is
+ * measured, freeing their buffers.  The results are added without the lock;
+ * only the one worker merging touches the feature data.
+ *
+ * \param inBuffer the buffer of the tile just measured
+ * \param inResults the tile's results, or NULL if measuring it failed
+ */
+template<class T, class U> void MeasurementWorkers<T, U>::Merge (size_t inBuffer,
+		const Results *inResults)
+	{
+	std::unique_lock<std::mutex>	lock (fMutex);
+	
+	fTileResults[inBuffer] = inResults;
+	fMeasured[inBuffer] = true;
+	
+	if (fMerging)
+		return;
+		
+	fMerging = true;
+	
+	while (!fTileOrder.empty () && fMeasured[fTileOrder.front ()])
+		{
+		size_t			buffer = fTileOrder.front ();
+		const Results	*results = fTileResults[buffer];
+		
+		lock.unlock ();
+		
+		try
+			{
+			if (results != NULL)
+				AddTileResults<T, U> (*results, fFeatureData);
+			}
+		catch (...)
+			{
+			std::lock_guard<std::mutex>		errorLock (fMutex);
+			if (!fError)
+				fError = std::current_exception ();
+			}
+			
+		lock.lock ();
+		
+		fTileOrder.pop_front ();
+		fMeasured[buffer] = false;
+		fTileResults[buffer] = NULL;
+		fFreeBuffers.push_back (buffer);
+		fBufferFreed.notify_one ();
+		}
+		
+	fMerging = false;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Tell the workers to stop and wait for them.
+ *
+ * \param inDrain measure the tiles still queued first
+ */
+template<class T, class U> void MeasurementWorkers<T, U>::Stop (bool inDrain)
+	{
+		{
+		std::lock_guard<std::mutex>		lock (fMutex);
+		if (inDrain)
+			fDraining = true;
+		else
+			fStopping = true;
+		}
+		
+	fBufferQueued.notify_all ();
+	
+	for (size_t thread = 0; thread < fThreads.size (); thread++)
+		if (fThreads[thread].joinable ())
+			fThreads[thread].join ();
+			
+	fThreads.clear ();
+	}
+	
+/******************************************************************************/
+
+/**
+ * Throw what a worker threw, if anything.
+ */
+template<class T, class U> void MeasurementWorkers<T, U>::ThrowIfFailed ()
+	{
+	std::lock_guard<std::mutex>		lock (fMutex);
+	
+	if (fError)
+		std::rethrow_exception (fError);
+	}
+	
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A new file in the data directory that a data point is exported to.  What is
+ * written is kept in a buffer of kExport_BufferBytes and written to the file
+ * when the buffer is full, so a file of any size takes a few writes.  A file
+ * that is not closed, because exporting it failed, is deleted.
+ */
+class MeasurementExportFile
+	{
+	public:
+	
+		MeasurementExportFile ();
+		virtual ~MeasurementExportFile ();
+		
+		bool Create (const SPPlatformFileSpecificationW &inDataDirectory,
+				const PIUASZString &inFilename);
+				
+		void Write (const void *inData, size_t inBytes);
+		void WriteText (const std::vector<MeasurementExportColumn> &inColumns,
+				bool inLineEnds);
+		void WriteColumnar (const std::vector<MeasurementExportColumn> &inColumns);
+		
+		void Close ();
+		
+	private:
+	
+		char *Reserve (size_t inBytes);
+		void WriteUInt64 (uint64 inValue);
+		void Flush ();
+		void Remove ();
+		
+	private:
+	
+		MeasurementExportFile (const MeasurementExportFile &);
+		MeasurementExportFile &operator= (const MeasurementExportFile &);
+		
+	private:
+	
+#if __PIMac__
+		FSRef				fFileRef;
+		FSIORefNum			fForkRefNum;
+#elif __PIWin__
+		PIUASZString		fPath;
+		HANDLE				fFile;
+#endif
+		bool				fOpen;
+		std::vector<char>	fBuffer;
+		size_t				fUsed;
+		
+	};
+	
+/******************************************************************************/
+
+/**
+ * Construct with no file.
+ */
+MeasurementExportFile::MeasurementExportFile ()
+	:	
+#if __PIMac__
+		fForkRefNum (0),
+#elif __PIWin__
+		fFile (INVALID_HANDLE_VALUE),
+#endif
+		fOpen (false),
+		fUsed (0)
+	{
+	}
+	
+/******************************************************************************/
+
+/**
+ * Delete the file if it was not closed.
+ */
+MeasurementExportFile::~MeasurementExportFile ()
+	{
+	if (fOpen)
+		Remove ();
+	}
+	
+/******************************************************************************/
+
+/**
+ * Write bytes to the file, through the buffer.
+ *
+ * \param inData the bytes
+ * \param inBytes how many bytes
+ */
+void MeasurementExportFile::Write (const void *inData, size_t inBytes)
+	{
+	const char		*data = (const char*)inData;
+	
+	while (inBytes > 0)
+		{
+		size_t		chunk = std::min (inBytes, (size_t)kExport_BufferBytes);
+		
+		std::memcpy (Reserve (chunk), data, chunk);
+		fUsed += chunk;
+		data += chunk;
+		inBytes -= chunk;
+		}
+	}
+	
+/******************************************************************************/
+
+/**
+ * Write the columns as comma delimited text, a line for each column.  Each
+ * number is formatted straight into the buffer.
+ *
+ * \param inColumns the columns
+ * \param inLineEnds whether the last line ends with a new line too
+ */
+void MeasurementExportFile::WriteText (const std::vector<MeasurementExportColumn> &inColumns,
+		bool inLineEnds)
+	{
+	for (size_t column = 0; column < inColumns.size (); column++)
+		{
+		const std::vector<double>	&values = inColumns[column].values;
+		
+		if (column > 0)
+			Write ("\n", 1);
+			
+		for (size_t index = 0; index < values.size (); index++)
+			{
+			char		*start = Reserve (kExport_NumberBytes);
+			char		*text = start;
+			
+			if (index > 0)
+				{
+				*text++ = ',';
+				*text++ = ' ';
+				}
+				
+			text = FormatExportNumber (values[index], text);
+			fUsed += text - start;
+			}
+		}
+		
+	if (inLineEnds && !inColumns.empty ())
+		Write ("\n", 1);
+	}
+	
+/******************************************************************************/
+
+/**
+ * Write the columns in the columnar format: a header, then the values of each
+ * column in turn, as little-endian IEEE doubles.  The header is the signature,
+ * the version and the number of columns, as 32-bit values, 32 bits of zero,
+ * then for each column the number of values, as 64 bits, and the name, zero
+ * padded to kExport_ColumnarNameBytes.  Every array starts 8-byte aligned.
+ *
+ * \param inColumns the columns
+ */
+void MeasurementExportFile::WriteColumnar (const std::vector<MeasurementExportColumn> &inColumns)
+	{
+	Write (kExport_ColumnarSignature, 4);
+	WriteUInt64 (kExport_ColumnarVersion | ((uint64)inColumns.size () << 32));
+	
+	// The two 32-bit values above went out as one; this is the zero after them
+	Write ("\0\0\0\0", 4);
+	
+	for (size_t column = 0; column < inColumns.size (); column++)
+		{
+		char		name[kExport_ColumnarNameBytes];
+		
+		std::memset (name, 0, sizeof (name));
+		std::memcpy (name, inColumns[column].name.c_str (), 
+				std::min (inColumns[column].name.size (), sizeof (name) - 1));
+				
+		WriteUInt64 (inColumns[column].values.size ());
+		Write (name, sizeof (name));
+		}
+		
+	for (size_t column = 0; column < inColumns.size (); column++)
+		{
+		const std::vector<double>	&values = inColumns[column].values;
+		
+		for (size_t index = 0; index < values.size (); index++)
+			{
+			uint64		bits;
+			
+			std::memcpy (&bits, &values[index], sizeof (bits));
+			WriteUInt64 (bits);
+			}
+		}
+	}
+	
+/******************************************************************************/
+
+/**
+ * Write what is left in the buffer and close the file, which is then kept.
+ */
+void MeasurementExportFile::Close ()
+	{
+	Flush ();
+	
+#if __PIMac__
+	OSErr		err = FSCloseFork (fForkRefNum);
+	
+	fForkRefNum = 0;
+	ThrowIfOSErr (err);
+#elif __PIWin__
+	if (!CloseHandle (fFile))
+		{
+		fFile = INVALID_HANDLE_VALUE;
+		ThrowOSErr (writErr);
+		}
+		
+	fFile = INVALID_HANDLE_VALUE;
+#endif
+
+	fOpen = false;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Room for at least inBytes at the end of the buffer, flushing it first if
+ * there is not.  fUsed is left for the caller to advance.
+ *
+ * \param inBytes the bytes about to be written, at most kExport_BufferBytes
+ */
+char *MeasurementExportFile::Reserve (size_t inBytes)
+	{
+	if (fBuffer.size () < kExport_BufferBytes)
+		fBuffer.resize (kExport_BufferBytes);
+		
+	if (fUsed + inBytes > fBuffer.size ())
+		Flush ();
+		
+	return &fBuffer[fUsed];
+	}
+	
+/******************************************************************************/
+
+/**
+ * Write a 64-bit value, least significant byte first.
+ *
+ * \param inValue the value
+ */
+void MeasurementExportFile::WriteUInt64 (uint64 inValue)
+	{
+	char		*bytes = Reserve (8);
+	
+	for (uint32 byte = 0; byte < 8; byte++)
+		bytes[byte] = (char)(inValue >> (8 * byte));
+		
+	fUsed += 8;
+	}
+	
+////////////////////////////////////////////////////////////////////////////////
+
+class MeasurementSamplePlugin
+	{
+	public:
+		
+		MeasurementSamplePlugin ();
+		virtual ~MeasurementSamplePlugin ();
+		
+		void HandleSelector (int16 inSelector, void *inRecord);
+		
+	private:
+	
+		void HandleSelectorAbout (AboutRecord *inRecord);
+		void HandleSelectorRegisterDataPointDataTypes (MeasurementRegisterRecord *inRecord);
+		void HandleSelectorRegisterDataPoints (MeasurementRegisterRecord *inRecord);
+		void HandleSelectorPrepareMeasurements (MeasurementPrepareRecord *inRecord);
+		void HandleSelectorRecordMeasurements (MeasurementRecordRecord *inRecord);
+		void HandleSelectorExportMeasurement (MeasurementExportRecord *inRecord);
+		
+		void WriteFiles (const std::vector<MeasurementExportColumn> &inColumns,
+				bool inLineEnds, const SPPlatformFileSpecificationW &inDataDirectory,
+				const char *inName, PIUASZString &outFilename);
+				
+	private:
+
+		MeasurementSamplePlugin (MeasurementSamplePlugin &);
+		
+	};
+
+////////////////////////////////////////////////////////////////////////////////
+
+MeasurementSamplePlugin::MeasurementSamplePlugin ()
+	{
+	}
+
+/******************************************************************************/
+
+MeasurementSamplePlugin::~MeasurementSamplePlugin () 
+	{
+	}
+	
+/******************************************************************************/
+
+/**
+ * Simply switch on the selector and cast the record to the appropriate type.
+ *
+ * /param inSelector the selector to invoke in the plugin
+ * /param inRecord the record associated with the selector
+ */
+void MeasurementSamplePlugin::HandleSelector (int16 inSelector, void *inRecord)
+	{
+	switch (inSelector)
+		{
+		case measurementSelectorAbout:
+			sSPBasic = ((AboutRecord*)inRecord)->sSPBasic;
 			HandleSelectorAbout ((AboutRecord*)inRecord);
 			break;
 			
@@ -604,6 +2134,26 @@ void MeasurementSamplePlugin::HandleSelectorRegisterDataPointDataTypes (Measurem
 	descriptor.PutString (kIDStr, kMSP_DataPointDataType_PlanePixelsNonZero_Identifier);
 	descriptor.PutString (kparentIDStr, kPIM_DataPointDataType_Generic_Identifier);
 	list.PutObject (kmeasurementLogDataPointDataTypeClassStr, descriptor);
+	
+	// A descriptor with a list of float values, one per plane, the same as
+	// above, for the image statistics
+	descriptor.Make ();
+	descriptor.PutString (kIDStr, kMSP_DataPointDataType_PlaneValues_Identifier);
+	descriptor.PutString (kparentIDStr, kPIM_DataPointDataType_Generic_Identifier);
+	list.PutObject (kmeasurementLogDataPointDataTypeClassStr, descriptor);
+	
+	// A descriptor with a list with, per plane, a list of 256 counts
+	descriptor.Make ();
+	descriptor.PutString (kIDStr, kMSP_DataPointDataType_Histograms_Identifier);
+	descriptor.PutString (kparentIDStr, kPIM_DataPointDataType_Generic_Identifier);
+	list.PutObject (kmeasurementLogDataPointDataTypeClassStr, descriptor);
+	
+	// A descriptor with a list of percentiles and a list with, per plane, a
+	// list of the values at those percentiles
+	descriptor.Make ();
+	descriptor.PutString (kIDStr, kMSP_DataPointDataType_Percentiles_Identifier);
+	descriptor.PutString (kparentIDStr, kPIM_DataPointDataType_Generic_Identifier);
+	list.PutObject (kmeasurementLogDataPointDataTypeClassStr, descriptor);
 	}
 	
 /******************************************************************************/
@@ -720,6 +2270,54 @@ void MeasurementSamplePlugin::HandleSelectorRegisterDataPoints (MeasurementRegis
 	descriptor.PutZString (kabbreviatedNameStr, PIUASZString ("GPNZ"));
 	descriptor.PutZString (kdescriptionStr, PIUASZString ("Gray Pixels (Non-Zero) - The number of non-zero pixels in the feature in the grayscale image"));
 	list.PutObject (kmeasurementLogDataPointClassStr, descriptor);
+	
+	// These data points are statistics of the values of the pixels in the
+	// feature in the gray scale version of the image, all measured in the
+	// same pass as the others.  32-bit values are from 0 to 1.
+	RegisterDataPoint (list, kMSP_DataPoint_GrayMinimum_Identifier, 
+			kPIM_DataPointDataType_Float_Identifier, "Gray Minimum", "GMIN",
+			"Gray Minimum - The lowest value of the pixels in the feature in the grayscale image");
+	RegisterDataPoint (list, kMSP_DataPoint_GrayMaximum_Identifier, 
+			kPIM_DataPointDataType_Float_Identifier, "Gray Maximum", "GMAX",
+			"Gray Maximum - The highest value of the pixels in the feature in the grayscale image");
+	RegisterDataPoint (list, kMSP_DataPoint_GrayMean_Identifier, 
+			kPIM_DataPointDataType_Float_Identifier, "Gray Mean", "GMEAN",
+			"Gray Mean - The mean value of the pixels in the feature in the grayscale image");
+	RegisterDataPoint (list, kMSP_DataPoint_GrayStandardDeviation_Identifier, 
+			kPIM_DataPointDataType_Float_Identifier, "Gray Standard Deviation", "GSD",
+			"Gray Standard Deviation - The standard deviation of the values of the pixels in the feature in the grayscale image");
+	RegisterDataPoint (list, kMSP_DataPoint_GrayMedian_Identifier, 
+			kPIM_DataPointDataType_Float_Identifier, "Gray Median", "GMED",
+			"Gray Median - The median value of the pixels in the feature in the grayscale image");
+	RegisterDataPoint (list, kMSP_DataPoint_GrayPercentiles_Identifier, 
+			kMSP_DataPointDataType_Percentiles_Identifier, "Gray Percentiles", "GPCT",
+			"Gray Percentiles - The 1st to 99th percentile values of the pixels in the feature in the grayscale image");
+	RegisterDataPoint (list, kMSP_DataPoint_GrayHistogram_Identifier, 
+			kMSP_DataPointDataType_Histograms_Identifier, "Gray Histogram", "GHIST",
+			"Gray Histogram - The number of pixels in the feature at each of 256 levels in the grayscale image");
+
+	// The same statistics for each plane of the original image
+	RegisterDataPoint (list, kMSP_DataPoint_ImageMinimum_Identifier, 
+			kMSP_DataPointDataType_PlaneValues_Identifier, "Plane Minimum", "PMIN",
+			"Plane Minimum - The lowest value of the pixels in the feature in each plane in the original image");
+	RegisterDataPoint (list, kMSP_DataPoint_ImageMaximum_Identifier, 
+			kMSP_DataPointDataType_PlaneValues_Identifier, "Plane Maximum", "PMAX",
+			"Plane Maximum - The highest value of the pixels in the feature in each plane in the original image");
+	RegisterDataPoint (list, kMSP_DataPoint_ImageMean_Identifier, 
+			kMSP_DataPointDataType_PlaneValues_Identifier, "Plane Mean", "PMEAN",
+			"Plane Mean - The mean value of the pixels in the feature in each plane in the original image");
+	RegisterDataPoint (list, kMSP_DataPoint_ImageStandardDeviation_Identifier, 
+			kMSP_DataPointDataType_PlaneValues_Identifier, "Plane Standard Deviation", "PSD",
+			"Plane Standard Deviation - The standard deviation of the values of the pixels in the feature in each plane in the original image");
+	RegisterDataPoint (list, kMSP_DataPoint_ImageMedian_Identifier, 
+			kMSP_DataPointDataType_PlaneValues_Identifier, "Plane Median", "PMED",
+			"Plane Median - The median value of the pixels in the feature in each plane in the original image");
+	RegisterDataPoint (list, kMSP_DataPoint_ImagePercentiles_Identifier, 
+			kMSP_DataPointDataType_Percentiles_Identifier, "Plane Percentiles", "PPCT",
+			"Plane Percentiles - The 1st to 99th percentile values of the pixels in the feature in each plane in the original image");
+	RegisterDataPoint (list, kMSP_DataPoint_ImageHistograms_Identifier, 
+			kMSP_DataPointDataType_Histograms_Identifier, "Plane Histograms", "PHIST",
+			"Plane Histograms - The number of pixels in the feature at each of 256 levels in each plane in the original image");
 	}
 	
 /******************************************************************************/
@@ -738,28 +2336,28 @@ void MeasurementSamplePlugin::HandleSelectorPrepareMeasurements (MeasurementPrep
 	{
 	REQUIRE_NON_NULL_PARAMETER (inRecord);
 
-	int16		imageDepth;
-	int16		imageModePlanes;
-	uint32		sampleDataSize;
+	int16				imageDepth;
+	uint64				reserve;
+	DescriptorKeyID		descriptorKeys[kMSDK_Last];
+	uint32				statistics;
+	
+	// The statistics asked for, which are most of the data when they have histograms
+	GetDescriptorKeys (inRecord, descriptorKeys);
+	statistics = GetStatistics (descriptorKeys);
 	
-	// Calculate the size of each sample data object based upon the image depth
-	// Since MeasurementSampleData is a template class to deal with different
-	// pixels sizes, then size of the data changes based upon the pixel type
-	// of the original image
+	// What the data and tile buffers take depends upon the pixel type of the
+	// original image, since MeasurementSampleData is a template class to deal
+	// with different pixel sizes.  Photoshop will try to free that much memory
+	// for the non-Photoshop memory APIs
 	imageDepth = inRecord->imageDepth;
-	imageModePlanes = inRecord->imageModePlanes;
 	if (imageDepth == 32)
-		sampleDataSize = MeasurementSampleData<float, double>::GetDataSize(imageModePlanes);
+		reserve = GetSpaceReserve<float, double> (inRecord, statistics);
 	else if (imageDepth == 16)
-		sampleDataSize = MeasurementSampleData<uint16, uint64>::GetDataSize(imageModePlanes);
+		reserve = GetSpaceReserve<uint16, uint64> (inRecord, statistics);
 	else
-		sampleDataSize = MeasurementSampleData<uint8, uint64>::GetDataSize(imageModePlanes);
-
-	// Reserve how much memory we will need through non-Photoshop memory APIs
-	// Basically the size of our data storage for each feature plus one for
-	// the summary
-	inRecord->requestSpaceReserve = (inRecord->maskFeatureCount + 1) *
-			sampleDataSize;
+		reserve = GetSpaceReserve<uint8, uint64> (inRecord, statistics);
+		
+	inRecord->requestSpaceReserve = reserve < 0x7fffffff ? (int32)reserve : 0x7fffffff;
 	}
 
 /******************************************************************************/
@@ -810,72 +2408,38 @@ template<class T, class U> void RecordMeasurements (MeasurementRecordRecord *inR
 	MeasurementRecordRecord			*recordRecord;
 	TestAbortProc					FN_TestAbort;
 	ProgressProc					FN_Progress;
-	AdvanceStateProc				FN_AdvanceState;
-	
-	// Get the various records
-	baseRecord = AsBase (inRecord);
-	prepareRecord = AsPrepare (inRecord);
-	recordRecord = inRecord;
-	
-	// Get the various procs
-	FN_TestAbort = baseRecord->testAbortProc;
-	FN_Progress = baseRecord->progressProc;
-	FN_AdvanceState = recordRecord->advanceStateProc;
-	
-	MeasurementSampleDescriptorMap	descriptorMap;
-	DescriptorTypeID				descriptorKeys[kMSDK_Last];
-	
-	// Initialize descriptor map, used to map identifier strings to an index in
-	// the descriptor keys, makes for quicker and easier checks to see if
-	// a particular data point is being measured
-	descriptorMap[kMSP_DataPoint_EdgeTouching_Identifier] = kMSDK_EdgeTouching;
-	descriptorMap[kMSP_DataPoint_Foreground_Identifier] = kMSDK_Foreground;
-	descriptorMap[kMSP_DataPoint_CenterX_Identifier] = kMSDK_CenterX;
-	descriptorMap[kMSP_DataPoint_CenterY_Identifier] = kMSDK_CenterY;
-	descriptorMap[kMSP_DataPoint_ImagePixelsNonZero_Identifier] = kMSDK_ImagePixelsNonZero;
-	descriptorMap[kMSP_DataPoint_GrayPixelsNonZero_Identifier] = kMSDK_GrayPixelsNonZero;
-
-	// Initialize descriptor keys, indicates whether a data point is being
-	// recorded if associated descriptor key is not typeNull
-	for (uint32 index = 0; index < kMSDK_Last; index++)
-		descriptorKeys[index] = typeNull;
-	
-	// Wrap list, but do not own it (we don't want to delete it)
-	PIUActionList					dataPointIdentifiers (prepareRecord->dataPointIdentifiers, false);
-	uint32							identifierCount;
-			
-	// Walk the data point identifier list and see what we should record
-	identifierCount = dataPointIdentifiers.GetCount ();
-	for (uint32 index = 0; index < identifierCount; index++)
-		{
-		std::string									identifier;
-		MeasurementSampleDescriptorMap::iterator	iter;
-		
-		// Grab the next data point identifier we should record
-		identifier = dataPointIdentifiers.GetString (index);
-		
-		// Find it in the map, if we don't find it ignore (though, this 
-		// shouldn't happen anyhow)
-		iter = descriptorMap.find (identifier);
-		if (descriptorMap.end () == iter)
-			continue;
-			
-		// If we found it, then override the typeNull key in the descriptor keys
-		// array with the actual key for the identifier, this indicates that
-		// we do want to record this data point
-		descriptorKeys[iter->second] = PIUActionControl::GetStringID (identifier);
-		}
+	AdvanceStateProc				FN_AdvanceState;
+	
+	// Get the various records
+	baseRecord = AsBase (inRecord);
+	prepareRecord = AsPrepare (inRecord);
+	recordRecord = inRecord;
+	
+	// Get the various procs
+	FN_TestAbort = baseRecord->testAbortProc;
+	FN_Progress = baseRecord->progressProc;
+	FN_AdvanceState = recordRecord->advanceStateProc;
+	
+	DescriptorTypeID				descriptorKeys[kMSDK_Last];
+	uint32							statistics;
+	
+	// Find which data points we are to record, and which statistics of the
+	// pixel values they need
+	GetDescriptorKeys (prepareRecord, descriptorKeys);
+	statistics = GetStatistics (descriptorKeys);
 
 	// Are we requesting image or gray data (we don't for bitmap mode)
 	if (prepareRecord->imageMode != plugInModeBitmap)
 		{
 		// Image is required if we are requesting any image calculations
 		recordRecord->requestImage =
-				(descriptorKeys[kMSDK_ImagePixelsNonZero] != typeNull);
+				(descriptorKeys[kMSDK_ImagePixelsNonZero] != typeNull) ||
+				((statistics & kMSSF_Image) != 0);
 				
 		// Gray is required if we are requesting any gray calculations
 		recordRecord->requestGray = 
-				(descriptorKeys[kMSDK_GrayPixelsNonZero] != typeNull);
+				(descriptorKeys[kMSDK_GrayPixelsNonZero] != typeNull) ||
+				((statistics & kMSSF_Gray) != 0);
 		}
 		
 	// Are we requesting the mask?  We need the mask if we are requesting the
@@ -891,12 +2455,11 @@ template<class T, class U> void RecordMeasurements (MeasurementRecordRecord *inR
 	
 	// Our data objects for the features we collect information with
 	// Plus one to act as a summary
-	MeasurementSampleData<T, U>					summaryData (prepareRecord->imageModePlanes);
+	MeasurementSampleData<T, U>					summaryData (prepareRecord->imageModePlanes, statistics);
 	std::vector< MeasurementSampleData<T, U> >	featureData;
 
 	// Initialize the feature data vector
-	featureData.resize (prepareRecord->maskFeatureCount, 
-			MeasurementSampleData<T, U> (prepareRecord->imageModePlanes));
+	featureData.resize (prepareRecord->maskFeatureCount, summaryData);
 	
 	// Only process if we are requesting something, setup and then walk
 	// through the mask, image, and gray data in a tile based fashion while
@@ -912,6 +2475,7 @@ template<class T, class U> void RecordMeasurements (MeasurementRecordRecord *inR
 		uint64		progressTotal;
 		uint64		progressCompleted;
 		VRect		workRect;
+		uint32		workerCount;
 		
 		// If we are requesting the image, then setup image request planes to
 		// request all normal image planes (ignore alpha and spot planes as
@@ -959,6 +2523,25 @@ template<class T, class U> void RecordMeasurements (MeasurementRecordRecord *inR
 			}
 		progressCompleted = 0;
 		
+		// Tiles that have not changed since they were last measured are
+		// taken from the cache; the others are measured on their own in
+		// tileData first, to be kept
+		MeasurementTileCache<T, U>					&tileCache = MeasurementTileCache<T, U>::Get ();
+		std::vector< MeasurementSampleData<T, U> >	tileData;
+		
+		tileCache.Begin (summaryData, featureData.size ());
+		
+		// On a large enough image, the tiles are measured on worker threads
+		// while this thread fetches the next ones from the host
+		std::unique_ptr< MeasurementWorkers<T, U> >	workers;
+		
+		workerCount = GetWorkerCount (prepareRecord);
+		if (workerCount > 0)
+			workers.reset (new MeasurementWorkers<T, U> (workerCount, 
+					featureData.size (), tileCache));
+		else
+			tileData.resize (featureData.size (), summaryData);
+		
 		// Walk through the entire mask rows, one chunk at a time
 		for (workRect.top = maskRect.top; workRect.top < maskRect.bottom; 
 				workRect.top = workRect.bottom)
@@ -1004,7 +2587,15 @@ template<class T, class U> void RecordMeasurements (MeasurementRecordRecord *inR
 				// Now that we've gotten all relevant information regarding the
 				// tile, measure that tile and perform all calculations
 				// A templated function to handle different image pixel depths
-				MeasureTile<T, U> (inRecord, summaryData, featureData);
+				if (workers)
+					workers->Measure (inRecord);
+				else
+					{
+					typename MeasurementTileCache<T, U>::Results		results;
+					
+					AddTileResults<T, U> (*MeasureTileCached<T, U> (GetResponseTile (inRecord),
+							tileCache, tileData, results), featureData);
+					}
 				
 				// Progress update, account for shift calculated above
 				progressCompleted += (workRect.bottom - workRect.top) * (workRect.right - workRect.left);
@@ -1012,127 +2603,713 @@ template<class T, class U> void RecordMeasurements (MeasurementRecordRecord *inR
 				}
 			}
 			
+		// Wait for the workers and gather what they measured
+		if (workers)
+			workers->Finish (featureData);
+			
+		// Forget the tiles this measurement did not have
+		tileCache.End ();
+		
 		// Add the feature data to the summary data
 		for (uint32 index = 0; index < featureData.size (); index++)
 			summaryData.Add (featureData[index]);
 		}
 		
-	// Write the results
-	summaryData.Write (descriptorKeys, recordRecord->summaryData);
-	for (uint32 index = 0; index < featureData.size (); index++)
-		featureData[index].Write (descriptorKeys, recordRecord->featureData[index]);
+	// Write the results
+	summaryData.Write (descriptorKeys, recordRecord->summaryData);
+	for (uint32 index = 0; index < featureData.size (); index++)
+		featureData[index].Write (descriptorKeys, recordRecord->featureData[index]);
+	}
+	
+/******************************************************************************/
+
+/**
+ * Measure a tile through the tile cache.  If the same tile was measured before,
+ * its results are those in the cache; if not, it is measured into ioTileData,
+ * which has nothing recorded, and each feature it has is moved into the
+ * results, which are kept in the cache if there is room.
+ *
+ * \param inTile the tile's pixels, from the host or a copy
+ * \param ioCache the tile cache, begun for this measurement
+ * \param ioTileData feature data for every feature, with nothing recorded
+ * \param outResults empty, for the results if the cache does not keep them
+ * \return the tile's results, in the cache or outResults
+ */
+template<class T, class U> const typename MeasurementTileCache<T, U>::Results *MeasureTileCached (
+		const MeasurementTile &inTile, MeasurementTileCache<T, U> &ioCache,
+		std::vector< MeasurementSampleData<T, U> > &ioTileData,
+		typename MeasurementTileCache<T, U>::Results &outResults)
+	{
+	typedef typename MeasurementTileCache<T, U>::Results	Results;
+	
+	const MeasurementSampleData<T, U>	&emptyData = ioCache.GetEmptyData ();
+	uint64								hash;
+	const Results						*cached;
+	
+	hash = HashTile (inTile, sizeof (T) * emptyData.GetImagePlanes (), sizeof (T));
+	
+	cached = ioCache.Find (hash, inTile.rect);
+	if (cached != NULL)
+		return cached;
+		
+	MeasureTile<T, U> (inTile, ioTileData);
+	
+	for (size_t index = 0; index < ioTileData.size (); index++)
+		if (ioTileData[index].HasData ())
+			{
+			outResults.push_back (std::make_pair ((uint32)index, ioTileData[index]));
+			ioTileData[index] = emptyData;
+			}
+			
+	cached = ioCache.Insert (hash, inTile.rect, outResults);
+	
+	return cached != NULL ? cached : &outResults;
+	}
+
+/******************************************************************************/
+
+/**
+ * Add the results of one tile into the feature data of each feature it has.
+ * The tiles are added in the order the host gives them, on one thread or many.
+ *
+ * \param inResults the tile's results, from MeasureTileCached
+ * \param ioFeatureData the vector of feature data objects to store data in
+ */
+template<class T, class U> void AddTileResults (
+		const typename MeasurementTileCache<T, U>::Results &inResults,
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData)
+	{
+	for (size_t index = 0; index < inResults.size (); index++)
+		ioFeatureData[inResults[index].first].Add (inResults[index].second);
+	}
+
+/******************************************************************************/
+
+/**
+ * Templated function to examine each tile and measure each feature in the tile.
+ * When each row's pixels are next to each other in memory, as the host and
+ * MeasurementTileBuffer give them, the rows are measured in runs of one feature
+ * by a kernel made for the data that was requested; otherwise pixel by pixel.
+ *
+ * \param inTile the tile's pixels, from the host or a copy
+ * \param ioFeatureData the vector of feature data objects to store data in
+ */
+template<class T, class U> void MeasureTile (
+		const MeasurementTile &inTile, 
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData)
+	{
+	uint32		imagePlanes;
+	bool		contiguous;
+	
+	// Nothing to record in
+	if (ioFeatureData.empty ())
+		return;
+		
+	imagePlanes = ioFeatureData[0].GetImagePlanes ();
+	
+	contiguous = (inTile.maskColumnBytes == sizeof (uint16)) &&
+			(inTile.imageData == NULL || 
+				(imagePlanes > 0 && inTile.imageColumnBytes == (int32)(sizeof (T) * imagePlanes))) &&
+			(inTile.grayData == NULL || inTile.grayColumnBytes == sizeof (T));
+	
+	if (!contiguous)
+		MeasureTilePixels<T, U> (inTile, ioFeatureData);
+	else if (inTile.imageData != NULL && inTile.grayData != NULL)
+		MeasureTileRuns<T, U, true, true> (inTile, imagePlanes, ioFeatureData);
+	else if (inTile.imageData != NULL)
+		MeasureTileRuns<T, U, true, false> (inTile, imagePlanes, ioFeatureData);
+	else if (inTile.grayData != NULL)
+		MeasureTileRuns<T, U, false, true> (inTile, imagePlanes, ioFeatureData);
+	else
+		MeasureTileRuns<T, U, false, false> (inTile, imagePlanes, ioFeatureData);
+	}
+
+/******************************************************************************/
+
+/**
+ * Measure a tile whose rows are contiguous, one run of a feature at a time.
+ * The end of each run is found eight mask pixels at a time, the non zero image
+ * and gray pixels in it are counted with MeasurementCountNonZero, and the run
+ * is recorded once.  The template flags are whether there is image and gray
+ * data, so a kernel only has the loops its data points need.
+ *
+ * \param inTile the tile's pixels, from the host or a copy
+ * \param inImagePlanes the image planes of each pixel
+ * \param ioFeatureData the vector of feature data objects to store data in
+ */
+template<class T, class U, bool kImage, bool kGray> void MeasureTileRuns (
+		const MeasurementTile &inTile, uint32 inImagePlanes,
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData)
+	{
+	VRect							tileRect;
+	int32							tileWidth;
+	size_t							featureCount;
+	std::vector<uint64>				imagePixelsNonZero (kImage ? inImagePlanes : 0);
+	
+	// Grab the tile rect
+	tileRect = inTile.rect;
+	tileWidth = tileRect.right - tileRect.left;
+	
+	// Feature count
+	featureCount = ioFeatureData.size ();
+	
+	// Walk the rows of the tile
+	for (int32 row = tileRect.top; row < tileRect.bottom; row++)
+		{
+		ptrdiff_t		rowIndex = row - tileRect.top;
+		const uint16	*maskData = (const uint16*)(inTile.maskData + rowIndex * inTile.maskRowBytes);
+		const T			*imageData = kImage ? (const T*)(inTile.imageData + rowIndex * inTile.imageRowBytes) : NULL;
+		const T			*grayData = kGray ? (const T*)(inTile.grayData + rowIndex * inTile.grayRowBytes) : NULL;
+		
+		// Walk the runs of the row
+		for (int32 column = 0; column < tileWidth; )
+			{
+			uint16		feature;
+			uint16		identifier;
+			int32		length;
+			
+			// The feature of the run and where it ends
+			feature = maskData[column];
+			length = MeasurementRunLength (maskData + column, tileWidth - column, feature);
+			
+			// Unidentified features are ignored, as in MeasureTilePixels
+			identifier = feature & featureMaskIdentifierMask;
+			if (identifier >= featureCount)
+				;
+			else if (length < kShortRun_Maximum)
+				{
+				// Too short to be worth counting as a run
+				for (int32 index = column; index < column + length; index++)
+					ioFeatureData[identifier].Record (row, tileRect.left + index, feature,
+							kImage ? (T*)(imageData + (size_t)index * inImagePlanes) : NULL, 
+							kGray ? (T*)(grayData + index) : NULL);
+				}
+			else
+				{
+				uint64		grayPixelsNonZero = 0;
+				
+				if (kImage)
+					{
+					std::fill (imagePixelsNonZero.begin (), imagePixelsNonZero.end (), 0);
+					MeasurementCountNonZero (imageData + (size_t)column * inImagePlanes, 
+							length, inImagePlanes, &imagePixelsNonZero[0]);
+					}
+					
+				if (kGray)
+					MeasurementCountNonZero (grayData + column, length, 1, &grayPixelsNonZero);
+				
+				ioFeatureData[identifier].RecordRun (row, 
+						tileRect.left + column, tileRect.left + column + length - 1, feature,
+						kImage ? &imagePixelsNonZero[0] : NULL, kGray, grayPixelsNonZero);
+						
+				ioFeatureData[identifier].RecordValues (
+						kImage ? imageData + (size_t)column * inImagePlanes : NULL,
+						kGray ? grayData + column : NULL, length);
+				}
+				
+			column += length;
+			}
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * Measure a tile pixel by pixel.
+ * In short; walk each pixel in the tile by columns, then rows from upper left
+ * to lower right; check to see if the pixel is properly identified; and record 
+ * all relevant data for the feature associated with the pixel.
+ *
+ * \param inTile the tile's pixels, from the host or a copy
+ * \param ioFeatureData the vector of feature data objects to store data in
+ */
+template<class T, class U> void MeasureTilePixels (
+		const MeasurementTile &inTile, 
+		std::vector< MeasurementSampleData<T, U> > &ioFeatureData)
+	{
+	VRect							tileRect;
+	int32							tileWidth;
+	T								*imageData;
+	int32							imageColumnBytes;
+	int32							imageRowBytesDelta;
+	T								*grayData;
+	int32							grayColumnBytes;
+	int32							grayRowBytesDelta;
+	uint16							*maskData;
+	int32							maskColumnBytes;
+	int32							maskRowBytes;
+	int32							maskRowBytesDelta;
+	size_t							featureCount;
+	
+	// Grab the tile rect
+	tileRect = inTile.rect;
+	tileWidth = tileRect.right - tileRect.left;
+	
+	// Get the image data
+	imageData = (T*)inTile.imageData;
+	
+	// Calculate the image related bytes
+	imageColumnBytes = inTile.imageColumnBytes;
+	imageRowBytesDelta = inTile.imageRowBytes - tileWidth * imageColumnBytes; 
+		
+	// Get the gray data
+	grayData = (T*)inTile.grayData;
+	
+	// Calculate the gray related bytes
+	grayColumnBytes = inTile.grayColumnBytes;
+	grayRowBytesDelta = inTile.grayRowBytes - tileWidth * grayColumnBytes; 
+
+	// Get the mask data
+	maskData = (uint16*)inTile.maskData;
+	
+	// Calculate the mask related bytes
+	maskColumnBytes = inTile.maskColumnBytes;
+	maskRowBytes = inTile.maskRowBytes;
+	maskRowBytesDelta = maskRowBytes - tileWidth * maskColumnBytes; 
+			
+	// Feature count
+	featureCount = ioFeatureData.size ();
+	
+	// Walk the rows of the tile
+	for (int32 row = tileRect.top; row < tileRect.bottom; row++)
+		{
+		// Walk the columns of the tile
+		for (int32 column = tileRect.left; column < tileRect.right; column++)
+			{
+			uint16		feature;
+			uint16		identifier;
+			
+			// Determine feature from the mask pixel
+			feature = *maskData;
+				
+			// Grab the identifier, if a valid identifer the use it,
+			// It is possible to get a non-valid identifier (0x7FF) if the
+			// image has more features than can be counted, for this plugin
+			// we ignore unidentified features
+			identifier = feature & featureMaskIdentifierMask;
+			if (identifier < featureCount)
+				ioFeatureData[identifier].Record (row, column, 
+						feature, imageData, grayData);
+
+			// Next column (in bytes, which is why there are the pointer casts)
+			imageData = (T*)(((uint8*)imageData) + imageColumnBytes);
+			grayData = (T*)(((uint8*)grayData) + grayColumnBytes);
+			maskData = (uint16*)(((uint8*)maskData) + maskColumnBytes);
+			}
+		
+		// Next row (in bytes, which is why there are the pointer casts)
+		imageData = (T*)(((uint8*)imageData) + imageRowBytesDelta);
+		grayData = (T*)(((uint8*)grayData) + grayRowBytesDelta);
+		maskData = (uint16*)(((uint8*)maskData) + maskRowBytesDelta);
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * The tile the host just delivered, in the record's response fields.
+ *
+ * \param inRecord the record after advanceStateProc
+ */
+static MeasurementTile GetResponseTile (const MeasurementRecordRecord *inRecord)
+	{
+	MeasurementTile		tile;
+	
+	tile.rect = inRecord->requestImageRect;
+	tile.imageData = (const uint8*)inRecord->responseImageData;
+	tile.imageColumnBytes = inRecord->responseImageColumnBytes;
+	tile.imageRowBytes = inRecord->responseImageRowBytes;
+	tile.grayData = (const uint8*)inRecord->responseGrayData;
+	tile.grayColumnBytes = inRecord->responseGrayColumnBytes;
+	tile.grayRowBytes = inRecord->responseGrayRowBytes;
+	tile.maskData = (const uint8*)inRecord->responseMaskData;
+	tile.maskColumnBytes = inRecord->responseMaskColumnBytes;
+	tile.maskRowBytes = inRecord->responseMaskRowBytes;
+	
+	return tile;
+	}
+	
+/******************************************************************************/
+
+/**
+ * A hash of a tile for the tile cache: of its rect and of the mask, image and
+ * gray bytes MeasureTile reads, and of which of them there are.
+ *
+ * \param inTile the tile's pixels, from the host or a copy
+ * \param inImagePixelBytes bytes read for each image pixel
+ * \param inGrayPixelBytes bytes read for each gray pixel
+ */
+static uint64 HashTile (const MeasurementTile &inTile, uint32 inImagePixelBytes,
+		uint32 inGrayPixelBytes)
+	{
+	uint64		hash = 0;
+	
+	hash = MeasurementHashWord (hash, ((uint64)(uint32)inTile.rect.top << 32) | (uint32)inTile.rect.left);
+	hash = MeasurementHashWord (hash, ((uint64)(uint32)inTile.rect.bottom << 32) | (uint32)inTile.rect.right);
+	
+	hash = HashTileData (hash, inTile.maskData, inTile.maskColumnBytes,
+			inTile.maskRowBytes, sizeof (uint16), inTile.rect);
+	hash = HashTileData (hash, inTile.imageData, inTile.imageColumnBytes,
+			inTile.imageRowBytes, inImagePixelBytes, inTile.rect);
+	hash = HashTileData (hash, inTile.grayData, inTile.grayColumnBytes,
+			inTile.grayRowBytes, inGrayPixelBytes, inTile.rect);
+			
+	return hash;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Mix one of the image, gray or mask data of a tile into a hash.  Each row is
+ * hashed from its first pixel to the end of its last one, as
+ * MeasurementTileBuffer copies it.  When the pixels are spread out, the bytes
+ * between them are hashed too; a change there only costs measuring again.
+ *
+ * \param inHash the hash so far
+ * \return the hash with the data, or with a mark for no data
+ */
+static uint64 HashTileData (uint64 inHash, const uint8 *inData, int32 inColumnBytes,
+		int32 inRowBytes, uint32 inPixelBytes, const VRect &inRect)
+	{
+	int32		width = inRect.right - inRect.left;
+	int32		height = inRect.bottom - inRect.top;
+	
+	if (inData == NULL || width <= 0 || height <= 0)
+		return MeasurementHashWord (inHash, 0);
+		
+	size_t		rowSpan = (size_t)(width - 1) * inColumnBytes + inPixelBytes;
+	
+	inHash = MeasurementHashWord (inHash, ((uint64)(uint32)inColumnBytes << 32) | inPixelBytes);
+	
+	for (int32 row = 0; row < height; row++)
+		inHash = MeasurementHashBytes (inHash, inData + (ptrdiff_t)row * inRowBytes, rowSpan);
+		
+	return inHash;
+	}
+	
+/******************************************************************************/
+
+/**
+ * How many worker threads to measure tiles on: one per core, less one for the
+ * host thread fetching tiles, or none, to measure on the host thread, with one
+ * core or too few tiles to be worth starting threads for.
+ *
+ * \param inRecord the prepare record, for the mask rect and tile size
+ */
+static uint32 GetWorkerCount (const MeasurementPrepareRecord *inRecord)
+	{
+	uint32		cores = std::thread::hardware_concurrency ();
+	
+	if (cores < 2)
+		return 0;
+		
+	int32		tileHeight = inRecord->maskTileHeight > 0 ? inRecord->maskTileHeight : kTileHeight_Default;
+	int32		tileWidth = inRecord->maskTileWidth > 0 ? inRecord->maskTileWidth : kTileWidth_Default;
+	int64		rows = ((int64)inRecord->maskRect.bottom - inRecord->maskRect.top + tileHeight - 1) / tileHeight;
+	int64		columns = ((int64)inRecord->maskRect.right - inRecord->maskRect.left + tileWidth - 1) / tileWidth;
+	
+	if (rows * columns < kParallelTiles_Minimum)
+		return 0;
+		
+	if (cores - 1 > rows * columns)
+		return (uint32)(rows * columns);
+		
+	return cores - 1;
+	}
+	
+/******************************************************************************/
+
+/**
+ * How much memory a measurement allocates through non-Photoshop memory APIs:
+ * the data of each feature and of the summary, the data each tile is
+ * measured in and its results, the tile cache and, on worker threads, the
+ * tile buffers.
+ *
+ * \param inRecord the prepare record, for the image planes, mask and tile size
+ * \param inStatistics the statistics asked for, kMSSF_ flags
+ */
+template<class T, class U> static uint64 GetSpaceReserve (
+		const MeasurementPrepareRecord *inRecord, uint32 inStatistics)
+	{
+	uint16		planes = inRecord->imageModePlanes;
+	uint64		features = inRecord->maskFeatureCount > 0 ? inRecord->maskFeatureCount : 0;
+	int32		tileHeight = inRecord->maskTileHeight > 0 ? inRecord->maskTileHeight : kTileHeight_Default;
+	int32		tileWidth = inRecord->maskTileWidth > 0 ? inRecord->maskTileWidth : kTileWidth_Default;
+	uint64		maskPixels = (uint64)((int64)inRecord->maskRect.bottom - inRecord->maskRect.top) *
+						(uint64)((int64)inRecord->maskRect.right - inRecord->maskRect.left);
+	uint64		tilePixels = (uint64)tileHeight * tileWidth;
+	uint64		tileDataSize = GetFeatureDataSize<T, U> (planes, inStatistics, features, tilePixels);
+	uint64		reserve;
+	
+	reserve = GetFeatureDataSize<T, U> (planes, inStatistics, features, maskPixels) +
+			GetFeatureDataSize<T, U> (planes, inStatistics, 1, maskPixels) +
+			kTileCache_MaximumBytes;
+			
+	// On worker threads, the feature data the tiles are added into, each
+	// worker's tile data and the results and buffer (mask, image and gray for
+	// every pixel) of each tile waiting to be added; otherwise one tile's data
+	// and results
+	uint32		workerCount = GetWorkerCount (inRecord);
+	if (workerCount > 0)
+		reserve += GetFeatureDataSize<T, U> (planes, inStatistics, features, maskPixels) +
+				workerCount * (1 + kBuffersPerWorker) * tileDataSize +
+				workerCount * kBuffersPerWorker * tilePixels * (sizeof (uint16) + (planes + 1) * sizeof (T));
+	else
+		reserve += 2 * tileDataSize;
+		
+	return reserve;
+	}
+	
+/******************************************************************************/
+
+/**
+ * The memory the data of some features takes, with as many histogram blocks
+ * as they could have between them.  A histogram has a block for each range
+ * of values its feature has, so never more blocks than pixels; over all the
+ * features that is most when the pixels are shared out evenly.
+ *
+ * \param inImagePlanes the number of image planes
+ * \param inStatistics the statistics asked for, kMSSF_ flags
+ * \param inFeatures the number of features
+ * \param inPixels the number of pixels the features have between them, at most
+ */
+template<class T, class U> static uint64 GetFeatureDataSize (uint16 inImagePlanes,
+		uint32 inStatistics, uint64 inFeatures, uint64 inPixels)
+	{
+	if (inFeatures == 0)
+		return 0;
+		
+	uint64		blocks = (inPixels + inFeatures - 1) / inFeatures;
+	
+	if (blocks > MeasurementHistogram<T>::GetBlockCount ())
+		blocks = MeasurementHistogram<T>::GetBlockCount ();
+		
+	return inFeatures * MeasurementSampleData<T, U>::GetDataSize (inImagePlanes, 
+			inStatistics, (uint32)blocks);
 	}
 	
 /******************************************************************************/
 
 /**
- * Templated function to examine each tile and measure each feature in the tile.
- * In short; walk each pixel in the tile by columns, then rows from upper left
- * to lower right; check to see if the pixel is properly identified; and record 
- * all relevant data for the feature associated with the pixel.
+ * Find which data points are to be recorded.  Each data point's descriptor key
+ * is typeNull unless it is in the record's list of data point identifiers.
  *
- * \param inRecord the record containing relevant tile data
- * \param ioSummaryData the summary data object to store data in
- * \param ioFeatureData the vector of feature data objects to store data in
+ * \param inRecord the prepare record, for the data point identifiers
+ * \param outDescriptorKeys the descriptor key of each data point (kMSDK_Last of them)
  */
-template<class T, class U> void MeasureTile (
-		const MeasurementRecordRecord *inRecord, 
-		MeasurementSampleData<T, U> &ioSummaryData, 
-		std::vector< MeasurementSampleData<T, U> > &ioFeatureData)
+static void GetDescriptorKeys (const MeasurementPrepareRecord *inRecord,
+		DescriptorKeyID outDescriptorKeys[])
 	{
-	REQUIRE_NON_NULL_PARAMETER (inRecord);
-
-	const MeasurementRecordRecord	*recordRecord;
-	VRect							tileRect;
-	int32							tileWidth;
-	T								*imageData;
-	int32							imageColumnBytes;
-	int32							imageRowBytesDelta;
-	T								*grayData;
-	int32							grayColumnBytes;
-	int32							grayRowBytesDelta;
-	uint16							*maskData;
-	int32							maskColumnBytes;
-	int32							maskRowBytes;
-	int32							maskRowBytesDelta;
-	size_t							featureCount;
+	MeasurementSampleDescriptorMap	descriptorMap;
 	
-	// Get the various records
-	recordRecord = inRecord;
+	// Initialize descriptor map, used to map identifier strings to an index in
+	// the descriptor keys, makes for quicker and easier checks to see if
+	// a particular data point is being measured
+	descriptorMap[kMSP_DataPoint_EdgeTouching_Identifier] = kMSDK_EdgeTouching;
+	descriptorMap[kMSP_DataPoint_Foreground_Identifier] = kMSDK_Foreground;
+	descriptorMap[kMSP_DataPoint_CenterX_Identifier] = kMSDK_CenterX;
+	descriptorMap[kMSP_DataPoint_CenterY_Identifier] = kMSDK_CenterY;
+	descriptorMap[kMSP_DataPoint_ImagePixelsNonZero_Identifier] = kMSDK_ImagePixelsNonZero;
+	descriptorMap[kMSP_DataPoint_GrayPixelsNonZero_Identifier] = kMSDK_GrayPixelsNonZero;
+	descriptorMap[kMSP_DataPoint_GrayMinimum_Identifier] = kMSDK_GrayMinimum;
+	descriptorMap[kMSP_DataPoint_GrayMaximum_Identifier] = kMSDK_GrayMaximum;
+	descriptorMap[kMSP_DataPoint_GrayMean_Identifier] = kMSDK_GrayMean;
+	descriptorMap[kMSP_DataPoint_GrayStandardDeviation_Identifier] = kMSDK_GrayStandardDeviation;
+	descriptorMap[kMSP_DataPoint_GrayMedian_Identifier] = kMSDK_GrayMedian;
+	descriptorMap[kMSP_DataPoint_GrayPercentiles_Identifier] = kMSDK_GrayPercentiles;
+	descriptorMap[kMSP_DataPoint_GrayHistogram_Identifier] = kMSDK_GrayHistogram;
+	descriptorMap[kMSP_DataPoint_ImageMinimum_Identifier] = kMSDK_ImageMinimum;
+	descriptorMap[kMSP_DataPoint_ImageMaximum_Identifier] = kMSDK_ImageMaximum;
+	descriptorMap[kMSP_DataPoint_ImageMean_Identifier] = kMSDK_ImageMean;
+	descriptorMap[kMSP_DataPoint_ImageStandardDeviation_Identifier] = kMSDK_ImageStandardDeviation;
+	descriptorMap[kMSP_DataPoint_ImageMedian_Identifier] = kMSDK_ImageMedian;
+	descriptorMap[kMSP_DataPoint_ImagePercentiles_Identifier] = kMSDK_ImagePercentiles;
+	descriptorMap[kMSP_DataPoint_ImageHistograms_Identifier] = kMSDK_ImageHistograms;
 
-	// Grab the tile rect
-	tileRect = recordRecord->requestImageRect;
-	tileWidth = tileRect.right - tileRect.left;
-	
-	// Get the image data
-	imageData = (T*)recordRecord->responseImageData;
+	// Initialize descriptor keys, indicates whether a data point is being
+	// recorded if associated descriptor key is not typeNull
+	for (uint32 index = 0; index < kMSDK_Last; index++)
+		outDescriptorKeys[index] = typeNull;
 	
-	// Calculate the image related bytes
-	imageColumnBytes = recordRecord->responseImageColumnBytes;
-	imageRowBytesDelta = recordRecord->responseImageRowBytes - tileWidth * imageColumnBytes; 
+	// Wrap list, but do not own it (we don't want to delete it)
+	PIUActionList					dataPointIdentifiers (inRecord->dataPointIdentifiers, false);
+	uint32							identifierCount;
+			
+	// Walk the data point identifier list and see what we should record
+	identifierCount = dataPointIdentifiers.GetCount ();
+	for (uint32 index = 0; index < identifierCount; index++)
+		{
+		std::string									identifier;
+		MeasurementSampleDescriptorMap::iterator	iter;
 		
-	// Get the gray data
-	grayData = (T*)recordRecord->responseGrayData;
+		// Grab the next data point identifier we should record
+		identifier = dataPointIdentifiers.GetString (index);
+		
+		// Find it in the map, if we don't find it ignore (though, this 
+		// shouldn't happen anyhow)
+		iter = descriptorMap.find (identifier);
+		if (descriptorMap.end () == iter)
+			continue;
+			
+		// If we found it, then override the typeNull key in the descriptor keys
+		// array with the actual key for the identifier, this indicates that
+		// we do want to record this data point
+		outDescriptorKeys[iter->second] = PIUActionControl::GetStringID (identifier);
+		}
+	}
 	
-	// Calculate the gray related bytes
-	grayColumnBytes = recordRecord->responseGrayColumnBytes;
-	grayRowBytesDelta = recordRecord->responseGrayRowBytes - tileWidth * grayColumnBytes; 
+/******************************************************************************/
 
-	// Get the mask data
-	maskData = (uint16*)recordRecord->responseMaskData;
+/**
+ * Which statistics of the pixel values the data points to be recorded need
+ * (MeasurementSampleStatisticsFlag).  The median, percentiles and histograms
+ * need a histogram of the values, the others only sums.
+ *
+ * \param inDescriptorKeys the descriptor key of each data point, see GetDescriptorKeys
+ */
+static uint32 GetStatistics (const DescriptorKeyID inDescriptorKeys[])
+	{
+	uint32		statistics = kMSSF_None;
 	
-	// Calculate the mask related bytes
-	maskColumnBytes = recordRecord->responseMaskColumnBytes;
-	maskRowBytes = recordRecord->responseMaskRowBytes;
-	maskRowBytesDelta = maskRowBytes - tileWidth * maskColumnBytes; 
+	for (uint32 index = kMSDK_GrayMinimum; index <= kMSDK_GrayHistogram; index++)
+		if (inDescriptorKeys[index] != typeNull)
+			statistics |= kMSSF_Gray;
 			
-	// Feature count
-	featureCount = ioFeatureData.size ();
+	for (uint32 index = kMSDK_ImageMinimum; index <= kMSDK_ImageHistograms; index++)
+		if (inDescriptorKeys[index] != typeNull)
+			statistics |= kMSSF_Image;
+			
+	if ((inDescriptorKeys[kMSDK_GrayMedian] != typeNull) ||
+			(inDescriptorKeys[kMSDK_GrayPercentiles] != typeNull) ||
+			(inDescriptorKeys[kMSDK_GrayHistogram] != typeNull))
+		statistics |= kMSSF_GrayHistogram;
+		
+	if ((inDescriptorKeys[kMSDK_ImageMedian] != typeNull) ||
+			(inDescriptorKeys[kMSDK_ImagePercentiles] != typeNull) ||
+			(inDescriptorKeys[kMSDK_ImageHistograms] != typeNull))
+		statistics |= kMSSF_ImageHistogram;
+		
+	return statistics;
+	}
 	
-	// Walk the rows of the tile
-	for (int32 row = tileRect.top; row < tileRect.bottom; row++)
+/******************************************************************************/
+
+/**
+ * Register one data point, see HandleSelectorRegisterDataPoints.  The display
+ * name is the full name.
+ *
+ * \param ioList the list of data points to add to
+ * \param inIdentifier the unique ID of the data point
+ * \param inTypeIdentifier the unique ID of its data point data type
+ * \param inName the full name
+ * \param inAbbreviatedName the abbreviated name
+ * \param inDescription the description
+ */
+static void RegisterDataPoint (PIUActionList &ioList, const char *inIdentifier,
+		const char *inTypeIdentifier, const char *inName, 
+		const char *inAbbreviatedName, const char *inDescription)
+	{
+	PIUActionDescriptor		descriptor;
+	
+	descriptor.Make ();
+	descriptor.PutString (kIDStr, inIdentifier);
+	descriptor.PutString (ktypeIDStr, inTypeIdentifier);
+	descriptor.PutZString (kfullNameStr, PIUASZString (inName));
+	descriptor.PutZString (kdisplayNameStr, PIUASZString (inName));
+	descriptor.PutZString (kabbreviatedNameStr, PIUASZString (inAbbreviatedName));
+	descriptor.PutZString (kdescriptionStr, PIUASZString (inDescription));
+	ioList.PutObject (kmeasurementLogDataPointClassStr, descriptor);
+	}
+	
+/******************************************************************************/
+
+/**
+ * The float values of a list, as an exported column.
+ *
+ * \param inList the list of values
+ * \param inName the column's name
+ * \param outColumn the column
+ */
+static void GetExportColumn (PIUActionList &inList, const std::string &inName,
+		MeasurementExportColumn &outColumn)
+	{
+	uint32		count = inList.GetCount ();
+	
+	outColumn.name = inName;
+	outColumn.values.resize (count);
+	
+	for (uint32 index = 0; index < count; index++)
+		outColumn.values[index] = inList.GetFloat (index);
+	}
+	
+/******************************************************************************/
+
+/**
+ * Format a number for the exported text, whatever the locale.  Whole numbers,
+ * which counts and 8 and 16-bit values are, are written digit by digit; the
+ * rest as "%.15g" with a '.' for the decimal point.
+ *
+ * \param inValue the number
+ * \param outText where to write it, room for kExport_NumberBytes
+ * \return the end of the number, which is not terminated
+ */
+static char *FormatExportNumber (double inValue, char *outText)
+	{
+	if (inValue == std::floor (inValue) && std::fabs (inValue) < 9007199254740992.0)
 		{
-		// Walk the columns of the tile
-		for (int32 column = tileRect.left; column < tileRect.right; column++)
+		char		digits[20];
+		int32		count = 0;
+		uint64		integer;
+		
+		if (inValue < 0)
 			{
-			uint16		feature;
-			uint16		identifier;
+			*outText++ = '-';
+			integer = (uint64)-inValue;
+			}
+		else
+			integer = (uint64)inValue;
 			
-			// Determine feature from the mask pixel
-			feature = *maskData;
-				
-			// Grab the identifier, if a valid identifer the use it,
-			// It is possible to get a non-valid identifier (0x7FF) if the
-			// image has more features than can be counted, for this plugin
-			// we ignore unidentified features
-			identifier = feature & featureMaskIdentifierMask;
-			if (identifier < featureCount)
-				ioFeatureData[identifier].Record (row, column, 
-						feature, imageData, grayData);
-
-			// Next column (in bytes, which is why there are the pointer casts)
-			imageData = (T*)(((uint8*)imageData) + imageColumnBytes);
-			grayData = (T*)(((uint8*)grayData) + grayColumnBytes);
-			maskData = (uint16*)(((uint8*)maskData) + maskColumnBytes);
+		do
+			{
+			digits[count++] = (char)('0' + integer % 10);
+			integer /= 10;
 			}
+		while (integer != 0);
 		
-		// Next row (in bytes, which is why there are the pointer casts)
-		imageData = (T*)(((uint8*)imageData) + imageRowBytesDelta);
-		grayData = (T*)(((uint8*)grayData) + grayRowBytesDelta);
-		maskData = (uint16*)(((uint8*)maskData) + maskRowBytesDelta);
+		while (count > 0)
+			*outText++ = digits[--count];
+			
+		return outText;
 		}
+		
+	char		point = *std::localeconv ()->decimal_point;
+	int32		length = snprintf (outText, kExport_NumberBytes - 2, "%.15g", inValue);
+	
+	if (length < 0)
+		length = 0;
+	else if (length > kExport_NumberBytes - 3)
+		length = kExport_NumberBytes - 3;
+		
+	if (point != '.')
+		for (int32 index = 0; index < length; index++)
+			if (outText[index] == point)
+				outText[index] = '.';
+				
+	return outText + length;
 	}
-
+	
 /******************************************************************************/
 
 /**
- * Handle the export measurement selector.  The only data point data type this
- * plugin currently exports is the plane pixels non-zero data type.  In order
- * to show usage of the data directory, this data type is written to a separate 
- * file for each measurement.  The file is a text file contained comma-delimited 
- * data for each plane of the histogram.  
+ * Handle the export measurement selector.  Each data point data type this
+ * plugin exports is written to a separate file for each measurement, to show
+ * usage of the data directory.  The file is a text file of comma delimited
+ * values: one line of the value of each plane, or for the histograms and
+ * percentiles, a line for each plane (after one of the percentile levels).
+ * With kExport_Columnar, the same columns are also written to a binary file
+ * of the same name, see MeasurementExportFile::WriteColumnar.
  *
- * The actual file I/O is performed in a separate OS-specific function.
+ * The actual file I/O is performed in MeasurementExportFile.
  *
  * \param inRecord the record for the selector
  */
@@ -1146,57 +3323,84 @@ void MeasurementSamplePlugin::HandleSelectorExportMeasurement (MeasurementExport
 	PIUActionDescriptor		dataPointDataType (inRecord->dataPointDataType, false);
 	std::string				identifier;
 	
-	// Which data point data type is it for, we only handle one right now
+	// Which data point data type is it for
 	identifier = dataPointDataType.GetString (kIDStr);
-	if (identifier == kMSP_DataPointDataType_PlanePixelsNonZero_Identifier)
+	if (identifier == kMSP_DataPointDataType_PlanePixelsNonZero_Identifier ||
+			identifier == kMSP_DataPointDataType_PlaneValues_Identifier ||
+			identifier == kMSP_DataPointDataType_Histograms_Identifier ||
+			identifier == kMSP_DataPointDataType_Percentiles_Identifier)
 		{
 		// Wrap the data point data, but do not own (don't delete it)
-		PIUActionDescriptor			dataPointData (inRecord->dataPointData, false);
-		PIUActionList				channelList;
-		uint32						channelCount;
-		PIUASZString				filename;
+		PIUActionDescriptor						dataPointData (inRecord->dataPointData, false);
+		PIUActionList							channelList;
+		std::vector<MeasurementExportColumn>	columns;
+		bool									lineEnds;
+		const char								*name;
+		PIUASZString							filename;
 
 		// Get the list of channels from the data
 		channelList = dataPointData.GetList (kchannelsStr);
 		
-		// Walk the channels of the list
-		channelCount = channelList.GetCount ();
-		if (channelCount > 0)
+		// The files are named after the data point data type
+		if (identifier == kMSP_DataPointDataType_PlanePixelsNonZero_Identifier)
+			name = "PlanePixelsNonZero";
+		else if (identifier == kMSP_DataPointDataType_PlaneValues_Identifier)
+			name = "PlaneValues";
+		else if (identifier == kMSP_DataPointDataType_Histograms_Identifier)
+			name = "Histograms";
+		else
+			name = "Percentiles";
+		
+		// The plane values are one column, the others a column for each plane
+		if (identifier == kMSP_DataPointDataType_PlanePixelsNonZero_Identifier ||
+				identifier == kMSP_DataPointDataType_PlaneValues_Identifier)
+			{
+			// Nothing to export without channels
+			if (channelList.GetCount () == 0)
+				return;
+				
+			columns.resize (1);
+			GetExportColumn (channelList, "channels", columns[0]);
+			lineEnds = false;
+			}
+		else
 			{
-			std::string		output;
+			uint32		channelCount = channelList.GetCount ();
 			
+			// The percentile levels go first
+			if (identifier == kMSP_DataPointDataType_Percentiles_Identifier)
+				{
+				PIUActionList		levelList;
+				
+				levelList = dataPointData.GetList (klevelsStr);
+				columns.resize (1);
+				GetExportColumn (levelList, "levels", columns[0]);
+				}
+				
 			for (uint32 channelIndex = 0; channelIndex < channelCount; channelIndex++)
 				{
-				double		doubleValue;
-				uint64		integerValue;
-				char		valueString[31];
+				PIUActionList		valueList (channelList.GetList (channelIndex));
+				char				name[kExport_ColumnarNameBytes];
 				
-				// Get the value for the channel
-				doubleValue = channelList.GetFloat (channelIndex);
-				integerValue = (uint64)doubleValue;
+				snprintf (name, kExport_ColumnarNameBytes, "channel %lu", (unsigned long)channelIndex + 1);
 				
-				// Translate value to a string
-				snprintf (valueString, 31, "%ld", (long)integerValue);
-
-				// Add a comma delimiter
-				if (channelIndex > 0)
-					output += ", ";
-
-				// Add string to the output
-				output += valueString;
+				columns.resize (columns.size () + 1);
+				GetExportColumn (valueList, name, columns.back ());
 				}
+				
+			lineEnds = true;
+			}
 			
-			// Write the file and get the filename used for output purposes
-			WriteFile (output, inRecord->dataDirectory, filename);
+		// Write the file and get the filename used for output purposes
+		WriteFiles (columns, lineEnds, inRecord->dataDirectory, name, filename);
 
-			// Set the string written in the main export file as the filename
-			// used by the data file in the data directory
-			inRecord->exportString = filename.Release ();
-			
-			// We exported a file, this tells the main application that the
-			// data directory is needed as should not be deleted at completion
-			inRecord->exportData = true;
-			}
+		// Set the string written in the main export file as the filename
+		// used by the data file in the data directory
+		inRecord->exportString = filename.Release ();
+		
+		// We exported a file, this tells the main application that the
+		// data directory is needed as should not be deleted at completion
+		inRecord->exportData = true;
 		}
 
 	// Else, what?
@@ -1207,133 +3411,184 @@ void MeasurementSamplePlugin::HandleSelectorExportMeasurement (MeasurementExport
 /******************************************************************************/
 
 /**
- * Write the plane pixels non zero data string to a file.  The file is stored in the 
- * specified data directory and has a unique filename.
+ * Write an exported data point to a text file, and with kExport_Columnar a
+ * columnar file of the same name, in the data directory.  The name is made
+ * unique by its number.
  *
- * \param inOutput the plane pixels non zero data string
- * \param inDataDirectory the directory to store the file in
- * \param outFilename the final filename used by the file
+ * \param inColumns the columns of the data point
+ * \param inLineEnds whether the text's last line ends with a new line
+ * \param inDataDirectory the directory to store the files in
+ * \param inName the name of the data point data type, ahead of the number
+ * \param outFilename the final filename used by the text file
  */
-#if __PIMac__
-
-void MeasurementSamplePlugin::WriteFile (const std::string &inOutput,
-		const SPPlatformFileSpecificationW &inDataDirectory,
-		PIUASZString &outFilename)
+void MeasurementSamplePlugin::WriteFiles (const std::vector<MeasurementExportColumn> &inColumns,
+		bool inLineEnds, const SPPlatformFileSpecificationW &inDataDirectory,
+		const char *inName, PIUASZString &outFilename)
 	{
-    
-	FSRef			fileRef;
+	MeasurementExportFile		textFile;
+	MeasurementExportFile		columnarFile;
+	int32						fileCount;
 	
 	// Loop until we find a unique filename
-	for (int32 fileCount = 1; ; fileCount++)
+	for (fileCount = 1; ; fileCount++)
 		{
-		OSErr			err;
-
-		// Generate a filename
-		outFilename = "PlanePixelsNonZero-^0.csv";
+		outFilename = std::string (inName) + "-^0.csv";
 		outFilename.Replace (0, PIUASZString::RomanizationOf (fileCount));
-
-		// Attempt to create a new file, if not then deal with it
-		err = FSCreateFileUnicode (&inDataDirectory.mReference, 
-				outFilename.GetUnicodeStringLength (), outFilename.GetUnicodeString (),
-				kFSCatInfoNone, NULL, &fileRef, NULL);
-		if (err == dupFNErr)
-			continue;
-		else if (err == noErr)
+		
+		if (textFile.Create (inDataDirectory, outFilename))
 			break;
+		}
+		
+	// The columnar file has the number of the text file
+	if (kExport_Columnar)
+		{
+		PIUASZString		columnarFilename (std::string (inName) + "-^0.msc");
+		
+		columnarFilename.Replace (0, PIUASZString::RomanizationOf (fileCount));
+		if (!columnarFile.Create (inDataDirectory, columnarFilename))
+			ThrowOSErr (writErr);
 			
-		ThrowOSErr (err);
+		columnarFile.WriteColumnar (inColumns);
 		}
 		
-	FSIORefNum /*SInt16*/			forkRefNum = 0;
+	textFile.WriteText (inColumns, inLineEnds);
+	
+	textFile.Close ();
+	if (kExport_Columnar)
+		columnarFile.Close ();
+	}
 
-	try
-		{
-		HFSUniStr255	forkName;
+/******************************************************************************/
 
-		// Create and open the data fork
-		ThrowIfOSErr (FSGetDataForkName (&forkName));
-		ThrowIfOSErr (FSCreateFork (&fileRef, forkName.length, forkName.unicode));
-		ThrowIfOSErr (FSOpenFork (&fileRef, forkName.length, forkName.unicode, 
-				fsWrPerm, &forkRefNum));
-				
-		// Write the output
-		ThrowIfOSErr (FSWriteFork (forkRefNum, fsFromStart, 0, inOutput.size (),
-				inOutput.c_str (), NULL));
-				
-		// Close
-		ThrowIfOSErr (FSCloseFork (forkRefNum));
-		}
-	catch (...)
+/**
+ * Create the file, if there is no file of that name already, and open it.
+ *
+ * \param inDataDirectory the directory to create the file in
+ * \param inFilename the file's name
+ * \return whether the file was created, false if there is one of that name
+ */
+#if __PIMac__
+
+bool MeasurementExportFile::Create (const SPPlatformFileSpecificationW &inDataDirectory,
+		const PIUASZString &inFilename)
+	{
+	REQUIRE (!fOpen);
+	
+	OSErr			err;
+	HFSUniStr255	forkName;
+
+	// Attempt to create a new file, if not then deal with it
+	err = FSCreateFileUnicode (&inDataDirectory.mReference, 
+			inFilename.GetUnicodeStringLength (), inFilename.GetUnicodeString (),
+			kFSCatInfoNone, NULL, &fFileRef, NULL);
+	if (err == dupFNErr)
+		return false;
+	ThrowIfOSErr (err);
+	
+	fOpen = true;
+
+	// Create and open the data fork
+	ThrowIfOSErr (FSGetDataForkName (&forkName));
+	ThrowIfOSErr (FSCreateFork (&fFileRef, forkName.length, forkName.unicode));
+	ThrowIfOSErr (FSOpenFork (&fFileRef, forkName.length, forkName.unicode, 
+			fsWrPerm, &fForkRefNum));
+			
+	return true;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Write the buffer to the file and empty it.
+ */
+void MeasurementExportFile::Flush ()
+	{
+	if (fUsed == 0)
+		return;
+		
+	ThrowIfOSErr (FSWriteFork (fForkRefNum, fsAtMark, 0, fUsed, &fBuffer[0], NULL));
+	fUsed = 0;
+	}
+	
+/******************************************************************************/
+
+/**
+ * Close the file, if it is open, and delete it.
+ */
+void MeasurementExportFile::Remove ()
+	{
+	if (fForkRefNum != 0)
 		{
-		if (forkRefNum != 0)
-			{
-			FSCloseFork (forkRefNum);
-			forkRefNum = 0;
-			}
-		FSDeleteObject (&fileRef);
-		throw;
+		FSCloseFork (fForkRefNum);
+		fForkRefNum = 0;
 		}
+		
+	FSDeleteObject (&fFileRef);
+	fOpen = false;
 	}
 
 #elif __PIWin__
 
-void MeasurementSamplePlugin::WriteFile (const std::string &inOutput,
-		const SPPlatformFileSpecificationW &inDataDirectory,
-		PIUASZString &outFilename)
+bool MeasurementExportFile::Create (const SPPlatformFileSpecificationW &inDataDirectory,
+		const PIUASZString &inFilename)
 	{
-	HANDLE			file;
+	REQUIRE (!fOpen);
 	
-	// Loop until we find a unique filename
-	for (int32 fileCount = 1; ; fileCount++)
+	// Generate a path
+	fPath = "^0^1";
+	fPath.Replace (0, PIUASZString (inDataDirectory.mReference));
+	fPath.Replace (1, inFilename);
+
+	// Attempt to create a new file, if not then deal with it
+	fFile = CreateFileW ((LPCWSTR)fPath.GetUnicodeString (), GENERIC_WRITE, 0, 
+			NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fFile == INVALID_HANDLE_VALUE)
 		{
-		PIUASZString		path;
+		if (GetLastError () == ERROR_FILE_EXISTS)
+			return false;
+			
+		ThrowOSErr (writErr);
+		}
 		
-		// Generate a filename
-		outFilename = "PlanePixelsNonZero-^0.csv";
-		outFilename.Replace (0, PIUASZString::RomanizationOf (fileCount));
-
- 		// Generate a path
-		path = "^0^1";
-		path.Replace (0, PIUASZString (inDataDirectory.mReference));
-		path.Replace (1, outFilename);
-
-		// Attempt to create a new file, if not then deal with it
-		file = CreateFileW ((LPCWSTR)path.GetUnicodeString (), GENERIC_WRITE, 0, 
-				NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
-		if (file == INVALID_HANDLE_VALUE)
-			{
-			DWORD	lastError;
-
-			// Determine the error
-			lastError = GetLastError ();
-			if (lastError == ERROR_FILE_EXISTS)
-				continue;
-			else if (lastError == ERROR_SUCCESS)
-				break;
-
-			ThrowOSErr (writErr);				
-			}
+	fOpen = true;
+	
+	return true;
+	}
+	
+/******************************************************************************/
 
-		break;
-		}
+/**
+ * Write the buffer to the file and empty it.
+ */
+void MeasurementExportFile::Flush ()
+	{
+	DWORD	bytesWritten;
+	
+	if (fUsed == 0)
+		return;
 		
-	try
-		{
-		DWORD	bytesWritten;
+	if (!::WriteFile (fFile, &fBuffer[0], (DWORD)fUsed, &bytesWritten, NULL) ||
+			bytesWritten != fUsed)
+		ThrowOSErr (writErr);
+		
+	fUsed = 0;
+	}
+	
+/******************************************************************************/
 
-		// Write the output
-		if (!::WriteFile (file, inOutput.c_str (), (DWORD)inOutput.size (), &bytesWritten, NULL))
-			ThrowOSErr (writErr);
-				
-		// Close
-		CloseHandle (file);
-		}
-	catch (...)
+/**
+ * Close the file, if it is open, and delete it.
+ */
+void MeasurementExportFile::Remove ()
+	{
+	if (fFile != INVALID_HANDLE_VALUE)
 		{
-		if (file != NULL)
-			CloseHandle (file);
-		throw;
+		CloseHandle (fFile);
+		fFile = INVALID_HANDLE_VALUE;
 		}
+		
+	DeleteFileW ((LPCWSTR)fPath.GetUnicodeString ());
+	fOpen = false;
 	}
 
 #endif
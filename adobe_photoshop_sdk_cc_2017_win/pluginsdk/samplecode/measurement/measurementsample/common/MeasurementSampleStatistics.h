@@ -0,0 +1,604 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright 2007 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------------------
+
+#ifndef __MeasurementSampleStatistics__
+#define __MeasurementSampleStatistics__
+
+// uint64 is defined by the plug-in before this is included
+#include "PITypes.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Bins in each block of a histogram
+#define kHistogramBlockShift		8
+#define kHistogramBlockBins			(1 << kHistogramBlockShift)
+
+// Bins in the histograms written to the Measurement Log, as in the Histogram panel
+#define kHistogramDisplayBins		256
+
+/******************************************************************************/
+
+/**
+ * How the values of each pixel type are binned in a histogram.  8-bit values
+ * each have their own bin, and so do 16-bit values, 0 to 32768.  32-bit values
+ * are clamped to 0 to 1 and binned as 16-bit ones would be.
+ */
+template<class T> struct MeasurementValues;
+
+template<> struct MeasurementValues<uint8>
+	{
+	enum { kBins = 256 };
+
+	static uint32 GetBin (uint8 inValue) { return inValue; }
+	static double GetValue (uint32 inBin) { return inBin; }
+	};
+
+template<> struct MeasurementValues<uint16>
+	{
+	enum { kBins = 32769 };
+
+	static uint32 GetBin (uint16 inValue) { return inValue < 32768 ? inValue : 32768; }
+	static double GetValue (uint32 inBin) { return inBin; }
+	};
+
+template<> struct MeasurementValues<float>
+	{
+	enum { kBins = 32769 };
+
+	static uint32 GetBin (float inValue)
+		{
+		if (!(inValue > 0))
+			return 0;
+		if (inValue >= 1)
+			return 32768;
+		return (uint32)(inValue * 32768 + 0.5f);
+		}
+
+	static double GetValue (uint32 inBin) { return inBin / 32768.0; }
+	};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The count of values in each bin for one plane of one feature.  The bins are
+ * kept in blocks of kHistogramBlockBins, made as values land in them: an 8-bit
+ * histogram is one block, direct; a 16-bit or 32-bit one only has blocks for
+ * the range of values its feature actually has.  Nothing is made until the
+ * first value.
+ */
+template<class T> class MeasurementHistogram
+	{
+	public:
+
+		static uint32 GetBlockCount ();
+		static uint32 GetDataSize (uint32 inBlocks);
+
+	public:
+
+		void Add (uint32 inBin)
+			{
+			if (fBlocks.empty ())
+				fBlocks.resize ((MeasurementValues<T>::kBins + kHistogramBlockBins - 1) / kHistogramBlockBins);
+
+			std::vector<uint64>		&block = fBlocks[inBin >> kHistogramBlockShift];
+
+			if (block.empty ())
+				block.resize (kHistogramBlockBins, 0);
+
+			block[inBin & (kHistogramBlockBins - 1)]++;
+			}
+
+		void Add (const MeasurementHistogram &inHistogram);
+
+		uint32 FindRank (uint64 inRank) const;
+
+		void GetDisplayCounts (uint64 outCounts[kHistogramDisplayBins]) const;
+
+		size_t GetAllocatedSize () const;
+
+	private:
+
+		std::vector< std::vector<uint64> >		fBlocks;
+
+	};
+
+/******************************************************************************/
+
+/**
+ * The most blocks a histogram can have: 1 for 8-bit values, 129 for 16 and
+ * 32-bit ones.
+ */
+template<class T> uint32 MeasurementHistogram<T>::GetBlockCount ()
+	{
+	return (MeasurementValues<T>::kBins + kHistogramBlockBins - 1) / kHistogramBlockBins;
+	}
+
+/******************************************************************************/
+
+/**
+ * The memory a histogram with some blocks takes, beyond its own size.
+ *
+ * \param inBlocks the number of blocks, 0 for a histogram with no values
+ */
+template<class T> uint32 MeasurementHistogram<T>::GetDataSize (uint32 inBlocks)
+	{
+	if (inBlocks == 0)
+		return 0;
+
+	return GetBlockCount () * sizeof (std::vector<uint64>) +
+			inBlocks * kHistogramBlockBins * sizeof (uint64);
+	}
+
+/******************************************************************************/
+
+/**
+ * Add the counts of another histogram, one block at a time.
+ *
+ * \param inHistogram the histogram to add to this one
+ */
+template<class T> void MeasurementHistogram<T>::Add (const MeasurementHistogram &inHistogram)
+	{
+	if (inHistogram.fBlocks.empty ())
+		return;
+
+	if (fBlocks.empty ())
+		{
+		fBlocks = inHistogram.fBlocks;
+		return;
+		}
+
+	for (size_t index = 0; index < fBlocks.size (); index++)
+		{
+		const std::vector<uint64>	&from = inHistogram.fBlocks[index];
+		std::vector<uint64>			&to = fBlocks[index];
+
+		if (from.empty ())
+			continue;
+
+		if (to.empty ())
+			to = from;
+		else
+			for (uint32 bin = 0; bin < kHistogramBlockBins; bin++)
+				to[bin] += from[bin];
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * The bin of a value by its rank, the smallest being rank 0.  Whole blocks are
+ * skipped by their totals.  The last bin if there are not that many values.
+ *
+ * \param inRank the rank of the value
+ */
+template<class T> uint32 MeasurementHistogram<T>::FindRank (uint64 inRank) const
+	{
+	uint64		below = 0;
+
+	for (size_t index = 0; index < fBlocks.size (); index++)
+		{
+		const std::vector<uint64>	&block = fBlocks[index];
+		uint64						total = 0;
+
+		if (block.empty ())
+			continue;
+
+		for (uint32 bin = 0; bin < kHistogramBlockBins; bin++)
+			total += block[bin];
+
+		if (below + total <= inRank)
+			{
+			below += total;
+			continue;
+			}
+
+		for (uint32 bin = 0; bin < kHistogramBlockBins; bin++)
+			{
+			below += block[bin];
+			if (below > inRank)
+				return (uint32)(index * kHistogramBlockBins + bin);
+			}
+		}
+
+	return MeasurementValues<T>::kBins - 1;
+	}
+
+/******************************************************************************/
+
+/**
+ * The counts in kHistogramDisplayBins bins, the way Photoshop shows a 16-bit
+ * histogram in 256 levels.
+ *
+ * \param outCounts the count of each display bin
+ */
+template<class T> void MeasurementHistogram<T>::GetDisplayCounts (
+		uint64 outCounts[kHistogramDisplayBins]) const
+	{
+	const uint32	lastBin = MeasurementValues<T>::kBins - 1;
+
+	for (uint32 bin = 0; bin < kHistogramDisplayBins; bin++)
+		outCounts[bin] = 0;
+
+	for (size_t index = 0; index < fBlocks.size (); index++)
+		{
+		const std::vector<uint64>	&block = fBlocks[index];
+
+		if (block.empty ())
+			continue;
+
+		for (uint32 bin = 0; bin < kHistogramBlockBins; bin++)
+			{
+			uint32		value = (uint32)(index * kHistogramBlockBins + bin);
+
+			if (block[bin] != 0)
+				outCounts[(value * (kHistogramDisplayBins - 1) + lastBin / 2) / lastBin] += block[bin];
+			}
+		}
+	}
+
+/******************************************************************************/
+
+/**
+ * The memory this histogram has, beyond its own size: its blocks, which a
+ * feature with a wide range of 16 or 32-bit values has many of.
+ */
+template<class T> size_t MeasurementHistogram<T>::GetAllocatedSize () const
+	{
+	size_t		size = fBlocks.capacity () * sizeof (std::vector<uint64>);
+
+	for (size_t index = 0; index < fBlocks.size (); index++)
+		size += fBlocks[index].capacity () * sizeof (uint64);
+
+	return size;
+	}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The 128-bit product of two 64-bit values, from four 32-bit products.
+ *
+ * \param inA one value
+ * \param inB the other value
+ * \param outHigh the upper 64 bits of the product
+ * \param outLow the lower 64 bits of the product
+ */
+inline void MultiplyUInt64 (uint64 inA, uint64 inB, uint64 &outHigh, uint64 &outLow)
+	{
+	uint64		lowLow = (inA & 0xffffffff) * (inB & 0xffffffff);
+	uint64		lowHigh = (inA & 0xffffffff) * (inB >> 32);
+	uint64		highLow = (inA >> 32) * (inB & 0xffffffff);
+	uint64		highHigh = (inA >> 32) * (inB >> 32);
+	uint64		middle = (lowLow >> 32) + (lowHigh & 0xffffffff) + (highLow & 0xffffffff);
+
+	outLow = (middle << 32) | (lowLow & 0xffffffff);
+	outHigh = highHigh + (lowHigh >> 32) + (highLow >> 32) + (middle >> 32);
+	}
+
+/******************************************************************************/
+
+/**
+ * The sums behind the mean and standard deviation of 8 and 16-bit values.
+ * The sum is a 'U' and the sum of squares 128 bits, so both are exact, and
+ * the same whatever order the values and the sums of other statistics are
+ * added in.  The variance is worked out exactly as well, as n times the sum
+ * of squares less the square of the sum, before it is divided.
+ */
+template<class T, class U> class MeasurementMoments
+	{
+	public:
+
+		MeasurementMoments ()
+			:	fSum (0),
+				fSquaresLow (0),
+				fSquaresHigh (0)
+			{
+			}
+
+		void Add (T inValue, uint64 /*inCount*/)
+			{
+			uint64		square = (uint64)inValue * inValue;
+
+			fSum += inValue;
+			fSquaresLow += square;
+			fSquaresHigh += fSquaresLow < square;
+			}
+
+		void Add (const MeasurementMoments &inMoments, uint64 /*inCount*/, uint64 /*inOtherCount*/)
+			{
+			fSum += inMoments.fSum;
+			fSquaresLow += inMoments.fSquaresLow;
+			fSquaresHigh += inMoments.fSquaresHigh + (fSquaresLow < inMoments.fSquaresLow);
+			}
+
+		double GetMean (uint64 inCount) const
+			{
+			return (double)fSum / inCount;
+			}
+
+		double GetVariance (uint64 inCount) const
+			{
+			uint64		high, low, sumHigh, sumLow;
+
+			// Only the difference has to fit 128 bits, so the terms are
+			// worked out modulo 2^128
+			MultiplyUInt64 (inCount, fSquaresLow, high, low);
+			high += inCount * fSquaresHigh;
+			MultiplyUInt64 ((uint64)fSum, (uint64)fSum, sumHigh, sumLow);
+
+			high -= sumHigh + (low < sumLow);
+			low -= sumLow;
+
+			return ((double)high * 18446744073709551616.0 + (double)low) / inCount / inCount;
+			}
+
+	private:
+
+		U				fSum;
+		uint64			fSquaresLow;
+		uint64			fSquaresHigh;
+
+	};
+
+/**
+ * The sums behind the mean and standard deviation of 32-bit values.  Within
+ * a tile the values are summed less the first of them, which keeps the sum of
+ * squares near the spread of the values rather than their size.  Statistics
+ * are added with Chan's pairwise update of the mean and the sum of squared
+ * deviations from it, which does not lose the spread to rounding either.
+ * Rounding does depend on the order of those additions, so the tiles are
+ * always added in the same order; see MeasurementWorkers.
+ */
+template<> class MeasurementMoments<float, double>
+	{
+	public:
+
+		MeasurementMoments ()
+			:	fShift (0),
+				fSum (0),
+				fSumSquares (0)
+			{
+			}
+
+		void Add (float inValue, uint64 inCount)
+			{
+			// An infinite shift would take every deviation to NaN
+			if (inCount == 0 && std::isfinite (inValue))
+				fShift = inValue;
+
+			double		deviation = (double)inValue - fShift;
+
+			fSum += deviation;
+			fSumSquares += deviation * deviation;
+			}
+
+		void Add (const MeasurementMoments &inMoments, uint64 inCount, uint64 inOtherCount)
+			{
+			if (inOtherCount == 0)
+				return;
+
+			if (inCount == 0)
+				{
+				*this = inMoments;
+				return;
+				}
+
+			double		count = (double)inCount + (double)inOtherCount;
+			double		mean = GetMean (inCount);
+			double		delta = inMoments.GetMean (inOtherCount) - mean;
+
+			fSumSquares = GetDeviations (inCount) + inMoments.GetDeviations (inOtherCount) +
+					delta * delta * ((double)inCount * (double)inOtherCount / count);
+			fShift = mean + delta * ((double)inOtherCount / count);
+			fSum = 0;
+			}
+
+		double GetMean (uint64 inCount) const
+			{
+			return fShift + fSum / inCount;
+			}
+
+		double GetVariance (uint64 inCount) const
+			{
+			return GetDeviations (inCount) / inCount;
+			}
+
+	private:
+
+		// The sum of squared deviations from the mean
+		double GetDeviations (uint64 inCount) const
+			{
+			double		deviations = fSumSquares - fSum * fSum / inCount;
+
+			// Rounding can take a spread of nothing below zero
+			return deviations > 0 ? deviations : 0;
+			}
+
+	private:
+
+		double			fShift;
+		double			fSum;		// of the values less fShift
+		double			fSumSquares;
+
+	};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Statistics of the values of one plane of one feature: the count, minimum,
+ * maximum, and the moments, for the mean and standard deviation, and,
+ * if asked for, a histogram for the median and percentiles.  The 'U' template
+ * class is the type for summing pixel values.  32-bit NaN values are left out.
+ */
+template<class T, class U> class MeasurementStatistics
+	{
+	public:
+
+		static uint32 GetDataSize (bool inHistogram, uint32 inBlocks);
+
+	public:
+
+		MeasurementStatistics (bool inHistogram = false);
+
+		void Add (T inValue)
+			{
+			// NaN is not even equal to itself
+			if (inValue != inValue)
+				return;
+
+			if (fMinimum > inValue)
+				fMinimum = inValue;
+			if (fMaximum < inValue)
+				fMaximum = inValue;
+
+			fMoments.Add (inValue, fCount);
+			fCount++;
+
+			if (fHasHistogram)
+				fHistogram.Add (MeasurementValues<T>::GetBin (inValue));
+			}
+
+		void Add (const MeasurementStatistics &inStatistics);
+
+		uint64 GetCount () const { return fCount; }
+		double GetMinimum () const { return fCount != 0 ? (double)fMinimum : 0; }
+		double GetMaximum () const { return fCount != 0 ? (double)fMaximum : 0; }
+		double GetMean () const;
+		double GetStandardDeviation () const;
+		double GetPercentile (double inPercent) const;
+
+		void GetHistogram (uint64 outCounts[kHistogramDisplayBins]) const;
+
+		size_t GetAllocatedSize () const { return fHistogram.GetAllocatedSize (); }
+
+	private:
+
+		uint64						fCount;
+		T							fMinimum;
+		T							fMaximum;
+		MeasurementMoments<T, U>	fMoments;
+		bool						fHasHistogram;
+		MeasurementHistogram<T>		fHistogram;
+
+	};
+
+/******************************************************************************/
+
+/**
+ * The memory one plane's statistics take.
+ *
+ * \param inHistogram whether there is a histogram
+ * \param inBlocks the number of blocks in the histogram
+ */
+template<class T, class U> uint32 MeasurementStatistics<T, U>::GetDataSize (bool inHistogram,
+		uint32 inBlocks)
+	{
+	return sizeof (MeasurementStatistics<T, U>) +
+			(inHistogram ? MeasurementHistogram<T>::GetDataSize (inBlocks) : 0);
+	}
+
+/******************************************************************************/
+
+/**
+ * Construct empty statistics.
+ *
+ * \param inHistogram whether to keep a histogram of the values
+ */
+template<class T, class U> MeasurementStatistics<T, U>::MeasurementStatistics (bool inHistogram)
+	:	fCount (0),
+		fMinimum (std::numeric_limits<T>::max ()),
+		fMaximum (std::numeric_limits<T>::lowest ()),
+		fHasHistogram (inHistogram)
+	{
+	}
+
+/******************************************************************************/
+
+/**
+ * Add the values of other statistics, from another thread or feature.
+ *
+ * \param inStatistics the statistics to add to these
+ */
+template<class T, class U> void MeasurementStatistics<T, U>::Add (
+		const MeasurementStatistics &inStatistics)
+	{
+	if (fMinimum > inStatistics.fMinimum)
+		fMinimum = inStatistics.fMinimum;
+	if (fMaximum < inStatistics.fMaximum)
+		fMaximum = inStatistics.fMaximum;
+
+	fMoments.Add (inStatistics.fMoments, fCount, inStatistics.fCount);
+	fCount += inStatistics.fCount;
+
+	if (fHasHistogram)
+		fHistogram.Add (inStatistics.fHistogram);
+	}
+
+/******************************************************************************/
+
+/**
+ * The mean of the values, 0 if there are none.
+ */
+template<class T, class U> double MeasurementStatistics<T, U>::GetMean () const
+	{
+	return fCount != 0 ? fMoments.GetMean (fCount) : 0;
+	}
+
+/******************************************************************************/
+
+/**
+ * The standard deviation of the values, as a population, 0 if there are none.
+ */
+template<class T, class U> double MeasurementStatistics<T, U>::GetStandardDeviation () const
+	{
+	return fCount != 0 ? std::sqrt (fMoments.GetVariance (fCount)) : 0;
+	}
+
+/******************************************************************************/
+
+/**
+ * A percentile of the values by the nearest rank, from the histogram: the
+ * smallest value with at least that percent of the values at or below it.
+ * 32-bit values are those of their bins, so to within 1/32768.  0 if there
+ * are no values or no histogram.
+ *
+ * \param inPercent the percentile, 50 for the median
+ */
+template<class T, class U> double MeasurementStatistics<T, U>::GetPercentile (double inPercent) const
+	{
+	if (fCount == 0 || !fHasHistogram)
+		return 0;
+
+	uint64		rank = (uint64)std::ceil (inPercent / 100 * fCount);
+
+	if (rank < 1)
+		rank = 1;
+	if (rank > fCount)
+		rank = fCount;
+
+	return MeasurementValues<T>::GetValue (fHistogram.FindRank (rank - 1));
+	}
+
+/******************************************************************************/
+
+/**
+ * The histogram in kHistogramDisplayBins bins, all 0 if there is none.
+ *
+ * \param outCounts the count of each bin
+ */
+template<class T, class U> void MeasurementStatistics<T, U>::GetHistogram (
+		uint64 outCounts[kHistogramDisplayBins]) const
+	{
+	fHistogram.GetDisplayCounts (outCounts);
+	}
+
+#endif
@@ -0,0 +1,734 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+
+// Turns the event recordings that PIUDescriptorLog writes, see
+// PIURecording.h, into text, JSON lines, or an ExtendScript that plays
+// the events back, or replays them, see PIUReplay.h, on a stand-in for
+// the host that makes each event's values and plays nothing.  Builds
+// anywhere with a C++ compiler; nothing from Photoshop is needed.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "PIURecording.h"
+#include "PIUReplay.h"
+
+/* -------------------------------------------------------------- */
+
+enum
+	{
+	// leave zero as an invalid value
+	kText = 1,
+	kJSON,
+	kScript,
+	kReplay,
+	kFolded
+	};
+
+typedef struct Output
+	{
+	const PIURecordingReader * reader;
+	int format;
+	int variables;			// for the script, the last variable number used
+	} Output;
+
+static bool ReadWholeFile(const char * name, std::vector<uint8_t> & data);
+static void WriteEvent(Output & output, const RecordedEvent & event);
+
+// Without Photoshop there is nothing to play an event on, so a replay
+// here times reading the recording and copying each event's values,
+// which is what a plug-in does before it plays one, and shows a paced
+// replay keeps up.  Replay on the host with the Listener plug-in.
+class StandInHost : public PIUReplayTarget
+	{
+	public:
+		virtual int Build(const PIURecordingReader & /*reader*/, const RecordedEvent & event)
+			{
+			built = event.descriptor;
+			return 0;
+			}
+		virtual int Play(const PIURecordingReader & /*reader*/, const RecordedEvent & /*event*/)
+			{
+			return 0;
+			}
+		virtual void Free(void)
+			{
+			built.children.clear();
+			built.keys.clear();
+			}
+
+	private:
+		RecordedValue built;
+	};
+
+/* -------------------------------------------------------------- */
+int main(int argc, char * argv[])
+{
+	int format = kText;
+	int firstFile = 1;
+	PIUReplayOptions options;
+
+	if (argc > 1 && argv[1][0] == '-')
+		{
+		if (!strcmp(argv[1], "-text"))
+			format = kText;
+		else if (!strcmp(argv[1], "-json"))
+			format = kJSON;
+		else if (!strcmp(argv[1], "-jsx"))
+			format = kScript;
+		else if (!strcmp(argv[1], "-replay"))
+			format = kReplay;
+		else if (!strcmp(argv[1], "-folded"))
+			format = kFolded;
+		else
+			format = 0;
+		firstFile = 2;
+		}
+
+	if ((format == kReplay || format == kFolded) && argc > firstFile && !strcmp(argv[firstFile], "-paced"))
+		{
+		options.paced = true;
+		firstFile++;
+		}
+
+	if (format == 0 || argc <= firstFile)
+		{
+		printf("Usage: DescriptorDecoder [-text | -json | -jsx | -replay [-paced] | -folded [-paced]] filename1 filename2 ...\n");
+		printf("\t-text\tindented text, as the Listener log (the default)\n");
+		printf("\t-json\tone JSON object per event\n");
+		printf("\t-jsx\tan ExtendScript that plays the events back\n");
+		printf("\t-replay\treplays the events and writes how long each kind took\n");
+		printf("\t-folded\treplays the events and writes the times for a flame graph\n");
+		printf("\t-paced\treplays at the pace the events were recorded\n");
+		return 1;
+		}
+
+	int result = 0;
+
+	for (int i = firstFile; i < argc; i++)
+		{
+		const char * inputFileName = argv[i];
+		std::vector<uint8_t> data;
+
+		if (!ReadWholeFile(inputFileName, data))
+			{
+			fprintf(stderr, "Could not read file %s\n", inputFileName);
+			result = 1;
+			continue;
+			}
+
+		PIURecordingReader reader(data.empty() ? NULL : &data[0], data.size());
+		if (!reader.IsRecording())
+			{
+			fprintf(stderr, "%s is not an event recording\n", inputFileName);
+			result = 1;
+			continue;
+			}
+
+		if (format == kReplay || format == kFolded)
+			{
+			StandInHost host;
+			PIUReplay replay(host);
+
+			if (!replay.Run(&data[0], data.size(), options))
+				{
+				fprintf(stderr, "%s is cut short or damaged\n", inputFileName);
+				result = 1;
+				}
+
+			if (format == kReplay)
+				{
+				printf("// %s\n\n", inputFileName);
+				replay.WriteSummary(stdout);
+				}
+			else
+				{
+				replay.WriteFolded(stdout);
+				}
+			continue;
+			}
+
+		Output output = { &reader, format, 0 };
+		RecordedEvent event;
+		uint64_t dropped = 0;
+		int tag;
+
+		if (format != kJSON)
+			printf("// %s\n\n", inputFileName);
+
+		while ((tag = reader.Next(event, dropped)) != kRecordEnd)
+			{
+			switch (tag)
+				{
+				case kRecordSession:
+					if (format == kJSON)
+						printf("{\"session\": true}\n");
+					else
+						printf("// session\n\n");
+					break;
+				case kRecordDropped:
+					if (format == kJSON)
+						printf("{\"dropped\": %llu}\n", (unsigned long long)dropped);
+					else
+						printf("// %llu events dropped\n", (unsigned long long)dropped);
+					break;
+				case kRecordEvent:
+					WriteEvent(output, event);
+					break;
+				}
+			}
+
+		if (!reader.IsOK())
+			{
+			fprintf(stderr, "%s is cut short or damaged\n", inputFileName);
+			result = 1;
+			}
+		}
+
+	return result;
+
+}  /* main */
+
+/* -------------------------------------------------------------- */
+static bool ReadWholeFile(const char * name, std::vector<uint8_t> & data)
+{
+	FILE * input = fopen(name, "rb");
+	if (input == NULL)
+		return false;
+
+	const size_t kReadBytes = 1 << 20;
+	size_t total = 0;
+	size_t got;
+
+	do
+		{
+		data.resize(total + kReadBytes);
+		got = fread(&data[total], 1, kReadBytes, input);
+		total += got;
+		}
+	while (got == kReadBytes);
+
+	data.resize(total);
+
+	bool ok = !ferror(input);
+	fclose(input);
+	return ok;
+}
+
+/* -------------------------------------------------------------- */
+/*	IDs and strings                                               */
+/* -------------------------------------------------------------- */
+
+static bool IsCharID(uint32_t id)
+{
+	for (int a = 0; a < 4; a++)
+		{
+		char c = (char)(id >> (24 - 8 * a));
+		if (c < ' ' || c > '~')
+			return false;
+		}
+	return true;
+}
+
+static std::string CharID(uint32_t id)
+{
+	std::string text(4, ' ');
+	for (int a = 0; a < 4; a++)
+		text[a] = (char)(id >> (24 - 8 * a));
+	return text;
+}
+
+// Escaped for a double quoted string in JSON or JavaScript.
+static std::string Quote(const std::string & text)
+{
+	std::string quoted = "\"";
+	for (size_t c = 0; c < text.size(); c++)
+		{
+		unsigned char letter = (unsigned char)text[c];
+		switch (letter)
+			{
+			case '"':	quoted += "\\\""; break;
+			case '\\':	quoted += "\\\\"; break;
+			case '\n':	quoted += "\\n"; break;
+			case '\r':	quoted += "\\r"; break;
+			case '\t':	quoted += "\\t"; break;
+			default:
+				if (letter < ' ')
+					{
+					char escape[8];
+					sprintf(escape, "\\u%04x", letter);
+					quoted += escape;
+					}
+				else
+					{
+					quoted += (char)letter;
+					}
+				break;
+			}
+		}
+	return quoted + "\"";
+}
+
+// 'Hash' for a four character ID and "name" for a runtime ID in text,
+// the same but quoted for JSON, and the call that makes the ID in a script.
+static std::string ID(const Output & output, uint32_t number)
+{
+	const RecordedID & id = output.reader->ID(number);
+	bool isRuntime = id.id < kRecordingRuntimeIDLimit;
+	char text[32];
+
+	if (output.format == kScript)
+		{
+		if (isRuntime)
+			return "stringIDToTypeID( " + Quote(id.name) + " )";
+		if (IsCharID(id.id))
+			return "charIDToTypeID( " + Quote(CharID(id.id)) + " )";
+		sprintf(text, "%lu", (unsigned long)id.id);
+		return text;
+		}
+
+	std::string plain;
+	if (isRuntime)
+		plain = "\"" + id.name + "\"";
+	else if (IsCharID(id.id))
+		plain = "'" + CharID(id.id) + "'";
+	else
+		{
+		sprintf(text, "%lu", (unsigned long)id.id);
+		plain = text;
+		}
+
+	return output.format == kJSON ? Quote(plain) : plain;
+}
+
+static std::string Number(const Output & output, double value)
+{
+	char text[40];
+	if (output.format != kText && !isfinite(value))
+		return output.format == kJSON ? "null" : (isnan(value) ? "NaN" : (value > 0 ? "Infinity" : "-Infinity"));
+	sprintf(text, output.format == kText ? "%.15g" : "%.17g", value);
+	return text;
+}
+
+static std::string Integer(int64_t value)
+{
+	char text[24];
+	sprintf(text, "%lld", (long long)value);
+	return text;
+}
+
+static void Indent(int depth)
+{
+	for (int a = 0; a < depth; a++)
+		putchar('\t');
+}
+
+/* -------------------------------------------------------------- */
+/*	Text                                                          */
+/* -------------------------------------------------------------- */
+
+static void TextDescriptor(const Output & output, const RecordedValue & descriptor, int depth);
+static void TextValue(const Output & output, const RecordedValue & value, int depth);
+
+static void TextReference(const Output & output, const RecordedValue & reference, int depth)
+{
+	for (size_t p = 0; p < reference.children.size(); p++)
+		{
+		const RecordedValue & part = reference.children[p];
+		Indent(depth);
+		printf("%s", ID(output, part.id1).c_str());
+		switch (part.kind)
+			{
+			case kFormName:
+				printf(" name \"%s\"", part.text.c_str());
+				break;
+			case kFormIndex:
+				printf(" index %s", Integer(part.integer).c_str());
+				break;
+			case kFormIdentifier:
+				printf(" identifier %s", Integer(part.integer).c_str());
+				break;
+			case kFormOffset:
+				printf(" offset %s", Integer(part.integer).c_str());
+				break;
+			case kFormEnumerated:
+				printf(" enumerated %s %s", ID(output, part.id2).c_str(), ID(output, part.id3).c_str());
+				break;
+			case kFormProperty:
+				printf(" property %s", ID(output, part.id2).c_str());
+				break;
+			case kFormClass:
+				break;
+			default:
+				printf(" form %s", Integer(part.integer).c_str());
+				break;
+			}
+		printf("\n");
+		}
+}
+
+// Finishes the line that the caller started with the key, if any.
+static void TextValue(const Output & output, const RecordedValue & value, int depth)
+{
+	switch (value.kind)
+		{
+		case kValueInteger64:
+			printf("integer64 %s\n", Integer(value.integer).c_str());
+			break;
+		case kValueInteger:
+			printf("integer %s\n", Integer(value.integer).c_str());
+			break;
+		case kValueFloat:
+			printf("float %s\n", Number(output, value.number).c_str());
+			break;
+		case kValueUnitFloat:
+			printf("unitFloat %s %s\n", ID(output, value.id1).c_str(), Number(output, value.number).c_str());
+			break;
+		case kValueString:
+			printf("string \"%s\"\n", value.text.c_str());
+			break;
+		case kValuePath:
+			printf("path \"%s\"\n", value.text.c_str());
+			break;
+		case kValueFalse:
+		case kValueTrue:
+			printf("boolean %s\n", value.kind == kValueTrue ? "true" : "false");
+			break;
+		case kValueObject:
+		case kValueGlobalObject:
+			printf("%s %s\n", value.kind == kValueObject ? "object" : "globalObject", ID(output, value.id1).c_str());
+			TextDescriptor(output, value, depth + 1);
+			break;
+		case kValueEnumerated:
+			printf("enumerated %s %s\n", ID(output, value.id1).c_str(), ID(output, value.id2).c_str());
+			break;
+		case kValueList:
+			printf("list\n");
+			for (size_t v = 0; v < value.children.size(); v++)
+				{
+				Indent(depth + 1);
+				printf("%lu: ", (unsigned long)v);
+				TextValue(output, value.children[v], depth + 1);
+				}
+			break;
+		case kValueReference:
+			printf("reference\n");
+			TextReference(output, value, depth + 1);
+			break;
+		case kValueClass:
+		case kValueGlobalClass:
+			printf("%s %s\n", value.kind == kValueClass ? "class" : "globalClass", ID(output, value.id1).c_str());
+			break;
+		case kValueData:
+			printf("data, %s bytes\n", Integer(value.integer).c_str());
+			break;
+		default:
+			printf("type %s\n", Integer(value.integer).c_str());
+			break;
+		}
+}
+
+static void TextDescriptor(const Output & output, const RecordedValue & descriptor, int depth)
+{
+	for (size_t k = 0; k < descriptor.keys.size(); k++)
+		{
+		Indent(depth);
+		printf("%s: ", ID(output, descriptor.keys[k]).c_str());
+		TextValue(output, descriptor.children[k], depth);
+		}
+}
+
+/* -------------------------------------------------------------- */
+/*	JSON                                                          */
+/* -------------------------------------------------------------- */
+
+static void JSONDescriptor(const Output & output, const RecordedValue & descriptor);
+
+static void JSONReference(const Output & output, const RecordedValue & reference)
+{
+	static const char * const forms[] =
+		{ "", "name", "index", "identifier", "offset", "enumerated", "property", "class", "other" };
+
+	printf("[");
+	for (size_t p = 0; p < reference.children.size(); p++)
+		{
+		const RecordedValue & part = reference.children[p];
+		printf("%s{\"form\": \"%s\", \"class\": %s", p ? ", " : "",
+			   part.kind <= kFormOther ? forms[part.kind] : "other", ID(output, part.id1).c_str());
+		switch (part.kind)
+			{
+			case kFormName:
+				printf(", \"value\": %s", Quote(part.text).c_str());
+				break;
+			case kFormIndex:
+			case kFormIdentifier:
+			case kFormOffset:
+				printf(", \"value\": %s", Integer(part.integer).c_str());
+				break;
+			case kFormEnumerated:
+				printf(", \"enumType\": %s, \"value\": %s", ID(output, part.id2).c_str(), ID(output, part.id3).c_str());
+				break;
+			case kFormProperty:
+				printf(", \"value\": %s", ID(output, part.id2).c_str());
+				break;
+			case kFormClass:
+				break;
+			default:
+				printf(", \"code\": %s", Integer(part.integer).c_str());
+				break;
+			}
+		printf("}");
+		}
+	printf("]");
+}
+
+static void JSONValue(const Output & output, const RecordedValue & value)
+{
+	switch (value.kind)
+		{
+		case kValueInteger64:
+		case kValueInteger:
+			printf("{\"type\": \"%s\", \"value\": %s}", value.kind == kValueInteger ? "integer" : "integer64",
+				   Integer(value.integer).c_str());
+			break;
+		case kValueFloat:
+			printf("{\"type\": \"float\", \"value\": %s}", Number(output, value.number).c_str());
+			break;
+		case kValueUnitFloat:
+			printf("{\"type\": \"unitFloat\", \"unit\": %s, \"value\": %s}",
+				   ID(output, value.id1).c_str(), Number(output, value.number).c_str());
+			break;
+		case kValueString:
+		case kValuePath:
+			printf("{\"type\": \"%s\", \"value\": %s}", value.kind == kValueString ? "string" : "path",
+				   Quote(value.text).c_str());
+			break;
+		case kValueFalse:
+		case kValueTrue:
+			printf("{\"type\": \"boolean\", \"value\": %s}", value.kind == kValueTrue ? "true" : "false");
+			break;
+		case kValueObject:
+		case kValueGlobalObject:
+			printf("{\"type\": \"%s\", \"class\": %s, \"value\": ",
+				   value.kind == kValueObject ? "object" : "globalObject", ID(output, value.id1).c_str());
+			JSONDescriptor(output, value);
+			printf("}");
+			break;
+		case kValueEnumerated:
+			printf("{\"type\": \"enumerated\", \"enumType\": %s, \"value\": %s}",
+				   ID(output, value.id1).c_str(), ID(output, value.id2).c_str());
+			break;
+		case kValueList:
+			printf("{\"type\": \"list\", \"value\": [");
+			for (size_t v = 0; v < value.children.size(); v++)
+				{
+				if (v) printf(", ");
+				JSONValue(output, value.children[v]);
+				}
+			printf("]}");
+			break;
+		case kValueReference:
+			printf("{\"type\": \"reference\", \"value\": ");
+			JSONReference(output, value);
+			printf("}");
+			break;
+		case kValueClass:
+		case kValueGlobalClass:
+			printf("{\"type\": \"%s\", \"value\": %s}", value.kind == kValueClass ? "class" : "globalClass",
+				   ID(output, value.id1).c_str());
+			break;
+		case kValueData:
+			printf("{\"type\": \"data\", \"length\": %s}", Integer(value.integer).c_str());
+			break;
+		default:
+			printf("{\"type\": \"other\", \"code\": %s}", Integer(value.integer).c_str());
+			break;
+		}
+}
+
+static void JSONDescriptor(const Output & output, const RecordedValue & descriptor)
+{
+	printf("{");
+	for (size_t k = 0; k < descriptor.keys.size(); k++)
+		{
+		printf("%s%s: ", k ? ", " : "", ID(output, descriptor.keys[k]).c_str());
+		JSONValue(output, descriptor.children[k]);
+		}
+	printf("}");
+}
+
+/* -------------------------------------------------------------- */
+/*	Script                                                        */
+/*                                                                */
+/*	Builds the event's descriptor with the same calls that the    */
+/*	ScriptListener plug-in writes, inner values first, and then   */
+/*	plays the event.                                              */
+/* -------------------------------------------------------------- */
+
+static std::string ScriptDescriptor(Output & output, const RecordedValue & descriptor);
+
+static std::string ScriptReference(Output & output, const RecordedValue & reference)
+{
+	char name[24];
+	sprintf(name, "ref%d", ++output.variables);
+	printf("var %s = new ActionReference();\n", name);
+
+	for (size_t p = 0; p < reference.children.size(); p++)
+		{
+		const RecordedValue & part = reference.children[p];
+		std::string desiredClass = ID(output, part.id1);
+		switch (part.kind)
+			{
+			case kFormName:
+				printf("%s.putName( %s, %s );\n", name, desiredClass.c_str(), Quote(part.text).c_str());
+				break;
+			case kFormIndex:
+				printf("%s.putIndex( %s, %s );\n", name, desiredClass.c_str(), Integer(part.integer).c_str());
+				break;
+			case kFormIdentifier:
+				printf("%s.putIdentifier( %s, %s );\n", name, desiredClass.c_str(), Integer(part.integer).c_str());
+				break;
+			case kFormOffset:
+				printf("%s.putOffset( %s, %s );\n", name, desiredClass.c_str(), Integer(part.integer).c_str());
+				break;
+			case kFormEnumerated:
+				printf("%s.putEnumerated( %s, %s, %s );\n", name, desiredClass.c_str(),
+					   ID(output, part.id2).c_str(), ID(output, part.id3).c_str());
+				break;
+			case kFormProperty:
+				printf("%s.putProperty( %s, %s );\n", name, desiredClass.c_str(), ID(output, part.id2).c_str());
+				break;
+			case kFormClass:
+				printf("%s.putClass( %s );\n", name, desiredClass.c_str());
+				break;
+			default:
+				printf("// %s: form %s was not recorded\n", name, Integer(part.integer).c_str());
+				break;
+			}
+		}
+	return name;
+}
+
+// Writes the put call for one value.  key is empty for a list.
+static void ScriptValue(Output & output, const std::string & target, const std::string & key, const RecordedValue & value)
+{
+	std::string keyComma = key.empty() ? std::string() : key + ", ";
+
+	switch (value.kind)
+		{
+		case kValueInteger64:
+			printf("%s.putLargeInteger( %s%s );\n", target.c_str(), keyComma.c_str(), Integer(value.integer).c_str());
+			break;
+		case kValueInteger:
+			printf("%s.putInteger( %s%s );\n", target.c_str(), keyComma.c_str(), Integer(value.integer).c_str());
+			break;
+		case kValueFloat:
+			printf("%s.putDouble( %s%s );\n", target.c_str(), keyComma.c_str(), Number(output, value.number).c_str());
+			break;
+		case kValueUnitFloat:
+			printf("%s.putUnitDouble( %s%s, %s );\n", target.c_str(), keyComma.c_str(),
+				   ID(output, value.id1).c_str(), Number(output, value.number).c_str());
+			break;
+		case kValueString:
+			printf("%s.putString( %s%s );\n", target.c_str(), keyComma.c_str(), Quote(value.text).c_str());
+			break;
+		case kValuePath:
+			printf("%s.putPath( %snew File( %s ) );\n", target.c_str(), keyComma.c_str(), Quote(value.text).c_str());
+			break;
+		case kValueFalse:
+		case kValueTrue:
+			printf("%s.putBoolean( %s%s );\n", target.c_str(), keyComma.c_str(), value.kind == kValueTrue ? "true" : "false");
+			break;
+		case kValueObject:
+		case kValueGlobalObject:
+		{
+			std::string inner = ScriptDescriptor(output, value);
+			printf("%s.putObject( %s%s, %s );\n", target.c_str(), keyComma.c_str(),
+				   ID(output, value.id1).c_str(), inner.c_str());
+			break;
+		}
+		case kValueEnumerated:
+			printf("%s.putEnumerated( %s%s, %s );\n", target.c_str(), keyComma.c_str(),
+				   ID(output, value.id1).c_str(), ID(output, value.id2).c_str());
+			break;
+		case kValueList:
+		{
+			char name[24];
+			sprintf(name, "list%d", ++output.variables);
+			printf("var %s = new ActionList();\n", name);
+			for (size_t v = 0; v < value.children.size(); v++)
+				ScriptValue(output, name, std::string(), value.children[v]);
+			printf("%s.putList( %s%s );\n", target.c_str(), keyComma.c_str(), name);
+			break;
+		}
+		case kValueReference:
+		{
+			std::string inner = ScriptReference(output, value);
+			printf("%s.putReference( %s%s );\n", target.c_str(), keyComma.c_str(), inner.c_str());
+			break;
+		}
+		case kValueClass:
+		case kValueGlobalClass:
+			printf("%s.putClass( %s%s );\n", target.c_str(), keyComma.c_str(), ID(output, value.id1).c_str());
+			break;
+		case kValueData:
+			printf("// %s: %s bytes of data were not recorded\n", target.c_str(), Integer(value.integer).c_str());
+			break;
+		default:
+			printf("// %s: type %s was not recorded\n", target.c_str(), Integer(value.integer).c_str());
+			break;
+		}
+}
+
+static std::string ScriptDescriptor(Output & output, const RecordedValue & descriptor)
+{
+	char name[24];
+	sprintf(name, "desc%d", ++output.variables);
+	printf("var %s = new ActionDescriptor();\n", name);
+
+	for (size_t k = 0; k < descriptor.keys.size(); k++)
+		ScriptValue(output, name, ID(output, descriptor.keys[k]), descriptor.children[k]);
+
+	return name;
+}
+
+/* -------------------------------------------------------------- */
+static void WriteEvent(Output & output, const RecordedEvent & event)
+{
+	switch (output.format)
+		{
+		case kText:
+			printf("// %s s\n", Number(output, event.seconds).c_str());
+			printf("event %s\n", ID(output, event.event).c_str());
+			TextDescriptor(output, event.descriptor, 1);
+			printf("\n");
+			break;
+
+		case kJSON:
+			printf("{\"seconds\": %s, \"event\": %s, \"descriptor\": ",
+				   Number(output, event.seconds).c_str(), ID(output, event.event).c_str());
+			JSONDescriptor(output, event.descriptor);
+			printf("}\n");
+			break;
+
+		case kScript:
+		{
+			printf("// %.15g s\n", event.seconds);
+			std::string descriptor = ScriptDescriptor(output, event.descriptor);
+			printf("executeAction( %s, %s, DialogModes.NO );\n\n", ID(output, event.event).c_str(), descriptor.c_str());
+			break;
+		}
+		}
+}
+
+// end DescriptorDecoder.cpp
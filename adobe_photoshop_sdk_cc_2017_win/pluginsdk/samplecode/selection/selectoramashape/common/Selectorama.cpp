@@ -30,6 +30,19 @@
 
 #include "Selectorama.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define SELECTORAMA_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define SELECTORAMA_SSE2 0
+#endif
+
 //-------------------------------------------------------------------------------
 //	Globals -- Define global variables for plug-in scope.
 //-------------------------------------------------------------------------------
@@ -244,24 +257,535 @@ static int32 AccountChannel (ReadChannelDesc *source,
 
 /*****************************************************************************/
 
+/* Threshold one row of a block for the min or max mode, with the mask if
+   there is one.  Min keeps the pixels of 128 and up; max inverts the ones
+   below 128.  With SSE2 sixteen pixels are done at once; either way there
+   is no branch on the pixel values. */
+
+template <short kWhatArea, bool kMask>
+static void ThresholdRow (const unsigned8 *s,
+						  const unsigned8 *m,
+						  unsigned8 *d,
+						  int32 count)
+	{
+	
+	int32 col = 0;
+	
+#if SELECTORAMA_SSE2
+	for (; col + 16 <= count; col += 16)
+		{
+	
+		__m128i source = _mm_loadu_si128 ((const __m128i *) (s + col));
+		__m128i high;
+	
+		if (kMask) source = _mm_min_epu8 (source, _mm_loadu_si128 ((const __m128i *) (m + col)));
+	
+		/* 128 and up is negative as a signed byte */
+		high = _mm_cmplt_epi8 (source, _mm_setzero_si128 ());
+	
+		if (kWhatArea == iSelectMin)
+			source = _mm_and_si128 (high, source);
+		else
+			source = _mm_andnot_si128 (high, _mm_xor_si128 (source, _mm_set1_epi8 (-1)));
+	
+		_mm_storeu_si128 ((__m128i *) (d + col), source);
+	
+		}
+#endif
+	
+	for (; col < count; col++)
+		{
+	
+		unsigned8 source = s[col];
+		unsigned8 high;
+	
+		if (kMask && m[col] < source) source = m[col];
+	
+		/* all ones for 128 and up */
+		high = (unsigned8) (0 - (source >> 7));
+	
+		if (kWhatArea == iSelectMin)
+			d[col] = source & high;
+		else
+			d[col] = (unsigned8) (~source & ~high);
+	
+		}
+	
+	}
+
+/*****************************************************************************/
+
+template <short kWhatArea, bool kMask>
+static void ThresholdBlock (const unsigned8 *s,
+							const unsigned8 *m,
+							unsigned8 *d,
+							int32 rows,
+							int32 cols,
+							int32 rowBytes)
+	{
+	
+	for (int32 row = 0; row < rows; row++)
+		ThresholdRow<kWhatArea, kMask> (s + row * rowBytes,
+										kMask ? m + row * rowBytes : NULL,
+										d + row * rowBytes,
+										cols);
+	
+	}
+
+/*****************************************************************************/
+
+/* The random bits of a pixel come from a counter based generator.  They are
+   a hash of the pixel's row and column, using the murmur3 finalizer twice.
+   So the bits do not depend on the order the blocks are done in, and every
+   channel and every run picks the same pixel. */
+
+static inline unsigned32 MixBits (unsigned32 bits)
+	{
+	
+	bits ^= bits >> 16;
+	bits *= 0x85EBCA6B;
+	bits ^= bits >> 13;
+	bits *= 0xC2B2AE35;
+	bits ^= bits >> 16;
+	
+	return bits;
+	
+	}
+
+#if SELECTORAMA_SSE2
+
+/* SSE2 has no 32 bit multiply that keeps the low halves, so it takes
+   two 64 bit ones, of the even lanes and of the odd ones. */
+
+static inline __m128i MultiplyLanes (__m128i a, __m128i b)
+	{
+	
+	__m128i even = _mm_mul_epu32 (a, b);
+	__m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+	
+	return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+							   _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+	
+	}
+
+static inline __m128i MixLanes (__m128i bits)
+	{
+	
+	bits = _mm_xor_si128 (bits, _mm_srli_epi32 (bits, 16));
+	bits = MultiplyLanes (bits, _mm_set1_epi32 ((int) 0x85EBCA6B));
+	bits = _mm_xor_si128 (bits, _mm_srli_epi32 (bits, 13));
+	bits = MultiplyLanes (bits, _mm_set1_epi32 ((int) 0xC2B2AE35));
+	bits = _mm_xor_si128 (bits, _mm_srli_epi32 (bits, 16));
+	
+	return bits;
+	
+	}
+
+#endif
+
+/*****************************************************************************/
+
+/* Pick one row of a block at random: 255 where a pixel's random bits are
+   below threshold, 0 elsewhere.  The column is spread over the bits by an
+   odd multiplier before it meets the row's key. */
+
+static void RandomRow (unsigned8 *d,
+					   int32 row,
+					   int32 col,
+					   int32 count,
+					   unsigned32 threshold)
+	{
+	
+	unsigned32 rowKey = MixBits ((unsigned32) row ^ kRandomSeed);
+	int32 index = 0;
+	
+#if SELECTORAMA_SSE2
+	/* unsigned compares as signed ones, with the top bits flipped */
+	const __m128i flip = _mm_set1_epi32 ((int) 0x80000000);
+	const __m128i limit = _mm_set1_epi32 ((int) (threshold ^ 0x80000000));
+	const __m128i key = _mm_set1_epi32 ((int) rowKey);
+	const __m128i step = _mm_set1_epi32 ((int) (4 * 0x9E3779B1));
+	__m128i column = MultiplyLanes (_mm_add_epi32 (_mm_set1_epi32 (col), _mm_set_epi32 (3, 2, 1, 0)),
+									_mm_set1_epi32 ((int) 0x9E3779B1));
+	
+	for (; index + 16 <= count; index += 16)
+		{
+	
+		__m128i picked[4];
+	
+		for (int lanes = 0; lanes < 4; lanes++)
+			{
+			__m128i bits = MixLanes (_mm_xor_si128 (key, column));
+			picked[lanes] = _mm_cmplt_epi32 (_mm_xor_si128 (bits, flip), limit);
+			column = _mm_add_epi32 (column, step);
+			}
+	
+		/* all ones and zeros pack to 255 and 0 */
+		_mm_storeu_si128 ((__m128i *) (d + index),
+						  _mm_packs_epi16 (_mm_packs_epi32 (picked[0], picked[1]),
+										   _mm_packs_epi32 (picked[2], picked[3])));
+	
+		}
+#endif
+	
+	for (; index < count; index++)
+		{
+		unsigned32 bits = MixBits (rowKey ^ ((unsigned32) (col + index) * 0x9E3779B1));
+		d[index] = (unsigned8) (0 - (bits < threshold));
+		}
+	
+	}
+
+/*****************************************************************************/
+
+/* Compute the selection of one block from its source and mask pixels.  Only
+   the area is done, which is clipped at the image edges.  Each mode has its
+   own loops, so nothing is decided per pixel. */
+
+static void ApplyBlock (GPtr globals,
+						const unsigned8 *s,
+						const unsigned8 *m,
+						unsigned8 *d,
+						const VRect *area,
+						int32 rowBytes)
+	{
+	
+	int32 rows = area->bottom - area->top;
+	int32 cols = area->right - area->left;
+	int32 row;
+	
+	switch (gWhatArea)
+		{
+		case iSelectMin:
+			if (m != NULL)
+				ThresholdBlock<iSelectMin, true> (s, m, d, rows, cols, rowBytes);
+			else
+				ThresholdBlock<iSelectMin, false> (s, m, d, rows, cols, rowBytes);
+			break;
+	
+		case iSelectMax:
+			if (m != NULL)
+				ThresholdBlock<iSelectMax, true> (s, m, d, rows, cols, rowBytes);
+			else
+				ThresholdBlock<iSelectMax, false> (s, m, d, rows, cols, rowBytes);
+			break;
+	
+		case iSelectRandom:
+			/* none and all cannot be had with a threshold */
+			if (gPercent <= kPercentMin || gPercent >= kPercentMax)
+				{
+				for (row = 0; row < rows; row++)
+					memset (d + row * rowBytes, gPercent <= kPercentMin ? 0 : 255, cols);
+				}
+			else
+				{
+				unsigned32 threshold = (unsigned32) (4294967296.0 * gPercent / 100);
+	
+				for (row = 0; row < rows; row++)
+					RandomRow (d + row * rowBytes, area->top + row, area->left, cols, threshold);
+				}
+			break;
+		}
+	
+	}
+
+/*****************************************************************************/
+
+/* One block on its way through the pipeline: the area it covers and the
+   pixel memory it is read into, computed in and written from.  Each block
+   has memory of its own, so the host can read and write some while the
+   workers compute others. */
+
+typedef struct BlockSlot
+	{
+	VRect area;
+	PixelMemoryDesc sDesc;
+	PixelMemoryDesc mDesc;
+	PixelMemoryDesc dDesc;
+	Boolean hasMask;
+	} BlockSlot;
+
+/*****************************************************************************/
+
+/* The threads that compute blocks.  The host thread submits a block once it
+   has read its pixels, and takes it back when it is finished to write it.
+   Only the host thread talks to the host; a worker only runs ApplyBlock,
+   which reads the parameters in the globals and nothing else. */
+
+class BlockWorkers
+	{
+	public:
+		BlockWorkers (GPtr globals);
+		~BlockWorkers ();
+
+		/* Blocks to keep in flight: two for each worker, so each has the
+		   next one waiting while the host reads and writes. */
+		size_t Slots (void) const { return 2 * threads.size (); }
+
+		void Submit (BlockSlot *slot);
+
+		/* The next finished block, waiting for one if there are none yet.
+		   Only to be called with blocks submitted and not taken back. */
+		BlockSlot *Finished (void);
+
+		/* A finished block, or NULL if there are none right now. */
+		BlockSlot *TryFinished (void);
+
+	private:
+		void Run (void);
+
+		/* Wakes the workers and joins them; whatever is queued is dropped. */
+		void Stop (void);
+
+		GPtr globals;
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable jobAdded, jobDone;
+		std::deque<BlockSlot *> jobs, finished;
+		bool stopping;
+	};
+
+/*****************************************************************************/
+
+BlockWorkers::BlockWorkers (GPtr inGlobals)
+	: globals (inGlobals),
+	  stopping (false)
+	{
+	
+	unsigned count = std::thread::hardware_concurrency ();
+	
+	/* leave a core for the host thread, which reads and writes the ports */
+	if (count > 1)
+		count--;
+	if (count < 1)
+		count = 1;
+	
+	/* a thread that fails to start must not leave the others running */
+	try
+		{
+		threads.reserve (count);
+		for (unsigned a = 0; a < count; a++)
+			threads.push_back (std::thread (&BlockWorkers::Run, this));
+		}
+	catch (...)
+		{
+		Stop ();
+		throw;
+		}
+	
+	}
+
+/*****************************************************************************/
+
+BlockWorkers::~BlockWorkers ()
+	{
+	
+	Stop ();
+	
+	}
+
+/*****************************************************************************/
+
+void BlockWorkers::Stop (void)
+	{
+	
+		{
+		std::lock_guard<std::mutex> lock (mutex);
+		stopping = true;
+		}
+	jobAdded.notify_all ();
+	
+	for (size_t a = 0; a < threads.size (); a++)
+		threads[a].join ();
+	threads.clear ();
+	
+	}
+
+/*****************************************************************************/
+
+void BlockWorkers::Submit (BlockSlot *slot)
+	{
+	
+		{
+		std::lock_guard<std::mutex> lock (mutex);
+		jobs.push_back (slot);
+		}
+	jobAdded.notify_one ();
+	
+	}
+
+/*****************************************************************************/
+
+BlockSlot *BlockWorkers::Finished (void)
+	{
+	
+	std::unique_lock<std::mutex> lock (mutex);
+	BlockSlot *slot;
+	
+	jobDone.wait (lock, [this] { return !finished.empty (); });
+	
+	slot = finished.front ();
+	finished.pop_front ();
+	
+	return slot;
+	
+	}
+
+/*****************************************************************************/
+
+BlockSlot *BlockWorkers::TryFinished (void)
+	{
+	
+	std::lock_guard<std::mutex> lock (mutex);
+	BlockSlot *slot = NULL;
+	
+	if (!finished.empty ())
+		{
+		slot = finished.front ();
+		finished.pop_front ();
+		}
+	
+	return slot;
+	
+	}
+
+/*****************************************************************************/
+
+void BlockWorkers::Run (void)
+	{
+	
+	std::unique_lock<std::mutex> lock (mutex);
+	
+	for (;;)
+		{
+		
+		BlockSlot *slot;
+		
+		jobAdded.wait (lock, [this] { return stopping || !jobs.empty (); });
+		
+		/* blocks still queued when stopping are never written, so they
+		   need not be computed either */
+		if (stopping)
+			return;
+		
+		slot = jobs.front ();
+		jobs.pop_front ();
+		
+		lock.unlock ();
+		
+		ApplyBlock (globals,
+					(const unsigned8 *) slot->sDesc.data,
+					slot->hasMask ? (const unsigned8 *) slot->mDesc.data : NULL,
+					(unsigned8 *) slot->dDesc.data,
+					&slot->area,
+					slot->sDesc.rowBits / 8);
+		
+		lock.lock ();
+		
+		finished.push_back (slot);
+		jobDone.notify_one ();
+		
+		}
+	
+	}
+
+/*****************************************************************************/
+
+/* The first row or column after position that starts a tile, for tiles of
+   size starting at origin. */
+
+static int32 NextTileEdge (int32 position, int32 origin, int32 size)
+	{
+	
+	int32 offset = (position - origin) % size;
+	
+	if (offset < 0) offset += size;
+	
+	return position - offset + size;
+	
+	}
+
+/*****************************************************************************/
+
+/* Read the pixels of area from a port.  Anything short of the whole area
+   is an error. */
+
+static OSErr ReadBlock (GPtr globals,
+						ChannelReadPort port,
+						const VRect *area,
+						PixelMemoryDesc *desc)
+	{
+	
+	PSScaling scaling;
+	VRect wrote;
+	OSErr err;
+	
+	scaling.sourceRect = *area;
+	scaling.destinationRect = *area;
+	
+	err = ReadPixels (port, &scaling, area, desc, &wrote);
+	if (err != noErr) return err;
+	
+	if (!EqualVRects (area, &wrote)) return -1;
+	
+	return noErr;
+	
+	}
+
+/*****************************************************************************/
+
+/* Write a finished block to the destination and count it as done. */
+
+static OSErr WriteBlock (GPtr globals,
+						 WriteChannelDesc *dest,
+						 BlockSlot *slot,
+						 size_t *done,
+						 size_t total)
+	{
+	
+	OSErr err;
+	
+	err = WritePixels (dest->port, &slot->area, &slot->dDesc);
+	if (err != noErr) return err;
+	
+	*done += (slot->area.right - slot->area.left) * (slot->area.bottom - slot->area.top);
+	
+	PIUpdateProgress ((int32)*done, (int32)total);
+	
+	return noErr;
+	
+	}
+
+/*****************************************************************************/
+
+/* Compute a channel into the destination, a block at a time.  The blocks
+   are the channel's own tiles, so no read or write crosses one, split up
+   if they are larger than kBlockMaxRows by kBlockMaxCols.
+
+   The host thread reads each block into free memory and hands it to the
+   workers, and writes the blocks they have finished, so the ports are only
+   ever used from the one thread while all the other cores compute. */
+
 static void ApplyChannel (GPtr globals,
+						  BlockWorkers *workers,
 						  ReadChannelDesc *source,
-						  PixelMemoryDesc *sDesc,
 						  ReadChannelDesc *mask, 
-						  PixelMemoryDesc *mDesc,
 						  WriteChannelDesc *dest, 
 						  ChannelReadPort destRead,
-						  PixelMemoryDesc *dDesc,
-						  PixelMemoryDesc *rDesc,
 						  size_t *done,
 						  size_t total)
 	{
 	
 	VRect limit;
-	int32 row, col, row2, col2;
-	unsigned8 *s, *m, *d;
-	unsigned8 *r = (unsigned8 *)rDesc->data;
-	Boolean initRandom = (*r == kInitRandom);
+	VPoint tileSize, tileOrigin;
+	int32 blockRows, blockCols, blockBytes;
+	int32 row, col, rowEnd, colEnd;
+	size_t slotCount, inFlight = 0, index;
+	BufferID buffer = 0;
+	Ptr data = NULL;
+	std::vector<BlockSlot> slots;
+	std::vector<BlockSlot *> idle;
+	BlockSlot *slot;
 		
 	limit = source->bounds;
 	TrimVRect (&limit, &dest->bounds);
@@ -269,112 +793,148 @@ static void ApplyChannel (GPtr globals,
 		
 	if (limit.right <= limit.left || limit.bottom <= limit.top) return;
 	
-	for (row = limit.top; row < limit.bottom; row += kBlockRows)
-		for (col = limit.left; col < limit.right; col += kBlockCols)
+	/* Size the blocks by the tiles, or the defaults for a channel that
+	   does not say. */
+	
+	tileSize = source->tileSize;
+	tileOrigin = source->tileOrigin;
+	
+	if (tileSize.v <= 0 || tileSize.h <= 0)
+		{
+		tileSize.v = kBlockRows;
+		tileSize.h = kBlockCols;
+		tileOrigin.v = limit.top;
+		tileOrigin.h = limit.left;
+		}
+	
+	blockRows = tileSize.v < kBlockMaxRows ? tileSize.v : kBlockMaxRows;
+	blockCols = tileSize.h < kBlockMaxCols ? tileSize.h : kBlockMaxCols;
+	blockBytes = blockRows * blockCols;
+	
+	/* Allocate the memory for every block in flight, in one buffer. */
+	
+	slotCount = workers->Slots ();
+	
+	gResult = AllocateBuffer ((int32) (slotCount * blockBytes * (mask != NULL ? 3 : 2)), &buffer);
+	if (gResult != noErr) return;
+	
+	data = LockBuffer (buffer, false);
+	if (data == NULL)
+		{
+		gResult = memFullErr;
+		goto CleanUp;
+		}
+	
+	slots.resize (slotCount);
+	
+	for (index = 0; index < slotCount; index++)
+		{
+		
+		slot = &slots[index];
+		
+		slot->sDesc.data = data + index * blockBytes;
+		slot->sDesc.rowBits = blockCols * 8;
+		slot->sDesc.colBits = 8;
+		slot->sDesc.bitOffset = 0;
+		slot->sDesc.depth = 8;
+		
+		slot->dDesc = slot->sDesc;
+		slot->dDesc.data = data + (slotCount + index) * blockBytes;
+		
+		slot->mDesc = slot->sDesc;
+		slot->mDesc.data = mask != NULL ? data + (2 * slotCount + index) * blockBytes : NULL;
+		
+		slot->hasMask = mask != NULL;
+		
+		idle.push_back (slot);
+		
+		}
+	
+	for (row = limit.top; row < limit.bottom; row = rowEnd)
+		{
+		
+		rowEnd = NextTileEdge (row, tileOrigin.v, tileSize.v);
+		if (rowEnd > row + blockRows) rowEnd = row + blockRows;
+		if (rowEnd > limit.bottom) rowEnd = limit.bottom;
+		
+		for (col = limit.left; col < limit.right; col = colEnd)
 			{
 			
-			VRect area;
-			PSScaling scaling;
-			VRect wrote;
+			colEnd = NextTileEdge (col, tileOrigin.h, tileSize.h);
+			if (colEnd > col + blockCols) colEnd = col + blockCols;
+			if (colEnd > limit.right) colEnd = limit.right;
 			
 			if (TestAbort ())
 				{
 				gResult = userCanceledErr;
-				return;
+				goto CleanUp;
 				}
 			
-			area.top = row;  area.bottom = row + kBlockRows;
-			area.left = col; area.right  = col + kBlockCols;
+			/* Write what is finished, and wait for a block to finish if
+			   all of them are in flight. */
 			
-			if (limit.bottom < area.bottom) area.bottom = limit.bottom;
-			if (limit.right  < area.right ) area.right  = limit.right;
+			while ((slot = idle.empty () ? workers->Finished () : workers->TryFinished ()) != NULL)
+				{
+				
+				inFlight--;
+				idle.push_back (slot);
+				
+				gResult = WriteBlock (globals, dest, slot, done, total);
+				if (gResult != noErr) goto CleanUp;
+				
+				}
 			
-			scaling.sourceRect = area;
-			scaling.destinationRect = area;
+			slot = idle.back ();
+			idle.pop_back ();
 			
-			gResult = ReadPixels (destRead, &scaling, &area, dDesc, &wrote);
-			if (gResult != noErr) return;
+			slot->area.top = row;  slot->area.bottom = rowEnd;
+			slot->area.left = col; slot->area.right  = colEnd;
 			
-			if (!EqualVRects (&area, &wrote))
-				{
-				gResult = -1;
-				return;
-				}
-				
-			gResult = ReadPixels (source->port, &scaling, &area, sDesc, &wrote);
-			if (gResult != noErr) return;
+			gResult = ReadBlock (globals, destRead, &slot->area, &slot->dDesc);
+			if (gResult != noErr) goto CleanUp;
+			
+			gResult = ReadBlock (globals, source->port, &slot->area, &slot->sDesc);
+			if (gResult != noErr) goto CleanUp;
 			
-			if (!EqualVRects (&area, &wrote))
-				{
-				gResult = -1;
-				return;
-				}
-				
 			if (mask != NULL)
 				{
-				
-				gResult = ReadPixels (mask->port, &scaling, &area, mDesc, &wrote);
-				if (gResult != noErr) return;
-				
-				if (!EqualVRects (&area, &wrote))
-					{
-					gResult = -1;
-					return;
-					}
+				gResult = ReadBlock (globals, mask->port, &slot->area, &slot->mDesc);
+				if (gResult != noErr) goto CleanUp;
 				}
-				m = (unsigned8 *) mDesc->data;
 				/* mask all set and ready to go */
-									
-			/* heart of the routine.  Compares source pixel and destination
-			   pixel and, if destination is smaller, replaces it with
-			   source */
-
-			s = (unsigned8 *) sDesc->data;
-			d = (unsigned8 *) dDesc->data;
-			r = (unsigned8 *) rDesc->data;
-						
-			for (row2 = kBlockRows; row2 > 0; --row2)
-				for (col2 = kBlockCols; col2 > 0; --col2)
-				{
-					
-					switch (gWhatArea)
-					{
-						case iSelectMin:
-							if (mask != NULL && *m < *s ) *s = *m;
-							if (*s > 127) *d = *s;
-							else *d = 0;
-							break;
-						case iSelectMax:
-							if (mask != NULL && *m < *s ) *s = *m;
-							if (*s < 128) *d = 255 - *s; // if (*d < *s) *d = *s;
-							else *d = 0;
-							break;
-						case iSelectRandom:
-							if (initRandom)
-							{
-								if ((((unsigned16) rand ()) % 100) < gPercent)
-									*r = kRandomOn; // flag as picked
-								else *r = kRandomOff; // flag as off
-							}
-							if (*r == kRandomOn)
-								*d = 255;
-							else *d = 0;
-							break;
-					}
-					++s;
-					++d;
-					++r;
-					if (mask != NULL) ++m;
-				}
-					
-			gResult = WritePixels (dest->port, &area, dDesc);
-			if (gResult != noErr) return;
 			
-			*done += (area.right - area.left) * (area.bottom - area.top);
+			/* the heart of the routine, ApplyBlock, runs on a worker */
+			
+			workers->Submit (slot);
+			inFlight++;
 			
-			PIUpdateProgress ((int32)*done, (int32)total);
-				
 			}
+		
+		}
+	
+	/* And the blocks still being computed. */
+	
+	while (inFlight > 0)
+		{
+		
+		slot = workers->Finished ();
+		inFlight--;
+		
+		gResult = WriteBlock (globals, dest, slot, done, total);
+		if (gResult != noErr) goto CleanUp;
+		
+		}
+	
+	CleanUp:
+	
+	/* Nothing more is written after an error, but the workers must be done
+	   with the memory before it goes. */
+	
+	for (; inFlight > 0; inFlight--)
+		(void) workers->Finished ();
+	
+	if (data != NULL) UnlockBuffer (buffer);
+	if (buffer != 0) FreeBuffer (buffer);
 	
 	}
 
@@ -388,16 +948,7 @@ void DoExecute (GPtr globals)
 	
 	Boolean	doThis = true;
 	
-	BufferID sBuffer = 0;
-	Ptr sData = NULL;
-	BufferID dBuffer = 0;
-	Ptr dData = NULL;
-	BufferID mBuffer = 0;
-	Ptr mData = NULL;
-	BufferID rBuffer = 0;
-	Ptr rData = NULL;
-	
-	PixelMemoryDesc sDesc, dDesc, mDesc, rDesc;
+	BlockWorkers *workers = NULL;
 
 	ReadImageDocumentDesc *doc = gStuff->documentInfo;
 	WriteChannelDesc *selection = gStuff->newSelection;
@@ -457,62 +1008,25 @@ void DoExecute (GPtr globals)
 		transparency = doc->mergedTransparency;
 	}
 			
-	/* Allocate the buffers. */
+	/* Each channel allocates the buffers for its blocks. */
 	
 	if (!WarnBufferProcsAvailable ())
 		{
 		gResult = +1;
 		goto CleanUp;
 		}
-		
-	#define kBufferSize kBlockRows * (long) kBlockCols
 	
-	gResult = AllocateBuffer (kBufferSize, &sBuffer);
-	if (gResult != noErr) goto CleanUp;
+	/* Start the threads that compute the blocks. */
 	
-	gResult = AllocateBuffer (kBufferSize, &dBuffer);
-	if (gResult != noErr) goto CleanUp;
-	
-	gResult = AllocateBuffer (kBufferSize, &rBuffer);
-	if (gResult != noErr) goto CleanUp;
-	
-	if (transparency != NULL)
+	try
 		{
-		gResult = AllocateBuffer (kBufferSize, &mBuffer);
-		if (gResult != noErr) goto CleanUp;
+		workers = new BlockWorkers (globals);
+		}
+	catch (...)
+		{
+		gResult = memFullErr;
+		goto CleanUp;
 		}
-		
-	/* Lock the buffers down. */
-	
-	sData = LockBuffer (sBuffer, false);
-	dData = LockBuffer (dBuffer, false);
-	rData = LockBuffer (rBuffer, false);
-	if (!sData || !dData || !rData) goto CleanUp;
-	if (mBuffer != 0)
-	{
-		mData = LockBuffer(mBuffer, false);
-		if (!mData) goto CleanUp;
-	}
-	
-	
-	/* Set up the pixel memory descriptors. */
-	
-	sDesc.data = sData;
-	sDesc.rowBits = kBlockCols * 8;
-	sDesc.colBits = 8;
-	sDesc.bitOffset = 0;
-	sDesc.depth = 8;
-	
-	dDesc = sDesc;
-	dDesc.data = dData;
-	
-	rDesc = sDesc;
-	rDesc.data = rData;
-	
-	mDesc = sDesc;
-	mDesc.data = mData;
-	
-	rData[0] = kInitRandom; // flag for uninitialized random buffer
 	
 	/* Count the channels to process. */
 	
@@ -547,10 +1061,10 @@ void DoExecute (GPtr globals)
 	
 	if (doc->selection != NULL)
 		{
-		ApplyChannel (globals, doc->selection, &sDesc,
-						  NULL, &mDesc,
-						  selection, selectionRead, &dDesc,
-						  &rDesc, &done, total);
+		ApplyChannel (globals, workers, doc->selection,
+						  NULL,
+						  selection, selectionRead,
+						  &done, total);
 		if (gResult != noErr) goto CleanUp;
 		}
 	
@@ -563,10 +1077,10 @@ void DoExecute (GPtr globals)
 	{
 		if (DoTarget ? curChannel->target : curChannel->shown)
 		{
-			ApplyChannel (globals, curChannel, &sDesc,
-							  transparency, &mDesc,
-							  selection, selectionRead, &dDesc,
-							  &rDesc, &done, total);
+			ApplyChannel (globals, workers, curChannel,
+							  transparency,
+							  selection, selectionRead,
+							  &done, total);
 			if (gResult != noErr) goto CleanUp;
 		}
 							  
@@ -577,10 +1091,10 @@ void DoExecute (GPtr globals)
 	if (doc->targetLayerMask != NULL &&
 	   (DoTarget ? doc->targetLayerMask->target : doc->targetLayerMask->shown))
 	{
-		ApplyChannel (globals, doc->targetLayerMask, &sDesc,
-						  NULL, &mDesc,
-						  selection, selectionRead, &dDesc,
-						  &rDesc, &done, total);
+		ApplyChannel (globals, workers, doc->targetLayerMask,
+						  NULL,
+						  selection, selectionRead,
+						  &done, total);
 		if (gResult != noErr) goto CleanUp;
 	}
 		
@@ -590,10 +1104,10 @@ void DoExecute (GPtr globals)
 	{
 		if (DoTarget ? curChannel->target : curChannel->shown)
 		{
-			ApplyChannel (globals, curChannel, &sDesc,
-							  NULL, &mDesc,
-							  selection, selectionRead, &dDesc,
-							  &rDesc, &done, total);
+			ApplyChannel (globals, workers, curChannel,
+							  NULL,
+							  selection, selectionRead,
+							  &done, total);
 			if (gResult != noErr) goto CleanUp;
 		}
 							  
@@ -602,15 +1116,7 @@ void DoExecute (GPtr globals)
 	
 	CleanUp:
 	
-	if (sData != NULL) UnlockBuffer (sBuffer);
-	if (dData != NULL) UnlockBuffer (dBuffer);
-	if (mData != NULL) UnlockBuffer (mBuffer);
-	if (rData != NULL) UnlockBuffer (rBuffer);
-	
-	if (sBuffer != 0) FreeBuffer (sBuffer);
-	if (dBuffer != 0) FreeBuffer (dBuffer);
-	if (mBuffer != 0) FreeBuffer (mBuffer);	
-	if (rBuffer != 0) FreeBuffer (rBuffer);
+	delete workers;
 	
 	WriteScriptParams(globals);
 
@@ -34,8 +34,12 @@
 /*****************************************************************************/
 /* Any constants here */
 
+/* Blocks follow the channel's tiles; the size of a block for a channel
+   without any, and the largest a block may be */
 #define kBlockRows			64
 #define kBlockCols			64
+#define kBlockMaxRows		512
+#define kBlockMaxCols		512
 
 #define kFirstItem			4
 #define kLastItem			kFirstItem+2
@@ -53,9 +57,8 @@
 #define kCreateRadio1		14
 #define kCreateRadioLast	kCreateRadio1+2
 
-#define kInitRandom			1
-#define kRandomOn			255
-#define kRandomOff			0
+/* Mixed into the random bits of every pixel */
+#define kRandomSeed			0x5E1EC7A4
 
 /*****************************************************************************/
 
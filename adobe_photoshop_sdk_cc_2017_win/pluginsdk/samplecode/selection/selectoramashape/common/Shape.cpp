@@ -33,6 +33,7 @@
 //-------------------------------------------------------------------------------
 
 #include "Shape.h"
+#include "ShapePath.h"
 
 //-------------------------------------------------------------------------------
 //	Globals -- Define global variables for plug-in scope.
@@ -231,7 +232,8 @@ void ValidateParameters (GPtr globals)
 //
 //	DoExecuteShape
 //
-//	Main routine.  In this case, pop the UI then return the path.
+//	Main routine.  In this case, pop the UI then return the path, or
+//	the selection made from it when the host can take the pixels.
 //
 //	Inputs:
 //		GPtr globals		Pointer to global structure.
@@ -246,6 +248,7 @@ void ValidateParameters (GPtr globals)
 void DoExecuteShape (GPtr globals)
 {
 	Boolean			doThis = true;
+	Boolean			newerVersion = false;
 
 	gQueryForParameters = ReadScriptParamsShape (globals);
 
@@ -265,22 +268,190 @@ void DoExecuteShape (GPtr globals)
 		
 		gStuff->treatment = KeyToEnumShape(EnumToKeyShape(gCreate,typeMyCreate),typeMyPISel);
 
+		// A selection or a layer only needs the pixels the path covers, so
+		// render them here rather than leave the host to convert the path.
+		// Hosts without the procs for it still get the path.
+		if (gCreate != iCreateMaskpath &&
+			gStuff->newSelection != NULL &&
+			gStuff->documentInfo != NULL &&
+			ChannelPortAvailable(&newerVersion) &&
+			BufferProcsAvailable(&newerVersion))
+		{
+			RenderShapeSelection (globals);
+
+			PIDisposeHandle(gStuff->newPath);
+			gStuff->newPath = NULL;
+
+			if (gResult != noErr) return;
+		}
+
 		WriteScriptParamsShape (globals);
 	} // user cancelled or dialog err or silent
 }
 
+//-------------------------------------------------------------------------------
+//
+//	NextTileEdge
+//
+//	The first row or column after position that starts a tile, for tiles
+//	of size starting at origin.
+//
+//-------------------------------------------------------------------------------
+
+static int32 NextTileEdge (int32 position, int32 origin, int32 size)
+{
+	int32 offset = (position - origin) % size;
+
+	if (offset < 0) offset += size;
+
+	return position - offset + size;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	RenderShapeSelection
+//
+//	Render the path in gStuff->newPath into the new selection, a tile at a
+//	time, as the anti-aliased mask the host would have made of it.
+//
+//	Inputs:
+//		GPtr globals		Pointer to global structure.
+//
+//	Outputs:
+//		gResult				Returns noErr if completed without error, or
+//							the error reading the path or writing the
+//							selection.
+//
+//-------------------------------------------------------------------------------
+
+void RenderShapeSelection (GPtr globals)
+{
+	ReadImageDocumentDesc * doc = gStuff->documentInfo;
+	WriteChannelDesc * selection = gStuff->newSelection;
+	VRect limit = selection->bounds;
+	VPoint tileSize = selection->tileSize;
+	VPoint tileOrigin = selection->tileOrigin;
+	ShapePath path;
+	BufferID buffer = 0;
+	PixelMemoryDesc desc;
+	int32 row, col, rowEnd, colEnd;
+	size_t done = 0, total;
+
+	gResult = ReadShapePathHandle(gStuff->handleProcs, gStuff->newPath, path);
+	if (gResult != noErr) return;
+
+	ShapeMask mask(path,
+				   doc->bounds.right - doc->bounds.left,
+				   doc->bounds.bottom - doc->bounds.top);
+
+	// Write whole tiles where the selection has them
+	if (tileSize.v <= 0 || tileSize.h <= 0)
+	{
+		tileSize.v = kShapeBlockRows;
+		tileSize.h = kShapeBlockCols;
+		tileOrigin.v = limit.top;
+		tileOrigin.h = limit.left;
+	}
+
+	gResult = AllocateBuffer(tileSize.v * tileSize.h, &buffer);
+	if (gResult != noErr) return;
+
+	desc.data = LockBuffer(buffer, false);
+	desc.rowBits = tileSize.h * 8;
+	desc.colBits = 8;
+	desc.bitOffset = 0;
+	desc.depth = 8;
+
+	if (desc.data == NULL)
+		gResult = memFullErr;
+
+	total = (size_t)(limit.right - limit.left) * (limit.bottom - limit.top);
+
+	for (row = limit.top; row < limit.bottom && gResult == noErr; row = rowEnd)
+	{
+		rowEnd = NextTileEdge(row, tileOrigin.v, tileSize.v);
+		if (rowEnd > limit.bottom) rowEnd = limit.bottom;
+
+		for (col = limit.left; col < limit.right && gResult == noErr; col = colEnd)
+		{
+			VRect area;
+
+			colEnd = NextTileEdge(col, tileOrigin.h, tileSize.h);
+			if (colEnd > limit.right) colEnd = limit.right;
+
+			if (TestAbort())
+			{
+				gResult = userCanceledErr;
+				break;
+			}
+
+			area.top = row;  area.bottom = rowEnd;
+			area.left = col; area.right = colEnd;
+
+			mask.Render(area, (uint8 *)desc.data, tileSize.h);
+
+			gResult = WritePixels(selection->port, &area, &desc);
+
+			done += (size_t)(colEnd - col) * (rowEnd - row);
+			PIUpdateProgress((int32)done, (int32)total);
+		}
+	}
+
+	if (desc.data != NULL) UnlockBuffer(buffer);
+	FreeBuffer(buffer);
+
+} // end RenderShapeSelection
+
+//-------------------------------------------------------------------------------
+//
+//	NewMadeShapeHandle
+//
+//	The shapes that are made rather than stored, in the middle half of the
+//	document like the stored ones, as a path handle the same as theirs.
+//
+//-------------------------------------------------------------------------------
+
+static Handle NewMadeShapeHandle (HandleProcs * procs, short inTreatment)
+{
+	ShapeBounds bounds = { 0.25, 0.25, 0.75, 0.75 };
+	ShapePath path;
+	path.initialFill = -1;
+
+	switch (inTreatment)
+	{
+		case iShapeHexagon:
+			AddPolygonSubpath (path, bounds, 6, 0);
+			break;
+		case iShapeBurst:
+			AddStarSubpath (path, bounds, 12, 0.4, 0);
+			break;
+		case iShapeRoundedRect:
+			AddRoundedRectSubpath (path, bounds, 0.08, 0.08);
+			break;
+		default:
+			return NULL;
+	}
+
+	return NewShapePathHandle (procs, path);
+
+} // end NewMadeShapeHandle
+
 //-------------------------------------------------------------------------------
 
 Handle GetPathHandle(HandleProcs * procs, short inTreatment)
 {
     Handle h = NULL;
-    uint8_t * pathData = NULL;
+    const uint8_t * pathData = NULL;
     size_t pathSize = 0;
+
+    if (inTreatment >= iShapeHexagon)
+        return NewMadeShapeHandle(procs, inTreatment);
+
     switch (inTreatment)
     {
         case iShapeTriangle:
         {
-        uint8_t trianglePath[] =
+        static const uint8_t trianglePath[] =
     { 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -299,7 +470,7 @@ Handle GetPathHandle(HandleProcs * procs, short inTreatment)
     
         case iShapeSquare:
         {
-        uint8_t squarePath[] =
+        static const uint8_t squarePath[] =
     { 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00,
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -319,7 +490,7 @@ Handle GetPathHandle(HandleProcs * procs, short inTreatment)
         break;
         case iShapeCircle:
         {
-    uint8_t circlePath[] =
+    static const uint8_t circlePath[] =
     {   0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -335,7 +506,7 @@ Handle GetPathHandle(HandleProcs * procs, short inTreatment)
         break;
         case iShapeStar:
         {
-        uint8_t starPath[] =
+        static const uint8_t starPath[] =
     {   0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -359,7 +530,7 @@ Handle GetPathHandle(HandleProcs * procs, short inTreatment)
         break;
         case iShapeTreble:
         {
-        uint8_t treblePath[] =
+        static const uint8_t treblePath[] =
         {   0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -450,7 +621,7 @@ Handle GetPathHandle(HandleProcs * procs, short inTreatment)
         
         case iShapeRibbon:
         {
-        uint8_t ribbonPath[] =
+        static const uint8_t ribbonPath[] =
         {   0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x00, 0x00,
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -483,7 +654,7 @@ Handle GetPathHandle(HandleProcs * procs, short inTreatment)
         
         case iShapeNote:
         {
-        uint8_t notePath[] =
+        static const uint8_t notePath[] =
         {   0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
             0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
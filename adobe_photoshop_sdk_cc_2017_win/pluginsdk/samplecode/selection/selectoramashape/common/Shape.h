@@ -32,6 +32,13 @@
 #include "PIUtilities.h"		// SDK Utility library
 #include "ShapeTerminology.h"	// Terminology for this plug-in.
 
+//-------------------------------------------------------------------------------
+//	Definitions -- Constants
+//-------------------------------------------------------------------------------
+
+#define kShapeBlockRows		128		// Tile size for a selection without tiles
+#define kShapeBlockCols		128
+
 //-------------------------------------------------------------------------------
 //	Definitions -- Enumerations
 //-------------------------------------------------------------------------------
@@ -44,7 +51,10 @@ enum
 	iShapeStar,
 	iShapeTreble,
 	iShapeRibbon,
-	iShapeNote
+	iShapeNote,
+	iShapeHexagon,		// Made with ShapePath rather than stored, and
+	iShapeBurst,		// only offered to scripting; the dialog keeps
+	iShapeRoundedRect	// to the stored shapes above
 };
 
 enum
@@ -99,6 +109,7 @@ short KeyToEnumShape (OSType key, OSType whatType);
 OSType EnumToKeyShape (short keyEnum, OSType whatType);
 
 Handle GetPathHandle(HandleProcs * procs, short inTreatment);
+void RenderShapeSelection (GPtr globals);	// Renders newPath into newSelection.
 
 //-------------------------------------------------------------------------------
 
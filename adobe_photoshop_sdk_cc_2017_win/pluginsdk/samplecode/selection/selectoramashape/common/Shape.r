@@ -172,7 +172,19 @@ resource 'aete' (ResourceID1, plugInName1 " dictionary", purgeable)
 
 				"note",						/* seventh value */
 				shapeNote,					/* 'shP6' */
-				"note path"					/* optional description */
+				"note path",				/* optional description */
+
+				"hexagon",					/* eighth value */
+				shapeHexagon,				/* 'shP7' */
+				"hexagon path",				/* optional description */
+
+				"burst",					/* ninth value */
+				shapeBurst,					/* 'shP8' */
+				"burst path",				/* optional description */
+
+				"rounded rectangle",		/* tenth value */
+				shapeRoundedRect,			/* 'shP9' */
+				"rounded rectangle path"	/* optional description */
 			},
 
 			typeMyCreate,					/* type shape 'tshP' */
@@ -0,0 +1,840 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		ShapePath.cpp
+//
+//	Description:
+//		This file contains the source and functions for the paths
+//		of the Selection module Shape.  See ShapePath.h.
+//
+//	Use:
+//		Records are read and written as described in the "Path
+//		layout" section of the Photoshop File Format.  A mask is
+//		rendered by accumulating the signed area each line covers
+//		in each pixel, then summing along the rows: the running sum
+//		is the winding number, fractional at the edges.
+//
+//-------------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------------
+//	Includes
+//-------------------------------------------------------------------------------
+
+#include "ShapePath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+	#define SHAPE_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define SHAPE_SSE2 0
+#endif
+
+//-------------------------------------------------------------------------------
+//	Definitions
+//-------------------------------------------------------------------------------
+
+#define kPathPi				3.14159265358979323846
+
+// Control points a quarter circle's radius out, for a cubic Bezier arc
+#define kPathArcKappa		0.55228474983079339840
+
+//-------------------------------------------------------------------------------
+//
+//	Records are big endian, whatever the platform.
+//
+//-------------------------------------------------------------------------------
+
+static int16 ReadInt16 (const uint8 * p)
+{
+	return (int16)((p[0] << 8) | p[1]);
+}
+
+static int32 ReadInt32 (const uint8 * p)
+{
+	return (int32)(((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8) | p[3]);
+}
+
+static void WriteInt16 (uint8 * p, int16 value)
+{
+	p[0] = (uint8)((uint16)value >> 8);
+	p[1] = (uint8)value;
+}
+
+static void WriteInt32 (uint8 * p, int32 value)
+{
+	p[0] = (uint8)((uint32)value >> 24);
+	p[1] = (uint8)((uint32)value >> 16);
+	p[2] = (uint8)((uint32)value >> 8);
+	p[3] = (uint8)value;
+}
+
+static ShapePoint ReadPoint (const uint8 * p)
+{
+	ShapePoint point;
+	point.v = ReadInt32 (p);
+	point.h = ReadInt32 (p + 4);
+	return point;
+}
+
+static void WritePoint (uint8 * p, const ShapePoint & point)
+{
+	WriteInt32 (p, point.v);
+	WriteInt32 (p + 4, point.h);
+}
+
+//-------------------------------------------------------------------------------
+//
+//	ParseShapePath
+//
+//	Read path records into a path.  Each subpath's length record is followed
+//	by that many knot records of the same kind, open or closed.  The fill
+//	rule record has nothing in it, and clipboard records and any others are
+//	skipped.
+//
+//	Inputs:
+//		const uint8 * data		The records.
+//		size_t size				Their size, a whole number of records.
+//
+//	Outputs:
+//		ShapePath & path		The subpaths, and the initial fill if there
+//								is one.
+//
+//		returns OSErr			paramErr if the records are not a path.
+//
+//-------------------------------------------------------------------------------
+
+OSErr ParseShapePath (const uint8 * data, size_t size, ShapePath & path)
+{
+	size_t remaining = 0;	// knots the current subpath has still to come
+
+	path.initialFill = -1;
+	path.subpaths.clear ();
+
+	if (size % kPathRecordSize != 0)
+		return paramErr;
+
+	for (size_t offset = 0; offset < size; offset += kPathRecordSize)
+	{
+		const uint8 * record = data + offset;
+		int16 selector = ReadInt16 (record);
+
+		switch (selector)
+		{
+			case iRecordClosedLength:
+			case iRecordOpenLength:
+				if (remaining != 0)
+					return paramErr;
+
+				path.subpaths.push_back (ShapeSubpath ());
+				path.subpaths.back ().closed = selector == iRecordClosedLength;
+
+				remaining = (uint16)ReadInt16 (record + 2);
+				path.subpaths.back ().knots.reserve (remaining);
+				break;
+
+			case iRecordClosedKnotLinked:
+			case iRecordClosedKnotUnlinked:
+			case iRecordOpenKnotLinked:
+			case iRecordOpenKnotUnlinked:
+			{
+				Boolean closed = selector < iRecordOpenLength;
+				ShapeKnot knot;
+
+				if (remaining == 0 || closed != path.subpaths.back ().closed)
+					return paramErr;
+
+				knot.preceding = ReadPoint (record + 2);
+				knot.anchor = ReadPoint (record + 10);
+				knot.leaving = ReadPoint (record + 18);
+				knot.linked = selector == iRecordClosedKnotLinked ||
+							  selector == iRecordOpenKnotLinked;
+
+				path.subpaths.back ().knots.push_back (knot);
+				remaining--;
+				break;
+			}
+
+			case iRecordInitialFill:
+				path.initialFill = ReadInt16 (record + 2);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return remaining == 0 ? noErr : paramErr;
+
+} // end ParseShapePath
+
+//-------------------------------------------------------------------------------
+//
+//	GetShapePathSize / WriteShapePath
+//
+//	Write a path as records: the fill rule record, the initial fill record
+//	if the path has one, then each subpath's length record and knots.
+//	Everything a record does not use is zero.
+//
+//-------------------------------------------------------------------------------
+
+size_t GetShapePathSize (const ShapePath & path)
+{
+	size_t records = path.initialFill >= 0 ? 2 : 1;
+
+	for (size_t s = 0; s < path.subpaths.size (); s++)
+		records += 1 + path.subpaths[s].knots.size ();
+
+	return records * kPathRecordSize;
+
+} // end GetShapePathSize
+
+void WriteShapePath (const ShapePath & path, uint8 * data)
+{
+	memset (data, 0, GetShapePathSize (path));
+
+	WriteInt16 (data, iRecordFillRule);
+	data += kPathRecordSize;
+
+	if (path.initialFill >= 0)
+	{
+		WriteInt16 (data, iRecordInitialFill);
+		WriteInt16 (data + 2, path.initialFill);
+		data += kPathRecordSize;
+	}
+
+	for (size_t s = 0; s < path.subpaths.size (); s++)
+	{
+		const ShapeSubpath & subpath = path.subpaths[s];
+
+		WriteInt16 (data, subpath.closed ? iRecordClosedLength : iRecordOpenLength);
+		WriteInt16 (data + 2, (int16)subpath.knots.size ());
+		data += kPathRecordSize;
+
+		for (size_t k = 0; k < subpath.knots.size (); k++)
+		{
+			const ShapeKnot & knot = subpath.knots[k];
+			int16 selector;
+
+			if (subpath.closed)
+				selector = knot.linked ? iRecordClosedKnotLinked : iRecordClosedKnotUnlinked;
+			else
+				selector = knot.linked ? iRecordOpenKnotLinked : iRecordOpenKnotUnlinked;
+
+			WriteInt16 (data, selector);
+			WritePoint (data + 2, knot.preceding);
+			WritePoint (data + 10, knot.anchor);
+			WritePoint (data + 18, knot.leaving);
+			data += kPathRecordSize;
+		}
+	}
+
+} // end WriteShapePath
+
+//-------------------------------------------------------------------------------
+//
+//	ReadShapePathHandle / NewShapePathHandle
+//
+//	The same, for a path in a handle, as the host takes and gives them.
+//	NewShapePathHandle returns NULL if there is not the memory.
+//
+//-------------------------------------------------------------------------------
+
+OSErr ReadShapePathHandle (HandleProcs * procs, Handle h, ShapePath & path)
+{
+	size_t size = HostGetHandleSize (procs, h);
+	Ptr p = HostLockHandle (procs, h, FALSE);
+	OSErr err;
+
+	if (p == NULL)
+		return memFullErr;
+
+	err = ParseShapePath ((const uint8 *)p, size, path);
+
+	HostUnlockHandle (procs, h);
+
+	return err;
+
+} // end ReadShapePathHandle
+
+Handle NewShapePathHandle (HandleProcs * procs, const ShapePath & path)
+{
+	Handle h = HostNewHandle (procs, GetShapePathSize (path));
+
+	if (h != NULL)
+	{
+		Ptr p = HostLockHandle (procs, h, TRUE);
+		WriteShapePath (path, (uint8 *)p);
+		HostUnlockHandle (procs, h);
+	}
+
+	return h;
+
+} // end NewShapePathHandle
+
+//-------------------------------------------------------------------------------
+//
+//	The generators work in fractions of the document, so a shape keeps its
+//	place and proportion whatever the size of the document.  Angles are in
+//	degrees, clockwise, 0 being the top of the bounds.
+//
+//-------------------------------------------------------------------------------
+
+static ShapePoint MakePoint (double v, double h)
+{
+	ShapePoint point;
+	point.v = (int32)floor (v * kPathFixedOne + 0.5);
+	point.h = (int32)floor (h * kPathFixedOne + 0.5);
+	return point;
+}
+
+static ShapeKnot MakeKnot (const ShapePoint & preceding,
+						   const ShapePoint & anchor,
+						   const ShapePoint & leaving,
+						   Boolean linked)
+{
+	ShapeKnot knot;
+	knot.preceding = preceding;
+	knot.anchor = anchor;
+	knot.leaving = leaving;
+	knot.linked = linked;
+	return knot;
+}
+
+// A corner, with no curve into it or out of it
+static ShapeKnot MakeCorner (double v, double h)
+{
+	ShapePoint anchor = MakePoint (v, h);
+	return MakeKnot (anchor, anchor, anchor, false);
+}
+
+// Corners around the ellipse in bounds, every other one scale times as far out
+static void AddRadialSubpath (ShapePath & path, const ShapeBounds & bounds,
+							  int16 corners, double scale, double rotation)
+{
+	double centerV = (bounds.top + bounds.bottom) / 2;
+	double centerH = (bounds.left + bounds.right) / 2;
+	double radiusV = (bounds.bottom - bounds.top) / 2;
+	double radiusH = (bounds.right - bounds.left) / 2;
+
+	path.subpaths.push_back (ShapeSubpath ());
+	path.subpaths.back ().closed = true;
+
+	for (int16 c = 0; c < corners; c++)
+	{
+		double angle = (rotation + 360.0 * c / corners) * kPathPi / 180;
+		double out = (c & 1) ? scale : 1;
+
+		path.subpaths.back ().knots.push_back (
+			MakeCorner (centerV - radiusV * out * cos (angle),
+						centerH + radiusH * out * sin (angle)));
+	}
+}
+
+//-------------------------------------------------------------------------------
+//
+//	AddPolygonSubpath
+//
+//	Add a polygon with its corners on the ellipse in bounds, the first at
+//	rotation.  At least 3 sides.
+//
+//-------------------------------------------------------------------------------
+
+void AddPolygonSubpath (ShapePath & path, const ShapeBounds & bounds,
+						int16 sides, double rotation)
+{
+	AddRadialSubpath (path, bounds, sides < 3 ? 3 : sides, 1, rotation);
+
+} // end AddPolygonSubpath
+
+//-------------------------------------------------------------------------------
+//
+//	AddStarSubpath
+//
+//	Add a star with its points on the ellipse in bounds, the first at
+//	rotation.  As with the Polygon tool, the sides are indented by a
+//	fraction of the radius: 0 is a polygon of twice the points, and the
+//	points get sharper towards 1.  At least 2 points.
+//
+//-------------------------------------------------------------------------------
+
+void AddStarSubpath (ShapePath & path, const ShapeBounds & bounds,
+					 int16 points, double indent, double rotation)
+{
+	if (indent < 0) indent = 0;
+	if (indent > 1) indent = 1;
+
+	AddRadialSubpath (path, bounds, 2 * (points < 2 ? 2 : points), 1 - indent, rotation);
+
+} // end AddStarSubpath
+
+//-------------------------------------------------------------------------------
+//
+//	AddRoundedRectSubpath
+//
+//	Add the rectangle of bounds, its corners rounded by quarter ellipses of
+//	the radii, which are fractions of the document as the bounds are.  The
+//	radii are cut to half the sides; with either at 0 the corners are
+//	square.
+//
+//-------------------------------------------------------------------------------
+
+void AddRoundedRectSubpath (ShapePath & path, const ShapeBounds & bounds,
+							double radiusV, double radiusH)
+{
+	double top = bounds.top, left = bounds.left;
+	double bottom = bounds.bottom, right = bounds.right;
+
+	radiusV = std::min (radiusV, (bottom - top) / 2);
+	radiusH = std::min (radiusH, (right - left) / 2);
+
+	path.subpaths.push_back (ShapeSubpath ());
+	path.subpaths.back ().closed = true;
+
+	std::vector<ShapeKnot> & knots = path.subpaths.back ().knots;
+
+	if (radiusV <= 0 || radiusH <= 0)
+	{
+		knots.push_back (MakeCorner (top, left));
+		knots.push_back (MakeCorner (top, right));
+		knots.push_back (MakeCorner (bottom, right));
+		knots.push_back (MakeCorner (bottom, left));
+		return;
+	}
+
+	// Each corner is a curve between two knots, clockwise from the top left
+	double arcV = radiusV * (1 - kPathArcKappa);
+	double arcH = radiusH * (1 - kPathArcKappa);
+
+	ShapePoint anchor;
+
+	anchor = MakePoint (top, left + radiusH);
+	knots.push_back (MakeKnot (MakePoint (top, left + arcH), anchor, anchor, true));
+
+	anchor = MakePoint (top, right - radiusH);
+	knots.push_back (MakeKnot (anchor, anchor, MakePoint (top, right - arcH), true));
+
+	anchor = MakePoint (top + radiusV, right);
+	knots.push_back (MakeKnot (MakePoint (top + arcV, right), anchor, anchor, true));
+
+	anchor = MakePoint (bottom - radiusV, right);
+	knots.push_back (MakeKnot (anchor, anchor, MakePoint (bottom - arcV, right), true));
+
+	anchor = MakePoint (bottom, right - radiusH);
+	knots.push_back (MakeKnot (MakePoint (bottom, right - arcH), anchor, anchor, true));
+
+	anchor = MakePoint (bottom, left + radiusH);
+	knots.push_back (MakeKnot (anchor, anchor, MakePoint (bottom, left + arcH), true));
+
+	anchor = MakePoint (bottom - radiusV, left);
+	knots.push_back (MakeKnot (MakePoint (bottom - arcV, left), anchor, anchor, true));
+
+	anchor = MakePoint (top + radiusV, left);
+	knots.push_back (MakeKnot (anchor, anchor, MakePoint (top + arcV, left), true));
+
+} // end AddRoundedRectSubpath
+
+//-------------------------------------------------------------------------------
+//
+//	ShapeMask::ShapeMask
+//
+//	Flatten a path to lines in the pixels of a document width by height.
+//	Paths are filled as if closed, so an open subpath gets a line back to
+//	its first knot.
+//
+//-------------------------------------------------------------------------------
+
+ShapeMask::ShapeMask (const ShapePath & path, int32 inWidth, int32 inHeight)
+	: width (inWidth), height (inHeight)
+{
+	for (size_t s = 0; s < path.subpaths.size (); s++)
+	{
+		const std::vector<ShapeKnot> & knots = path.subpaths[s].knots;
+		size_t count = knots.size ();
+
+		for (size_t k = 0; k + 1 < count; k++)
+			AddCurve (knots[k], knots[k + 1]);
+
+		if (count == 0)
+			continue;
+
+		if (path.subpaths[s].closed)
+		{
+			AddCurve (knots[count - 1], knots[0]);
+		}
+		else
+		{
+			AddLine ((double)knots[count - 1].anchor.v / kPathFixedOne * height,
+					 (double)knots[count - 1].anchor.h / kPathFixedOne * width,
+					 (double)knots[0].anchor.v / kPathFixedOne * height,
+					 (double)knots[0].anchor.h / kPathFixedOne * width);
+		}
+	}
+
+	std::sort (edges.begin (), edges.end (),
+			   [] (const Edge & a, const Edge & b) { return a.top < b.top; });
+
+	// Whole pixels around the lines, inside the document
+	double top = height, left = width, bottom = 0, right = 0;
+
+	for (size_t e = 0; e < edges.size (); e++)
+	{
+		top = std::min (top, edges[e].top);
+		bottom = std::max (bottom, edges[e].bottom);
+		left = std::min (left, std::min (edges[e].left, edges[e].right));
+		right = std::max (right, std::max (edges[e].left, edges[e].right));
+	}
+
+	bounds.top = (int32)floor (std::max (top, 0.0));
+	bounds.left = (int32)floor (std::max (left, 0.0));
+	bounds.bottom = (int32)ceil (std::min (bottom, (double)height));
+	bounds.right = (int32)ceil (std::min (right, (double)width));
+
+	if (bounds.bottom <= bounds.top || bounds.right <= bounds.left)
+		bounds.top = bounds.left = bounds.bottom = bounds.right = 0;
+
+} // end ShapeMask::ShapeMask
+
+//-------------------------------------------------------------------------------
+
+void ShapeMask::AddLine (double v0, double h0, double v1, double h1)
+{
+	Edge edge;
+
+	// Lines along a row have no area
+	if (v0 == v1)
+		return;
+
+	if (v0 < v1)
+	{
+		edge.top = v0; edge.left = h0;
+		edge.bottom = v1; edge.right = h1;
+		edge.direction = 1;
+	}
+	else
+	{
+		edge.top = v1; edge.left = h1;
+		edge.bottom = v0; edge.right = h0;
+		edge.direction = -1;
+	}
+
+	edges.push_back (edge);
+}
+
+//-------------------------------------------------------------------------------
+//
+//	ShapeMask::AddCurve
+//
+//	Flatten the curve from one knot to the next in even steps.  A cubic
+//	strays from its chords by at most 3/4 of its largest second difference
+//	over the steps squared, so that sets the steps for kPathFlatness.
+//
+//-------------------------------------------------------------------------------
+
+void ShapeMask::AddCurve (const ShapeKnot & from, const ShapeKnot & to)
+{
+	double v[4], h[4];
+
+	v[0] = from.anchor.v;	h[0] = from.anchor.h;
+	v[1] = from.leaving.v;	h[1] = from.leaving.h;
+	v[2] = to.preceding.v;	h[2] = to.preceding.h;
+	v[3] = to.anchor.v;		h[3] = to.anchor.h;
+
+	for (int p = 0; p < 4; p++)
+	{
+		v[p] = v[p] / kPathFixedOne * height;
+		h[p] = h[p] / kPathFixedOne * width;
+	}
+
+	double bend = std::max (hypot (v[0] - 2 * v[1] + v[2], h[0] - 2 * h[1] + h[2]),
+							hypot (v[1] - 2 * v[2] + v[3], h[1] - 2 * h[2] + h[3]));
+	double steps = ceil (sqrt (0.75 * bend / kPathFlatness));
+	int32 count = steps < 1 ? 1 : steps > kPathMaxSteps ? kPathMaxSteps : (int32)steps;
+
+	double lastV = v[0], lastH = h[0];
+
+	for (int32 s = 1; s <= count; s++)
+	{
+		double t = (double)s / count, u = 1 - t;
+		double nextV, nextH;
+
+		if (s == count)
+		{
+			nextV = v[3];
+			nextH = h[3];
+		}
+		else
+		{
+			nextV = u * u * u * v[0] + 3 * u * u * t * v[1] + 3 * u * t * t * v[2] + t * t * t * v[3];
+			nextH = u * u * u * h[0] + 3 * u * u * t * h[1] + 3 * u * t * t * h[2] + t * t * t * h[3];
+		}
+
+		AddLine (lastV, lastH, nextV, nextH);
+
+		lastV = nextV;
+		lastH = nextH;
+	}
+
+} // end ShapeMask::AddCurve
+
+//-------------------------------------------------------------------------------
+//
+//	ShapeMask::AccumulateLine
+//
+//	Add the signed area a line covers to each pixel of the rows it crosses,
+//	in the area's coordinates.  v0 is above v1 and both h are in 0 to cols,
+//	so everything lands in a row's cols + 2 entries; the area to the right
+//	of the line goes into the pixel after, where the row sum picks it up.
+//
+//-------------------------------------------------------------------------------
+
+void ShapeMask::AccumulateLine (float v0, float h0, float v1, float h1,
+								float direction, int32 rows, int32 cols)
+{
+	const float limit = (float)cols;
+	float slope = (h1 - h0) / (v1 - v0);
+	float h = h0;
+	int32 row, end;
+
+	if (v0 < 0)
+	{
+		h = std::min (std::max (h0 - v0 * slope, 0.0f), limit);
+		row = 0;
+	}
+	else
+	{
+		row = (int32)v0;
+	}
+
+	end = v1 < rows ? (int32)ceil (v1) : rows;
+
+	for (; row < end; row++)
+	{
+		float * line = &cover[(size_t)row * (cols + 2)];
+		float dv = std::min ((float)(row + 1), v1) - std::max ((float)row, v0);
+		float next = std::min (std::max (h + slope * dv, 0.0f), limit);
+		float d = dv * direction;
+		float x0 = std::min (h, next);
+		float x1 = std::max (h, next);
+		int32 first = (int32)x0;
+		int32 last = (int32)ceil (x1);
+
+		if (last <= first + 1)
+		{
+			// Within one pixel: split by where the line is on average
+			float middle = 0.5f * (h + next) - first;
+
+			line[first] += d - d * middle;
+			line[first + 1] += d * middle;
+		}
+		else
+		{
+			// Across several: a triangle in the first and last pixels,
+			// and an even share of the area in each between
+			float share = 1.0f / (x1 - x0);
+			float x0f = x0 - first;
+			float x1f = x1 - last + 1;
+			float a0 = 0.5f * share * (1 - x0f) * (1 - x0f);
+			float am = 0.5f * share * x1f * x1f;
+
+			line[first] += d * a0;
+
+			if (last == first + 2)
+			{
+				line[first + 1] += d * (1 - a0 - am);
+			}
+			else
+			{
+				float a1 = share * (1.5f - x0f);
+
+				line[first + 1] += d * (a1 - a0);
+
+				for (int32 col = first + 2; col < last - 1; col++)
+					line[col] += d * share;
+
+				float a2 = a1 + (last - first - 3) * share;
+				line[last - 1] += d * (1 - a2 - am);
+			}
+
+			line[last] += d * am;
+		}
+
+		h = next;
+	}
+
+} // end ShapeMask::AccumulateLine
+
+//-------------------------------------------------------------------------------
+//
+//	The coverage of a pixel by the even-odd rule: the winding number taken
+//	modulo 2 and folded, so 1 and 3 are inside, 0 and 2 out, and the
+//	fractions at the edges in between.
+//
+//-------------------------------------------------------------------------------
+
+static inline uint8 EvenOddCoverage (float winding)
+{
+	float w = fabsf (winding);
+	float whole = (float)(int32)(w * 0.5f);
+
+	w = w - (whole + whole);
+	w = std::min (w, 2.0f - w);
+	w = std::max (w, 0.0f);
+
+	return (uint8)(int32)(w * 255.0f + 0.5f);
+}
+
+//-------------------------------------------------------------------------------
+//
+//	Sum a row of signed areas into coverage, clearing them for the next
+//	area.  With SSE2 four pixels are summed at once: each adds the one
+//	before it, then the two before, then the total so far.
+//
+//-------------------------------------------------------------------------------
+
+static void AccumulateRow (float * cover, uint8 * mask, int32 cols)
+{
+	float winding = 0;
+	int32 col = 0;
+
+#if SHAPE_SSE2
+	const __m128 zero = _mm_setzero_ps ();
+	const __m128 sign = _mm_set1_ps (-0.0f);
+	const __m128 half = _mm_set1_ps (0.5f);
+	const __m128 two = _mm_set1_ps (2.0f);
+	const __m128 scale = _mm_set1_ps (255.0f);
+	__m128 total = zero;
+
+	for (; col + 4 <= cols; col += 4)
+	{
+		__m128 w = _mm_loadu_ps (cover + col);
+		__m128 whole;
+		__m128i bytes;
+
+		w = _mm_add_ps (w, _mm_castsi128_ps (_mm_slli_si128 (_mm_castps_si128 (w), 4)));
+		w = _mm_add_ps (w, _mm_castsi128_ps (_mm_slli_si128 (_mm_castps_si128 (w), 8)));
+		w = _mm_add_ps (w, total);
+		total = _mm_shuffle_ps (w, w, _MM_SHUFFLE (3, 3, 3, 3));
+
+		_mm_storeu_ps (cover + col, zero);
+
+		w = _mm_andnot_ps (sign, w);
+		whole = _mm_cvtepi32_ps (_mm_cvttps_epi32 (_mm_mul_ps (w, half)));
+		w = _mm_sub_ps (w, _mm_add_ps (whole, whole));
+		w = _mm_min_ps (w, _mm_sub_ps (two, w));
+		w = _mm_max_ps (w, zero);
+
+		bytes = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (w, scale), half));
+		bytes = _mm_packs_epi32 (bytes, bytes);
+		bytes = _mm_packus_epi16 (bytes, bytes);
+
+		int32 four = _mm_cvtsi128_si32 (bytes);
+		memcpy (mask + col, &four, 4);
+	}
+
+	winding = _mm_cvtss_f32 (total);
+#endif
+
+	for (; col < cols; col++)
+	{
+		winding += cover[col];
+		cover[col] = 0;
+		mask[col] = EvenOddCoverage (winding);
+	}
+
+	// And what fell to the right of the area
+	cover[cols] = 0;
+	cover[cols + 1] = 0;
+}
+
+//-------------------------------------------------------------------------------
+//
+//	ShapeMask::Render
+//
+//	The coverage of each pixel of an area, 0 to 255, into mask.  Lines are
+//	cut where they cross the area's left and right sides; the parts outside
+//	are moved onto the sides, so a line to the left still counts for the
+//	whole row and one to the right for none of it.
+//
+//-------------------------------------------------------------------------------
+
+void ShapeMask::Render (const VRect & area, uint8 * mask, int32 rowBytes)
+{
+	int32 rows = area.bottom - area.top;
+	int32 cols = area.right - area.left;
+
+	if (rows <= 0 || cols <= 0)
+		return;
+
+	if (area.bottom <= bounds.top || area.top >= bounds.bottom ||
+		area.right <= bounds.left || area.left >= bounds.right)
+	{
+		for (int32 row = 0; row < rows; row++)
+			memset (mask + (size_t)row * rowBytes, 0, cols);
+		return;
+	}
+
+	// Always all zeros between areas, so only what is added needs clearing
+	size_t needed = (size_t)rows * (cols + 2);
+	if (cover.size () < needed)
+		cover.resize (needed, 0);
+
+	for (size_t e = 0; e < edges.size () && edges[e].top < area.bottom; e++)
+	{
+		const Edge & edge = edges[e];
+
+		if (edge.bottom <= area.top)
+			continue;
+
+		// Split at the sides, in the document's coordinates
+		double v[4], h[4];
+		int32 points = 0;
+
+		v[points] = edge.top; h[points] = edge.left; points++;
+
+		double sides[2] = { (double)area.left, (double)area.right };
+		if (edge.right < edge.left)
+			std::swap (sides[0], sides[1]);
+
+		for (int s = 0; s < 2; s++)
+			if ((edge.left - sides[s]) * (edge.right - sides[s]) < 0)
+			{
+				double t = (sides[s] - edge.left) / (edge.right - edge.left);
+				v[points] = edge.top + t * (edge.bottom - edge.top);
+				h[points] = sides[s];
+				points++;
+			}
+
+		v[points] = edge.bottom; h[points] = edge.right; points++;
+
+		for (int32 p = 0; p + 1 < points; p++)
+		{
+			float v0 = (float)(v[p] - area.top);
+			float v1 = (float)(v[p + 1] - area.top);
+			float h0 = (float)std::min (std::max (h[p] - area.left, 0.0), (double)cols);
+			float h1 = (float)std::min (std::max (h[p + 1] - area.left, 0.0), (double)cols);
+
+			if (v0 < v1)
+				AccumulateLine (v0, h0, v1, h1, edge.direction, rows, cols);
+		}
+	}
+
+	for (int32 row = 0; row < rows; row++)
+		AccumulateRow (&cover[(size_t)row * (cols + 2)], mask + (size_t)row * rowBytes, cols);
+
+} // end ShapeMask::Render
+
+// end ShapePath.cpp
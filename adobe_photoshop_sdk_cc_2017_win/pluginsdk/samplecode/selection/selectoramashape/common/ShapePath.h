@@ -0,0 +1,160 @@
+// ADOBE SYSTEMS INCORPORATED
+// Copyright  1993 - 2002 Adobe Systems Incorporated
+// All Rights Reserved
+//
+// NOTICE:  Adobe permits you to use, modify, and distribute this
+// file in accordance with the terms of the Adobe license agreement
+// accompanying it.  If you have received this file from a source
+// other than Adobe, then your use, modification, or distribution
+// of it requires the prior written permission of Adobe.
+//-------------------------------------------------------------------
+//-------------------------------------------------------------------------------
+//
+//	File:
+//		ShapePath.h
+//
+//	Description:
+//		This file contains the structures and prototypes for the
+//		paths of the Selection module Shape: reading and writing
+//		path records, making polygons, stars and rounded rectangles,
+//		and turning a path into mask pixels without the host.
+//
+//	Use:
+//		A path is the "Path" resource as defined in the "Path layout"
+//		section of the Photoshop File Format, a list of 26 byte
+//		records.  ShapeMask renders any area of one for a document
+//		of a given size, anti-aliased, with the even-odd rule that
+//		paths are filled with.
+//
+//-------------------------------------------------------------------------------
+
+#ifndef __ShapePath_H__			// Has this not been defined yet?
+#define __ShapePath_H__			// Only include this once by predefining it
+
+#include "PIUtilities.h"		// SDK Utility library
+
+#include <vector>
+
+//-------------------------------------------------------------------------------
+//	Definitions -- Constants
+//-------------------------------------------------------------------------------
+
+#define kPathRecordSize			26			// Bytes in each record, big endian
+#define kPathFixedOne			0x01000000	// 1.0 in the 8.24 fixed point of a point
+
+#define kPathFlatness			0.02		// Pixels a flattened curve may stray
+#define kPathMaxSteps			1024		// Most lines a curve is flattened to
+
+enum
+{ // The selector that starts each record:
+	iRecordClosedLength,
+	iRecordClosedKnotLinked,
+	iRecordClosedKnotUnlinked,
+	iRecordOpenLength,
+	iRecordOpenKnotLinked,
+	iRecordOpenKnotUnlinked,
+	iRecordFillRule,
+	iRecordClipboard,
+	iRecordInitialFill
+};
+
+//-------------------------------------------------------------------------------
+//	Definitions -- Structures
+//-------------------------------------------------------------------------------
+
+// A point of a path in 8.24 fixed point, as fractions of the document's
+// height and width, vertical first as in the records.
+typedef struct ShapePoint
+{
+	int32	v;
+	int32	h;
+} ShapePoint;
+
+// A Bezier knot: its anchor, and the control points of the curves
+// coming into it and leaving it.
+typedef struct ShapeKnot
+{
+	ShapePoint	preceding;
+	ShapePoint	anchor;
+	ShapePoint	leaving;
+	Boolean		linked;
+} ShapeKnot;
+
+typedef struct ShapeSubpath
+{
+	Boolean					closed;
+	std::vector<ShapeKnot>	knots;
+} ShapeSubpath;
+
+typedef struct ShapePath
+{
+	int16						initialFill;	// -1 without an initial fill record
+	std::vector<ShapeSubpath>	subpaths;
+} ShapePath;
+
+// Where a made shape goes, in fractions of the document's height and width.
+typedef struct ShapeBounds
+{
+	double	top;
+	double	left;
+	double	bottom;
+	double	right;
+} ShapeBounds;
+
+//-------------------------------------------------------------------------------
+//	Definitions -- Classes
+//-------------------------------------------------------------------------------
+
+// A path flattened to lines in the pixels of one document size.  Render
+// gives the coverage of each pixel of an area, 0 to 255, so a mask can be
+// made a tile at a time with the lines kept between tiles.
+class ShapeMask
+{
+public:
+	ShapeMask (const ShapePath & path, int32 width, int32 height);
+
+	void Render (const VRect & area, uint8 * mask, int32 rowBytes);
+
+	// The pixels the path touches; everything outside is 0.
+	const VRect & Bounds (void) const { return bounds; }
+
+private:
+	typedef struct Edge
+	{
+		double	top, left;			// the end with the smaller v
+		double	bottom, right;
+		float	direction;			// 1 going down, -1 going up
+	} Edge;
+
+	void AddLine (double v0, double h0, double v1, double h1);
+	void AddCurve (const ShapeKnot & from, const ShapeKnot & to);
+	void AccumulateLine (float v0, float h0, float v1, float h1,
+						 float direction, int32 rows, int32 cols);
+
+	int32 width, height;
+	VRect bounds;
+	std::vector<Edge> edges;		// sorted by top
+	std::vector<float> cover;		// the area's rows, a cols + 2 stride
+};
+
+//-------------------------------------------------------------------------------
+//	Prototypes
+//-------------------------------------------------------------------------------
+
+OSErr ParseShapePath (const uint8 * data, size_t size, ShapePath & path);
+size_t GetShapePathSize (const ShapePath & path);
+void WriteShapePath (const ShapePath & path, uint8 * data);
+
+OSErr ReadShapePathHandle (HandleProcs * procs, Handle h, ShapePath & path);
+Handle NewShapePathHandle (HandleProcs * procs, const ShapePath & path);
+
+void AddPolygonSubpath (ShapePath & path, const ShapeBounds & bounds,
+						int16 sides, double rotation);
+void AddStarSubpath (ShapePath & path, const ShapeBounds & bounds,
+					 int16 points, double indent, double rotation);
+void AddRoundedRectSubpath (ShapePath & path, const ShapeBounds & bounds,
+							double radiusV, double radiusH);
+
+//-------------------------------------------------------------------------------
+
+#endif // __ShapePath_H__
@@ -229,6 +229,15 @@ short KeyToEnumShape (OSType key, OSType whatType)
 				case shapeNote:
 					outValue = iShapeNote;
 					break;
+				case shapeHexagon:
+					outValue = iShapeHexagon;
+					break;
+				case shapeBurst:
+					outValue = iShapeBurst;
+					break;
+				case shapeRoundedRect:
+					outValue = iShapeRoundedRect;
+					break;
 			}
 			break;
 		case typeMyCreate:
@@ -297,6 +306,15 @@ OSType EnumToKeyShape (short keyEnum, OSType whatType)
 				case iShapeNote:
 					outValue = shapeNote;
 					break;
+				case iShapeHexagon:
+					outValue = shapeHexagon;
+					break;
+				case iShapeBurst:
+					outValue = shapeBurst;
+					break;
+				case iShapeRoundedRect:
+					outValue = shapeRoundedRect;
+					break;
 			}
 			break;
 		case typeMyCreate:
@@ -42,6 +42,9 @@
 #define shapeTreble			'shP4'
 #define	shapeRibbon			'shP5'
 #define shapeNote			'shP6'
+#define shapeHexagon		'shP7'
+#define shapeBurst			'shP8'
+#define shapeRoundedRect	'shP9'
 #define typeMyShape			'tshP'
 #define keyMyShape			keyShape
 #define keyMyCreate			'kcrE'
@@ -65,10 +65,11 @@ ShapeController *gShapeController = NULL;
     [shapeRibbonID setState:false];
     [shapeNoteID setState:false];
     
+    // a made shape from scripting has no button, and is kept unless
+    // another shape is picked
     switch (shapeOpt)
     {
         case iShapeTriangle:
-        default:
             [shapeTriangleID setState:true];
             break;
         case iShapeSquare:
@@ -89,6 +90,8 @@ ShapeController *gShapeController = NULL;
         case iShapeNote:
             [shapeNoteID setState:true];
             break;
+        default:
+            break;
     }
     
     shapeOption = shapeOpt;
@@ -54,10 +54,13 @@ DLLExport BOOL WINAPI ShapeProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lPar
 			
 			CenterDialog(hDlg); // CenterWindow(hDlg, CW_BOTH);
 			
-			SetRadioGroupState(hDlg,
-							   kDFirstItem,
-							   kDLastItem,
-							   kDFirstItem + gWhatShape);
+			/* a made shape from scripting has no button, and is kept
+			   unless another shape is picked */
+			if (kDFirstItem + gWhatShape <= kDLastItem)
+				SetRadioGroupState(hDlg,
+								   kDFirstItem,
+								   kDLastItem,
+								   kDFirstItem + gWhatShape);
 			SetRadioGroupState(hDlg,
 							   kDCreateRadio1,
 							   kDCreateRadioLast,
@@ -78,8 +81,9 @@ DLLExport BOOL WINAPI ShapeProc(HWND hDlg, UINT wMsg, WPARAM wParam, LPARAM lPar
 				switch  (idd)
 				{
 					case OK:
-						gWhatShape = GetRadioGroupState(hDlg, kDFirstItem, kDLastItem)
-									 - kDFirstItem;
+						if (GetRadioGroupState(hDlg, kDFirstItem, kDLastItem) != 0)
+							gWhatShape = GetRadioGroupState(hDlg, kDFirstItem, kDLastItem)
+										 - kDFirstItem;
 						gCreate = GetRadioGroupState(hDlg, kDCreateRadio1, kDCreateRadioLast)
 								  - kDCreateRadio1;
 						EndDialog(hDlg, idd);